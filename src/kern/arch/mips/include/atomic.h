@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _MIPS_ATOMIC_H_
+#define _MIPS_ATOMIC_H_
+
+/*
+ * Atomic operations for MIPS, using LL/SC as in spinlock.h (see the
+ * notes there). The read-modify-write operations retry until the SC
+ * succeeds, and have a sync on each side to make them full barriers.
+ *
+ * See include/atomic.h for further information.
+ */
+
+#include <membar.h>
+#include <spinlock.h>	/* for spinlock_data_cas */
+
+/*
+ * Loads and stores of an aligned word are single instructions, and
+ * instructions are atomic with respect to memory.
+ */
+ATOMIC_INLINE
+int
+atomic_load(const struct atomic *a)
+{
+	return a->at_val;
+}
+
+ATOMIC_INLINE
+void
+atomic_store(struct atomic *a, int val)
+{
+	a->at_val = val;
+}
+
+ATOMIC_INLINE
+int
+atomic_fetchadd(struct atomic *a, int inc)
+{
+	int x;
+	int y;
+
+	membar_any_any();
+	do {
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%2);"		/*   x = a->at_val */
+			"addu %1, %0, %3;"	/*   y = x + inc */
+			"sc %1, 0(%2);"		/*   a->at_val = y; y = success? */
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "=&r" (y) : "r" (&a->at_val), "r" (inc)
+			: "memory");
+	} while (y == 0);
+	membar_any_any();
+
+	return x;
+}
+
+/*
+ * Compare-and-swap is exactly spinlock_data_cas (the compare has to
+ * sit between the LL and the SC, so it lives in one asm block there);
+ * wrap it in the barriers. spinlock_data_t is an unsigned word, so the
+ * int can be accessed through it.
+ */
+ATOMIC_INLINE
+bool
+atomic_cas(struct atomic *a, int oldval, int newval)
+{
+	bool ret;
+
+	membar_any_any();
+	ret = spinlock_data_cas((volatile spinlock_data_t *)&a->at_val,
+				(spinlock_data_t)oldval,
+				(spinlock_data_t)newval);
+	membar_any_any();
+
+	return ret;
+}
+
+ATOMIC_INLINE
+int
+atomic_xchg(struct atomic *a, int newval)
+{
+	int x;
+	int y;
+
+	membar_any_any();
+	do {
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%2);"		/*   x = a->at_val */
+			"move %1, %3;"		/*   y = newval */
+			"sc %1, 0(%2);"		/*   a->at_val = y; y = success? */
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "=&r" (y) : "r" (&a->at_val), "r" (newval)
+			: "memory");
+	} while (y == 0);
+	membar_any_any();
+
+	return x;
+}
+
+#endif /* _MIPS_ATOMIC_H_ */
@@ -46,6 +46,12 @@ SPINLOCK_INLINE
 spinlock_data_t spinlock_data_get(volatile spinlock_data_t *sd);
 SPINLOCK_INLINE
 spinlock_data_t spinlock_data_testandset(volatile spinlock_data_t *sd);
+SPINLOCK_INLINE
+spinlock_data_t spinlock_data_fetchadd(volatile spinlock_data_t *sd,
+				       unsigned inc);
+SPINLOCK_INLINE
+bool spinlock_data_cas(volatile spinlock_data_t *sd,
+		       spinlock_data_t oldval, spinlock_data_t newval);
 
 ////////////////////////////////////////////////////////////
 
@@ -118,5 +124,69 @@ spinlock_data_testandset(volatile spinlock_data_t *sd)
 	return x;
 }
 
+/*
+ * Atomically add INC to a spinlock_data_t and return the old value.
+ * Also uses LL/SC; unlike test-and-set, retry until the SC succeeds.
+ * The add is a register operation, so there's still no memory access
+ * between the LL and the SC.
+ */
+SPINLOCK_INLINE
+spinlock_data_t
+spinlock_data_fetchadd(volatile spinlock_data_t *sd, unsigned inc)
+{
+	spinlock_data_t x;
+	spinlock_data_t y;
+
+	do {
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%2);"		/*   x = *sd */
+			"addu %1, %0, %3;"	/*   y = x + inc */
+			"sc %1, 0(%2);"		/*   *sd = y; y = success? */
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "=&r" (y) : "r" (sd), "r" (inc));
+	} while (y == 0);
+
+	return x;
+}
+
+/*
+ * Compare-and-swap a spinlock_data_t: if it contains OLDVAL, replace
+ * it with NEWVAL and return true; otherwise return false. The compare
+ * happens between the LL and the SC, so it has to be in the same asm
+ * block; the branch delay slot clears Y so a mismatch looks like a
+ * failed SC. Retry only if the SC itself failed.
+ */
+SPINLOCK_INLINE
+bool
+spinlock_data_cas(volatile spinlock_data_t *sd,
+		  spinlock_data_t oldval, spinlock_data_t newval)
+{
+	spinlock_data_t x;
+	spinlock_data_t y;
+
+	do {
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set noreorder;"	/* we fill the delay slot */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%2);"		/*   x = *sd */
+			"bne %0, %3, 1f;"	/*   if (x != oldval) fail */
+			"li %1, 0;"		/*   y = 0 (delay slot) */
+			"move %1, %4;"		/*   y = newval */
+			"sc %1, 0(%2);"		/*   *sd = y; y = success? */
+			"1:"
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "=&r" (y)
+			: "r" (sd), "r" (oldval), "r" (newval)
+			: "memory");
+	} while (x == oldval && y == 0);
+
+	return x == oldval;
+}
+
 
 #endif /* _MIPS_SPINLOCK_H_ */
@@ -38,6 +38,7 @@
 #include <current.h>
 #include <vm.h>
 #include <mainbus.h>
+#include <softirq.h>
 #include <syscall.h>
 
 
@@ -188,6 +189,15 @@ mips_trap(struct trapframe *tf)
 		mainbus_interrupt(tf);
 
 		if (doadjust) {
+			/*
+			 * We interrupted code running at spl0, so
+			 * nothing stops us running the drivers'
+			 * softirqs now, with interrupts back on.
+			 * Otherwise they wait until the spl drops or
+			 * the CPU goes idle.
+			 */
+			softirq_run(true);
+
 			KASSERT(curthread->t_curspl == IPL_HIGH);
 			KASSERT(curthread->t_iplhigh_count == 1);
 			curthread->t_iplhigh_count--;
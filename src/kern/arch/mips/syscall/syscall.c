@@ -109,6 +109,39 @@ syscall(struct trapframe *tf)
 				 (userptr_t)tf->tf_a1);
 		break;
 
+	    case SYS_getrusage:
+		err = sys_getrusage(tf->tf_a0, (userptr_t)tf->tf_a1);
+		break;
+
+	    case SYS_nanosleep:
+		err = sys_nanosleep((userptr_t)tf->tf_a0,
+				    (userptr_t)tf->tf_a1);
+		break;
+
+	    case SYS___thread_create:
+		err = sys___thread_create((userptr_t)tf->tf_a0,
+					  (userptr_t)tf->tf_a1,
+					  (userptr_t)tf->tf_a2,
+					  &retval);
+		break;
+
+	    case SYS_thread_join:
+		err = sys_thread_join(tf->tf_a0, (userptr_t)tf->tf_a1);
+		break;
+
+	    case SYS_thread_exit:
+		sys_thread_exit((userptr_t)tf->tf_a0);
+		/* doesn't return */
+
+	    case SYS_thread_detach:
+		err = sys_thread_detach(tf->tf_a0);
+		break;
+
+	    case SYS_futex:
+		err = sys_futex((userptr_t)tf->tf_a0, tf->tf_a1, tf->tf_a2,
+				&retval);
+		break;
+
 	    /* Add stuff here */
 
 	    default:
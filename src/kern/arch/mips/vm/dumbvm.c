@@ -59,6 +59,17 @@
 /* (this must be > 64K so argument blocks of size ARG_MAX will fit) */
 #define DUMBVM_STACKPAGES    18
 
+/*
+ * Stacks for additional user threads go below the main stack, each
+ * DUMBVM_THREADSTACKPAGES long with an unmapped guard page above it.
+ */
+#define DUMBVM_TSTACKSTRIDE  ((DUMBVM_THREADSTACKPAGES + 1) * PAGE_SIZE)
+#define DUMBVM_TSTACKTOP(slot) \
+	(USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE \
+	 - (slot) * DUMBVM_TSTACKSTRIDE - PAGE_SIZE)
+#define DUMBVM_TSTACKBASE(slot) \
+	(DUMBVM_TSTACKTOP(slot) - DUMBVM_THREADSTACKPAGES * PAGE_SIZE)
+
 /*
  * Wrap ram_stealmem in a spinlock.
  */
@@ -222,7 +233,19 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 		paddr = (faultaddress - stackbase) + as->as_stackpbase;
 	}
 	else {
-		return EFAULT;
+		paddr = 0;
+		for (i=0; i<AS_THREADSTACKS; i++) {
+			if (as->as_tstackpbase[i] != 0 &&
+			    faultaddress >= DUMBVM_TSTACKBASE(i) &&
+			    faultaddress < DUMBVM_TSTACKTOP(i)) {
+				paddr = (faultaddress - DUMBVM_TSTACKBASE(i))
+					+ as->as_tstackpbase[i];
+				break;
+			}
+		}
+		if (paddr == 0) {
+			return EFAULT;
+		}
 	}
 
 	/* make sure it's page-aligned */
@@ -252,6 +275,7 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 struct addrspace *
 as_create(void)
 {
+	unsigned i;
 	struct addrspace *as = kmalloc(sizeof(struct addrspace));
 	if (as==NULL) {
 		return NULL;
@@ -264,6 +288,9 @@ as_create(void)
 	as->as_pbase2 = 0;
 	as->as_npages2 = 0;
 	as->as_stackpbase = 0;
+	for (i=0; i<AS_THREADSTACKS; i++) {
+		as->as_tstackpbase[i] = 0;
+	}
 
 	return as;
 }
@@ -398,10 +425,39 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+/*
+ * Thread stacks are allocated the first time a slot is used and kept
+ * for reuse afterwards (dumbvm can't free memory anyway).
+ */
+int
+as_define_thread_stack(struct addrspace *as, unsigned slot,
+		       vaddr_t *stackptr)
+{
+	KASSERT(as->as_stackpbase != 0);
+
+	if (slot >= AS_THREADSTACKS) {
+		return EINVAL;
+	}
+
+	dumbvm_can_sleep();
+
+	if (as->as_tstackpbase[slot] == 0) {
+		as->as_tstackpbase[slot] = getppages(DUMBVM_THREADSTACKPAGES);
+		if (as->as_tstackpbase[slot] == 0) {
+			return ENOMEM;
+		}
+	}
+	as_zero_region(as->as_tstackpbase[slot], DUMBVM_THREADSTACKPAGES);
+
+	*stackptr = DUMBVM_TSTACKTOP(slot);
+	return 0;
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
 	struct addrspace *new;
+	unsigned i;
 
 	dumbvm_can_sleep();
 
@@ -437,6 +493,20 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 		(const void *)PADDR_TO_KVADDR(old->as_stackpbase),
 		DUMBVM_STACKPAGES*PAGE_SIZE);
 
+	for (i=0; i<AS_THREADSTACKS; i++) {
+		if (old->as_tstackpbase[i] == 0) {
+			continue;
+		}
+		new->as_tstackpbase[i] = getppages(DUMBVM_THREADSTACKPAGES);
+		if (new->as_tstackpbase[i] == 0) {
+			as_destroy(new);
+			return ENOMEM;
+		}
+		memmove((void *)PADDR_TO_KVADDR(new->as_tstackpbase[i]),
+			(const void *)PADDR_TO_KVADDR(old->as_tstackpbase[i]),
+			DUMBVM_THREADSTACKPAGES*PAGE_SIZE);
+	}
+
 	*ret = new;
 	return 0;
 }
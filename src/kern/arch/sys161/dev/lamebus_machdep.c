@@ -75,6 +75,43 @@ mips_timer_set(uint32_t count)
 		:: "r" (count));
 }
 
+/*
+ * Read c0_count ($9), which counts cycles since the last timer
+ * interrupt.
+ */
+static
+uint32_t
+mips_timer_count(void)
+{
+	uint32_t count;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mfc0 %0, $9;"		/* read it */
+		".set pop"		/* restore assembler mode */
+		: "=r" (count));
+	return count;
+}
+
+/*
+ * Read c0_cause ($13).
+ */
+static
+uint32_t
+mips_cause(void)
+{
+	uint32_t cause;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mfc0 %0, $13;"		/* read it */
+		".set pop"		/* restore assembler mode */
+		: "=r" (cause));
+	return cause;
+}
+
 /*
  * LAMEbus data for the system. (We have only one LAMEbus per system.)
  * This does not need to be locked, because it's constant once
@@ -304,6 +341,12 @@ mainbus_interrupt(struct trapframe *tf)
 		seen = true;
 	}
 	if (cause & MIPS_TIMER_BIT) {
+		/*
+		 * The count register starts over from 0 when it
+		 * matches compare, so right now it says how long ago
+		 * the timer fired.
+		 */
+		hardclock_latency(mips_timer_count());
 		/* Reset the timer (this clears the interrupt) */
 		mips_timer_set(CPU_FREQUENCY / HZ);
 		/* and call hardclock */
@@ -332,3 +375,35 @@ mainbus_interrupt(struct trapframe *tf)
 		}
 	}
 }
+
+/*
+ * Cycle clock for this CPU. c0_count starts over at every timer
+ * interrupt, so count whole ticks with this CPU's hardclock count
+ * (lined up with hardclock_ticks when the CPU started; see
+ * cpu_hatch) and add c0_count for the part of the current tick.
+ *
+ * With interrupts off, the timer may have gone off and restarted
+ * c0_count without hardclock having run yet. Then the interrupt is
+ * still pending in c0_cause, and the tick it ends needs counting. A
+ * small count tells that c0_count was read after the restart rather
+ * than just before. (So this is a tick off if interrupts have been
+ * off for more than half a tick, which shouldn't happen.)
+ */
+uint32_t
+cpu_cycles(void)
+{
+	const uint32_t tick = CPU_FREQUENCY / HZ;
+	uint32_t ticks, count, cause;
+	int s;
+
+	s = splhigh();
+	ticks = curcpu->c_tickbase + curcpu->c_hardclocks;
+	count = mips_timer_count();
+	cause = mips_cause();
+	splx(s);
+
+	if ((cause & MIPS_TIMER_BIT) && count < tick / 2) {
+		ticks++;
+	}
+	return ticks * tick + count;
+}
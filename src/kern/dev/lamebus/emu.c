@@ -118,6 +118,18 @@ emu_wreg(struct emu_softc *sc, uint32_t reg, uint32_t val)
 	bus_write_register(sc->e_busdata, sc->e_buspos, reg, val);
 }
 
+/*
+ * Bottom half of the interrupt: wake up whoever's waiting.
+ */
+static
+void
+emu_softirq(void *dev)
+{
+	struct emu_softc *sc = dev;
+
+	V(sc->e_sem);
+}
+
 /*
  * Called by the underlying bus code when an interrupt happens
  */
@@ -129,7 +141,7 @@ emu_irq(void *dev)
 	sc->e_result = emu_rreg(sc, REG_RESULT);
 	emu_wreg(sc, REG_RESULT, 0);
 
-	V(sc->e_sem);
+	softirq_schedule(&sc->e_softirq);
 }
 
 /*
@@ -473,31 +485,24 @@ emufs_reclaim(struct vnode *v)
 	int result;
 
 	/*
-	 * Need all of these locks, e_lock to protect the device,
-	 * vfs_biglock to protect the fs-related material, and
-	 * vn_countlock for the reference count.
+	 * Need both of these locks, e_lock to protect the device and
+	 * vfs_biglock to protect the fs-related material.
 	 */
 
 	vfs_biglock_acquire();
 	lock_acquire(ef->ef_emu->e_lock);
-	spinlock_acquire(&ev->ev_v.vn_countlock);
-
-	if (ev->ev_v.vn_refcount > 1) {
-		/* consume the reference VOP_DECREF passed us */
-		ev->ev_v.vn_refcount--;
 
-		spinlock_release(&ev->ev_v.vn_countlock);
+	if (vnode_decref_nonlast(&ev->ev_v)) {
+		/* consumed the reference VOP_DECREF passed us */
 		lock_release(ef->ef_emu->e_lock);
 		vfs_biglock_release();
 		return EBUSY;
 	}
-	KASSERT(ev->ev_v.vn_refcount == 1);
 
 	/*
 	 * Since we hold e_lock and are the last ref, nobody can increment
-	 * the refcount, so we can release vn_countlock.
+	 * the refcount.
 	 */
-	spinlock_release(&ev->ev_v.vn_countlock);
 
 	/* emu_close retries on I/O error */
 	result = emu_close(ev->ev_emu, ev->ev_handle);
@@ -1349,6 +1354,7 @@ config_emu(struct emu_softc *sc, int emuno)
 		sc->e_lock = NULL;
 		return ENOMEM;
 	}
+	softirq_init(&sc->e_softirq, emu_softirq, sc);
 	sc->e_iobuf = bus_map_area(sc->e_busdata, sc->e_buspos, EMU_BUFFER);
 
 	snprintf(name, sizeof(name), "emu%d", emuno);
@@ -37,6 +37,7 @@
 #include <uio.h>
 #include <membar.h>
 #include <synch.h>
+#include <softirq.h>
 #include <platform/bus.h>
 #include <vfs.h>
 #include <lamebus/lhd.h>
@@ -96,15 +97,27 @@ int lhd_code_to_errno(struct lhd_softc *lh, int code)
 }
 
 /*
- * Record that an I/O has completed: save the result and poke the
- * completion semaphore.
+ * Bottom half of I/O completion: poke the completion semaphore.
+ */
+static
+void
+lhd_softirq(void *vlh)
+{
+	struct lhd_softc *lh = vlh;
+
+	V(lh->lh_done);
+}
+
+/*
+ * Record that an I/O has completed: save the result and leave the
+ * wakeup to the softirq.
  */
 static
 void
 lhd_iodone(struct lhd_softc *lh, int err)
 {
 	lh->lh_result = err;
-	V(lh->lh_done);
+	softirq_schedule(&lh->lh_softirq);
 }
 
 /*
@@ -295,6 +308,7 @@ config_lhd(struct lhd_softc *lh, int lhdno)
 		lh->lh_clear = NULL;
 		return ENOMEM;
 	}
+	softirq_init(&lh->lh_softirq, lhd_softirq, lh);
 
 	/* Set up the VFS device structure. */
 	lh->lh_dev.d_ops = &lhd_devops;
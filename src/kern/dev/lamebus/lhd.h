@@ -31,6 +31,7 @@
 #define _LAMEBUS_LHD_H_
 
 #include <device.h>
+#include <softirq.h>
 
 /*
  * Our sector size
@@ -54,6 +55,7 @@ struct lhd_softc {
 	int lh_result;			/* Result from I/O operation */
 	struct semaphore *lh_clear;	/* Synchronization */
 	struct semaphore *lh_done;
+	struct softirq lh_softirq;	/* Completion bottom half */
 
 	struct device lh_dev;		/* VFS device structure */
 };
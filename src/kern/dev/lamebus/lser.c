@@ -44,14 +44,69 @@
 #define LSER_IRQ_ACTIVE  2
 #define LSER_IRQ_FORCE   4
 
+/*
+ * Bottom half: pass completed writes and received characters up to
+ * the attached driver, in the order the top half saw them.
+ *
+ * The callbacks can't be made with ls_lock held (ls_start usually
+ * writes the next character), and if this softirq is running on
+ * another CPU too we mustn't hand characters up out of order, so
+ * whoever gets here first sets ls_inbh and drains everything.
+ */
+static
+void
+lser_softirq(void *vsc)
+{
+	struct lser_softc *sc = vsc;
+	bool clear_to_write;
+	int ch = 0;
+
+	spinlock_acquire(&sc->ls_lock);
+	if (sc->ls_inbh) {
+		spinlock_release(&sc->ls_lock);
+		return;
+	}
+	sc->ls_inbh = true;
+
+	while (sc->ls_wdone || sc->ls_rhead != sc->ls_rtail) {
+		clear_to_write = sc->ls_wdone;
+		if (clear_to_write) {
+			sc->ls_wdone = false;
+		}
+		else {
+			ch = sc->ls_rbuf[sc->ls_rhead % LSER_RBUFSIZE];
+			sc->ls_rhead++;
+		}
+		spinlock_release(&sc->ls_lock);
+
+		if (clear_to_write) {
+			if (sc->ls_start != NULL) {
+				sc->ls_start(sc->ls_devdata);
+			}
+		}
+		else if (sc->ls_input != NULL) {
+			sc->ls_input(sc->ls_devdata, ch);
+		}
+
+		spinlock_acquire(&sc->ls_lock);
+	}
+
+	sc->ls_inbh = false;
+	spinlock_release(&sc->ls_lock);
+}
+
+/*
+ * Top half: acknowledge the device and note what happened. If the
+ * input buffer is full the character is lost, as it would be if the
+ * attached driver's buffer were full.
+ */
 void
 lser_irq(void *vsc)
 {
 	struct lser_softc *sc = vsc;
 	uint32_t x;
-	bool clear_to_write = false;
-	bool got_a_read = false;
-	uint32_t ch = 0;
+	uint32_t ch;
+	bool any = false;
 
 	spinlock_acquire(&sc->ls_lock);
 
@@ -59,7 +114,8 @@ lser_irq(void *vsc)
 	if (x & LSER_IRQ_ACTIVE) {
 		x = LSER_IRQ_ENABLE;
 		sc->ls_wbusy = 0;
-		clear_to_write = true;
+		sc->ls_wdone = true;
+		any = true;
 		bus_write_register(sc->ls_busdata, sc->ls_buspos,
 				   LSER_REG_WIRQ, x);
 	}
@@ -69,18 +125,19 @@ lser_irq(void *vsc)
 		x = LSER_IRQ_ENABLE;
 		ch = bus_read_register(sc->ls_busdata, sc->ls_buspos,
 				       LSER_REG_CHAR);
-		got_a_read = true;
+		if (sc->ls_rtail - sc->ls_rhead < LSER_RBUFSIZE) {
+			sc->ls_rbuf[sc->ls_rtail % LSER_RBUFSIZE] = ch;
+			sc->ls_rtail++;
+		}
+		any = true;
 		bus_write_register(sc->ls_busdata, sc->ls_buspos,
 				   LSER_REG_RIRQ, x);
 	}
 
 	spinlock_release(&sc->ls_lock);
 
-	if (clear_to_write && sc->ls_start != NULL) {
-		sc->ls_start(sc->ls_devdata);
-	}
-	if (got_a_read && sc->ls_input != NULL) {
-		sc->ls_input(sc->ls_devdata, ch);
+	if (any) {
+		softirq_schedule(&sc->ls_softirq);
 	}
 }
 
@@ -182,6 +239,10 @@ config_lser(struct lser_softc *sc, int lserno)
 
 	spinlock_init(&sc->ls_lock);
 	sc->ls_wbusy = false;
+	sc->ls_wdone = false;
+	sc->ls_rhead = sc->ls_rtail = 0;
+	sc->ls_inbh = false;
+	softirq_init(&sc->ls_softirq, lser_softirq, sc);
 
 	bus_write_register(sc->ls_busdata, sc->ls_buspos,
 			   LSER_REG_RIRQ, LSER_IRQ_ENABLE);
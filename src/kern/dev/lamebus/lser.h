@@ -31,12 +31,24 @@
 #define _LAMEBUS_LSER_H_
 
 #include <spinlock.h>
+#include <softirq.h>
+
+/* Characters lser_irq can hold for lser_softirq */
+#define LSER_RBUFSIZE 64
 
 struct lser_softc {
 	/* Initialized by config function */
 	struct spinlock ls_lock;    /* protects ls_wbusy and device regs */
 	volatile bool ls_wbusy;     /* true if write in progress */
 
+	/* Passed from lser_irq to lser_softirq; protected by ls_lock */
+	bool ls_wdone;              /* write finished; call ls_start */
+	unsigned ls_rhead;          /* next char for ls_input */
+	unsigned ls_rtail;          /* next free slot in ls_rbuf */
+	unsigned char ls_rbuf[LSER_RBUFSIZE];
+	bool ls_inbh;               /* someone is calling ls_start/ls_input */
+	struct softirq ls_softirq;
+
 	/* Initialized by lower-level attachment function */
 	void *ls_busdata;
 	uint32_t ls_buspos;
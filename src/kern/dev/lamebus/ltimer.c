@@ -32,7 +32,6 @@
  */
 #include <types.h>
 #include <lib.h>
-#include <spl.h>
 #include <clock.h>
 #include <platform/bus.h>
 #include <lamebus/ltimer.h>
@@ -51,6 +50,18 @@
 
 static bool havetimerclock;
 
+/*
+ * timerclock wakes up everything waiting on lbolt, which can be a
+ * lot; do it in a softirq rather than in the interrupt handler.
+ */
+static
+void
+ltimer_softirq(void *vlt)
+{
+	(void)vlt;
+	timerclock();
+}
+
 /*
  * Setup routine called by autoconf stuff when an ltimer is found.
  */
@@ -82,6 +93,7 @@ config_ltimer(struct ltimer_softc *lt, int ltimerno)
 	 */
 	(void)ltimerno;
 	lt->lt_hardclock = 0;
+	softirq_init(&lt->lt_softirq, ltimer_softirq, lt);
 
 	/*
 	 * We do, however, use ltimer for the timer clock, since the
@@ -122,7 +134,7 @@ ltimer_irq(void *vlt)
 		 * Likewise for timerclock.
 		 */
 		if (lt->lt_timerclock) {
-			timerclock();
+			softirq_schedule(&lt->lt_softirq);
 		}
 	}
 }
@@ -150,38 +162,28 @@ ltimer_gettime(void *vlt, struct timespec *ts)
 {
 	struct ltimer_softc *lt = vlt;
 	uint32_t secs1, secs2;
-	int spl;
 
 	/*
-	 * Read the seconds twice, on either side of the nanoseconds.
-	 * If nsecs is small, use the *later* value of seconds, in case
-	 * the nanoseconds turned over between the time we got the earlier
-	 * value and the time we got nsecs.
+	 * Read the seconds twice, on either side of the nanoseconds,
+	 * and start over if they differ: the nanoseconds turned over
+	 * somewhere in between and we can't tell which seconds value
+	 * goes with them. This is a sequence-lock read with the
+	 * seconds register as the sequence number, so there's no
+	 * need to turn interrupts off; an interrupt among the reads
+	 * at worst costs another go around.
 	 *
 	 * Note that the clock in the ltimer device is accurate down
 	 * to a single processor cycle, so this might actually matter
 	 * now and then.
-	 *
-	 * Do it with interrupts off on the current processor to avoid
-	 * getting garbage if we get an interrupt among the register
-	 * reads.
 	 */
-
-	spl = splhigh();
-
-	secs1 = bus_read_register(lt->lt_bus, lt->lt_buspos,
-				  LT_REG_SEC);
-	ts->tv_nsec = bus_read_register(lt->lt_bus, lt->lt_buspos,
-				   LT_REG_NSEC);
-	secs2 = bus_read_register(lt->lt_bus, lt->lt_buspos,
-				  LT_REG_SEC);
-
-	splx(spl);
-
-	if (ts->tv_nsec < 5000000) {
-		ts->tv_sec = secs2;
-	}
-	else {
-		ts->tv_sec = secs1;
-	}
+	do {
+		secs1 = bus_read_register(lt->lt_bus, lt->lt_buspos,
+					  LT_REG_SEC);
+		ts->tv_nsec = bus_read_register(lt->lt_bus, lt->lt_buspos,
+						LT_REG_NSEC);
+		secs2 = bus_read_register(lt->lt_bus, lt->lt_buspos,
+					  LT_REG_SEC);
+	} while (secs1 != secs2);
+
+	ts->tv_sec = secs1;
 }
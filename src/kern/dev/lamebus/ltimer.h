@@ -30,6 +30,8 @@
 #ifndef _LAMEBUS_LTIMER_H_
 #define _LAMEBUS_LTIMER_H_
 
+#include <softirq.h>
+
 struct timespec;
 
 /*
@@ -39,6 +41,7 @@ struct ltimer_softc {
 	/* Initialized by config function */
 	int lt_hardclock;        /* true if we should call hardclock() */
 	int lt_timerclock;        /* true if we should call timerclock() */
+	struct softirq lt_softirq; /* calls timerclock() */
 
 	/* Initialized by lower-level attach routine */
 	void *lt_bus;		/* bus we're on */
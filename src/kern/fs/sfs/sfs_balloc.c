@@ -33,63 +33,199 @@
  * Block allocation.
  */
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
+#include <synch.h>
 #include <bitmap.h>
+#include <buf.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
 /*
- * Zero out a disk block.
+ * Zero out a disk block. This only happens in the buffer cache; the
+ * zeros reach the disk when the buffer is written back.
  */
 static
 int
 sfs_clearblock(struct sfs_fs *sfs, daddr_t block)
 {
-	/* static -> automatically initialized to zero */
-	static char zeros[SFS_BLOCKSIZE];
+	struct buf *buf;
+	int result;
+
+	result = buffer_get(sfs->sfs_device, block, &buf);
+	if (result) {
+		return result;
+	}
+	bzero(buffer_map(buf), SFS_BLOCKSIZE);
+	buffer_markdirty(buf);
+	buffer_release(buf);
+	return 0;
+}
+
+/*
+ * Note that the freemap bit for DISKBLOCK changed, so the freemap
+ * block holding it needs writing back. Called with sfs_freemaplock.
+ */
+static
+void
+sfs_freemap_markdirty(struct sfs_fs *sfs, daddr_t diskblock)
+{
+	unsigned index = diskblock / SFS_BITSPERBLOCK;
+
+	if (!bitmap_isset(sfs->sfs_freemapdirtyblocks, index)) {
+		bitmap_mark(sfs->sfs_freemapdirtyblocks, index);
+	}
+	sfs->sfs_freemapdirty = true;
+}
+
+/*
+ * Set up the free block counts for the allocation regions, from the
+ * freemap just loaded at mount time.
+ */
+int
+sfs_countfree(struct sfs_fs *sfs)
+{
+	uint32_t nblocks = sfs->sfs_sb.sb_nblocks;
+	uint32_t block;
+	unsigned i;
+
+	sfs->sfs_nregions = DIVROUNDUP(nblocks, SFS_REGIONBLOCKS);
+	sfs->sfs_regionfree =
+		kmalloc(sfs->sfs_nregions * sizeof(sfs->sfs_regionfree[0]));
+	if (sfs->sfs_regionfree == NULL) {
+		return ENOMEM;
+	}
+	for (i=0; i<sfs->sfs_nregions; i++) {
+		sfs->sfs_regionfree[i] = 0;
+	}
+	for (block=0; block<nblocks; block++) {
+		if (!bitmap_isset(sfs->sfs_freemap, block)) {
+			sfs->sfs_regionfree[block / SFS_REGIONBLOCKS]++;
+		}
+	}
+	sfs->sfs_cursor = 0;
+	return 0;
+}
+
+/*
+ * Find a free block, the first one at or after GOAL if there is one,
+ * else the first one from the start of the volume. Regions with no
+ * free blocks are skipped without looking at their bits. Called with
+ * sfs_freemaplock.
+ */
+static
+int
+sfs_bfind(struct sfs_fs *sfs, daddr_t goal, daddr_t *diskblock)
+{
+	uint32_t nblocks = sfs->sfs_sb.sb_nblocks;
+	unsigned region, i, start, end;
+	unsigned index;
+
+	KASSERT(goal < nblocks);
 
-	return sfs_writeblock(sfs, block, zeros, SFS_BLOCKSIZE);
+	/*
+	 * Go around all the regions, starting and ending with GOAL's:
+	 * first the part from GOAL on, last the part before it.
+	 */
+	region = goal / SFS_REGIONBLOCKS;
+	for (i=0; i<=sfs->sfs_nregions; i++) {
+		start = (i == 0) ? goal : region * SFS_REGIONBLOCKS;
+		end = (i == sfs->sfs_nregions) ?
+			goal : (region + 1) * SFS_REGIONBLOCKS;
+		if (end > nblocks) {
+			end = nblocks;
+		}
+		if (sfs->sfs_regionfree[region] > 0 &&
+		    bitmap_findclear(sfs->sfs_freemap, start, end,
+				     &index) == 0) {
+			*diskblock = index;
+			return 0;
+		}
+		region = (region + 1) % sfs->sfs_nregions;
+	}
+	return ENOSPC;
 }
 
 /*
- * Allocate a block.
+ * Allocate a block, as close after GOAL as we can. Callers pass the
+ * block after the one that precedes the new one in the file, or the
+ * file's inode, so a file's blocks end up together and in order on
+ * disk. With GOAL 0 (no preference), allocation goes on from after
+ * the last block allocated, so the search doesn't start at the
+ * (usually full) beginning of the volume every time.
+ *
+ * The block is zeroed if CLEAR is set. A caller that's about to write
+ * the whole block through the buffer cache passes false; buffer_get
+ * hands it a zeroed buffer anyway, as sfs_bfree dropped whatever the
+ * cache had for the block when it was last freed.
  */
 int
-sfs_balloc(struct sfs_fs *sfs, daddr_t *diskblock)
+sfs_balloc(struct sfs_fs *sfs, daddr_t goal, bool clear,
+	   daddr_t *diskblock)
 {
 	int result;
 
-	result = bitmap_alloc(sfs->sfs_freemap, diskblock);
+	lock_acquire(sfs->sfs_freemaplock);
+	if (goal == 0 || goal >= sfs->sfs_sb.sb_nblocks) {
+		goal = sfs->sfs_cursor;
+	}
+	result = sfs_bfind(sfs, goal, diskblock);
 	if (result) {
+		lock_release(sfs->sfs_freemaplock);
 		return result;
 	}
-	sfs->sfs_freemapdirty = true;
+	bitmap_mark(sfs->sfs_freemap, *diskblock);
+	sfs->sfs_regionfree[*diskblock / SFS_REGIONBLOCKS]--;
+	sfs->sfs_cursor = *diskblock + 1;
+	if (sfs->sfs_cursor >= sfs->sfs_sb.sb_nblocks) {
+		sfs->sfs_cursor = 0;
+	}
+	sfs_freemap_markdirty(sfs, *diskblock);
+	lock_release(sfs->sfs_freemaplock);
 
-	if (*diskblock >= sfs->sfs_sb.sb_nblocks) {
-		panic("sfs: %s: balloc: invalid block %u\n",
-		      sfs->sfs_sb.sb_volname, *diskblock);
+	if (!clear) {
+		return 0;
 	}
 
-	/* Clear block before returning it */
+	/*
+	 * Clear block before returning it. This can wait for the
+	 * buffer cache to write something back, so don't hold the
+	 * freemap lock; the block is ours already.
+	 */
 	result = sfs_clearblock(sfs, *diskblock);
 	if (result) {
+		lock_acquire(sfs->sfs_freemaplock);
 		bitmap_unmark(sfs->sfs_freemap, *diskblock);
+		sfs->sfs_regionfree[*diskblock / SFS_REGIONBLOCKS]++;
+		lock_release(sfs->sfs_freemaplock);
 	}
 	return result;
 }
 
 /*
- * Free a block.
+ * Free a block. Whatever the cache has for it, even if dirty, is
+ * garbage now.
  */
 void
 sfs_bfree(struct sfs_fs *sfs, daddr_t diskblock)
 {
+	buffer_drop(sfs->sfs_device, diskblock);
+	lock_acquire(sfs->sfs_freemaplock);
 	bitmap_unmark(sfs->sfs_freemap, diskblock);
-	sfs->sfs_freemapdirty = true;
+	sfs->sfs_regionfree[diskblock / SFS_REGIONBLOCKS]++;
+	sfs_freemap_markdirty(sfs, diskblock);
+	lock_release(sfs->sfs_freemaplock);
 }
 
 /*
  * Check if a block is in use.
+ *
+ * This is only a sanity check on blocks the caller already owns (the
+ * blocks of a file it has locked, or an inode it's loading), so
+ * nobody else can be changing their bits, and it doesn't take the
+ * freemap lock. A concurrent change to another bit in the same byte
+ * doesn't matter either: the byte is read as a whole, old or new,
+ * and our bit is the same in both.
  */
 int
 sfs_bused(struct sfs_fs *sfs, daddr_t diskblock)
@@ -35,39 +35,55 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <synch.h>
 #include <vfs.h>
+#include <buf.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
+/*
+ * Where to try to allocate a new block of SV: right after PREV, the
+ * disk block just before it in the file, if there is one, else right
+ * after the inode.
+ */
+static
+daddr_t
+sfs_bmap_goal(struct sfs_vnode *sv, daddr_t prev)
+{
+	return prev != 0 ? prev + 1 : sv->sv_ino + 1;
+}
+
 /*
  * Look up the disk block number (from 0 up to the number of blocks on
  * the disk) given a file and the logical block number within that
- * file. If DOALLOC is set, and no such block exists, one will be
- * allocated.
+ * file. If DOALLOC isn't SFS_BMAP_LOOKUP, and no such block exists,
+ * one will be allocated. It's zeroed, unless DOALLOC is SFS_BMAP_FILL
+ * and the caller is about to overwrite all of it; the indirect block
+ * is always zeroed.
  */
 int
-sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
+sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, int doalloc,
 	 daddr_t *diskblock)
 {
-	/*
-	 * I/O buffer for handling indirect blocks.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
-	 */
-	static uint32_t idbuf[SFS_DBPERIDB];
-
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *idbuf;
+	uint32_t *iddata;
 	daddr_t block;
 	daddr_t idblock;
+	daddr_t goal;
 	uint32_t idnum, idoff;
 	int result;
 
-	KASSERT(sizeof(idbuf)==SFS_BLOCKSIZE);
+	COMPILE_ASSERT(SFS_DBPERIDB * sizeof(uint32_t) == SFS_BLOCKSIZE);
+
+	/* The inode and the indirect block are covered by sv_lock. */
+	KASSERT(lock_do_i_hold(sv->sv_lock));
 
-	/* Since we're using a static buffer, we'd better be locked. */
-	KASSERT(vfs_biglock_do_i_hold());
+	if (sfs->sfs_sb.sb_features & SFS_FEATURE_EXTENTS) {
+		uint32_t run;
+
+		return sfs_ext_bmap(sv, fileblock, doalloc, diskblock, &run);
+	}
 
 	/*
 	 * If the block we want is one of the direct blocks...
@@ -81,8 +97,11 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		/*
 		 * Do we need to allocate?
 		 */
-		if (block==0 && doalloc) {
-			result = sfs_balloc(sfs, &block);
+		if (block==0 && doalloc != SFS_BMAP_LOOKUP) {
+			goal = sfs_bmap_goal(sv, fileblock > 0 ?
+				sv->sv_i.sfi_direct[fileblock-1] : 0);
+			result = sfs_balloc(sfs, goal,
+					    doalloc != SFS_BMAP_FILL, &block);
 			if (result) {
 				return result;
 			}
@@ -127,7 +146,7 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 	/* Get the disk block number of the indirect block. */
 	idblock = sv->sv_i.sfi_indirect;
 
-	if (idblock==0 && !doalloc) {
+	if (idblock==0 && doalloc == SFS_BMAP_LOOKUP) {
 		/*
 		 * There's no indirect block allocated. We weren't
 		 * asked to allocate anything, so pretend the indirect
@@ -143,7 +162,8 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		 * the indirect block. Thus, we need to allocate an
 		 * indirect block.
 		 */
-		result = sfs_balloc(sfs, &idblock);
+		goal = sfs_bmap_goal(sv, sv->sv_i.sfi_direct[SFS_NDIRECT-1]);
+		result = sfs_balloc(sfs, goal, true, &idblock);
 		if (result) {
 			return result;
 		}
@@ -154,38 +174,36 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		/* Mark the inode dirty */
 		sv->sv_dirty = true;
 
-		/* Clear the indirect block buffer */
-		bzero(idbuf, sizeof(idbuf));
+		/* (sfs_balloc zeroed it, so it's in the cache now) */
 	}
-	else {
-		/*
-		 * We already have an indirect block allocated; load it.
-		 */
-		result = sfs_readblock(sfs, idblock, idbuf, sizeof(idbuf));
-		if (result) {
-			return result;
-		}
+
+	/* Load the indirect block */
+	result = buffer_read(sfs->sfs_device, idblock, &idbuf);
+	if (result) {
+		return result;
 	}
+	iddata = buffer_map(idbuf);
 
-	/* Get the block out of the indirect block buffer */
-	block = idbuf[idoff];
+	/* Get the block out of the indirect block */
+	block = iddata[idoff];
 
 	/* If there's no block there, allocate one */
-	if (block==0 && doalloc) {
-		result = sfs_balloc(sfs, &block);
+	if (block==0 && doalloc != SFS_BMAP_LOOKUP) {
+		goal = sfs_bmap_goal(sv, idoff > 0 ? iddata[idoff-1] : idblock);
+		result = sfs_balloc(sfs, goal, doalloc != SFS_BMAP_FILL,
+				    &block);
 		if (result) {
+			buffer_release(idbuf);
 			return result;
 		}
 
 		/* Remember the block we allocated */
-		idbuf[idoff] = block;
+		iddata[idoff] = block;
 
-		/* The indirect block is now dirty; write it back */
-		result = sfs_writeblock(sfs, idblock, idbuf, sizeof(idbuf));
-		if (result) {
-			return result;
-		}
+		/* The indirect block is now dirty */
+		buffer_markdirty(idbuf);
 	}
+	buffer_release(idbuf);
 
 	/* Hand back the result and return. */
 	if (block != 0 && !sfs_bused(sfs, block)) {
@@ -198,21 +216,37 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 }
 
 /*
- * Called for ftruncate() and from sfs_reclaim.
+ * Like sfs_bmap with SFS_BMAP_LOOKUP, but also return in *RUN how many
+ * blocks from FILEBLOCK on are known to be consecutive on disk. That's
+ * the rest of the extent on volumes with extents, and otherwise 1, as
+ * it is for a hole.
  */
 int
-sfs_itrunc(struct sfs_vnode *sv, off_t len)
+sfs_bmaprun(struct sfs_vnode *sv, uint32_t fileblock, daddr_t *diskblock,
+	    uint32_t *run)
 {
-	/*
-	 * I/O buffer for handling the indirect block.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
-	 */
-	static uint32_t idbuf[SFS_DBPERIDB];
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+
+	KASSERT(lock_do_i_hold(sv->sv_lock));
+
+	if (sfs->sfs_sb.sb_features & SFS_FEATURE_EXTENTS) {
+		return sfs_ext_bmap(sv, fileblock, SFS_BMAP_LOOKUP, diskblock,
+				    run);
+	}
+	*run = 1;
+	return sfs_bmap(sv, fileblock, SFS_BMAP_LOOKUP, diskblock);
+}
 
+/*
+ * Called for ftruncate() and from sfs_reclaim. The caller holds
+ * sv_lock, or is sfs_reclaim.
+ */
+int
+sfs_itrunc(struct sfs_vnode *sv, off_t len)
+{
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *idbuf;
+	uint32_t *iddata;
 
 	/* Length in blocks (divide rounding up) */
 	uint32_t blocklen = DIVROUNDUP(len, SFS_BLOCKSIZE);
@@ -223,9 +257,9 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 	int result;
 	int hasnonzero, iddirty;
 
-	KASSERT(sizeof(idbuf)==SFS_BLOCKSIZE);
-
-	vfs_biglock_acquire();
+	if (sfs->sfs_sb.sb_features & SFS_FEATURE_EXTENTS) {
+		return sfs_ext_itrunc(sv, len);
+	}
 
 	/*
 	 * Go through the direct blocks. Discard any that are
@@ -253,42 +287,38 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 		/* We're past the proposed EOF; may need to free stuff */
 
 		/* Read the indirect block */
-		result = sfs_readblock(sfs, idblock, idbuf, sizeof(idbuf));
+		result = buffer_read(sfs->sfs_device, idblock, &idbuf);
 		if (result) {
-			vfs_biglock_release();
 			return result;
 		}
+		iddata = buffer_map(idbuf);
 
 		hasnonzero = 0;
 		iddirty = 0;
 		for (j=0; j<SFS_DBPERIDB; j++) {
 			/* Discard any blocks that are past the new EOF */
-			if (blocklen < baseblock+j && idbuf[j] != 0) {
-				sfs_bfree(sfs, idbuf[j]);
-				idbuf[j] = 0;
+			if (blocklen < baseblock+j && iddata[j] != 0) {
+				sfs_bfree(sfs, iddata[j]);
+				iddata[j] = 0;
 				iddirty = 1;
 			}
 			/* Remember if we see any nonzero blocks in here */
-			if (idbuf[j]!=0) {
+			if (iddata[j]!=0) {
 				hasnonzero=1;
 			}
 		}
 
+		if (iddirty) {
+			buffer_markdirty(idbuf);
+		}
+		buffer_release(idbuf);
+
 		if (!hasnonzero) {
 			/* The whole indirect block is empty now; free it */
 			sfs_bfree(sfs, idblock);
 			sv->sv_i.sfi_indirect = 0;
 			sv->sv_dirty = true;
 		}
-		else if (iddirty) {
-			/* The indirect block is dirty; write it back */
-			result = sfs_writeblock(sfs, idblock, idbuf,
-						sizeof(idbuf));
-			if (result) {
-				vfs_biglock_release();
-				return result;
-			}
-		}
 	}
 
 	/* Set the file size */
@@ -297,7 +327,6 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 	/* Mark the inode dirty */
 	sv->sv_dirty = true;
 
-	vfs_biglock_release();
 	return 0;
 }
 
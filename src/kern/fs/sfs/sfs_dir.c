@@ -31,14 +31,47 @@
  * SFS filesystem
  *
  * Directory I/O
+ *
+ * Everything here is called with the directory's sv_lock held.
+ *
+ * Directories come in two formats, chosen for the whole volume by
+ * SFS_FEATURE_HASHDIR: an unordered array of entries, searched from
+ * one end to the other, or a hash table. See kern/sfs.h.
+ *
+ * A hashed directory is rebuilt when adding a name would take it over
+ * three quarters full (counting deleted entries, which slow lookups
+ * down just as much). The rebuild leaves the deleted entries out and
+ * is sized from the names actually left, so it's at most half full:
+ * it grows if the names need it, and shrinks if most were deleted.
+ * That way creating and removing names over and over doesn't make
+ * the directory any bigger. It can't grow past the largest file size;
+ * at that size it's rebuilt only when it has no free slots left.
  */
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <synch.h>
 #include <vfs.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
+/*
+ * Largest directory, in slots: as big as a file can be, which depends
+ * on whether the volume maps blocks with extents.
+ */
+static
+int
+sfs_dir_maxslots(struct sfs_vnode *sv)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+
+	if (sfs->sfs_sb.sb_features & SFS_FEATURE_EXTENTS) {
+		return SFS_EXTMAXFILEBLOCK * SFS_DIRENTPERBLOCK;
+	}
+	return (SFS_NDIRECT + SFS_NINDIRECT * SFS_DBPERIDB) *
+		SFS_DIRENTPERBLOCK;
+}
+
 /*
  * Read the directory entry out of slot SLOT of a directory vnode.
  * The "slot" is the index of the directory entry, starting at 0.
@@ -95,6 +128,227 @@ sfs_dir_nentries(struct sfs_vnode *sv)
 	return size / sizeof(struct sfs_direntry);
 }
 
+/*
+ * Check if a directory is a hash table.
+ */
+static
+bool
+sfs_dir_ishashed(struct sfs_vnode *sv)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+
+	return (sfs->sfs_sb.sb_features & SFS_FEATURE_HASHDIR) != 0;
+}
+
+/*
+ * Search a hashed directory for NAME, handing back its inode number
+ * and slot if it's there. Also hands back the first slot on the way
+ * that a new entry could use, or -1 if there isn't one, and whether
+ * that slot is empty as opposed to holding a deleted entry.
+ */
+static
+int
+sfs_dir_hashfind(struct sfs_vnode *sv, const char *name,
+		 uint32_t *ino, int *slot, int *freeslot, bool *freeempty)
+{
+	struct sfs_direntry tsd;
+	int nentries, i, n, result;
+
+	nentries = sfs_dir_nentries(sv);
+	*freeslot = -1;
+	*freeempty = false;
+	if (nentries == 0) {
+		return ENOENT;
+	}
+
+	i = sfs_dirhash(name) % nentries;
+	for (n=0; n<nentries; n++) {
+		result = sfs_readdir(sv, i, &tsd);
+		if (result) {
+			return result;
+		}
+		if (tsd.sfd_ino != SFS_NOINO) {
+			/* Ensure null termination, just in case */
+			tsd.sfd_name[sizeof(tsd.sfd_name)-1] = 0;
+			if (!strcmp(tsd.sfd_name, name)) {
+				if (slot != NULL) {
+					*slot = i;
+				}
+				if (ino != NULL) {
+					*ino = tsd.sfd_ino;
+				}
+				return 0;
+			}
+		}
+		else {
+			if (*freeslot < 0) {
+				*freeslot = i;
+				*freeempty = (tsd.sfd_name[0] == 0);
+			}
+			if (tsd.sfd_name[0] == 0) {
+				/* Empty; the name isn't any further on. */
+				break;
+			}
+		}
+		i = (i + 1) % nentries;
+	}
+	return ENOENT;
+}
+
+/*
+ * Count the slots of a hashed directory that aren't empty (that is,
+ * in use or deleted), and the ones in use, if we haven't yet since
+ * loading it.
+ */
+static
+int
+sfs_dir_countused(struct sfs_vnode *sv)
+{
+	struct sfs_direntry tsd;
+	int nentries, i, used, live, result;
+
+	if (sv->sv_dirused >= 0) {
+		return 0;
+	}
+
+	nentries = sfs_dir_nentries(sv);
+	used = live = 0;
+	for (i=0; i<nentries; i++) {
+		result = sfs_readdir(sv, i, &tsd);
+		if (result) {
+			return result;
+		}
+		if (tsd.sfd_ino != SFS_NOINO || tsd.sfd_name[0] != 0) {
+			used++;
+		}
+		if (tsd.sfd_ino != SFS_NOINO) {
+			live++;
+		}
+	}
+	sv->sv_dirused = used;
+	sv->sv_dirlive = live;
+	return 0;
+}
+
+/*
+ * Size, in slots, to rebuild a hashed directory holding LIVE names at:
+ * whole blocks, at least twice as many slots as names once one more
+ * is added, but no bigger than a file can be.
+ */
+static
+int
+sfs_dir_hashsize(struct sfs_vnode *sv, int live)
+{
+	int slots;
+
+	slots = ROUNDUP((live + 1) * 2, (int)SFS_DIRENTPERBLOCK);
+	if (slots > sfs_dir_maxslots(sv)) {
+		slots = sfs_dir_maxslots(sv);
+	}
+	return slots;
+}
+
+/*
+ * Rebuild a hashed directory at the size sfs_dir_hashsize picks,
+ * leaving out deleted entries, and with room for at least one more
+ * name. The new table is built in a scratch inode whose blocks are
+ * then swapped with the directory's; dropping the scratch inode frees
+ * the old ones. Needs the counts from sfs_dir_countused.
+ */
+static
+int
+sfs_dir_rehash(struct sfs_vnode *sv)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct sfs_vnode *tmp;
+	struct sfs_direntry tsd, osd;
+	struct sfs_dinode swap;
+	int nentries, newslots, live, i, j, result;
+
+	KASSERT(sv->sv_dirused >= 0);
+
+	nentries = sfs_dir_nentries(sv);
+	live = sv->sv_dirlive;
+	newslots = sfs_dir_hashsize(sv, live);
+	KASSERT(newslots % SFS_DIRENTPERBLOCK == 0);
+	if (live + 1 > newslots) {
+		return ENOSPC;
+	}
+
+	result = sfs_makeobj(sfs, SFS_TYPE_DIR, &tmp);
+	if (result) {
+		return result;
+	}
+	lock_acquire(tmp->sv_lock);
+
+	/*
+	 * Writing the last slot of each block allocates the block,
+	 * zeroed, and leaves the size at NEWSLOTS entries.
+	 */
+	bzero(&osd, sizeof(osd));
+	for (i = SFS_DIRENTPERBLOCK - 1; i < newslots;
+	     i += SFS_DIRENTPERBLOCK) {
+		result = sfs_writedir(tmp, i, &osd);
+		if (result) {
+			goto fail;
+		}
+	}
+
+	for (i=0; i<nentries; i++) {
+		result = sfs_readdir(sv, i, &tsd);
+		if (result) {
+			goto fail;
+		}
+		if (tsd.sfd_ino == SFS_NOINO) {
+			continue;
+		}
+		tsd.sfd_name[sizeof(tsd.sfd_name)-1] = 0;
+
+		/* There's room, so this finds an empty slot. */
+		j = sfs_dirhash(tsd.sfd_name) % newslots;
+		while (1) {
+			result = sfs_readdir(tmp, j, &osd);
+			if (result) {
+				goto fail;
+			}
+			if (osd.sfd_ino == SFS_NOINO) {
+				break;
+			}
+			j = (j + 1) % newslots;
+		}
+		result = sfs_writedir(tmp, j, &tsd);
+		if (result) {
+			goto fail;
+		}
+	}
+
+	/*
+	 * Swap the blocks: everything in the inodes but the link
+	 * counts, however the blocks are mapped.
+	 */
+	swap = sv->sv_i;
+	sv->sv_i = tmp->sv_i;
+	sv->sv_i.sfi_linkcount = swap.sfi_linkcount;
+	swap.sfi_linkcount = tmp->sv_i.sfi_linkcount;
+	tmp->sv_i = swap;
+	bzero(&sv->sv_lastext, sizeof(sv->sv_lastext));
+	bzero(&tmp->sv_lastext, sizeof(tmp->sv_lastext));
+	sv->sv_dirty = true;
+	tmp->sv_dirty = true;
+	sv->sv_dirused = live;
+	KASSERT(sv->sv_dirlive == live);
+	lock_release(tmp->sv_lock);
+
+	/* Its link count is 0, so this frees it and the old blocks. */
+	VOP_DECREF(&tmp->sv_absvn);
+	return 0;
+
+ fail:
+	lock_release(tmp->sv_lock);
+	VOP_DECREF(&tmp->sv_absvn);
+	return result;
+}
+
 /*
  * Search a directory for a particular filename in a directory, and
  * return its inode number, its slot, and/or the slot number of an
@@ -106,6 +360,17 @@ sfs_dir_findname(struct sfs_vnode *sv, const char *name,
 {
 	struct sfs_direntry tsd;
 	int found, nentries, i, result;
+	int freeslot;
+	bool freeempty;
+
+	if (sfs_dir_ishashed(sv)) {
+		result = sfs_dir_hashfind(sv, name, ino, slot,
+					  &freeslot, &freeempty);
+		if (emptyslot != NULL && freeslot >= 0) {
+			*emptyslot = freeslot;
+		}
+		return result;
+	}
 
 	nentries = sfs_dir_nentries(sv);
 
@@ -146,9 +411,91 @@ sfs_dir_findname(struct sfs_vnode *sv, const char *name,
 	return found ? 0 : ENOENT;
 }
 
+/*
+ * sfs_dir_link for hashed directories.
+ */
+static
+int
+sfs_dir_hashlink(struct sfs_vnode *sv, const char *name, uint32_t ino,
+		 int *slot)
+{
+	struct sfs_direntry sd;
+	int nentries, freeslot;
+	bool freeempty;
+	int result;
+
+	/* Look up the name. We want to make sure it *doesn't* exist. */
+	result = sfs_dir_hashfind(sv, name, NULL, NULL, &freeslot, &freeempty);
+	if (result!=0 && result!=ENOENT) {
+		return result;
+	}
+	if (result==0) {
+		return EEXIST;
+	}
+
+	if (strlen(name)+1 > sizeof(sd.sfd_name)) {
+		return ENAMETOOLONG;
+	}
+	if (!strcmp(name, SFS_DIRDELETED)) {
+		/* Would look like a deleted entry. */
+		return EINVAL;
+	}
+
+	result = sfs_dir_countused(sv);
+	if (result) {
+		return result;
+	}
+
+	/*
+	 * Rebuild the table if it's too full, unless that wouldn't
+	 * change anything: no deleted entries to drop and no room to
+	 * grow.
+	 */
+	nentries = sfs_dir_nentries(sv);
+	if (freeslot < 0 ||
+	    (freeempty && (sv->sv_dirused + 1) * 4 > nentries * 3 &&
+	     (sv->sv_dirused > sv->sv_dirlive ||
+	      sfs_dir_hashsize(sv, sv->sv_dirlive) != nentries))) {
+		result = sfs_dir_rehash(sv);
+		if (result) {
+			return result;
+		}
+		result = sfs_dir_hashfind(sv, name, NULL, NULL,
+					  &freeslot, &freeempty);
+		if (result != ENOENT) {
+			return result ? result : EEXIST;
+		}
+		KASSERT(freeslot >= 0);
+	}
+
+	/* Set up the entry. */
+	bzero(&sd, sizeof(sd));
+	sd.sfd_ino = ino;
+	strcpy(sd.sfd_name, name);
+
+	/* Write the entry. */
+	result = sfs_writedir(sv, freeslot, &sd);
+	if (result) {
+		return result;
+	}
+	if (freeempty) {
+		sv->sv_dirused++;
+	}
+	sv->sv_dirlive++;
+
+	/* Hand back the slot, if so requested. */
+	if (slot) {
+		*slot = freeslot;
+	}
+	return 0;
+}
+
 /*
  * Create a link in a directory to the specified inode by number, with
  * the specified name, and optionally hand back the slot.
+ *
+ * In a hashed directory this may move the other entries around, so
+ * any slot numbers the caller already had are stale afterwards.
  */
 int
 sfs_dir_link(struct sfs_vnode *sv, const char *name, uint32_t ino, int *slot)
@@ -157,6 +504,10 @@ sfs_dir_link(struct sfs_vnode *sv, const char *name, uint32_t ino, int *slot)
 	int result;
 	struct sfs_direntry sd;
 
+	if (sfs_dir_ishashed(sv)) {
+		return sfs_dir_hashlink(sv, name, ino, slot);
+	}
+
 	/* Look up the name. We want to make sure it *doesn't* exist. */
 	result = sfs_dir_findname(sv, name, NULL, NULL, &emptyslot);
 	if (result!=0 && result!=ENOENT) {
@@ -196,13 +547,26 @@ int
 sfs_dir_unlink(struct sfs_vnode *sv, int slot)
 {
 	struct sfs_direntry sd;
+	int result;
 
 	/* Initialize a suitable directory entry... */
 	bzero(&sd, sizeof(sd));
 	sd.sfd_ino = SFS_NOINO;
+	if (sfs_dir_ishashed(sv)) {
+		/* Leave a marker, so lookups keep going past it. */
+		strcpy(sd.sfd_name, SFS_DIRDELETED);
+	}
 
 	/* ... and write it */
-	return sfs_writedir(sv, slot, &sd);
+	result = sfs_writedir(sv, slot, &sd);
+	if (result) {
+		return result;
+	}
+	if (sfs_dir_ishashed(sv) && sv->sv_dirused >= 0) {
+		KASSERT(sv->sv_dirlive > 0);
+		sv->sv_dirlive--;
+	}
+	return 0;
 }
 
 /*
@@ -228,6 +592,7 @@ sfs_lookonce(struct sfs_vnode *sv, const char *name,
 		return result;
 	}
 
+	/* We hold the directory's lock, so we can look at this. */
 	if ((*ret)->sv_i.sfi_linkcount == 0) {
 		panic("sfs: %s: name %s (inode %u) in dir %u has "
 		      "linkcount 0\n", sfs->sfs_sb.sb_volname,
@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * SFS filesystem
+ *
+ * Extent-based block mapping, for volumes with SFS_FEATURE_EXTENTS.
+ * See kern/sfs.h for the layout. sfs_bmap and sfs_itrunc hand off to
+ * here on such volumes.
+ *
+ * Each vnode remembers the last leaf extent it looked up in
+ * sv_lastext, so sequential I/O mostly doesn't walk the tree at all.
+ * Extents only ever grow, except in truncation, which clears it.
+ */
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <synch.h>
+#include <vfs.h>
+#include <buf.h>
+#include <sfs.h>
+#include "sfsprivate.h"
+
+/*
+ * One node of the tree: the root, in the inode, or a tree block.
+ */
+struct sfs_extnode {
+	struct buf *en_buf;		/* tree block's buffer, or NULL */
+	uint16_t *en_depth;		/* depth of the tree below */
+	uint16_t *en_count;		/* number of entries in use */
+	struct sfs_extent *en_ext;	/* the entries */
+	unsigned en_max;		/* room for this many */
+};
+
+/*
+ * Get the root of SV's tree.
+ */
+static
+void
+sfs_ext_root(struct sfs_vnode *sv, struct sfs_extnode *node)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+
+	if (sv->sv_ei.sfi_extdepth > SFS_EXTMAXDEPTH ||
+	    sv->sv_ei.sfi_nextents > SFS_NEXTINODE) {
+		panic("sfs: %s: Bad extent tree root in file %u\n",
+		      sfs->sfs_sb.sb_volname, sv->sv_ino);
+	}
+	node->en_buf = NULL;
+	node->en_depth = &sv->sv_ei.sfi_extdepth;
+	node->en_count = &sv->sv_ei.sfi_nextents;
+	node->en_ext = sv->sv_ei.sfi_extents;
+	node->en_max = SFS_NEXTINODE;
+}
+
+static
+void
+sfs_ext_setnode(struct sfs_extnode *node, struct buf *buf)
+{
+	struct sfs_extblock *eb = buffer_map(buf);
+
+	node->en_buf = buf;
+	node->en_depth = &eb->seb_depth;
+	node->en_count = &eb->seb_nextents;
+	node->en_ext = eb->seb_extents;
+	node->en_max = SFS_NEXTBLOCK;
+}
+
+/*
+ * Load tree block BLOCK of SV, which should be at depth DEPTH.
+ */
+static
+int
+sfs_ext_load(struct sfs_vnode *sv, daddr_t block, unsigned depth,
+	     struct sfs_extnode *node)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *buf;
+	struct sfs_extblock *eb;
+	int result;
+
+	if (block == 0 || !sfs_bused(sfs, block)) {
+		panic("sfs: %s: Extent tree block %u of file %u "
+		      "marked free\n", sfs->sfs_sb.sb_volname,
+		      block, sv->sv_ino);
+	}
+
+	result = buffer_read(sfs->sfs_device, block, &buf);
+	if (result) {
+		return result;
+	}
+	eb = buffer_map(buf);
+	if (eb->seb_depth != depth || eb->seb_nextents == 0 ||
+	    eb->seb_nextents > SFS_NEXTBLOCK) {
+		panic("sfs: %s: Bad extent tree block %u in file %u\n",
+		      sfs->sfs_sb.sb_volname, block, sv->sv_ino);
+	}
+	sfs_ext_setnode(node, buf);
+	return 0;
+}
+
+/*
+ * Allocate a new, empty tree block at depth DEPTH.
+ */
+static
+int
+sfs_ext_newblock(struct sfs_vnode *sv, unsigned depth, daddr_t *block,
+		 struct sfs_extnode *node)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *buf;
+	int result;
+
+	/* Keep it near the inode */
+	result = sfs_balloc(sfs, sv->sv_ino + 1, true, block);
+	if (result) {
+		return result;
+	}
+
+	/* (sfs_balloc zeroed it, so it's in the cache now) */
+	result = buffer_read(sfs->sfs_device, *block, &buf);
+	if (result) {
+		sfs_bfree(sfs, *block);
+		return result;
+	}
+	sfs_ext_setnode(node, buf);
+	*node->en_depth = depth;
+	return 0;
+}
+
+static
+void
+sfs_ext_put(struct sfs_extnode *node)
+{
+	if (node->en_buf != NULL) {
+		buffer_release(node->en_buf);
+		node->en_buf = NULL;
+	}
+}
+
+static
+void
+sfs_ext_markdirty(struct sfs_vnode *sv, struct sfs_extnode *node)
+{
+	if (node->en_buf != NULL) {
+		buffer_markdirty(node->en_buf);
+	}
+	else {
+		sv->sv_dirty = true;
+	}
+}
+
+/*
+ * Return the index of the last entry of NODE starting at or before
+ * FILEBLOCK, or -1 if there isn't one.
+ */
+static
+int
+sfs_ext_find(const struct sfs_extnode *node, uint32_t fileblock)
+{
+	int lo, hi, mid;
+
+	lo = -1;
+	hi = (int)*node->en_count - 1;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (node->en_ext[mid].se_fileblock <= fileblock) {
+			lo = mid;
+		}
+		else {
+			hi = mid - 1;
+		}
+	}
+	return lo;
+}
+
+/*
+ * Go from index node NODE to the child that holds FILEBLOCK. NODE
+ * is released whether or not this works.
+ */
+static
+int
+sfs_ext_descend(struct sfs_vnode *sv, struct sfs_extnode *node,
+		uint32_t fileblock)
+{
+	struct sfs_extnode child;
+	int i, result;
+
+	KASSERT(*node->en_depth > 0 && *node->en_count > 0);
+
+	i = sfs_ext_find(node, fileblock);
+	if (i < 0) {
+		i = 0;
+	}
+	result = sfs_ext_load(sv, node->en_ext[i].se_diskblock,
+			      *node->en_depth - 1, &child);
+	sfs_ext_put(node);
+	if (result) {
+		return result;
+	}
+	*node = child;
+	return 0;
+}
+
+/*
+ * Find the leaf extent covering FILEBLOCK and put it in sv_lastext.
+ * If FILEBLOCK is in a hole, sv_lastext gets the extent before it
+ * instead, if it's in the same leaf, or is cleared.
+ */
+static
+int
+sfs_ext_lookup(struct sfs_vnode *sv, uint32_t fileblock)
+{
+	struct sfs_extnode node;
+	int i, result;
+
+	sfs_ext_root(sv, &node);
+	while (*node.en_depth > 0) {
+		result = sfs_ext_descend(sv, &node, fileblock);
+		if (result) {
+			return result;
+		}
+	}
+
+	i = sfs_ext_find(&node, fileblock);
+	if (i >= 0) {
+		sv->sv_lastext = node.en_ext[i];
+	}
+	else {
+		bzero(&sv->sv_lastext, sizeof(sv->sv_lastext));
+	}
+	sfs_ext_put(&node);
+	return 0;
+}
+
+/*
+ * If sv_lastext covers FILEBLOCK, return true, with the disk block in
+ * *DISKBLOCK and the number of blocks left in the extent from there
+ * in *RUN.
+ */
+static
+bool
+sfs_ext_cached(struct sfs_vnode *sv, uint32_t fileblock,
+	       daddr_t *diskblock, uint32_t *run)
+{
+	struct sfs_extent *se = &sv->sv_lastext;
+	uint32_t off;
+
+	if (se->se_len == 0 || fileblock < se->se_fileblock) {
+		return false;
+	}
+	off = fileblock - se->se_fileblock;
+	if (off >= se->se_len) {
+		return false;
+	}
+	*diskblock = se->se_diskblock + off;
+	*run = se->se_len - off;
+	return true;
+}
+
+/*
+ * Make room in the root by moving its entries into a new tree block
+ * and pointing the root at that. The tree gets one level deeper.
+ */
+static
+int
+sfs_ext_grow(struct sfs_vnode *sv)
+{
+	struct sfs_extnode root, child;
+	daddr_t block;
+	int result;
+
+	sfs_ext_root(sv, &root);
+	if (*root.en_depth >= SFS_EXTMAXDEPTH) {
+		return EFBIG;
+	}
+
+	result = sfs_ext_newblock(sv, *root.en_depth, &block, &child);
+	if (result) {
+		return result;
+	}
+	memcpy(child.en_ext, root.en_ext,
+	       *root.en_count * sizeof(struct sfs_extent));
+	*child.en_count = *root.en_count;
+	sfs_ext_markdirty(sv, &child);
+	sfs_ext_put(&child);
+
+	/* The first entry keeps its se_fileblock. */
+	root.en_ext[0].se_diskblock = block;
+	root.en_ext[0].se_len = 0;
+	bzero(&root.en_ext[1], (root.en_max - 1) * sizeof(struct sfs_extent));
+	*root.en_count = 1;
+	(*root.en_depth)++;
+	sfs_ext_markdirty(sv, &root);
+	return 0;
+}
+
+/*
+ * Split CHILD, which is full and is entry I of index node NODE,
+ * moving its upper half to a new tree block that goes in NODE after
+ * it. NODE must have room. Afterwards CHILD is whichever half now
+ * holds FILEBLOCK, and the other half has been released.
+ */
+static
+int
+sfs_ext_split(struct sfs_vnode *sv, struct sfs_extnode *node, int i,
+	      struct sfs_extnode *child, uint32_t fileblock)
+{
+	struct sfs_extnode sib;
+	struct sfs_extent *se;
+	daddr_t block;
+	unsigned keep, move;
+	int result;
+
+	KASSERT(*node->en_count < node->en_max);
+	KASSERT(*child->en_count == child->en_max);
+
+	result = sfs_ext_newblock(sv, *child->en_depth, &block, &sib);
+	if (result) {
+		return result;
+	}
+
+	keep = *child->en_count / 2;
+	move = *child->en_count - keep;
+	memcpy(sib.en_ext, child->en_ext + keep,
+	       move * sizeof(struct sfs_extent));
+	bzero(child->en_ext + keep, move * sizeof(struct sfs_extent));
+	*sib.en_count = move;
+	*child->en_count = keep;
+	sfs_ext_markdirty(sv, &sib);
+	sfs_ext_markdirty(sv, child);
+
+	memmove(&node->en_ext[i+2], &node->en_ext[i+1],
+		(*node->en_count - i - 1) * sizeof(struct sfs_extent));
+	se = &node->en_ext[i+1];
+	se->se_fileblock = sib.en_ext[0].se_fileblock;
+	se->se_diskblock = block;
+	se->se_len = 0;
+	(*node->en_count)++;
+	sfs_ext_markdirty(sv, node);
+
+	if (fileblock >= sib.en_ext[0].se_fileblock) {
+		sfs_ext_put(child);
+		*child = sib;
+	}
+	else {
+		sfs_ext_put(&sib);
+	}
+	return 0;
+}
+
+/*
+ * Add a one-block extent mapping FILEBLOCK, which is a hole, to
+ * DISKBLOCK. Full nodes are split on the way down to the leaf, so
+ * there's always room in the parent for the new half, and a failure
+ * leaves the tree intact.
+ */
+static
+int
+sfs_ext_insert(struct sfs_vnode *sv, uint32_t fileblock, daddr_t diskblock)
+{
+	struct sfs_extnode node, child;
+	struct sfs_extent *se;
+	int i, result;
+
+	sfs_ext_root(sv, &node);
+	if (*node.en_count == node.en_max) {
+		result = sfs_ext_grow(sv);
+		if (result) {
+			return result;
+		}
+	}
+
+	while (*node.en_depth > 0) {
+		i = sfs_ext_find(&node, fileblock);
+		if (i < 0) {
+			/* Keep the first key at or below what's under it */
+			i = 0;
+			node.en_ext[0].se_fileblock = fileblock;
+			sfs_ext_markdirty(sv, &node);
+		}
+		result = sfs_ext_load(sv, node.en_ext[i].se_diskblock,
+				      *node.en_depth - 1, &child);
+		if (result) {
+			sfs_ext_put(&node);
+			return result;
+		}
+		if (*child.en_count == child.en_max) {
+			result = sfs_ext_split(sv, &node, i, &child,
+					       fileblock);
+			if (result) {
+				sfs_ext_put(&child);
+				sfs_ext_put(&node);
+				return result;
+			}
+		}
+		sfs_ext_put(&node);
+		node = child;
+	}
+
+	i = sfs_ext_find(&node, fileblock) + 1;
+	memmove(&node.en_ext[i+1], &node.en_ext[i],
+		(*node.en_count - i) * sizeof(struct sfs_extent));
+	se = &node.en_ext[i];
+	se->se_fileblock = fileblock;
+	se->se_diskblock = diskblock;
+	se->se_len = 1;
+	(*node.en_count)++;
+	sfs_ext_markdirty(sv, &node);
+
+	sv->sv_lastext = *se;
+	sfs_ext_put(&node);
+	return 0;
+}
+
+/*
+ * Map FILEBLOCK, which is a hole, to the newly allocated DISKBLOCK.
+ * If that's right after the end of the extent before it on disk too,
+ * as it will be for a file written sequentially, just make that
+ * extent longer.
+ */
+static
+int
+sfs_ext_add(struct sfs_vnode *sv, uint32_t fileblock, daddr_t diskblock)
+{
+	struct sfs_extnode node;
+	struct sfs_extent *se;
+	int i, result;
+
+	sfs_ext_root(sv, &node);
+	while (*node.en_depth > 0) {
+		result = sfs_ext_descend(sv, &node, fileblock);
+		if (result) {
+			return result;
+		}
+	}
+
+	i = sfs_ext_find(&node, fileblock);
+	if (i >= 0) {
+		se = &node.en_ext[i];
+		KASSERT(fileblock - se->se_fileblock >= se->se_len);
+		if (se->se_fileblock + se->se_len == fileblock &&
+		    se->se_diskblock + se->se_len == diskblock) {
+			se->se_len++;
+			sfs_ext_markdirty(sv, &node);
+			sv->sv_lastext = *se;
+			sfs_ext_put(&node);
+			return 0;
+		}
+	}
+	sfs_ext_put(&node);
+
+	return sfs_ext_insert(sv, fileblock, diskblock);
+}
+
+/*
+ * Look up FILEBLOCK of SV. Returns the disk block in *DISKBLOCK, or 0
+ * for a hole, and in *RUN how many blocks from there on are mapped
+ * to consecutive disk blocks (1 for a hole).
+ */
+static
+int
+sfs_ext_map(struct sfs_vnode *sv, uint32_t fileblock, daddr_t *diskblock,
+	    uint32_t *run)
+{
+	int result;
+
+	if (sfs_ext_cached(sv, fileblock, diskblock, run)) {
+		return 0;
+	}
+	result = sfs_ext_lookup(sv, fileblock);
+	if (result) {
+		return result;
+	}
+	if (!sfs_ext_cached(sv, fileblock, diskblock, run)) {
+		*diskblock = 0;
+		*run = 1;
+	}
+	return 0;
+}
+
+/*
+ * sfs_bmap for extent-mapped files.
+ */
+int
+sfs_ext_bmap(struct sfs_vnode *sv, uint32_t fileblock, int doalloc,
+	     daddr_t *diskblock, uint32_t *run)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct sfs_extent *se;
+	daddr_t block, goal;
+	int result;
+
+	result = sfs_ext_map(sv, fileblock, &block, run);
+	if (result) {
+		return result;
+	}
+
+	if (block == 0 && doalloc != SFS_BMAP_LOOKUP) {
+		if (fileblock >= SFS_EXTMAXFILEBLOCK) {
+			return EFBIG;
+		}
+
+		/*
+		 * The lookup left the extent before FILEBLOCK, if any,
+		 * in sv_lastext. Put the new block as far from that on
+		 * disk as it is in the file, so that when the file is
+		 * filled in sequentially the extent just grows.
+		 */
+		se = &sv->sv_lastext;
+		if (se->se_len > 0 && se->se_fileblock < fileblock) {
+			goal = se->se_diskblock + (fileblock - se->se_fileblock);
+		}
+		else {
+			goal = sv->sv_ino + 1;
+		}
+		result = sfs_balloc(sfs, goal, doalloc != SFS_BMAP_FILL,
+				    &block);
+		if (result) {
+			return result;
+		}
+		result = sfs_ext_add(sv, fileblock, block);
+		if (result) {
+			sfs_bfree(sfs, block);
+			return result;
+		}
+		*run = 1;
+	}
+
+	if (block != 0 && !sfs_bused(sfs, block)) {
+		panic("sfs: %s: Data block %u (block %u of file %u) "
+		      "marked free\n", sfs->sfs_sb.sb_volname,
+		      block, fileblock, sv->sv_ino);
+	}
+	*diskblock = block;
+	return 0;
+}
+
+/*
+ * Free everything NODE maps at or past file block BLOCKLEN, and
+ * remove the entries left empty. Those are always at the end.
+ */
+static
+int
+sfs_ext_truncnode(struct sfs_vnode *sv, struct sfs_extnode *node,
+		  uint32_t blocklen)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct sfs_extnode child;
+	struct sfs_extent *se;
+	uint32_t start, keep, j;
+	bool empty;
+	int i, result;
+
+	for (i = (int)*node->en_count - 1; i >= 0; i--) {
+		se = &node->en_ext[i];
+		start = se->se_fileblock;
+
+		if (*node->en_depth > 0) {
+			result = sfs_ext_load(sv, se->se_diskblock,
+					      *node->en_depth - 1, &child);
+			if (result) {
+				return result;
+			}
+			result = sfs_ext_truncnode(sv, &child, blocklen);
+			empty = *child.en_count == 0;
+			sfs_ext_put(&child);
+			if (result) {
+				return result;
+			}
+			if (empty) {
+				sfs_bfree(sfs, se->se_diskblock);
+			}
+		}
+		else {
+			if (start + se->se_len <= blocklen) {
+				break;
+			}
+			keep = start < blocklen ? blocklen - start : 0;
+			for (j = keep; j < se->se_len; j++) {
+				sfs_bfree(sfs, se->se_diskblock + j);
+			}
+			se->se_len = keep;
+			empty = keep == 0;
+			sfs_ext_markdirty(sv, node);
+		}
+
+		if (empty) {
+			KASSERT(i == (int)*node->en_count - 1);
+			bzero(se, sizeof(*se));
+			(*node->en_count)--;
+			sfs_ext_markdirty(sv, node);
+		}
+
+		/* Entries before this one are all below START. */
+		if (start <= blocklen) {
+			break;
+		}
+	}
+	return 0;
+}
+
+/*
+ * sfs_itrunc for extent-mapped files.
+ */
+int
+sfs_ext_itrunc(struct sfs_vnode *sv, off_t len)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct sfs_extnode root, child;
+	daddr_t block;
+	uint32_t blocklen;
+	int result;
+
+	/* Length in blocks (divide rounding up) */
+	blocklen = DIVROUNDUP(len, SFS_BLOCKSIZE);
+
+	bzero(&sv->sv_lastext, sizeof(sv->sv_lastext));
+
+	sfs_ext_root(sv, &root);
+	result = sfs_ext_truncnode(sv, &root, blocklen);
+	if (result) {
+		return result;
+	}
+
+	/* Make the tree shallower while the root's one child fits in it */
+	while (*root.en_depth > 0 && *root.en_count <= 1) {
+		if (*root.en_count == 0) {
+			*root.en_depth = 0;
+			break;
+		}
+		block = root.en_ext[0].se_diskblock;
+		result = sfs_ext_load(sv, block, *root.en_depth - 1, &child);
+		if (result) {
+			return result;
+		}
+		if (*child.en_count > root.en_max) {
+			sfs_ext_put(&child);
+			break;
+		}
+		memcpy(root.en_ext, child.en_ext,
+		       *child.en_count * sizeof(struct sfs_extent));
+		*root.en_count = *child.en_count;
+		*root.en_depth = *child.en_depth;
+		sfs_ext_put(&child);
+		sfs_bfree(sfs, block);
+	}
+
+	/* Set the file size */
+	sv->sv_i.sfi_size = len;
+
+	/* Mark the inode dirty */
+	sv->sv_dirty = true;
+
+	return 0;
+}
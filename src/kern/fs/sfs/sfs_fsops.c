@@ -38,9 +38,11 @@
 #include <lib.h>
 #include <array.h>
 #include <bitmap.h>
+#include <synch.h>
 #include <uio.h>
 #include <vfs.h>
 #include <device.h>
+#include <buf.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
@@ -51,9 +53,9 @@
 #define SFS_FS_FREEMAPBLOCKS(sfs)  SFS_FREEMAPBLOCKS(SFS_FS_NBLOCKS(sfs))
 
 /*
- * Routine for doing I/O (reads or writes) on the free block bitmap.
- * We always do the whole bitmap at once; writing individual sectors
- * might or might not be a worthwhile optimization.
+ * Routine for reading the free block bitmap at mount time. After
+ * that, changed blocks of it are written back through the buffer
+ * cache by sfs_sync_freemap.
  *
  * The free block bitmap consists of SFS_FREEMAPBLOCKS 512-byte
  * sectors of bits, one bit for each sector on the filesystem. The
@@ -69,7 +71,7 @@
  */
 static
 int
-sfs_freemapio(struct sfs_fs *sfs, enum uio_rw rw)
+sfs_freemapload(struct sfs_fs *sfs)
 {
 	uint32_t j, freemapblocks;
 	char *freemapdata;
@@ -87,15 +89,9 @@ sfs_freemapio(struct sfs_fs *sfs, enum uio_rw rw)
 		/* Get a pointer to its data */
 		void *ptr = freemapdata + j*SFS_BLOCKSIZE;
 
-		/* and read or write it. The freemap starts at sector 2. */
-		if (rw == UIO_READ) {
-			result = sfs_readblock(sfs, SFS_FREEMAP_START+j, ptr,
-					       SFS_BLOCKSIZE);
-		}
-		else {
-			result = sfs_writeblock(sfs, SFS_FREEMAP_START+j, ptr,
-						SFS_BLOCKSIZE);
-		}
+		/* and read it. The freemap starts at sector 2. */
+		result = sfs_readblock(sfs, SFS_FREEMAP_START+j, ptr,
+				       SFS_BLOCKSIZE);
 
 		/* If we failed, stop. */
 		if (result) {
@@ -106,39 +102,111 @@ sfs_freemapio(struct sfs_fs *sfs, enum uio_rw rw)
 }
 
 /*
- * Sync routine for the vnode table.
+ * Copy a block's worth of our own data (the superblock, or part of
+ * the freemap) into the buffer cache, to be written back with
+ * everything else.
+ */
+static
+int
+sfs_writecache(struct sfs_fs *sfs, daddr_t block, const void *data)
+{
+	struct buf *buf;
+	int result;
+
+	result = buffer_get(sfs->sfs_device, block, &buf);
+	if (result) {
+		return result;
+	}
+	memcpy(buffer_map(buf), data, SFS_BLOCKSIZE);
+	buffer_markdirty(buf);
+	buffer_release(buf);
+	return 0;
+}
+
+/*
+ * Sync routine for the vnode table. This only copies the inodes into
+ * the buffer cache; sfs_sync writes the cache out afterwards, once,
+ * rather than calling VOP_FSYNC to do it for every vnode.
+ *
+ * Vnode locks come before sfs_vnlock, so we can't hold it while we
+ * sync each one. Instead take a reference to each in turn, which
+ * keeps it from being reclaimed, and let go of the table. Going from
+ * the end backwards means that when a reclaim moves the last vnode
+ * into an earlier slot, the one moved has already been done (it may
+ * get done twice, which is harmless); vnodes loaded meanwhile are
+ * added at the end, after where we are, and are skipped.
  */
 static
 int
 sfs_sync_vnodes(struct sfs_fs *sfs)
 {
+	struct vnode *v;
+	struct sfs_vnode *sv;
 	unsigned i, num;
+	int result;
 
-	/* Go over the array of loaded vnodes, syncing as we go. */
-	num = vnodearray_num(sfs->sfs_vnodes);
-	for (i=0; i<num; i++) {
-		struct vnode *v = vnodearray_get(sfs->sfs_vnodes, i);
-		VOP_FSYNC(v);
+	lock_acquire(sfs->sfs_vnlock);
+	i = vnodearray_num(sfs->sfs_vnodes);
+	while (i > 0) {
+		i--;
+		v = vnodearray_get(sfs->sfs_vnodes, i);
+		VOP_INCREF(v);
+		lock_release(sfs->sfs_vnlock);
+
+		sv = v->vn_data;
+		lock_acquire(sv->sv_lock);
+		result = sfs_sync_inode(sv);
+		lock_release(sv->sv_lock);
+		VOP_DECREF(v);
+		if (result) {
+			return result;
+		}
+
+		lock_acquire(sfs->sfs_vnlock);
+		num = vnodearray_num(sfs->sfs_vnodes);
+		if (i > num) {
+			i = num;
+		}
 	}
+	lock_release(sfs->sfs_vnlock);
 	return 0;
 }
 
 /*
- * Sync routine for the freemap.
+ * Sync routine for the freemap. Like the vnodes, only the freemap
+ * blocks that changed are copied into the buffer cache.
  */
 static
 int
 sfs_sync_freemap(struct sfs_fs *sfs)
 {
+	uint32_t j, freemapblocks;
+	char *freemapdata;
 	int result;
 
-	if (sfs->sfs_freemapdirty) {
-		result = sfs_freemapio(sfs, UIO_WRITE);
+	lock_acquire(sfs->sfs_freemaplock);
+	if (!sfs->sfs_freemapdirty) {
+		lock_release(sfs->sfs_freemaplock);
+		return 0;
+	}
+
+	freemapblocks = SFS_FS_FREEMAPBLOCKS(sfs);
+	freemapdata = bitmap_getdata(sfs->sfs_freemap);
+
+	for (j=0; j<freemapblocks; j++) {
+		if (!bitmap_isset(sfs->sfs_freemapdirtyblocks, j)) {
+			continue;
+		}
+		result = sfs_writecache(sfs, SFS_FREEMAP_START+j,
+					freemapdata + j*SFS_BLOCKSIZE);
 		if (result) {
+			lock_release(sfs->sfs_freemaplock);
 			return result;
 		}
-		sfs->sfs_freemapdirty = false;
+		bitmap_unmark(sfs->sfs_freemapdirtyblocks, j);
 	}
+	sfs->sfs_freemapdirty = false;
+	lock_release(sfs->sfs_freemaplock);
 
 	return 0;
 }
@@ -152,14 +220,16 @@ sfs_sync_superblock(struct sfs_fs *sfs)
 {
 	int result;
 
+	lock_acquire(sfs->sfs_freemaplock);
 	if (sfs->sfs_superdirty) {
-		result = sfs_writeblock(sfs, SFS_SUPER_BLOCK, &sfs->sfs_sb,
-					sizeof(sfs->sfs_sb));
+		result = sfs_writecache(sfs, SFS_SUPER_BLOCK, &sfs->sfs_sb);
 		if (result) {
+			lock_release(sfs->sfs_freemaplock);
 			return result;
 		}
 		sfs->sfs_superdirty = false;
 	}
+	lock_release(sfs->sfs_freemaplock);
 	return 0;
 }
 
@@ -174,8 +244,6 @@ sfs_sync(struct fs *fs)
 	struct sfs_fs *sfs;
 	int result;
 
-	vfs_biglock_acquire();
-
 	/*
 	 * Get the sfs_fs from the generic abstract fs.
 	 *
@@ -208,48 +276,47 @@ sfs_sync(struct fs *fs)
 
 	sfs = fs->fs_data;
 
-	/* If any vnodes need to be written, write them. */
+	/*
+	 * Copy the dirty vnodes, freemap blocks and superblock into
+	 * the buffer cache; then write the cache back in one sorted
+	 * pass, so the disk sees everything in block order.
+	 */
 	result = sfs_sync_vnodes(sfs);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
-	/* If the free block map needs to be written, write it. */
 	result = sfs_sync_freemap(sfs);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
-	/* If the superblock needs to be written, write it. */
 	result = sfs_sync_superblock(sfs);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
-	vfs_biglock_release();
+	result = buffer_sync(sfs->sfs_device);
+	if (result) {
+		return result;
+	}
+
 	return 0;
 }
 
 /*
  * Routine to retrieve the volume name. Filesystems can be referred
  * to by their volume name followed by a colon as well as the name
- * of the device they're mounted on.
+ * of the device they're mounted on. It doesn't change after mount,
+ * so there's nothing to lock.
  */
 static
 const char *
 sfs_getvolname(struct fs *fs)
 {
 	struct sfs_fs *sfs = fs->fs_data;
-	const char *ret;
-
-	vfs_biglock_acquire();
-	ret = sfs->sfs_sb.sb_volname;
-	vfs_biglock_release();
 
-	return ret;
+	return sfs->sfs_sb.sb_volname;
 }
 
 /*
@@ -262,7 +329,15 @@ sfs_fs_destroy(struct sfs_fs *sfs)
 	if (sfs->sfs_freemap != NULL) {
 		bitmap_destroy(sfs->sfs_freemap);
 	}
+	if (sfs->sfs_freemapdirtyblocks != NULL) {
+		bitmap_destroy(sfs->sfs_freemapdirtyblocks);
+	}
+	if (sfs->sfs_regionfree != NULL) {
+		kfree(sfs->sfs_regionfree);
+	}
+	lock_destroy(sfs->sfs_freemaplock);
 	vnodearray_destroy(sfs->sfs_vnodes);
+	lock_destroy(sfs->sfs_vnlock);
 	KASSERT(sfs->sfs_device == NULL);
 	kfree(sfs);
 }
@@ -270,26 +345,35 @@ sfs_fs_destroy(struct sfs_fs *sfs)
 /*
  * Unmount code.
  *
- * VFS calls FS_SYNC on the filesystem prior to unmounting it.
+ * VFS calls FS_SYNC on the filesystem prior to unmounting it. It
+ * also holds vfs_biglock, so nobody can find the volume to open a
+ * file on it while we're here.
  */
 static
 int
 sfs_unmount(struct fs *fs)
 {
 	struct sfs_fs *sfs = fs->fs_data;
-
-	vfs_biglock_acquire();
+	int result;
 
 	/* Do we have any files open? If so, can't unmount. */
+	lock_acquire(sfs->sfs_vnlock);
 	if (vnodearray_num(sfs->sfs_vnodes) > 0) {
-		vfs_biglock_release();
+		lock_release(sfs->sfs_vnlock);
 		return EBUSY;
 	}
+	lock_release(sfs->sfs_vnlock);
 
 	/* We should have just had sfs_sync called. */
 	KASSERT(sfs->sfs_superdirty == false);
 	KASSERT(sfs->sfs_freemapdirty == false);
 
+	/* Get our blocks out of the buffer cache. */
+	result = buffer_purge(sfs->sfs_device);
+	if (result) {
+		return result;
+	}
+
 	/* The vfs layer takes care of the device for us */
 	sfs->sfs_device = NULL;
 
@@ -297,7 +381,6 @@ sfs_unmount(struct fs *fs)
 	sfs_fs_destroy(sfs);
 
 	/* nothing else to do */
-	vfs_biglock_release();
 	return 0;
 }
 
@@ -321,12 +404,15 @@ struct sfs_fs *
 sfs_fs_create(void)
 {
 	struct sfs_fs *sfs;
+	unsigned i;
 
 	/*
 	 * Make sure our on-disk structures aren't messed up
 	 */
 	COMPILE_ASSERT(sizeof(struct sfs_superblock)==SFS_BLOCKSIZE);
 	COMPILE_ASSERT(sizeof(struct sfs_dinode)==SFS_BLOCKSIZE);
+	COMPILE_ASSERT(sizeof(struct sfs_extdinode)==SFS_BLOCKSIZE);
+	COMPILE_ASSERT(sizeof(struct sfs_extblock)==SFS_BLOCKSIZE);
 	COMPILE_ASSERT(SFS_BLOCKSIZE % sizeof(struct sfs_direntry) == 0);
 
 	/* Allocate object */
@@ -351,17 +437,36 @@ sfs_fs_create(void)
 	sfs->sfs_device = NULL;
 
 	/* vnode table */
+	sfs->sfs_vnlock = lock_create("sfs_vnlock");
+	if (sfs->sfs_vnlock == NULL) {
+		goto cleanup_object;
+	}
 	sfs->sfs_vnodes = vnodearray_create();
 	if (sfs->sfs_vnodes == NULL) {
-		goto cleanup_object;
+		goto cleanup_vnlock;
+	}
+	for (i=0; i<SFS_VNHASHSIZE; i++) {
+		sfs->sfs_vnhash[i] = NULL;
 	}
 
 	/* freemap */
+	sfs->sfs_freemaplock = lock_create("sfs_freemaplock");
+	if (sfs->sfs_freemaplock == NULL) {
+		goto cleanup_vnodes;
+	}
 	sfs->sfs_freemap = NULL;
 	sfs->sfs_freemapdirty = false;
+	sfs->sfs_freemapdirtyblocks = NULL;
+	sfs->sfs_regionfree = NULL;
+	sfs->sfs_nregions = 0;
+	sfs->sfs_cursor = 0;
 
 	return sfs;
 
+cleanup_vnodes:
+	vnodearray_destroy(sfs->sfs_vnodes);
+cleanup_vnlock:
+	lock_destroy(sfs->sfs_vnlock);
 cleanup_object:
 	kfree(sfs);
 fail:
@@ -388,8 +493,6 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	int result;
 	struct sfs_fs *sfs;
 
-	vfs_biglock_acquire();
-
 	/* We don't pass any options through mount */
 	(void)options;
 
@@ -402,7 +505,6 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	 * don't do that in sfs.)
 	 */
 	if (dev->d_blocksize != SFS_BLOCKSIZE) {
-		vfs_biglock_release();
 		kprintf("sfs: Cannot mount on device with blocksize %zu\n",
 			dev->d_blocksize);
 		return ENXIO;
@@ -410,7 +512,6 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 
 	sfs = sfs_fs_create();
 	if (sfs == NULL) {
-		vfs_biglock_release();
 		return ENOMEM;
 	}
 
@@ -423,7 +524,6 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	if (result) {
 		sfs->sfs_device = NULL;
 		sfs_fs_destroy(sfs);
-		vfs_biglock_release();
 		return result;
 	}
 
@@ -436,7 +536,6 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 			SFS_MAGIC);
 		sfs->sfs_device = NULL;
 		sfs_fs_destroy(sfs);
-		vfs_biglock_release();
 		return EINVAL;
 	}
 
@@ -448,26 +547,45 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	/* Ensure null termination of the volume name */
 	sfs->sfs_sb.sb_volname[sizeof(sfs->sfs_sb.sb_volname)-1] = 0;
 
+	if (sfs->sfs_sb.sb_features & ~SFS_FEATURES_KNOWN) {
+		kprintf("sfs: %s: Unsupported features 0x%x\n",
+			sfs->sfs_sb.sb_volname,
+			sfs->sfs_sb.sb_features & ~SFS_FEATURES_KNOWN);
+		sfs->sfs_device = NULL;
+		sfs_fs_destroy(sfs);
+		return EINVAL;
+	}
+
 	/* Load free block bitmap */
 	sfs->sfs_freemap = bitmap_create(SFS_FS_FREEMAPBITS(sfs));
 	if (sfs->sfs_freemap == NULL) {
 		sfs->sfs_device = NULL;
 		sfs_fs_destroy(sfs);
-		vfs_biglock_release();
 		return ENOMEM;
 	}
-	result = sfs_freemapio(sfs, UIO_READ);
+	sfs->sfs_freemapdirtyblocks =
+		bitmap_create(SFS_FS_FREEMAPBLOCKS(sfs));
+	if (sfs->sfs_freemapdirtyblocks == NULL) {
+		sfs->sfs_device = NULL;
+		sfs_fs_destroy(sfs);
+		return ENOMEM;
+	}
+	result = sfs_freemapload(sfs);
+	if (result) {
+		sfs->sfs_device = NULL;
+		sfs_fs_destroy(sfs);
+		return result;
+	}
+	result = sfs_countfree(sfs);
 	if (result) {
 		sfs->sfs_device = NULL;
 		sfs_fs_destroy(sfs);
-		vfs_biglock_release();
 		return result;
 	}
 
 	/* Hand back the abstract fs */
 	*ret = &sfs->sfs_absfs;
 
-	vfs_biglock_release();
 	return 0;
 }
 
@@ -35,26 +35,112 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <synch.h>
 #include <vfs.h>
+#include <buf.h>
+#include <namecache.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
 
 /*
- * Write an on-disk inode structure back out to disk.
+ * The table of loaded vnodes. Each is in sfs_vnodes, which sync and
+ * unmount go through, and in a hash chain by inode number, which
+ * sfs_loadvnode uses. Both are covered by sfs_vnlock.
+ */
+
+static
+unsigned
+sfs_vnhashval(uint32_t ino)
+{
+	return ino % SFS_VNHASHSIZE;
+}
+
+static
+struct sfs_vnode *
+sfs_vntable_find(struct sfs_fs *sfs, uint32_t ino)
+{
+	struct sfs_vnode *sv;
+
+	for (sv = sfs->sfs_vnhash[sfs_vnhashval(ino)];
+	     sv != NULL; sv = sv->sv_hashnext) {
+		if (sv->sv_ino == ino) {
+			return sv;
+		}
+	}
+	return NULL;
+}
+
+static
+int
+sfs_vntable_add(struct sfs_fs *sfs, struct sfs_vnode *sv)
+{
+	unsigned hv;
+	int result;
+
+	result = vnodearray_add(sfs->sfs_vnodes, &sv->sv_absvn,
+				&sv->sv_vnindex);
+	if (result) {
+		return result;
+	}
+	hv = sfs_vnhashval(sv->sv_ino);
+	sv->sv_hashnext = sfs->sfs_vnhash[hv];
+	sfs->sfs_vnhash[hv] = sv;
+	return 0;
+}
+
+static
+void
+sfs_vntable_remove(struct sfs_fs *sfs, struct sfs_vnode *sv)
+{
+	struct sfs_vnode **pp, *last;
+	unsigned num;
+	int result;
+
+	pp = &sfs->sfs_vnhash[sfs_vnhashval(sv->sv_ino)];
+	while (*pp != sv) {
+		if (*pp == NULL) {
+			panic("sfs: %s: reclaim vnode %u not in vnode pool\n",
+			      sfs->sfs_sb.sb_volname, sv->sv_ino);
+		}
+		pp = &(*pp)->sv_hashnext;
+	}
+	*pp = sv->sv_hashnext;
+	sv->sv_hashnext = NULL;
+
+	/* Move the last vnode into our slot in the array. */
+	num = vnodearray_num(sfs->sfs_vnodes);
+	KASSERT(sv->sv_vnindex < num);
+	KASSERT(vnodearray_get(sfs->sfs_vnodes, sv->sv_vnindex) ==
+		&sv->sv_absvn);
+	last = vnodearray_get(sfs->sfs_vnodes, num - 1)->vn_data;
+	vnodearray_set(sfs->sfs_vnodes, sv->sv_vnindex, &last->sv_absvn);
+	last->sv_vnindex = sv->sv_vnindex;
+	result = vnodearray_setsize(sfs->sfs_vnodes, num - 1);
+	/* Shrinking an array never fails. */
+	KASSERT(result == 0);
+}
+
+/*
+ * Write an on-disk inode structure back out to its block in the
+ * buffer cache. (It gets to the disk when the buffer does.) The
+ * caller holds sv_lock, or is sfs_reclaim.
  */
 int
 sfs_sync_inode(struct sfs_vnode *sv)
 {
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *buf;
 	int result;
 
 	if (sv->sv_dirty) {
-		result = sfs_writeblock(sfs, sv->sv_ino, &sv->sv_i,
-					sizeof(sv->sv_i));
+		result = buffer_get(sfs->sfs_device, sv->sv_ino, &buf);
 		if (result) {
 			return result;
 		}
+		memcpy(buffer_map(buf), &sv->sv_i, sizeof(sv->sv_i));
+		buffer_markdirty(buf);
+		buffer_release(buf);
 		sv->sv_dirty = false;
 	}
 	return 0;
@@ -70,34 +156,40 @@ sfs_reclaim(struct vnode *v)
 {
 	struct sfs_vnode *sv = v->vn_data;
 	struct sfs_fs *sfs = v->vn_fs->fs_data;
-	unsigned ix, i, num;
 	int result;
 
-	vfs_biglock_acquire();
+	/* Holding this keeps sfs_loadvnode from handing out the vnode. */
+	lock_acquire(sfs->sfs_vnlock);
 
 	/*
 	 * Make sure someone else hasn't picked up the vnode since the
-	 * decision was made to reclaim it. (You must also synchronize
-	 * this with sfs_loadvnode.)
+	 * decision was made to reclaim it.
+	 *
+	 * The name cache hands out references too, so take the vnode
+	 * out of it first. Only someone with a reference can put it
+	 * back in; if that happened and they've let go since, go
+	 * around again, because another lookup could have found it.
 	 */
-	spinlock_acquire(&v->vn_countlock);
-	if (v->vn_refcount != 1) {
-
-		/* consume the reference VOP_DECREF gave us */
-		KASSERT(v->vn_refcount>1);
-		v->vn_refcount--;
+	do {
+		namecache_purgevnode(v);
+		if (vnode_decref_nonlast(v)) {
+			/* consumed the reference VOP_DECREF gave us */
+			lock_release(sfs->sfs_vnlock);
+			return EBUSY;
+		}
+	} while (v->vn_nccount > 0);
 
-		spinlock_release(&v->vn_countlock);
-		vfs_biglock_release();
-		return EBUSY;
-	}
-	spinlock_release(&v->vn_countlock);
+	/*
+	 * Nobody else can get at the vnode now, so we don't need its
+	 * lock. Keep sfs_vnlock until the inode is written back, so
+	 * nobody loads it again from an out-of-date inode block.
+	 */
 
 	/* If there are no on-disk references to the file either, erase it. */
 	if (sv->sv_i.sfi_linkcount == 0) {
 		result = sfs_itrunc(sv, 0);
 		if (result) {
-			vfs_biglock_release();
+			lock_release(sfs->sfs_vnlock);
 			return result;
 		}
 	}
@@ -105,7 +197,7 @@ sfs_reclaim(struct vnode *v)
 	/* Sync the inode to disk */
 	result = sfs_sync_inode(sv);
 	if (result) {
-		vfs_biglock_release();
+		lock_release(sfs->sfs_vnlock);
 		return result;
 	}
 
@@ -115,25 +207,12 @@ sfs_reclaim(struct vnode *v)
 	}
 
 	/* Remove the vnode structure from the table in the struct sfs_fs. */
-	num = vnodearray_num(sfs->sfs_vnodes);
-	ix = num;
-	for (i=0; i<num; i++) {
-		struct vnode *v2 = vnodearray_get(sfs->sfs_vnodes, i);
-		struct sfs_vnode *sv2 = v2->vn_data;
-		if (sv2 == sv) {
-			ix = i;
-			break;
-		}
-	}
-	if (ix == num) {
-		panic("sfs: %s: reclaim vnode %u not in vnode pool\n",
-		      sfs->sfs_sb.sb_volname, sv->sv_ino);
-	}
-	vnodearray_remove(sfs->sfs_vnodes, ix);
+	sfs_vntable_remove(sfs, sv);
 
-	vnode_cleanup(&sv->sv_absvn);
+	lock_release(sfs->sfs_vnlock);
 
-	vfs_biglock_release();
+	vnode_cleanup(&sv->sv_absvn);
+	lock_destroy(sv->sv_lock);
 
 	/* Release the storage for the vnode structure itself. */
 	kfree(sv);
@@ -150,42 +229,43 @@ int
 sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 		 struct sfs_vnode **ret)
 {
-	struct vnode *v;
 	struct sfs_vnode *sv;
+	struct buf *buf;
 	const struct vnode_ops *ops;
-	unsigned i, num;
 	int result;
 
-	/* Look in the vnodes table */
-	num = vnodearray_num(sfs->sfs_vnodes);
-
-	/* Linear search. Is this too slow? You decide. */
-	for (i=0; i<num; i++) {
-		v = vnodearray_get(sfs->sfs_vnodes, i);
-		sv = v->vn_data;
+	lock_acquire(sfs->sfs_vnlock);
 
+	/* Look in the vnodes table */
+	sv = sfs_vntable_find(sfs, ino);
+	if (sv != NULL) {
 		/* Every inode in memory must be in an allocated block */
 		if (!sfs_bused(sfs, sv->sv_ino)) {
 			panic("sfs: %s: Found inode %u in unallocated block\n",
 			      sfs->sfs_sb.sb_volname, sv->sv_ino);
 		}
 
-		if (sv->sv_ino==ino) {
-			/* Found */
-
-			/* forcetype is only allowed when creating objects */
-			KASSERT(forcetype==SFS_TYPE_INVAL);
+		/* forcetype is only allowed when creating objects */
+		KASSERT(forcetype==SFS_TYPE_INVAL);
 
-			VOP_INCREF(&sv->sv_absvn);
-			*ret = sv;
-			return 0;
-		}
+		VOP_INCREF(&sv->sv_absvn);
+		lock_release(sfs->sfs_vnlock);
+		*ret = sv;
+		return 0;
 	}
 
 	/* Didn't have it loaded; load it */
 
 	sv = kmalloc(sizeof(struct sfs_vnode));
 	if (sv==NULL) {
+		lock_release(sfs->sfs_vnlock);
+		return ENOMEM;
+	}
+
+	sv->sv_lock = lock_create("sfs_vnode");
+	if (sv->sv_lock == NULL) {
+		kfree(sv);
+		lock_release(sfs->sfs_vnlock);
 		return ENOMEM;
 	}
 
@@ -196,15 +276,31 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 	}
 
 	/* Read the block the inode is in */
-	result = sfs_readblock(sfs, ino, &sv->sv_i, sizeof(sv->sv_i));
+	result = buffer_read(sfs->sfs_device, ino, &buf);
 	if (result) {
+		lock_destroy(sv->sv_lock);
 		kfree(sv);
+		lock_release(sfs->sfs_vnlock);
 		return result;
 	}
+	memcpy(&sv->sv_i, buffer_map(buf), sizeof(sv->sv_i));
+	buffer_release(buf);
 
 	/* Not dirty yet */
 	sv->sv_dirty = false;
 
+	/* No reads yet */
+	sv->sv_rapos = 0;
+	sv->sv_rablock = 0;
+	sv->sv_rawindow = 0;
+
+	/* Not counted yet */
+	sv->sv_dirused = -1;
+	sv->sv_dirlive = 0;
+
+	/* No extent looked up yet */
+	bzero(&sv->sv_lastext, sizeof(sv->sv_lastext));
+
 	/*
 	 * FORCETYPE is set if we're creating a new file, because the
 	 * block on disk will have been zeroed out by sfs_balloc and
@@ -235,7 +331,9 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 	/* Call the common vnode initializer */
 	result = vnode_init(&sv->sv_absvn, ops, &sfs->sfs_absfs, sv);
 	if (result) {
+		lock_destroy(sv->sv_lock);
 		kfree(sv);
+		lock_release(sfs->sfs_vnlock);
 		return result;
 	}
 
@@ -243,13 +341,17 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 	sv->sv_ino = ino;
 
 	/* Add it to our table */
-	result = vnodearray_add(sfs->sfs_vnodes, &sv->sv_absvn, NULL);
+	result = sfs_vntable_add(sfs, sv);
 	if (result) {
 		vnode_cleanup(&sv->sv_absvn);
+		lock_destroy(sv->sv_lock);
 		kfree(sv);
+		lock_release(sfs->sfs_vnlock);
 		return result;
 	}
 
+	lock_release(sfs->sfs_vnlock);
+
 	/* Hand it back */
 	*ret = sv;
 	return 0;
@@ -266,10 +368,12 @@ sfs_makeobj(struct sfs_fs *sfs, int type, struct sfs_vnode **ret)
 
 	/*
 	 * First, get an inode. (Each inode is a block, and the inode
-	 * number is the block number, so just get a block.)
+	 * number is the block number, so just get a block.) There's
+	 * no particular place it should go; the file's data will be
+	 * allocated after it.
 	 */
 
-	result = sfs_balloc(sfs, &ino);
+	result = sfs_balloc(sfs, 0, true, &ino);
 	if (result) {
 		return result;
 	}
@@ -296,25 +400,19 @@ sfs_getroot(struct fs *fs, struct vnode **ret)
 	struct sfs_vnode *sv;
 	int result;
 
-	vfs_biglock_acquire();
-
 	result = sfs_loadvnode(sfs, SFS_ROOTDIR_INO, SFS_TYPE_INVAL, &sv);
 	if (result) {
 		kprintf("sfs: %s: getroot: Cannot load root vnode\n",
 			sfs->sfs_sb.sb_volname);
-		vfs_biglock_release();
 		return result;
 	}
 
 	if (sv->sv_i.sfi_type != SFS_TYPE_DIR) {
 		kprintf("sfs: %s: getroot: not directory (type %u)\n",
 			sfs->sfs_sb.sb_volname, sv->sv_i.sfi_type);
-		vfs_biglock_release();
 		return EINVAL;
 	}
 
-	vfs_biglock_release();
-
 	*ret = &sv->sv_absvn;
 	return 0;
 }
@@ -38,6 +38,7 @@
 #include <uio.h>
 #include <vfs.h>
 #include <device.h>
+#include <buf.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
@@ -46,6 +47,11 @@
 // Basic block-level I/O routines
 
 /*
+ * This bypasses the buffer cache. It's only for loading the
+ * superblock and the free block bitmap at mount time; we keep our own
+ * copies of those, and write them back through the cache like
+ * everything else.
+ *
  * Note: sfs_readblock is used to read the superblock
  * early in mount, before sfs is fully (or even mostly)
  * initialized, and so may not use anything from sfs
@@ -62,8 +68,6 @@ sfs_rwblock(struct sfs_fs *sfs, struct uio *uio)
 	int result;
 	int tries=0;
 
-	KASSERT(vfs_biglock_do_i_hold());
-
 	DEBUG(DB_SFS, "sfs: %s %llu\n",
 	      uio->uio_rw == UIO_READ ? "read" : "write",
 	      uio->uio_offset / SFS_BLOCKSIZE);
@@ -116,28 +120,13 @@ sfs_readblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
 	return sfs_rwblock(sfs, &ku);
 }
 
-/*
- * Write a block.
- */
-int
-sfs_writeblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
-{
-	struct iovec iov;
-	struct uio ku;
-
-	KASSERT(len == SFS_BLOCKSIZE);
-
-	SFSUIO(&iov, &ku, data, block, UIO_WRITE);
-	return sfs_rwblock(sfs, &ku);
-}
-
 ////////////////////////////////////////////////////////////
 //
 // File-level I/O
 
 /*
  * Do I/O to a block of a file that doesn't cover the whole block.  We
- * need to read in the original block first, even if we're writing, so
+ * need the original contents of the block even if we're writing, so
  * we don't clobber the portion of the block we're not intending to
  * write over.
  *
@@ -150,28 +139,18 @@ int
 sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	      uint32_t skipstart, uint32_t len)
 {
-	/*
-	 * I/O buffer for handling partial sectors.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
-	 */
-	static char iobuf[SFS_BLOCKSIZE];
-
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *buf;
 	daddr_t diskblock;
 	uint32_t fileblock;
 	int result;
 
 	/* Allocate missing blocks if and only if we're writing */
-	bool doalloc = (uio->uio_rw==UIO_WRITE);
+	int doalloc = (uio->uio_rw==UIO_WRITE) ?
+		SFS_BMAP_ALLOC : SFS_BMAP_LOOKUP;
 
 	KASSERT(skipstart + len <= SFS_BLOCKSIZE);
 
-	/* We're using a global static buffer; it had better be locked */
-	KASSERT(vfs_biglock_do_i_hold());
-
 	/* Compute the block offset of this block in the file */
 	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
 
@@ -184,40 +163,52 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	if (diskblock == 0) {
 		/*
 		 * There was no block mapped at this point in the file.
-		 * Zero the buffer.
+		 * It reads as zeros.
 		 */
 		KASSERT(uio->uio_rw == UIO_READ);
-		bzero(iobuf, sizeof(iobuf));
-	}
-	else {
-		/*
-		 * Read the block.
-		 */
-		result = sfs_readblock(sfs, diskblock, iobuf, sizeof(iobuf));
-		if (result) {
-			return result;
-		}
+		return uiomovezeros(len, uio);
 	}
 
 	/*
-	 * Now perform the requested operation into/out of the buffer.
+	 * Get the block.
 	 */
-	result = uiomove(iobuf+skipstart, len, uio);
+	result = buffer_read(sfs->sfs_device, diskblock, &buf);
 	if (result) {
 		return result;
 	}
 
 	/*
-	 * If it was a write, write back the modified block.
+	 * Now perform the requested operation into/out of the buffer.
+	 */
+	result = uiomove((char *)buffer_map(buf) + skipstart, len, uio);
+
+	/*
+	 * If it was a write, the buffer now needs writing back. That's
+	 * so even if uiomove failed partway: whatever it copied is now
+	 * what the cache thinks is in the block.
 	 */
 	if (uio->uio_rw == UIO_WRITE) {
-		result = sfs_writeblock(sfs, diskblock, iobuf, sizeof(iobuf));
-		if (result) {
-			return result;
-		}
+		buffer_markdirty(buf);
 	}
+	buffer_release(buf);
 
-	return 0;
+	return result;
+}
+
+/*
+ * Zero a block on disk directly. This is only for a block the buffer
+ * cache has nothing for, or the two could disagree.
+ */
+static
+int
+sfs_zeroblock(struct sfs_fs *sfs, daddr_t block)
+{
+	static char zeros[SFS_BLOCKSIZE];
+	struct iovec iov;
+	struct uio ku;
+
+	SFSUIO(&iov, &ku, zeros, block, UIO_WRITE);
+	return sfs_rwblock(sfs, &ku);
 }
 
 /*
@@ -228,24 +219,40 @@ int
 sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 {
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *buf;
 	daddr_t diskblock;
 	uint32_t fileblock;
-	int result;
-	bool doalloc = (uio->uio_rw==UIO_WRITE);
-	off_t saveoff;
-	off_t diskoff;
-	off_t saveres;
-	off_t diskres;
+	uint32_t oldsize;
+	bool fresh;
+	int result, result2;
 
 	/* Get the block number within the file */
 	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
 
 	/* Look up the disk block number */
-	result = sfs_bmap(sv, fileblock, doalloc, &diskblock);
+	result = sfs_bmap(sv, fileblock, SFS_BMAP_LOOKUP, &diskblock);
 	if (result) {
 		return result;
 	}
 
+	/*
+	 * If we're writing a block that isn't there yet, allocate it.
+	 * Past EOF, don't bother zeroing it first, since we're about to
+	 * fill all of it anyway; if that fails, truncating gets rid of
+	 * it again. A hole inside the file can't be unmapped like that,
+	 * so it gets a zeroed block as usual.
+	 */
+	fresh = false;
+	if (diskblock == 0 && uio->uio_rw == UIO_WRITE) {
+		fresh = uio->uio_offset >= (off_t)sv->sv_i.sfi_size;
+		result = sfs_bmap(sv, fileblock,
+				  fresh ? SFS_BMAP_FILL : SFS_BMAP_ALLOC,
+				  &diskblock);
+		if (result) {
+			return result;
+		}
+	}
+
 	if (diskblock == 0) {
 		/*
 		 * No block - fill with zeros.
@@ -258,33 +265,133 @@ sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 	}
 
 	/*
-	 * Do the I/O directly to the uio region. Save the uio_offset,
-	 * and substitute one that makes sense to the device.
+	 * Get the block. A write replaces all of it, so there's no
+	 * need to read the old contents first.
 	 */
-	saveoff = uio->uio_offset;
-	diskoff = diskblock * SFS_BLOCKSIZE;
-	uio->uio_offset = diskoff;
+	if (uio->uio_rw == UIO_READ) {
+		result = buffer_read(sfs->sfs_device, diskblock, &buf);
+	}
+	else {
+		result = buffer_get(sfs->sfs_device, diskblock, &buf);
+	}
+	if (result) {
+		if (fresh) {
+			/*
+			 * The new block is in the file now, but we
+			 * can't write it, and it wasn't zeroed. Unmap
+			 * and free it by truncating at its start, then
+			 * put back the size (sfs_io sets it for what we
+			 * did get written). If that fails, zero it on
+			 * disk instead, so the file doesn't get whatever
+			 * was there before.
+			 */
+			oldsize = sv->sv_i.sfi_size;
+			result2 = sfs_itrunc(sv, uio->uio_offset);
+			sv->sv_i.sfi_size = oldsize;
+			if (result2) {
+				result2 = sfs_zeroblock(sfs, diskblock);
+			}
+			if (result2) {
+				kprintf("sfs: %s: block %u of a file left "
+					"mapped but not zeroed: %s\n",
+					sfs->sfs_sb.sb_volname, fileblock,
+					strerror(result2));
+			}
+		}
+		return result;
+	}
 
-	/*
-	 * Temporarily set the residue to be one block size.
-	 */
 	KASSERT(uio->uio_resid >= SFS_BLOCKSIZE);
-	saveres = uio->uio_resid;
-	diskres = SFS_BLOCKSIZE;
-	uio->uio_resid = diskres;
-
-	result = sfs_rwblock(sfs, uio);
+	result = uiomove(buffer_map(buf), SFS_BLOCKSIZE, uio);
 
 	/*
-	 * Now, restore the original uio_offset and uio_resid and update
-	 * them by the amount of I/O done.
+	 * As in sfs_partialio, a failed write still dirties the block.
+	 * For a fresh block, the part uiomove didn't get to is still
+	 * zeros from buffer_get.
 	 */
-	uio->uio_offset = (uio->uio_offset - diskoff) + saveoff;
-	uio->uio_resid = (uio->uio_resid - diskres) + saveres;
+	if (uio->uio_rw == UIO_WRITE) {
+		buffer_markdirty(buf);
+	}
+	buffer_release(buf);
 
 	return result;
 }
 
+/*
+ * Read-ahead.
+ *
+ * Each vnode remembers where the last read of it ended. A read that
+ * starts there is sequential, and the read-ahead window (how many
+ * blocks past the end of the read to fetch in the background) grows,
+ * doubling up to SFS_RA_MAXWINDOW; any other read halves it. There's
+ * no open file table to keep this in per open file, so two readers of
+ * one file interleaving their reads will look random.
+ *
+ * Besides the window, we also start reads for the blocks of this read
+ * after the first, so a big read's disk I/O overlaps with copying out
+ * the blocks that have already arrived.
+ */
+#define SFS_RA_MINWINDOW  4
+#define SFS_RA_MAXWINDOW  32
+
+static
+void
+sfs_readahead(struct sfs_vnode *sv, off_t pos, size_t len)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	uint32_t fileblock, start, stop, nblocks, run, i;
+	daddr_t diskblock;
+
+	if (pos == sv->sv_rapos) {
+		if (sv->sv_rawindow == 0) {
+			sv->sv_rawindow = SFS_RA_MINWINDOW;
+		}
+		else if (sv->sv_rawindow < SFS_RA_MAXWINDOW) {
+			sv->sv_rawindow *= 2;
+		}
+	}
+	else {
+		sv->sv_rawindow /= 2;
+		sv->sv_rablock = 0;
+	}
+	sv->sv_rapos = pos + len;
+
+	if (sv->sv_rawindow == 0) {
+		return;
+	}
+
+	/* From after the first block to the end of the window or file */
+	start = pos / SFS_BLOCKSIZE + 1;
+	stop = DIVROUNDUP(pos + len, SFS_BLOCKSIZE) + sv->sv_rawindow;
+	nblocks = DIVROUNDUP(sv->sv_i.sfi_size, SFS_BLOCKSIZE);
+	if (stop > nblocks) {
+		stop = nblocks;
+	}
+
+	/* Skip what the last read already asked for */
+	if (start < sv->sv_rablock) {
+		start = sv->sv_rablock;
+	}
+
+	/* One lookup per extent, not per block, where there are extents */
+	fileblock = start;
+	while (fileblock < stop) {
+		if (sfs_bmaprun(sv, fileblock, &diskblock, &run)) {
+			break;
+		}
+		if (run > stop - fileblock) {
+			run = stop - fileblock;
+		}
+		for (i=0; diskblock != 0 && i<run; i++) {
+			buffer_readahead(sfs->sfs_device, diskblock + i);
+		}
+		fileblock += run;
+	}
+	if (fileblock > sv->sv_rablock) {
+		sv->sv_rablock = fileblock;
+	}
+}
+
 /*
  * Do I/O of a whole region of data, whether or not it's block-aligned.
  */
@@ -317,6 +424,8 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 			KASSERT(uio->uio_resid > extraresid);
 			uio->uio_resid -= extraresid;
 		}
+
+		sfs_readahead(sv, uio->uio_offset, uio->uio_resid);
 	}
 
 	/*
@@ -407,38 +516,28 @@ sfs_metaio(struct sfs_vnode *sv, off_t actualpos, void *data, size_t len,
 	   enum uio_rw rw)
 {
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *buf;
+	char *ptr;
 	off_t endpos;
 	uint32_t vnblock;
 	uint32_t blockoffset;
 	daddr_t diskblock;
-	bool doalloc;
+	int doalloc;
 	int result;
 
-	/*
-	 * I/O buffer for metadata ops.
-	 *
-	 * Note: in real life (and when you've done the fs assignment) you
-	 * would get space from the disk buffer cache for this, not use a
-	 * static area.
-	 */
-	static char metaiobuf[SFS_BLOCKSIZE];
-
-	/* We're using a global static buffer; it had better be locked */
-	KASSERT(vfs_biglock_do_i_hold());
-
 	/* Figure out which block of the vnode (directory, whatever) this is */
 	vnblock = actualpos / SFS_BLOCKSIZE;
 	blockoffset = actualpos % SFS_BLOCKSIZE;
 
 	/* Get the disk block number */
-	doalloc = (rw == UIO_WRITE);
+	doalloc = (rw == UIO_WRITE) ? SFS_BMAP_ALLOC : SFS_BMAP_LOOKUP;
 	result = sfs_bmap(sv, vnblock, doalloc, &diskblock);
 	if (result) {
 		return result;
 	}
 
 	if (diskblock == 0) {
-		/* Should only get block 0 back if doalloc is false */
+		/* Should only get block 0 back if not allocating */
 		KASSERT(rw == UIO_READ);
 
 		/* Sparse file, read as zeros. */
@@ -446,26 +545,21 @@ sfs_metaio(struct sfs_vnode *sv, off_t actualpos, void *data, size_t len,
 		return 0;
 	}
 
-	/* Read the block */
-	result = sfs_readblock(sfs, diskblock, metaiobuf, sizeof(metaiobuf));
+	/* Get the block */
+	result = buffer_read(sfs->sfs_device, diskblock, &buf);
 	if (result) {
 		return result;
 	}
+	ptr = buffer_map(buf);
 
 	if (rw == UIO_READ) {
 		/* Copy out the selected region */
-		memcpy(data, metaiobuf + blockoffset, len);
+		memcpy(data, ptr + blockoffset, len);
 	}
 	else {
 		/* Update the selected region */
-		memcpy(metaiobuf + blockoffset, data, len);
-
-		/* Write the block back */
-		result = sfs_writeblock(sfs, diskblock,
-					metaiobuf, sizeof(metaiobuf));
-		if (result) {
-			return result;
-		}
+		memcpy(ptr + blockoffset, data, len);
+		buffer_markdirty(buf);
 
 		/* Update the vnode size if needed */
 		endpos = actualpos + len;
@@ -474,6 +568,7 @@ sfs_metaio(struct sfs_vnode *sv, off_t actualpos, void *data, size_t len,
 			sv->sv_dirty = true;
 		}
 	}
+	buffer_release(buf);
 
 	/* Done */
 	return 0;
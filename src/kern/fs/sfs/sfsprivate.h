@@ -42,14 +42,26 @@ extern const struct vnode_ops sfs_dirops;
     uio_kinit(iov, uio, ptr, SFS_BLOCKSIZE, ((off_t)(block))*SFS_BLOCKSIZE, rw)
 
 
+/* sfi_size is 32 bits, so with extents no file block can start at 4G. */
+#define SFS_EXTMAXFILEBLOCK  (0xffffffffU / SFS_BLOCKSIZE)
+
+/* Values for sfs_bmap's DOALLOC */
+#define SFS_BMAP_LOOKUP  0	/* don't allocate; a hole maps to block 0 */
+#define SFS_BMAP_ALLOC   1	/* fill a hole with a zeroed block */
+#define SFS_BMAP_FILL    2	/* same, not zeroed: the caller writes it all */
+
 /* Functions in sfs_balloc.c */
-int sfs_balloc(struct sfs_fs *sfs, daddr_t *diskblock);
+int sfs_countfree(struct sfs_fs *sfs);
+int sfs_balloc(struct sfs_fs *sfs, daddr_t goal, bool clear,
+		daddr_t *diskblock);
 void sfs_bfree(struct sfs_fs *sfs, daddr_t diskblock);
 int sfs_bused(struct sfs_fs *sfs, daddr_t diskblock);
 
 /* Functions in sfs_bmap.c */
-int sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
+int sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, int doalloc,
 		daddr_t *diskblock);
+int sfs_bmaprun(struct sfs_vnode *sv, uint32_t fileblock, daddr_t *diskblock,
+		uint32_t *run);
 int sfs_itrunc(struct sfs_vnode *sv, off_t len);
 
 /* Functions in sfs_dir.c */
@@ -62,6 +74,11 @@ int sfs_lookonce(struct sfs_vnode *sv, const char *name,
 		struct sfs_vnode **ret,
 		int *slot);
 
+/* Functions in sfs_extent.c */
+int sfs_ext_bmap(struct sfs_vnode *sv, uint32_t fileblock, int doalloc,
+		daddr_t *diskblock, uint32_t *run);
+int sfs_ext_itrunc(struct sfs_vnode *sv, off_t len);
+
 /* Functions in sfs_inode.c */
 int sfs_sync_inode(struct sfs_vnode *sv);
 int sfs_reclaim(struct vnode *v);
@@ -72,7 +89,6 @@ int sfs_getroot(struct fs *fs, struct vnode **ret);
 
 /* Functions in sfs_io.c */
 int sfs_readblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len);
-int sfs_writeblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len);
 int sfs_io(struct sfs_vnode *sv, struct uio *uio);
 int sfs_metaio(struct sfs_vnode *sv, off_t pos, void *data, size_t len,
 	       enum uio_rw rw);
@@ -40,6 +40,13 @@
 
 struct vnode;
 
+/*
+ * Number of stacks for additional user threads an address space can
+ * hold, and the size of each under dumbvm.
+ */
+#define AS_THREADSTACKS		16
+#define DUMBVM_THREADSTACKPAGES	4
+
 
 /*
  * Address space - data structure associated with the virtual memory
@@ -57,6 +64,7 @@ struct addrspace {
         paddr_t as_pbase2;
         size_t as_npages2;
         paddr_t as_stackpbase;
+        paddr_t as_tstackpbase[AS_THREADSTACKS];
 #else
         /* Put stuff here for your VM system */
 #endif
@@ -99,6 +107,10 @@ struct addrspace {
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
  *
+ *    as_define_thread_stack - set up (or reuse) stack number SLOT for
+ *                an additional user thread and hand back its initial
+ *                stack pointer. SLOT is less than AS_THREADSTACKS.
+ *
  * Note that when using dumbvm, addrspace.c is not used and these
  * functions are found in dumbvm.c.
  */
@@ -117,6 +129,8 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+int               as_define_thread_stack(struct addrspace *as, unsigned slot,
+                                         vaddr_t *initstackptr);
 
 
 /*
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _ATOMIC_H_
+#define _ATOMIC_H_
+
+/*
+ * Atomic operations on a single word.
+ *
+ * These are for counters and flags that are shared between CPUs but
+ * don't need a lock around them: reference counts, statistics, and
+ * the like. Loads and stores are plain single-word accesses and do
+ * not order anything else. The read-modify-write operations (fetchadd,
+ * cas, xchg) are also full memory barriers, so, for example, a thread
+ * that drops the last reference with atomic_fetchadd sees everything
+ * other threads did before they dropped theirs.
+ *
+ * load		Read the value.
+ * store	Set the value.
+ * fetchadd	Add INC and return the value from before.
+ * cas		If the value is OLDVAL, change it to NEWVAL and return
+ *		true; otherwise leave it alone and return false.
+ * xchg		Set the value to NEWVAL and return the value from before.
+ *
+ * As with spinlocks, code should use these functions and not look
+ * inside the structure.
+ */
+
+#include <cdefs.h>
+
+/* Inlining support - for making sure an out-of-line copy gets built */
+#ifndef ATOMIC_INLINE
+#define ATOMIC_INLINE INLINE
+#endif
+
+struct atomic {
+	volatile int at_val;
+};
+
+#define ATOMIC_INITIALIZER(val) { (val) }
+
+ATOMIC_INLINE int atomic_load(const struct atomic *a);
+ATOMIC_INLINE void atomic_store(struct atomic *a, int val);
+ATOMIC_INLINE int atomic_fetchadd(struct atomic *a, int inc);
+ATOMIC_INLINE bool atomic_cas(struct atomic *a, int oldval, int newval);
+ATOMIC_INLINE int atomic_xchg(struct atomic *a, int newval);
+
+/* Get the implementation. */
+#include <machine/atomic.h>
+
+#endif /* _ATOMIC_H_ */
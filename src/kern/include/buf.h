@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _BUF_H_
+#define _BUF_H_
+
+/*
+ * Buffer cache.
+ *
+ * Keeps recently used disk blocks in memory, keyed by device and
+ * block number, so a filesystem doesn't go to the disk every time it
+ * looks at an inode, a directory or an indirect block, and so writes
+ * can be delayed and batched.
+ *
+ * Once a filesystem uses the cache for a block, all I/O to that block
+ * must go through it; mixing in direct device I/O gets stale data.
+ * Blocks a filesystem keeps its own copy of (a superblock, say) can
+ * bypass it.
+ *
+ * A buffer is pinned from buffer_read or buffer_get until the
+ * matching buffer_release; pinned buffers are never evicted. The
+ * cache doesn't lock buffer contents: the caller's locks on whatever
+ * the block belongs to must keep two threads from changing it at
+ * once. Call buffer_markdirty after changing the data, not before.
+ *
+ * Dirty buffers are written back by the syncer thread, which runs
+ * vfs_sync every few seconds so that no dirty data stays in memory
+ * much longer than a maximum age (buffer_setmaxage), and sooner if
+ * too many buffers are dirty. They're also written back when they're
+ * evicted (least recently used first) and by buffer_sync.
+ *
+ * Functions:
+ *     buffer_read      - Get a pinned buffer for block BLOCK of DEV,
+ *                        reading it from the disk if it isn't cached.
+ *     buffer_get       - Same, but don't read it: for a block the
+ *                        caller is going to overwrite completely. If
+ *                        it wasn't cached it comes back zeroed.
+ *     buffer_release   - Unpin a buffer.
+ *     buffer_map       - Get a pointer to a buffer's data.
+ *     buffer_markdirty - Note that a buffer needs writing back.
+ *     buffer_readahead - Start reading block BLOCK of DEV into the
+ *                        cache in the background (on a work queue),
+ *                        unless it's already there. Only a hint: does
+ *                        nothing if that would mean waiting or writing
+ *                        something back first.
+ *     buffer_drop      - Forget any cached copy of a block, dirty or
+ *                        not, because it's no longer in use. The
+ *                        caller mustn't have it pinned; waits for
+ *                        read-ahead or write-back of it to finish.
+ *     buffer_sync      - Write back all of DEV's dirty buffers.
+ *     buffer_purge     - Sync, then discard, all of DEV's buffers; for
+ *                        unmount. None may be pinned.
+ *     buffer_setmaxage - Set the syncer's maximum dirty age, in
+ *                        seconds.
+ *     buffer_setreadahead - Turn buffer_readahead on (the default) or
+ *                        off, to measure what it buys.
+ *     buffer_printstats - Print hit, I/O and syncer counts.
+ *     buffer_bootstrap - Set up. Called from vfs_bootstrap.
+ *     buffer_syncer_start - Start the syncer thread. Called from boot
+ *                        once other CPUs are running.
+ *
+ * Blocks are BUFFER_SIZE bytes; the device's block size must match.
+ */
+
+#define BUFFER_SIZE  512
+
+struct buf;		/* Opaque. */
+struct device;
+
+int buffer_read(struct device *dev, daddr_t block, struct buf **ret);
+int buffer_get(struct device *dev, daddr_t block, struct buf **ret);
+void buffer_release(struct buf *b);
+void *buffer_map(struct buf *b);
+void buffer_markdirty(struct buf *b);
+void buffer_readahead(struct device *dev, daddr_t block);
+void buffer_drop(struct device *dev, daddr_t block);
+int buffer_sync(struct device *dev);
+int buffer_purge(struct device *dev);
+void buffer_setmaxage(unsigned seconds);
+void buffer_setreadahead(bool on);
+void buffer_printstats(void);
+void buffer_bootstrap(void);
+void buffer_syncer_start(void);
+
+#endif /* _BUF_H_ */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _CALLOUT_H_
+#define _CALLOUT_H_
+
+/*
+ * Callouts: functions to be called at a given number of hardclock
+ * ticks in the future.
+ *
+ * Callouts are kept on a hierarchical timer wheel that is advanced
+ * once per hardclock on CPU 0, so scheduling and cancelling are
+ * constant time and a tick costs constant time plus the work for the
+ * callouts that actually expire. The resolution is one hardclock
+ * (1/HZ seconds).
+ *
+ * Callout functions run on CPU 0 in interrupt context: they may take
+ * spinlocks and wake threads, but must not sleep.
+ *
+ * The structure is public so callouts can be embedded or put on the
+ * stack; use only the functions below to touch it.
+ */
+
+struct callout {
+	struct callout *co_next;	/* wheel slot list */
+	struct callout **co_prevp;	/* pointer to us in the list */
+	uint32_t co_expire;		/* tick at which to run */
+	void (*co_func)(void *);	/* what to call */
+	void *co_arg;			/* argument for co_func */
+	bool co_pending;		/* on the wheel */
+};
+
+/*
+ * Functions:
+ *
+ * callout_init     - Initialize a callout. Not pending.
+ * callout_schedule - Arrange for FUNC(ARG) to be called after TICKS
+ *                    hardclocks (at least one). The callout must not
+ *                    already be pending.
+ * callout_stop     - Cancel a callout. Returns true if it was pending
+ *                    and will now not run. If it is running right now
+ *                    on another CPU, waits for it to finish, so after
+ *                    callout_stop returns the callout's storage may
+ *                    be reused or freed.
+ * callout_hardclock - Advance the wheel by one tick. Called from
+ *                    hardclock() on CPU 0 only.
+ */
+void callout_init(struct callout *co);
+void callout_schedule(struct callout *co, uint32_t ticks,
+		      void (*func)(void *), void *arg);
+bool callout_stop(struct callout *co);
+void callout_hardclock(void);
+
+#endif /* _CALLOUT_H_ */
@@ -45,9 +45,28 @@
 /* hardclocks per second */
 #define HZ  100
 
+/* length of a hardclock */
+#define NS_PER_TICK  (1000000000 / HZ)
+
 void hardclock_bootstrap(void);
 void hardclock(void);
 
+/*
+ * Timer interrupt latency. The platform code calls hardclock_latency
+ * with the number of cycles between the timer firing and its getting
+ * around to calling hardclock; print shows the per-CPU mean and
+ * maximum, and reset clears them.
+ */
+void hardclock_latency(uint32_t cycles);
+void hardclock_latency_print(void);
+void hardclock_latency_reset(void);
+
+/*
+ * Number of hardclocks since boot, as counted on CPU 0. This is the
+ * (cheap, coarse) time base for scheduler accounting.
+ */
+extern volatile uint32_t hardclock_ticks;
+
 /*
  * timerclock() is called on one CPU once a second to allow simple
  * timed operations. (This is a fairly simpleminded interface.)
@@ -79,5 +98,13 @@ void timespec_sub(const struct timespec *t1,
  */
 void clocksleep(int seconds);
 
+/*
+ * thread_sleep_ns() suspends execution for at least NS nanoseconds.
+ * The resolution is one hardclock. ns_to_ticks() converts a duration
+ * to hardclocks, rounding up.
+ */
+void thread_sleep_ns(uint64_t ns);
+uint32_t ns_to_ticks(uint64_t ns);
+
 
 #endif /* _CLOCK_H_ */
@@ -61,11 +61,15 @@ struct cpu {
 	struct thread *c_curthread;	/* Current thread on cpu */
 	struct threadlist c_zombies;	/* List of exited threads */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
+	unsigned c_tickbase;		/* CPU 0's ticks before our first */
 	unsigned c_spinlocks;		/* Counter of spinlocks held */
 
 	/*
 	 * Accessed by other cpus.
 	 * Protected by the runqueue lock.
+	 *
+	 * thread_consider_migration peeks at c_runqueue.tl_count
+	 * without the lock, as a hint.
 	 */
 	bool c_isidle;			/* True if this cpu is idle */
 	struct threadlist c_runqueue;	/* Run queue for this cpu */
@@ -89,6 +93,25 @@ struct cpu {
 	struct tlbshootdown c_shootdown[TLBSHOOTDOWN_MAX];
 	int c_numshootdown;
 	struct spinlock c_ipi_lock;
+
+	/*
+	 * Written by this cpu, read by others. See epoch.h.
+	 */
+	struct epoch_cpu *c_epoch;	/* Epoch quiescent state */
+
+	/*
+	 * Accessed only by this cpu, with interrupts off. See softirq.h.
+	 */
+	struct softirq *c_softirqs;	/* Pending softirqs */
+	struct softirq **c_softirqs_tail;
+	bool c_insoftirq;		/* True while running them */
+
+#if OPT_LOCKSTAT
+	/*
+	 * Accessed only by this cpu, except by lockstat_print/reset.
+	 */
+	struct lockstat_cpu *c_lockstat; /* Lock statistics */
+#endif
 };
 
 #define TLBSHOOTDOWN_ALL  (-1)
@@ -141,6 +164,14 @@ void cpu_irqon(void);
 void cpu_idle(void);
 void cpu_halt(void);
 
+/*
+ * Read a cycle clock. It counts up steadily on each CPU (built from
+ * the timer interrupt count and the cycles since the last one), and
+ * the CPUs' clocks agree to within about a timer tick. It wraps, so
+ * only differences between nearby readings mean anything.
+ */
+uint32_t cpu_cycles(void);
+
 /*
  * Interprocessor interrupts.
  *
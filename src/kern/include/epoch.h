@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _EPOCH_H_
+#define _EPOCH_H_
+
+/*
+ * Epoch-based deferred reclamation (a simple form of RCU).
+ *
+ * Readers of a shared structure bracket their accesses with
+ * epoch_enter/epoch_exit. This costs a counter in curthread and no
+ * locks or memory barriers. Inside a read section the thread must not
+ * sleep, and it is not preempted.
+ *
+ * Writers still exclude each other with an ordinary lock. They
+ * publish changes so that readers never see a half-built object:
+ * initialize it, membar_store_store(), then store the pointer.
+ * Something a writer unlinks may still be in use by readers that
+ * found it earlier. It can be freed only once every CPU has passed a
+ * quiescent point, that is, a point where it is certainly not in a
+ * read section.
+ *
+ * Quiescent points are thread_switch and hardclock while the
+ * interrupted thread is outside a read section. hardclock runs every
+ * tick on every CPU, idle or not, so a grace period normally lasts
+ * about one tick.
+ *
+ * Functions:
+ *     epoch_enter       - Begin a read section. Sections nest.
+ *     epoch_exit        - End a read section.
+ *     epoch_synchronize - Sleep until a grace period has elapsed. After
+ *                         it returns, no reader can still hold anything
+ *                         unlinked before it was called.
+ *     epoch_defer       - Arrange for FUNC(ARG) to be called after a
+ *                         grace period, without waiting. CB is storage
+ *                         for the bookkeeping, usually embedded in the
+ *                         object to be freed. FUNC runs on CPU 0 in
+ *                         interrupt context, like a callout.
+ *
+ * Hooks:
+ *     epoch_cpu_create  - Set up per-CPU state. Called by cpu_create.
+ *     epoch_quiescent   - Note that this CPU is at a quiescent point.
+ *     epoch_hardclock   - Run deferred functions whose grace period
+ *                         is over. Called by hardclock on CPU 0.
+ */
+
+struct epoch_cpu;
+
+struct epoch_cb {
+	struct epoch_cb *ec_next;	/* pending list */
+	uint32_t ec_epoch;		/* grace period waited for */
+	void (*ec_func)(void *);	/* what to call */
+	void *ec_arg;			/* argument for ec_func */
+};
+
+void epoch_enter(void);
+void epoch_exit(void);
+void epoch_synchronize(void);
+void epoch_defer(struct epoch_cb *cb, void (*func)(void *), void *arg);
+
+struct epoch_cpu *epoch_cpu_create(void);
+void epoch_quiescent(void);
+void epoch_hardclock(void);
+
+#endif /* _EPOCH_H_ */
@@ -49,6 +49,7 @@
 /* flags for getrusage() */
 #define RUSAGE_SELF	0
 #define RUSAGE_CHILDREN	(-1)
+#define RUSAGE_THREAD	1		/* just the calling thread */
 
 struct rusage {
 	struct timeval ru_utime;
@@ -67,6 +68,8 @@ struct rusage {
 	__counter_t ru_nsignals;	/* signals delivered (count) */
 	__counter_t ru_nvcsw;		/* voluntary context switches (count)*/
 	__counter_t ru_nivcsw;		/* involuntary ditto (count) */
+	/* OS/161 extension */
+	struct timeval ru_wtime;	/* time runnable but not running */
 };
 
 /* limit codes for getrusage/setrusage */
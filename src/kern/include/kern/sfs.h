@@ -62,6 +62,14 @@
 /* Size of free block bitmap (in blocks) */
 #define SFS_FREEMAPBLOCKS(nblocks)  (SFS_FREEMAPBITS(nblocks)/SFS_BITSPERBLOCK)
 
+/* Directory entries per block */
+#define SFS_DIRENTPERBLOCK  (SFS_BLOCKSIZE / sizeof(struct sfs_direntry))
+
+/* Feature flags for sb_features */
+#define SFS_FEATURE_HASHDIR  0x00000001   /* directories are hash tables */
+#define SFS_FEATURE_EXTENTS  0x00000002   /* inodes map blocks by extent */
+#define SFS_FEATURES_KNOWN   (SFS_FEATURE_HASHDIR | SFS_FEATURE_EXTENTS)
+
 /* File types for sfi_type */
 #define SFS_TYPE_INVAL    0       /* Should not appear on disk */
 #define SFS_TYPE_FILE     1
@@ -74,7 +82,8 @@ struct sfs_superblock {
 	uint32_t sb_magic;		/* Magic number; should be SFS_MAGIC */
 	uint32_t sb_nblocks;			/* Number of blocks in fs */
 	char sb_volname[SFS_VOLNAME_SIZE];	/* Name of this volume */
-	uint32_t reserved[118];			/* unused, set to 0 */
+	uint32_t sb_features;			/* SFS_FEATURE_* flags */
+	uint32_t reserved[117];			/* unused, set to 0 */
 };
 
 /*
@@ -89,6 +98,52 @@ struct sfs_dinode {
 	uint32_t sfi_waste[128-3-SFS_NDIRECT];	/* unused space, set to 0 */
 };
 
+/*
+ * Extent-mapped inodes (SFS_FEATURE_EXTENTS).
+ *
+ * With the feature, every inode maps its blocks with extents, runs
+ * of consecutive blocks, instead of direct and indirect block
+ * pointers, and struct sfs_extdinode takes the place of struct
+ * sfs_dinode. A leaf extent maps se_len file blocks starting at
+ * se_fileblock to as many disk blocks starting at se_diskblock.
+ * File blocks no extent covers are holes and read as zeros.
+ *
+ * The extents form a tree rooted in the inode, sfi_extdepth levels
+ * deep (at most SFS_EXTMAXDEPTH). At depth 0 the inode's entries are
+ * leaf extents. Otherwise they're index entries (se_len 0) whose
+ * se_diskblock is a tree block (struct sfs_extblock) one level
+ * further down, holding the extents from the entry's se_fileblock up
+ * to the next entry's. In every node the entries are sorted by
+ * se_fileblock and don't overlap, unused entries are zero, and no
+ * tree block is empty.
+ */
+#define SFS_NEXTINODE     41            /* # of extents in inode */
+#define SFS_NEXTBLOCK     42            /* # of extents in a tree block */
+#define SFS_EXTMAXDEPTH   4             /* max depth of extent tree */
+
+struct sfs_extent {
+	uint32_t se_fileblock;			/* First file block mapped */
+	uint32_t se_diskblock;			/* Its disk or tree block */
+	uint32_t se_len;			/* # of blocks; 0 if index */
+};
+
+struct sfs_extdinode {
+	uint32_t sfi_size;			/* Size of this file (bytes) */
+	uint16_t sfi_type;			/* One of SFS_TYPE_* above */
+	uint16_t sfi_linkcount;			/* # hard links to this file */
+	uint16_t sfi_extdepth;			/* Depth of extent tree */
+	uint16_t sfi_nextents;			/* # of entries in use */
+	struct sfs_extent sfi_extents[SFS_NEXTINODE]; /* Root of tree */
+	uint32_t sfi_extwaste[2];		/* unused space, set to 0 */
+};
+
+struct sfs_extblock {
+	uint16_t seb_depth;			/* Depth of tree below here */
+	uint16_t seb_nextents;			/* # of entries in use */
+	uint32_t seb_reserved;			/* unused, set to 0 */
+	struct sfs_extent seb_extents[SFS_NEXTBLOCK];
+};
+
 /*
  * On-disk directory entry
  */
@@ -97,5 +152,36 @@ struct sfs_direntry {
 	char sfd_name[SFS_NAMELEN];		/* Filename */
 };
 
+/*
+ * Hashed directories (SFS_FEATURE_HASHDIR).
+ *
+ * Without the feature, a directory is an array of entries in no
+ * particular order, and unused entries have sfd_ino SFS_NOINO.
+ *
+ * With it, every directory is an open-addressed hash table. Its size
+ * is a whole number of blocks (possibly zero); each slot is an entry.
+ * A name lives in the first free slot at or after slot
+ * sfs_dirhash(name) % (number of slots), wrapping around at the end.
+ * So a lookup starts there and goes forward until it finds the name
+ * or an empty slot (sfd_ino SFS_NOINO, sfd_name empty). Removing a
+ * name leaves a deleted entry (sfd_ino SFS_NOINO, sfd_name
+ * SFS_DIRDELETED, which can't be a real name) so later lookups keep
+ * going past it; a new name can reuse the slot.
+ *
+ * The hash is 32-bit FNV-1a over the bytes of the name.
+ */
+#define SFS_DIRDELETED  "/"
+
+static inline uint32_t
+sfs_dirhash(const char *name)
+{
+	uint32_t h = 2166136261U;
+
+	while (*name != 0) {
+		h = (h ^ (unsigned char)*name++) * 16777619U;
+	}
+	return h;
+}
+
 
 #endif /* _KERN_SFS_H_ */
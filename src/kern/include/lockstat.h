@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+#include "opt-lockstat.h"
+
+/*
+ * Lock contention statistics ("options lockstat").
+ *
+ * Every spinlock, lock, CV, and rwlock is charged to a site: sleep
+ * locks and CVs by their name, spinlocks by the file and line of
+ * their spinlock_init (or SPINLOCK_INITIALIZER). Locks with the same
+ * name share a site, so for instance all vnode locks are counted
+ * together. Each CPU keeps its own table of per-site counters so the
+ * counting itself doesn't bounce cache lines around; lockstat_print
+ * adds the tables up.
+ *
+ * Times are in CPU cycles (see cpu_cycles). Wait time is counted for
+ * contended acquisitions only. For CVs an "acquisition" is a wait,
+ * every one of which is contended; rwlock hold times cover writers
+ * only.
+ *
+ * Without the option this header defines nothing and the locks carry
+ * no extra fields.
+ *
+ * Functions:
+ *     lockstat_cpu_create - allocate a CPU's counter table.
+ *     lockstat_register   - get the site number for a lock; the name
+ *                           is copied, so it needn't outlive the lock.
+ *     lockstat_now        - timestamp to pass to lockstat_acquired.
+ *     lockstat_acquired   - count an acquisition that started at
+ *                           START; returns the time now, for use as
+ *                           the hold-time stamp.
+ *     lockstat_released   - count a release of a lock acquired at
+ *                           STAMP.
+ *     lockstat_print      - print the MAX most contended sites.
+ *     lockstat_reset      - zero all the counters.
+ */
+
+#if OPT_LOCKSTAT
+
+#define LOCKSTAT_NSITES   128	/* sites tracked, including overflow */
+#define LOCKSTAT_NAMELEN  32	/* longest site name kept, plus one */
+#define LOCKSTAT_NOSITE   0	/* site number not looked up yet */
+
+#define LOCKSTAT_STR(x)   #x
+#define LOCKSTAT_XSTR(x)  LOCKSTAT_STR(x)
+#define LOCKSTAT_HERE     __FILE__ ":" LOCKSTAT_XSTR(__LINE__)
+
+struct lockstat_cpu;
+
+struct lockstat_cpu *lockstat_cpu_create(void);
+unsigned lockstat_register(const char *kind, const char *name);
+uint32_t lockstat_now(void);
+uint32_t lockstat_acquired(unsigned site, bool contended, uint32_t start);
+void lockstat_released(unsigned site, uint32_t stamp);
+void lockstat_print(unsigned max);
+void lockstat_reset(void);
+
+#endif /* OPT_LOCKSTAT */
+
+#endif /* _LOCKSTAT_H_ */
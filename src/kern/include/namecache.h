@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _NAMECACHE_H_
+#define _NAMECACHE_H_
+
+/*
+ * Name cache: remembers what single names in directories turned out
+ * to be, so repeated lookups of the same names don't scan the
+ * directory again.
+ *
+ * An entry maps (directory vnode, name) to a vnode, or to nothing (a
+ * negative entry) if the name was looked up and not found. Entries
+ * don't hold references; an entry is dropped when either vnode is
+ * reclaimed (vnode_cleanup calls namecache_purgevnode), and the
+ * cache is a fixed size, so old entries get reused.
+ *
+ * The cache is opt-in: a filesystem that uses it calls
+ * namecache_lookup before searching a directory and namecache_enter
+ * afterwards, and must call namecache_purge whenever a name in a
+ * directory is created, removed or renamed. The filesystem's own
+ * locking must keep a lookup from racing with the change and the
+ * purge, and with reclaim.
+ *
+ * Names longer than NAMECACHE_NAMELEN-1 aren't cached.
+ *
+ * Functions:
+ *     namecache_lookup  - Look up NAME in DIR. Returns false on a miss.
+ *                         On a hit, *RET is the vnode, with a new
+ *                         reference, or NULL if the name is known
+ *                         not to exist.
+ *     namecache_enter   - Remember that NAME in DIR is VN (NULL for
+ *                         a name that doesn't exist).
+ *     namecache_purge   - Forget NAME in DIR.
+ *     namecache_purgevnode - Forget everything about VN, as either a
+ *                         directory or a result.
+ *     namecache_printstats - Print lookup and hit counts.
+ *     namecache_bootstrap - Set up. Called from vfs_bootstrap.
+ */
+
+#define NAMECACHE_NAMELEN  32
+
+struct vnode;
+
+bool namecache_lookup(struct vnode *dir, const char *name,
+		      struct vnode **ret);
+void namecache_enter(struct vnode *dir, const char *name, struct vnode *vn);
+void namecache_purge(struct vnode *dir, const char *name);
+void namecache_purgevnode(struct vnode *vn);
+void namecache_printstats(void);
+void namecache_bootstrap(void);
+
+#endif /* _NAMECACHE_H_ */
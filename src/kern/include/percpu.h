@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _PERCPU_H_
+#define _PERCPU_H_
+
+/*
+ * Per-CPU counters.
+ *
+ * A counter that is changed often and read rarely (a statistic, or a
+ * count of live objects) shouldn't be one shared word that every CPU
+ * has to fight over. A percpu_counter keeps one slot per CPU; each
+ * CPU only ever writes its own slot, so changing the counter takes no
+ * lock and no atomic operation. Reading adds up all the slots, one
+ * at a time. The total is exact once changes stop. While they're
+ * going on it's only approximate, and can even be a value the counter
+ * never had (an add on one CPU missed and a later subtract on another
+ * seen), so don't wait for a percpu_counter to reach an exact value.
+ *
+ * Individual slots can go negative (one CPU increments, another
+ * decrements) or wrap; only the sum means anything.
+ *
+ * add		Add DELTA (which may be negative) to the counter.
+ * read		Return the sum of the slots.
+ * set		Set the counter to VAL. This is not atomic with respect
+ *		to concurrent adds, so it's only for initialization and
+ *		other times when nobody else is changing the counter.
+ *
+ * A zeroed counter (e.g. a static one) reads as 0 and needs no
+ * initialization.
+ */
+
+#include <platform/maxcpus.h>
+
+/* Keep slots of different CPUs out of the same cache line. */
+#define PERCPU_SLOTSIZE 32
+
+struct percpu_slot {
+	volatile int32_t ps_val;
+	char ps_pad[PERCPU_SLOTSIZE - sizeof(int32_t)];
+};
+
+struct percpu_counter {
+	struct percpu_slot pc_slots[MAXCPUS];
+};
+
+void percpu_counter_add(struct percpu_counter *pc, int32_t delta);
+int32_t percpu_counter_read(struct percpu_counter *pc);
+void percpu_counter_set(struct percpu_counter *pc, int32_t val);
+
+#endif /* _PERCPU_H_ */
@@ -37,17 +37,51 @@
  */
 
 #include <spinlock.h>
+#include <thread.h>	/* for struct schedstats */
 
 struct addrspace;
 struct thread;
 struct vnode;
+struct wchan;
+
+/*
+ * User-level threads other than a process's first thread, as created
+ * by the thread_create system call. A slot is free if ut_tid is 0.
+ * It's freed again when the thread exits, unless someone is already
+ * waiting in thread_join, who frees it instead; so the table limits
+ * how many threads can be running, not how many can be created.
+ *
+ * A thread that exits before it's joined leaves its id and exit value
+ * on the process's p_uzombies list until it is. A detached thread
+ * leaves nothing.
+ */
+#define PROC_MAXUTHREADS  16
+
+struct uthread {
+	int ut_tid;			/* thread id, or 0 if free */
+	struct thread *ut_thread;	/* kernel thread, once started */
+	bool ut_exited;			/* has called thread_exit */
+	bool ut_joining;		/* someone's in thread_join for it */
+	bool ut_detached;		/* nobody will join it */
+	vaddr_t ut_entry;		/* user-level start routine */
+	vaddr_t ut_func;		/* first argument to ut_entry */
+	vaddr_t ut_arg;			/* second argument to ut_entry */
+	vaddr_t ut_stack;		/* initial stack pointer */
+	userptr_t ut_retval;		/* argument to thread_exit */
+};
+
+struct uzombie {
+	struct uzombie *uz_next;
+	int uz_tid;			/* id of the exited thread */
+	userptr_t uz_retval;		/* argument to thread_exit */
+};
 
 /*
  * Process structure.
  *
- * Note that we only count the number of threads in each process.
- * (And, unless you implement multithreaded user processes, this
- * number will not exceed 1 except in kproc.) If you want to know
+ * Note that we only count the number of threads in each process;
+ * p_uthreads only lists user threads created with thread_create,
+ * not the first thread of the process. If you want to know
  * exactly which threads are in the process, e.g. for debugging, add
  * an array and a sleeplock to protect it. (You can't use a spinlock
  * to protect an array because arrays need to be able to call
@@ -70,6 +104,15 @@ struct proc {
 	/* VFS */
 	struct vnode *p_cwd;		/* current working directory */
 
+	/* Scheduling statistics of exited threads (under p_lock) */
+	struct schedstats p_stats;
+
+	/* User threads (under p_lock) */
+	struct uthread p_uthreads[PROC_MAXUTHREADS];
+	struct uzombie *p_uzombies;	/* exited, not yet joined */
+	int p_nexttid;			/* next thread id to hand out */
+	struct wchan *p_uthreadwc;	/* thread_join waits here */
+
 	/* add more material here as needed */
 };
 
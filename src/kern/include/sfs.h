@@ -48,14 +48,73 @@
  */
 #include <kern/sfs.h>
 
+/*
+ * Number of chains in the hash table of loaded vnodes.
+ */
+#define SFS_VNHASHSIZE  1024
+
+/*
+ * Blocks per allocation region. The allocator keeps a count of free
+ * blocks for each region so it can skip over full ones.
+ */
+#define SFS_REGIONBLOCKS  1024
+
+/*
+ * Locking.
+ *
+ * sv_lock covers everything in its sfs_vnode below it, except the
+ * table linkage, and the file's blocks: its data, or its entries if
+ * it's a directory, and its indirect block or extent tree blocks.
+ * The inode type never changes once loaded, so reading it needs no
+ * lock. Link counts are changed holding both the file's lock and the
+ * lock of the directory the name is in, so either is enough to read
+ * one.
+ *
+ * sfs_vnlock covers the table of loaded vnodes (sfs_vnodes,
+ * sfs_vnhash, sv_hashnext, sv_vnindex). sfs_freemaplock covers the
+ * freemap, its dirty flags, the region free counts, the allocation
+ * cursor, and sfs_superdirty.
+ *
+ * The lock order is:
+ *
+ *     vfs_biglock (not used by SFS itself, but held around some calls)
+ *     sv_lock of a directory
+ *     sv_lock of a file in it
+ *     sfs_vnlock
+ *     sfs_freemaplock
+ *     buffer cache
+ *
+ * So rename locks the directory, then the file being renamed. All
+ * names are in the root directory, so there's only ever one
+ * directory to lock; subdirectories would need a per-volume rename
+ * lock above all of these, to keep two renames from locking the same
+ * pair of directories in opposite orders.
+ *
+ * sfs_reclaim doesn't lock the vnode: it only goes ahead once it has
+ * the last reference, and new ones only come from sfs_loadvnode and
+ * the name cache, which it shuts out first.
+ */
+
 /*
  * In-memory inode
  */
 struct sfs_vnode {
 	struct vnode sv_absvn;          /* abstract vnode structure */
-	struct sfs_dinode sv_i;		/* copy of on-disk inode */
+	struct lock *sv_lock;           /* lock for the rest */
+	union {
+		struct sfs_dinode sv_i;		/* copy of on-disk inode */
+		struct sfs_extdinode sv_ei;	/* same, if extent-mapped */
+	};
+	struct sfs_extent sv_lastext;   /* extents: last one looked up */
 	uint32_t sv_ino;                /* inode number */
 	bool sv_dirty;                  /* true if sv_i modified */
+	off_t sv_rapos;                 /* read-ahead: end of last read */
+	uint32_t sv_rablock;            /* read-ahead: next block to fetch */
+	unsigned sv_rawindow;           /* read-ahead: blocks to fetch */
+	int sv_dirused;                 /* hashed dir: slots not empty, or -1 */
+	int sv_dirlive;                 /* hashed dir: names in it, if counted */
+	struct sfs_vnode *sv_hashnext;  /* chain in sfs_vnhash */
+	unsigned sv_vnindex;            /* index in sfs_vnodes */
 };
 
 /*
@@ -66,9 +125,16 @@ struct sfs_fs {
 	struct sfs_superblock sfs_sb;	/* copy of on-disk superblock */
 	bool sfs_superdirty;            /* true if superblock modified */
 	struct device *sfs_device;      /* device mounted on */
+	struct lock *sfs_vnlock;        /* lock for vnode table */
 	struct vnodearray *sfs_vnodes;  /* vnodes loaded into memory */
+	struct sfs_vnode *sfs_vnhash[SFS_VNHASHSIZE]; /* same, by inode # */
+	struct lock *sfs_freemaplock;   /* lock for freemap */
 	struct bitmap *sfs_freemap;     /* blocks in use are marked 1 */
 	bool sfs_freemapdirty;          /* true if freemap modified */
+	struct bitmap *sfs_freemapdirtyblocks; /* which freemap blocks */
+	unsigned *sfs_regionfree;       /* free blocks in each region */
+	unsigned sfs_nregions;          /* number of regions */
+	daddr_t sfs_cursor;             /* where to allocate with no goal */
 };
 
 /*
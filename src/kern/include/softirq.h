@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _SOFTIRQ_H_
+#define _SOFTIRQ_H_
+
+/*
+ * Softirqs: the bottom halves of interrupt handlers.
+ *
+ * An interrupt handler runs with interrupts off, so everything it
+ * does delays every other interrupt on that CPU, the timer included.
+ * A driver's handler should only do what the device needs right now
+ * (read the status, acknowledge the interrupt) and then schedule a
+ * softirq to do the rest: wake up waiters, pass input up, start the
+ * next transfer.
+ *
+ * Softirqs scheduled on a CPU run on that CPU, in order, as soon as
+ * nothing more urgent is happening there:
+ *    - at the end of an interrupt that came in at spl0, with
+ *      interrupts turned back on;
+ *    - when a thread drops to spl0 (including by releasing its last
+ *      spinlock), also with interrupts on;
+ *    - in the idle loop, with interrupts off.
+ *
+ * Softirq functions must not sleep, and they don't get preempted by
+ * hardclock, so they should be short. Once a softirq has started
+ * running it can be scheduled again, so the same softirq may be
+ * running on two CPUs at once; it must lock its own state.
+ *
+ * Functions:
+ *     softirq_init     - Set up SI to call FUNC(ARG).
+ *     softirq_schedule - Queue SI on the current CPU. Returns false,
+ *                        doing nothing, if it's already pending. May
+ *                        be called from anywhere, interrupt handlers
+ *                        included.
+ *
+ * Hooks:
+ *     softirq_cpu_init - Set up a CPU's queue. Called by cpu_create.
+ *     softirq_run      - Run the current CPU's pending softirqs.
+ *                        Must be called at splhigh; IRQON says
+ *                        whether to turn interrupts on while each
+ *                        one runs. Does nothing if called while this
+ *                        CPU is already running softirqs.
+ */
+
+#include <atomic.h>
+
+struct cpu;
+
+struct softirq {
+	struct softirq *si_next;	/* queue link */
+	void (*si_func)(void *);	/* what to call */
+	void *si_arg;			/* argument for si_func */
+	struct atomic si_pending;	/* 1 from schedule until it starts */
+};
+
+void softirq_init(struct softirq *si, void (*func)(void *), void *arg);
+bool softirq_schedule(struct softirq *si);
+
+void softirq_cpu_init(struct cpu *c);
+void softirq_run(bool irqon);
+
+#endif /* _SOFTIRQ_H_ */
@@ -45,24 +45,44 @@
 /* Get the machine-dependent bits. */
 #include <machine/spinlock.h>
 
+#include <lockstat.h>
+
 /*
  * Basic spinlock.
  *
  * Note that spinlocks are held by CPUs, not by threads.
  *
+ * These are ticket locks: a CPU that wants the lock takes the next
+ * number from splk_next and waits until splk_owner comes up to it.
+ * CPUs get the lock in the order they asked for it, and a release
+ * only bumps splk_owner, which only the holder writes.
+ *
  * This structure is made public so spinlocks do not have to be
  * malloc'd; however, code that uses spinlocks should not look inside
  * the structure directly but always use the spinlock API functions.
  */
 struct spinlock {
-	volatile spinlock_data_t splk_lock; /* Memory word where we spin. */
-	struct cpu *splk_holder;	    /* CPU holding this lock. */
+	volatile spinlock_data_t splk_next;  /* Next ticket to hand out. */
+	volatile spinlock_data_t splk_owner; /* Ticket now being served. */
+	struct cpu *splk_holder;	     /* CPU holding this lock. */
+#if OPT_LOCKSTAT
+	const char *splk_site;		     /* Where it was initialized. */
+	unsigned splk_stat;		     /* lockstat site number. */
+	uint32_t splk_stamp;		     /* When it was acquired. */
+#endif
 };
 
 /*
  * Initializer for cases where a spinlock needs to be static or global.
  */
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL }
+#if OPT_LOCKSTAT
+#define SPINLOCK_INITIALIZER \
+	{ SPINLOCK_DATA_INITIALIZER, SPINLOCK_DATA_INITIALIZER, NULL, \
+	  LOCKSTAT_HERE, LOCKSTAT_NOSITE, 0 }
+#else
+#define SPINLOCK_INITIALIZER \
+	{ SPINLOCK_DATA_INITIALIZER, SPINLOCK_DATA_INITIALIZER, NULL }
+#endif
 
 /*
  * Spinlock functions.
@@ -74,9 +94,17 @@ struct spinlock {
  * release	Release the lock. May re-enable interrupts.
  *
  * do_i_hold	Check if the current CPU holds the lock.
+ *
+ * With lockstat, spinlock_init records its caller's file and line,
+ * which is how spinlocks are told apart in the statistics.
  */
 
+#if OPT_LOCKSTAT
+void spinlock_init_at(struct spinlock *lk, const char *site);
+#define spinlock_init(lk) spinlock_init_at(lk, LOCKSTAT_HERE)
+#else
 void spinlock_init(struct spinlock *lk);
+#endif
 void spinlock_cleanup(struct spinlock *lk);
 
 void spinlock_acquire(struct spinlock *lk);
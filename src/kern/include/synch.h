@@ -37,6 +37,8 @@
 
 #include <spinlock.h>
 
+struct thread;	/* from <thread.h> */
+
 /*
  * Dijkstra-style semaphore.
  *
@@ -62,6 +64,12 @@ void sem_destroy(struct semaphore *);
 void P(struct semaphore *);
 void V(struct semaphore *);
 
+/*
+ * sem_timedP is P that gives up after NS nanoseconds (rounded up to
+ * whole hardclocks). Returns 0 on success or ETIMEDOUT.
+ */
+int sem_timedP(struct semaphore *, uint64_t ns);
+
 
 /*
  * Simple lock for mutual exclusion.
@@ -80,8 +88,36 @@ struct lock {
 				struct spinlock lk_lock;
 				volatile bool lk_locked;
 				volatile struct thread *lk_holderthread;
+
+	/*
+	 * Priority inheritance. lk_maxwaitprio is the highest
+	 * effective priority of any thread waiting for the lock (-1 if
+	 * none); the holder runs at no less than that, and it's
+	 * protected by thread_priority_lock. lk_nblocked counts the
+	 * threads with t_blockedon pointing here (under lk_lock and
+	 * thread_priority_lock both); while it's 0 there's nothing to
+	 * donate and the lock is taken and released without the
+	 * global lock. lk_nextheld chains the locks held by one
+	 * thread (t_heldlocks), and only that thread touches it.
+	 */
+	int lk_maxwaitprio;
+	unsigned lk_nblocked;
+	struct lock *lk_nextheld;
+
+#if OPT_LOCKSTAT
+	unsigned lk_stat;			/* lockstat site */
+	uint32_t lk_stamp;			/* when acquired */
+#endif
 };
 
+/*
+ * Default for lock_spinlimit, the number of times lock_acquire polls
+ * a lock whose holder is running on another CPU before it gives up
+ * and sleeps. Setting lock_spinlimit to 0 turns spinning off.
+ */
+#define LOCK_SPINLIMIT	2000
+extern int lock_spinlimit;
+
 struct lock *lock_create(const char *name);
 void lock_destroy(struct lock *);
 
@@ -94,12 +130,22 @@ void lock_destroy(struct lock *);
  *    lock_do_i_hold - Return true if the current thread holds the lock;
  *                   false otherwise.
  *
+ * While a thread waits in lock_acquire, the holder (and, transitively,
+ * whatever thread the holder is itself waiting on) runs at no less
+ * than the waiter's priority. Waiters are woken in priority order.
+ *
  * These operations must be atomic. You get to write them.
  */
 void lock_acquire(struct lock *);
 void lock_release(struct lock *);
 bool lock_do_i_hold(struct lock *);
 
+/*
+ * Highest priority donated to thread T through the locks it holds,
+ * or -1 if none. Call with thread_priority_lock held.
+ */
+int lock_heldpriority(const struct thread *t);
+
 
 /*
  * Condition variable.
@@ -123,6 +169,9 @@ struct cv {
 	struct wchan *cv_wchan;
         struct spinlock cv_lock;
 
+#if OPT_LOCKSTAT
+	unsigned cv_stat;			/* lockstat site */
+#endif
 };
 
 struct cv *cv_create(const char *name);
@@ -134,6 +183,9 @@ void cv_destroy(struct cv *);
  *                   waking up again, re-acquire the lock.
  *    cv_signal    - Wake up one thread that's sleeping on this CV.
  *    cv_broadcast - Wake up all threads sleeping on this CV.
+ *    cv_timedwait - Like cv_wait, but return ETIMEDOUT if not woken
+ *                   within NS nanoseconds (rounded up to whole
+ *                   hardclocks); 0 otherwise.
  *
  * For all three operations, the current thread must hold the lock passed
  * in. Note that under normal circumstances the same lock should be used
@@ -144,6 +196,7 @@ void cv_destroy(struct cv *);
 void cv_wait(struct cv *cv, struct lock *lock);
 void cv_signal(struct cv *cv, struct lock *lock);
 void cv_broadcast(struct cv *cv, struct lock *lock);
+int cv_timedwait(struct cv *cv, struct lock *lock, uint64_t ns);
 
 /*
  * Reader-writer locks.
@@ -153,22 +206,44 @@ void cv_broadcast(struct cv *cv, struct lock *lock);
  *
  * The name field is for easier debugging. A copy of the name is
  * (should be) made internally.
+ *
+ * The whole state of the lock is in one word, rw_state: the number of
+ * readers, whether a writer holds it, and whether writers or readers
+ * are waiting. Uncontended acquires and releases are a single atomic
+ * update of that word. Anything that has to sleep or wake someone
+ * takes rw_interlock, which also protects the waiter bookkeeping.
+ *
+ * Writers are preferred: once a writer is waiting, new readers wait
+ * too. But a run of writers can only get the lock ahead of waiting
+ * readers RW_MAXBYPASS times; then all the waiting readers go next.
  */
 
+#define RW_WRITER	0x80000000	/* a writer holds the lock */
+#define RW_WWAITERS	0x40000000	/* writers are waiting */
+#define RW_RWAITERS	0x20000000	/* readers are waiting */
+#define RW_READMASK	0x1fffffff	/* number of readers */
+
+#define RW_MAXBYPASS	4
+
 struct rwlock {
         char *rw_name;
-        // add what you need here
-        // (don't forget to mark things volatile as needed)
+	volatile spinlock_data_t rw_state;	/* RW_* bits, reader count */
+	struct thread *rw_writer;		/* holder, if write-locked */
+
+	/* Slow path state, protected by rw_interlock */
+	struct spinlock rw_interlock;
+	struct wchan *rw_readwchan;		/* waiting readers */
+	struct wchan *rw_writewchan;		/* waiting writers */
+	unsigned rw_readwaiters;		/* readers sleeping */
+	unsigned rw_writewaiters;		/* writers sleeping, ungranted */
+	unsigned rw_writegrants;		/* handoffs not yet picked up */
+	unsigned rw_readgen;			/* bumped when readers let in */
+	unsigned rw_bypass;			/* writers let past readers */
 
-       	volatile bool writer_count;
-        volatile unsigned int writer_aging;  // aging writer threads
-	volatile unsigned int max_readers ;
-	
-        struct wchan * rw_wchan;
-	struct spinlock rw_spinlock ; 
-        struct lock *rw_lock;
-	struct semaphore *rw_sem ;
-	
+#if OPT_LOCKSTAT
+	unsigned rw_stat;			/* lockstat site */
+	uint32_t rw_stamp;			/* when write-locked */
+#endif
 };
 
 struct rwlock * rwlock_create(const char *);
@@ -51,6 +51,9 @@ void enter_forked_process(struct trapframe *tf);
 __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 		       vaddr_t stackptr, vaddr_t entrypoint);
 
+/* Set up the futex wait queues. */
+void futex_bootstrap(void);
+
 
 /*
  * Prototypes for IN-KERNEL entry points for system call implementations.
@@ -58,5 +61,13 @@ __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys_getrusage(int who, userptr_t user_rusage);
+int sys_nanosleep(userptr_t user_req, userptr_t user_rem);
+int sys___thread_create(userptr_t entry, userptr_t func, userptr_t arg,
+			int32_t *retval);
+int sys_thread_join(int tid, userptr_t user_retval);
+int sys_thread_detach(int tid);
+__DEAD void sys_thread_exit(userptr_t retval);
+int sys_futex(userptr_t uaddr, int op, int val, int32_t *retval);
 
 #endif /* _SYSCALL_H_ */
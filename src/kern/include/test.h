@@ -71,6 +71,15 @@ int rwtest2(int, char **);
 int rwtest3(int, char **);
 int rwtest4(int, char **);
 int rwtest5(int, char **);
+int priotest(int, char **);
+int timertest(int, char **);
+int wakebench(int, char **);
+int lockbench(int, char **);
+int spinbench(int, char **);
+int epochtest(int, char **);
+int atomictest(int, char **);
+int workqueuetest(int, char **);
+int softirqtest(int, char **);
 
 /* semaphore unit tests */
 int semu1(int, char **);
@@ -103,6 +112,10 @@ int writestress(int, char **);
 int writestress2(int, char **);
 int longstress(int, char **);
 int createstress(int, char **);
+int openstress(int, char **);
+int truncstress(int, char **);
+int dirchurn(int, char **);
+int readbench(int, char **);
 int printfile(int, char **);
 
 /* HMAC/hash tests */
@@ -41,6 +41,7 @@
 #include <threadlist.h>
 
 struct cpu;
+struct lock;
 
 /* get machine-dependent defs */
 #include <machine/thread.h>
@@ -57,6 +58,25 @@ struct cpu;
 #define SAME_STACK(p1, p2)     (((p1) & STACK_MASK) == ((p2) & STACK_MASK))
 
 
+/*
+ * Thread priorities. Larger numbers run first. Threads of equal
+ * priority are scheduled round-robin.
+ */
+#define THREAD_PRI_MIN		0
+#define THREAD_PRI_DEFAULT	50
+#define THREAD_PRI_MAX		100
+
+/*
+ * Scheduling statistics, kept per thread and per process. Times are
+ * in hardclock ticks (see hardclock_ticks in clock.h).
+ */
+struct schedstats {
+	uint32_t ss_runticks;		/* time spent on a cpu */
+	uint32_t ss_waitticks;		/* time spent runnable, not running */
+	uint32_t ss_nvcsw;		/* voluntary switches (sleep, yield) */
+	uint32_t ss_nivcsw;		/* involuntary switches (preemption) */
+};
+
 /* States a thread can be in. */
 typedef enum {
 	S_RUN,		/* running */
@@ -92,7 +112,9 @@ struct thread {
 	void *t_stack;			/* Kernel-level stack */
 	struct switchframe *t_context;	/* Saved register context (on stack) */
 	struct cpu *t_cpu;		/* CPU thread runs on */
+	bool t_pinned;			/* Never migrate off t_cpu */
 	struct proc *t_proc;		/* Process thread belongs to */
+	char t_procname[16];		/* Copy of its name, for ps */
 
 	/*
 	 * Interrupt state fields.
@@ -111,6 +133,42 @@ struct thread {
 	int t_curspl;			/* Current spl*() state */
 	int t_iplhigh_count;		/* # of times IPL has been raised */
 
+	/*
+	 * Nesting depth of epoch read sections (see epoch.h). While
+	 * nonzero the thread must not sleep and is not preempted.
+	 */
+	unsigned t_epochdepth;
+
+	/*
+	 * Scheduling priority fields.
+	 *
+	 * t_basepriority is the priority the thread asked for;
+	 * t_priority is the effective priority, which may be raised
+	 * above the base priority while the thread holds a lock that
+	 * higher-priority threads are waiting for. t_blockedon is the
+	 * lock the thread is currently waiting to acquire, if any, and
+	 * t_heldlocks is the list of locks it holds (chained through
+	 * lk_nextheld). t_heldlocks is only touched by the thread
+	 * itself; the rest are protected by thread_priority_lock.
+	 */
+	int t_basepriority;		/* Priority requested */
+	volatile int t_priority;	/* Effective (inherited) priority */
+	struct lock *t_blockedon;	/* Lock we're waiting for */
+	struct lock *t_heldlocks;	/* Locks we hold */
+
+	/*
+	 * Accounting. t_oncpustamp is when the thread last started
+	 * running, t_readystamp when it last became runnable; both are
+	 * hardclock_ticks values and are updated in thread_switch (or
+	 * with the run queue locked). t_allprev/t_allnext link the
+	 * list of all threads, protected by allthreads_lock.
+	 */
+	uint32_t t_oncpustamp;
+	uint32_t t_readystamp;
+	struct schedstats t_stats;
+	struct thread *t_allprev;
+	struct thread *t_allnext;
+
 	/*
 	 * Public fields
 	 */
@@ -154,6 +212,14 @@ int thread_fork(const char *name, struct proc *proc,
                 void (*func)(void *, unsigned long),
                 void *data1, unsigned long data2);
 
+/*
+ * Like thread_fork, but the new thread runs on CPU number CPUNUM and
+ * is never migrated off it. For per-CPU service threads.
+ */
+int thread_fork_pinned(const char *name, struct proc *proc, unsigned cpunum,
+                       void (*func)(void *, unsigned long),
+                       void *data1, unsigned long data2);
+
 /*
  * Cause the current thread to exit.
  * Interrupts need not be disabled.
@@ -178,7 +244,42 @@ void schedule(void);
  */
 void thread_consider_migration(void);
 
-extern unsigned thread_count;
+/*
+ * Check if thread T is running on some CPU right now. This is only a
+ * hint; it may be out of date by the time the caller looks at it.
+ */
+bool thread_oncpu(const struct thread *t);
+
+/*
+ * T's effective priority was just raised; if it's on a run queue,
+ * move it up to where it now belongs. Call with thread_priority_lock
+ * held.
+ */
+void thread_priority_raised(struct thread *t);
+
+/*
+ * Get and set the base priority of the current thread. The effective
+ * priority may be higher because of priority inheritance through
+ * locks; see synch.c.
+ */
+int thread_getpriority(void);
+void thread_setpriority(int priority);
+
+/*
+ * Scheduling statistics. schedstats_thread returns the numbers for
+ * the current thread; schedstats_proc sums all threads, live and
+ * exited, of process P. thread_printstats prints a line for every
+ * thread in the system (the "ps" menu command).
+ */
+struct proc;
+void schedstats_thread(struct schedstats *ret);
+void schedstats_proc(struct proc *p, struct schedstats *ret);
+void thread_printstats(void);
+
+/* Protects the priority fields of all threads and locks. */
+extern struct spinlock thread_priority_lock;
+
+unsigned thread_get_count(void);
 void thread_wait_for_count(unsigned);
 
 #endif /* _THREAD_H_ */
@@ -185,8 +185,10 @@ DECLARRAY(vnode, VFSINLINE);
 DEFARRAY(vnode, VFSINLINE);
 
 /*
- * Global one-big-lock for all filesystem operations.
- * You must remove this for the filesystem assignment.
+ * Global one-big-lock for filesystem operations. It now only covers
+ * the VFS layer's own state (the device list, mounting, the boot
+ * filesystem) and emufs; SFS has its own locks (see sfs.h), and
+ * VOP calls are made without it.
  */
 void vfs_biglock_acquire(void);
 void vfs_biglock_release(void);
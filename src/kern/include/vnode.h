@@ -30,7 +30,7 @@
 #ifndef _VNODE_H_
 #define _VNODE_H_
 
-#include <spinlock.h>
+#include <atomic.h>
 struct uio;
 struct stat;
 
@@ -49,14 +49,15 @@ struct stat;
  * Note: vn_fs may be null if the vnode refers to a device.
  */
 struct vnode {
-	int vn_refcount;                /* Reference count */
-	struct spinlock vn_countlock;   /* Lock for vn_refcount */
+	struct atomic vn_refcount;      /* Reference count */
 
 	struct fs *vn_fs;               /* Filesystem vnode belongs to */
 
 	void *vn_data;                  /* Filesystem-specific data */
 
 	const struct vnode_ops *vn_ops; /* Functions on this vnode */
+
+	unsigned vn_nccount;            /* Name cache entries using it */
 };
 
 /*
@@ -263,6 +264,14 @@ void vnode_check(struct vnode *, const char *op);
 void vnode_incref(struct vnode *);
 void vnode_decref(struct vnode *);
 
+/*
+ * Drop a reference unless it's the last one. Returns true if it was
+ * dropped; false, leaving the count alone, if the caller's reference
+ * was the only one. For VOP_RECLAIM, which gets the last reference
+ * from VOP_DECREF but must give it back if someone took a new one.
+ */
+bool vnode_decref_nonlast(struct vnode *);
+
 #define VOP_INCREF(vn) 			vnode_incref(vn)
 #define VOP_DECREF(vn) 			vnode_decref(vn)
 
@@ -36,6 +36,7 @@
 
 
 struct spinlock; /* in spinlock.h */
+struct thread; /* in thread.h */
 struct wchan; /* Opaque */
 
 /*
@@ -56,6 +57,13 @@ void wchan_destroy(struct wchan *wc);
  */
 bool wchan_isempty(struct wchan *wc, struct spinlock *lk);
 
+/*
+ * Return the highest effective priority among the threads sleeping
+ * on the channel, or -1 if there are none. The associated spinlock
+ * should be locked.
+ */
+int wchan_maxpriority(struct wchan *wc, struct spinlock *lk);
+
 /*
  * Go to sleep on a wait channel. The current thread is suspended
  * until awakened by someone else, at which point this function
@@ -66,15 +74,29 @@ bool wchan_isempty(struct wchan *wc, struct spinlock *lk);
  */
 void wchan_sleep(struct wchan *wc, struct spinlock *lk);
 
+/*
+ * Like wchan_sleep, but give up after TICKS hardclocks if nobody
+ * wakes us. Returns true if it timed out.
+ */
+bool wchan_sleep_timeout(struct wchan *wc, struct spinlock *lk,
+			 uint32_t ticks);
+
 /*
  * Wake up one thread, or all threads, sleeping on a wait channel.
  * The associated spinlock should be locked.
  *
- * The current implementation is FIFO but this is not promised by the
- * interface.
+ * wchan_wakeone picks the highest-priority sleeper, FIFO among equals.
  */
 void wchan_wakeone(struct wchan *wc, struct spinlock *lk);
 void wchan_wakeall(struct wchan *wc, struct spinlock *lk);
 
+/*
+ * Wake up the particular thread T, which must be sleeping on the
+ * channel, in constant time. The associated spinlock should be
+ * locked.
+ */
+void wchan_wakethread(struct wchan *wc, struct spinlock *lk,
+		      struct thread *t);
+
 
 #endif /* _WCHAN_H_ */
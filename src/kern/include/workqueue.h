@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+/*
+ * Work queues: run functions later, in thread context, without
+ * forking a thread for each one.
+ *
+ * Each CPU has a worker thread, pinned to it, that runs the work
+ * items queued to that CPU one at a time in FIFO order. Work
+ * functions may sleep, but while one sleeps the rest of that CPU's
+ * queue waits, so long waits belong in a thread of their own.
+ *
+ * A struct work is the caller's storage for one pending call; embed
+ * it in the object the work is about. It can be queued again once its
+ * function has started (including from the function itself), and the
+ * function may free it.
+ *
+ * Functions:
+ *     work_init          - Set up a work item to call FUNC(ARG).
+ *     workqueue_enqueue  - Queue WK on the current CPU. Returns false,
+ *                          doing nothing, if WK is already pending.
+ *                          May be called from interrupt handlers.
+ *     workqueue_enqueue_cpu - Same, but on CPU number CPUNUM.
+ *     workqueue_enqueue_delayed - Queue WK on the current CPU after
+ *                          TICKS hardclocks (at least one).
+ *     workqueue_cancel_delayed - Cancel delayed work that hasn't been
+ *                          queued yet. Returns true if it won't run.
+ *     parallel_for       - Call FUNC(ARG, i) for each i in [0, N),
+ *                          split in contiguous ranges across the
+ *                          CPUs, and wait for them all. The caller
+ *                          runs its own CPU's share, and any share a
+ *                          worker hasn't started by then, so it may
+ *                          be called from work functions, nested
+ *                          arbitrarily deep. Returns an error
+ *                          only if it couldn't get memory, in which
+ *                          case nothing was called.
+ *
+ * Hooks:
+ *     workqueue_cpu_create - Set up a CPU's queue. Called by cpu_create.
+ *     workqueue_bootstrap  - Start the worker threads. Called from boot
+ *                          once all CPUs are up; work queued before
+ *                          that runs then.
+ */
+
+#include <atomic.h>
+#include <callout.h>
+
+struct work {
+	struct work *wk_next;		/* queue link */
+	void (*wk_func)(void *);	/* what to call */
+	void *wk_arg;			/* argument for wk_func */
+	unsigned wk_cpu;		/* CPU whose queue it goes on */
+	struct atomic wk_pending;	/* 1 from enqueue until it starts */
+	struct callout wk_callout;	/* for delayed work */
+};
+
+void work_init(struct work *wk, void (*func)(void *), void *arg);
+bool workqueue_enqueue(struct work *wk);
+bool workqueue_enqueue_cpu(struct work *wk, unsigned cpunum);
+bool workqueue_enqueue_delayed(struct work *wk, uint32_t ticks);
+bool workqueue_cancel_delayed(struct work *wk);
+int parallel_for(unsigned n, void (*func)(void *arg, unsigned i), void *arg);
+
+void workqueue_cpu_create(unsigned cpunum);
+void workqueue_bootstrap(void);
+
+#endif /* _WORKQUEUE_H_ */
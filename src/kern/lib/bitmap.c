@@ -95,29 +95,99 @@ bitmap_getdata(struct bitmap *b)
         return b->v;
 }
 
+/*
+ * Return the index of the lowest clear bit in W, which mustn't be
+ * all ones.
+ */
+static
+inline
+unsigned
+bitmap_ffz(WORD_TYPE w)
+{
+        unsigned offset = 0;
+
+        KASSERT(w != WORD_ALLBITS);
+        w = ~w;
+        if ((w & 0x0f) == 0) {
+                w >>= 4;
+                offset += 4;
+        }
+        if ((w & 0x03) == 0) {
+                w >>= 2;
+                offset += 2;
+        }
+        if ((w & 0x01) == 0) {
+                offset += 1;
+        }
+        return offset;
+}
+
+/*
+ * Find the first clear bit from START up to (not including) END. The
+ * bytes are checked a uint32_t at a time where they're aligned for
+ * it; whether a uint32_t is all ones doesn't depend on byte order, so
+ * the data stays endian-neutral. (The kernel is built freestanding,
+ * where plain memcpy is a function call; the builtin is one load.)
+ */
 int
-bitmap_alloc(struct bitmap *b, unsigned *index)
+bitmap_findclear(struct bitmap *b, unsigned start, unsigned end,
+                 unsigned *index)
 {
-        unsigned ix;
-        unsigned maxix = DIVROUNDUP(b->nbits, BITS_PER_WORD);
-        unsigned offset;
+        unsigned ix, maxix, bit;
+        uint32_t chunk;
+        WORD_TYPE w;
 
-        for (ix=0; ix<maxix; ix++) {
-                if (b->v[ix]!=WORD_ALLBITS) {
-                        for (offset = 0; offset < BITS_PER_WORD; offset++) {
-                                WORD_TYPE mask = ((WORD_TYPE)1) << offset;
-
-                                if ((b->v[ix] & mask)==0) {
-                                        b->v[ix] |= mask;
-                                        *index = (ix*BITS_PER_WORD)+offset;
-                                        KASSERT(*index < b->nbits);
-                                        return 0;
-                                }
+        if (end > b->nbits) {
+                end = b->nbits;
+        }
+        if (start >= end) {
+                return ENOSPC;
+        }
+
+        /* First word: ignore the bits below START */
+        ix = start / BITS_PER_WORD;
+        w = b->v[ix] | (WORD_TYPE)((1U << (start % BITS_PER_WORD)) - 1);
+        maxix = DIVROUNDUP(end, BITS_PER_WORD);
+
+        while (w == WORD_ALLBITS) {
+                ix++;
+                if (ix >= maxix) {
+                        return ENOSPC;
+                }
+                while (ix % sizeof(chunk) == 0 &&
+                       ix + sizeof(chunk) <= maxix) {
+                        __builtin_memcpy(&chunk, &b->v[ix],
+                                         sizeof(chunk));
+                        if (chunk != 0xffffffff) {
+                                break;
                         }
-                        KASSERT(0);
+                        ix += sizeof(chunk);
+                }
+                if (ix >= maxix) {
+                        return ENOSPC;
                 }
+                w = b->v[ix];
+        }
+
+        bit = ix*BITS_PER_WORD + bitmap_ffz(w);
+        if (bit >= end) {
+                return ENOSPC;
+        }
+        *index = bit;
+        return 0;
+}
+
+int
+bitmap_alloc(struct bitmap *b, unsigned *index)
+{
+        int result;
+
+        result = bitmap_findclear(b, 0, b->nbits, index);
+        if (result) {
+                return result;
         }
-        return ENOSPC;
+        bitmap_mark(b, *index);
+        return 0;
 }
 
 static
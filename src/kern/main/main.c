@@ -46,7 +46,9 @@
 #include <mainbus.h>
 #include <vfs.h>
 #include <device.h>
+#include <buf.h>
 #include <syscall.h>
+#include <workqueue.h>
 #include <test.h>
 #include <kern/test161.h>
 #include <version.h>
@@ -111,6 +113,7 @@ boot(void)
 	proc_bootstrap();
 	thread_bootstrap();
 	hardclock_bootstrap();
+	futex_bootstrap();
 	vfs_bootstrap();
 	kheap_nextgeneration();
 
@@ -128,6 +131,8 @@ boot(void)
 	vm_bootstrap();
 	kprintf_bootstrap();
 	thread_start_cpus();
+	workqueue_bootstrap();
+	buffer_syncer_start();
 	test161_bootstrap();
 
 	/* Default bootfs - but ignore failure, in case emu0 doesn't exist */
@@ -35,6 +35,8 @@
 #include <lib.h>
 #include <uio.h>
 #include <clock.h>
+#include <buf.h>
+#include <namecache.h>
 #include <thread.h>
 #include <proc.h>
 #include <vfs.h>
@@ -42,10 +44,12 @@
 #include <syscall.h>
 #include <test.h>
 #include <prompt.h>
+#include <lockstat.h>
 #include "opt-sfs.h"
 #include "opt-net.h"
 #include "opt-synchprobs.h"
 #include "opt-automationtest.h"
+#include "opt-lockstat.h"
 
 /*
  * In-kernel menu and command dispatcher.
@@ -125,7 +129,7 @@ common_prog(int nargs, char **args)
 		return ENOMEM;
 	}
 
-	tc = thread_count;
+	tc = thread_get_count();
 
 	result = thread_fork(args[0] /* thread name */,
 			proc /* new process */,
@@ -424,6 +428,120 @@ cmd_kheapdump(int nargs, char **args)
 	return 0;
 }
 
+static
+int
+cmd_ps(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	thread_printstats();
+
+	return 0;
+}
+
+static
+int
+cmd_bufstats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	buffer_printstats();
+
+	return 0;
+}
+
+static
+int
+cmd_ncstats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	namecache_printstats();
+
+	return 0;
+}
+
+static
+int
+cmd_syncage(int nargs, char **args)
+{
+	int seconds;
+
+	if (nargs != 2 || (seconds = atoi(args[1])) <= 0) {
+		kprintf("Usage: syncage seconds\n");
+		return EINVAL;
+	}
+
+	buffer_setmaxage(seconds);
+
+	return 0;
+}
+
+static
+int
+cmd_readahead(int nargs, char **args)
+{
+	if (nargs == 2 && !strcmp(args[1], "on")) {
+		buffer_setreadahead(true);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "off")) {
+		buffer_setreadahead(false);
+	}
+	else {
+		kprintf("Usage: readahead on|off\n");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+static
+int
+cmd_intrlat(int nargs, char **args)
+{
+	if (nargs == 1) {
+		hardclock_latency_print();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		hardclock_latency_reset();
+	}
+	else {
+		kprintf("Usage: intrlat [reset]\n");
+	}
+
+	return 0;
+}
+
+#if OPT_LOCKSTAT
+
+/* Default number of sites lockstat prints. */
+#define LOCKSTAT_TOP  20
+
+static
+int
+cmd_lockstat(int nargs, char **args)
+{
+	if (nargs == 1) {
+		lockstat_print(LOCKSTAT_TOP);
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		lockstat_reset();
+	}
+	else if (nargs == 2 && atoi(args[1]) > 0) {
+		lockstat_print(atoi(args[1]));
+	}
+	else {
+		kprintf("Usage: lockstat [count | reset]\n");
+	}
+
+	return 0;
+}
+
+#endif
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -509,6 +627,15 @@ static const char *testmenu[] = {
 	"[rwt3] RW lock test 3        (1?)   ",
 	"[rwt4] RW lock test 4        (1?)   ",
 	"[rwt5] RW lock test 5        (1?)   ",
+	"[pi1]  Priority inheritance test    ",
+	"[tmt1] Timer wheel test             ",
+	"[wb1]  Broadcast wakeup benchmark   ",
+	"[lkb]  Lock contention benchmark    ",
+	"[spb]  Spinlock fairness benchmark  ",
+	"[ept1] Epoch reclamation test       ",
+	"[at1] Atomic ops / per-CPU counters ",
+	"[wq1] Work queue test               ",
+	"[si1] Softirq test                  ",
 #if OPT_SYNCHPROBS
 	"[sp1] Whalemating test       (1)    ",
 	"[sp2] Stoplight test         (1)    ",
@@ -520,6 +647,10 @@ static const char *testmenu[] = {
 	"[fs4] FS write stress 2             ",
 	"[fs5] FS long stress                ",
 	"[fs6] FS create stress              ",
+	"[fs7] FS open files stress          ",
+	"[fs8] FS truncate vs write-back     ",
+	"[fs9] FS directory churn            ",
+	"[rdb] FS parallel read benchmark    ",
 	"[hm1] HMAC unit test                ",
 	NULL
 };
@@ -571,6 +702,15 @@ static const char *mainmenu[] = {
 	"[khu] Kernel heap usage             ",
 	"[khgen] Next kernel heap generation ",
 	"[khdump] Dump kernel heap           ",
+	"[ps] Thread scheduling stats        ",
+	"[intrlat] Timer interrupt latency   ",
+	"[bufstats] Buffer cache stats       ",
+	"[syncage] Set max dirty data age    ",
+	"[readahead] Toggle file read-ahead  ",
+	"[ncstats] Name cache stats          ",
+#if OPT_LOCKSTAT
+	"[lockstat] Lock contention stats    ",
+#endif
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -624,6 +764,15 @@ static struct {
 	{ "khu",        cmd_kheapused },
 	{ "khgen",      cmd_kheapgeneration },
 	{ "khdump",     cmd_kheapdump },
+	{ "ps",         cmd_ps },
+	{ "intrlat",    cmd_intrlat },
+	{ "bufstats",   cmd_bufstats },
+	{ "syncage",    cmd_syncage },
+	{ "readahead",  cmd_readahead },
+	{ "ncstats",    cmd_ncstats },
+#if OPT_LOCKSTAT
+	{ "lockstat",   cmd_lockstat },
+#endif
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -657,6 +806,15 @@ static struct {
 	{ "rwt3",	rwtest3 },
 	{ "rwt4",	rwtest4 },
 	{ "rwt5",	rwtest5 },
+	{ "pi1",	priotest },
+	{ "tmt1",	timertest },
+	{ "wb1",	wakebench },
+	{ "lkb",	lockbench },
+	{ "spb",	spinbench },
+	{ "ept1",	epochtest },
+	{ "at1",	atomictest },
+	{ "wq1",	workqueuetest },
+	{ "si1",	softirqtest },
 #if OPT_SYNCHPROBS
 	{ "sp1",	whalemating },
 	{ "sp2",	stoplight },
@@ -693,6 +851,10 @@ static struct {
 	{ "fs4",	writestress2 },
 	{ "fs5",	longstress },
 	{ "fs6",	createstress },
+	{ "fs7",	openstress },
+	{ "fs8",	truncstress },
+	{ "fs9",	dirchurn },
+	{ "rdb",	readbench },
 
 	/* HMAC unit tests */
 	{ "hm1",	hmacu1 },
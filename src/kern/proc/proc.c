@@ -38,12 +38,13 @@
  * things they point to. Rearrange this (and/or change it to be a
  * regular lock) as needed.
  *
- * Unless you're implementing multithreaded user processes, the only
- * process that will have more than one thread is the kernel process.
+ * User processes get more threads through the thread_create system
+ * call; see syscall/thread_syscalls.c.
  */
 
 #include <types.h>
 #include <spl.h>
+#include <wchan.h>
 #include <proc.h>
 #include <current.h>
 #include <addrspace.h>
@@ -73,8 +74,21 @@ proc_create(const char *name)
 		return NULL;
 	}
 
+	proc->p_uthreadwc = wchan_create(proc->p_name);
+	if (proc->p_uthreadwc == NULL) {
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
+
 	proc->p_numthreads = 0;
 	spinlock_init(&proc->p_lock);
+	bzero(&proc->p_stats, sizeof(proc->p_stats));
+
+	/* User thread fields; ids start at 1, 0 means free */
+	bzero(proc->p_uthreads, sizeof(proc->p_uthreads));
+	proc->p_uzombies = NULL;
+	proc->p_nexttid = 1;
 
 	/* VM fields */
 	proc->p_addrspace = NULL;
@@ -166,6 +180,16 @@ proc_destroy(struct proc *proc)
 	}
 
 	KASSERT(proc->p_numthreads == 0);
+
+	/* Exit values nobody joined. */
+	while (proc->p_uzombies != NULL) {
+		struct uzombie *uz = proc->p_uzombies;
+
+		proc->p_uzombies = uz->uz_next;
+		kfree(uz);
+	}
+
+	wchan_destroy(proc->p_uthreadwc);
 	spinlock_cleanup(&proc->p_lock);
 
 	kfree(proc->p_name);
@@ -241,6 +265,8 @@ proc_addthread(struct proc *proc, struct thread *t)
 	proc->p_numthreads++;
 	spinlock_release(&proc->p_lock);
 
+	snprintf(t->t_procname, sizeof(t->t_procname), "%s", proc->p_name);
+
 	spl = splhigh();
 	t->t_proc = proc;
 	splx(spl);
@@ -274,6 +300,8 @@ proc_remthread(struct thread *t)
 	spl = splhigh();
 	t->t_proc = NULL;
 	splx(spl);
+
+	t->t_procname[0] = '\0';
 }
 
 /*
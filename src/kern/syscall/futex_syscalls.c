@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Futexes: wait/wake on a word of user memory.
+ *
+ * A user-level mutex or semaphore keeps its state in an ordinary
+ * word and only calls into the kernel when it has to sleep or there
+ * might be someone to wake. FUTEX_WAIT sleeps if the word still
+ * holds the value the caller expects; FUTEX_WAKE wakes up to N
+ * sleepers on the word. The check in FUTEX_WAIT is made under the
+ * same lock FUTEX_WAKE takes, so a wakeup that follows a change to
+ * the word can't slip in between the check and the sleep.
+ *
+ * Sleepers are found by (address space, user address), so a futex is
+ * private to the threads of one process. Each such key that has
+ * sleepers gets a wait queue, made on demand in the hash bucket for
+ * the key and freed when its last sleeper leaves.
+ *
+ * The bucket lock is a sleep lock, not a spinlock, because we read
+ * the user word while holding it and copyin can fault.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/futex.h>
+#include <lib.h>
+#include <synch.h>
+#include <proc.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+#define FUTEX_NBUCKETS	64
+
+struct futex_queue {
+	struct futex_queue *fq_next;	/* bucket chain */
+	struct addrspace *fq_as;	/* key: address space */
+	vaddr_t fq_addr;		/* key: user address */
+	struct cv *fq_cv;		/* sleepers wait here */
+	unsigned fq_waiters;		/* threads in FUTEX_WAIT */
+	unsigned fq_wakeups;		/* wakeups not yet taken */
+};
+
+struct futex_bucket {
+	struct lock *fb_lock;
+	struct futex_queue *fb_queues;
+};
+
+static struct futex_bucket futex_table[FUTEX_NBUCKETS];
+
+/*
+ * Setup.
+ */
+void
+futex_bootstrap(void)
+{
+	unsigned i;
+
+	for (i=0; i<FUTEX_NBUCKETS; i++) {
+		futex_table[i].fb_lock = lock_create("futex");
+		if (futex_table[i].fb_lock == NULL) {
+			panic("futex_bootstrap: Out of memory\n");
+		}
+		futex_table[i].fb_queues = NULL;
+	}
+}
+
+/*
+ * Hash a key to its bucket. Futex words are aligned, so the low two
+ * bits of the address carry nothing.
+ */
+static
+struct futex_bucket *
+futex_bucket(struct addrspace *as, vaddr_t addr)
+{
+	uint32_t h;
+
+	h = (addr >> 2) ^ ((uintptr_t)as >> 4);
+	h ^= h >> 11;
+	return &futex_table[h % FUTEX_NBUCKETS];
+}
+
+/*
+ * Find the wait queue for a key, or NULL. Call with the bucket locked.
+ */
+static
+struct futex_queue *
+futex_queue_find(struct futex_bucket *fb, struct addrspace *as, vaddr_t addr)
+{
+	struct futex_queue *fq;
+
+	KASSERT(lock_do_i_hold(fb->fb_lock));
+
+	for (fq = fb->fb_queues; fq != NULL; fq = fq->fq_next) {
+		if (fq->fq_as == as && fq->fq_addr == addr) {
+			return fq;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Make an empty wait queue for a key and put it in its bucket. Call
+ * with the bucket locked.
+ */
+static
+struct futex_queue *
+futex_queue_create(struct futex_bucket *fb, struct addrspace *as,
+		   vaddr_t addr)
+{
+	struct futex_queue *fq;
+
+	KASSERT(lock_do_i_hold(fb->fb_lock));
+
+	fq = kmalloc(sizeof(*fq));
+	if (fq == NULL) {
+		return NULL;
+	}
+	fq->fq_cv = cv_create("futex");
+	if (fq->fq_cv == NULL) {
+		kfree(fq);
+		return NULL;
+	}
+	fq->fq_as = as;
+	fq->fq_addr = addr;
+	fq->fq_waiters = 0;
+	fq->fq_wakeups = 0;
+
+	fq->fq_next = fb->fb_queues;
+	fb->fb_queues = fq;
+	return fq;
+}
+
+/*
+ * Take an empty wait queue out of its bucket and free it. Call with
+ * the bucket locked.
+ */
+static
+void
+futex_queue_destroy(struct futex_bucket *fb, struct futex_queue *fq)
+{
+	struct futex_queue **fqp;
+
+	KASSERT(lock_do_i_hold(fb->fb_lock));
+	KASSERT(fq->fq_waiters == 0);
+	KASSERT(fq->fq_wakeups == 0);
+
+	for (fqp = &fb->fb_queues; *fqp != fq; fqp = &(*fqp)->fq_next) {
+		KASSERT(*fqp != NULL);
+	}
+	*fqp = fq->fq_next;
+
+	cv_destroy(fq->fq_cv);
+	kfree(fq);
+}
+
+/*
+ * FUTEX_WAIT: if *UADDR is VAL, sleep until woken by FUTEX_WAKE.
+ *
+ * A wakeup goes to whichever sleeper takes it first, which may be one
+ * that arrived after the FUTEX_WAKE; like any futex user, the caller
+ * must recheck its word after we return.
+ */
+static
+int
+futex_wait(struct addrspace *as, userptr_t uaddr, int val)
+{
+	struct futex_bucket *fb;
+	struct futex_queue *fq;
+	vaddr_t addr;
+	int cur;
+	int result;
+
+	addr = (vaddr_t)uaddr;
+	fb = futex_bucket(as, addr);
+
+	lock_acquire(fb->fb_lock);
+
+	result = copyin(uaddr, &cur, sizeof(cur));
+	if (result) {
+		goto out;
+	}
+	if (cur != val) {
+		result = EAGAIN;
+		goto out;
+	}
+
+	fq = futex_queue_find(fb, as, addr);
+	if (fq == NULL) {
+		fq = futex_queue_create(fb, as, addr);
+		if (fq == NULL) {
+			result = ENOMEM;
+			goto out;
+		}
+	}
+
+	fq->fq_waiters++;
+	while (fq->fq_wakeups == 0) {
+		cv_wait(fq->fq_cv, fb->fb_lock);
+	}
+	fq->fq_wakeups--;
+	fq->fq_waiters--;
+
+	if (fq->fq_waiters == 0) {
+		futex_queue_destroy(fb, fq);
+	}
+
+ out:
+	lock_release(fb->fb_lock);
+	return result;
+}
+
+/*
+ * FUTEX_WAKE: wake up to COUNT sleepers on UADDR. Returns the number
+ * actually woken.
+ */
+static
+int
+futex_wake(struct addrspace *as, userptr_t uaddr, int count)
+{
+	struct futex_bucket *fb;
+	struct futex_queue *fq;
+	vaddr_t addr;
+	int woken;
+
+	addr = (vaddr_t)uaddr;
+	fb = futex_bucket(as, addr);
+	woken = 0;
+
+	lock_acquire(fb->fb_lock);
+	fq = futex_queue_find(fb, as, addr);
+	if (fq != NULL) {
+		while (woken < count && fq->fq_wakeups < fq->fq_waiters) {
+			fq->fq_wakeups++;
+			cv_signal(fq->fq_cv, fb->fb_lock);
+			woken++;
+		}
+	}
+	lock_release(fb->fb_lock);
+
+	return woken;
+}
+
+/*
+ * The futex system call.
+ */
+int
+sys_futex(userptr_t uaddr, int op, int val, int32_t *retval)
+{
+	struct addrspace *as;
+
+	if ((vaddr_t)uaddr % sizeof(int) != 0) {
+		return EINVAL;
+	}
+	as = proc_getas();
+	if (as == NULL) {
+		return EFAULT;
+	}
+
+	switch (op) {
+	    case FUTEX_WAIT:
+		return futex_wait(as, uaddr, val);
+	    case FUTEX_WAKE:
+		if (val < 0) {
+			return EINVAL;
+		}
+		*retval = futex_wake(as, uaddr, val);
+		return 0;
+	}
+	return EINVAL;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <current.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/*
+ * Convert a tick count to a timeval.
+ */
+static
+void
+ticks_to_timeval(uint32_t ticks, struct timeval *tv)
+{
+	tv->tv_sec = ticks / HZ;
+	tv->tv_usec = (ticks % HZ) * (1000000 / HZ);
+}
+
+/*
+ * getrusage: report scheduling statistics for the current process
+ * (RUSAGE_SELF) or thread (RUSAGE_THREAD). We don't distinguish user
+ * from system time, so all cpu time is reported in ru_utime; the time
+ * spent waiting on a run queue goes in ru_wtime. Fields we don't
+ * track are zero. There is no process hierarchy to report children
+ * for, so RUSAGE_CHILDREN is not supported.
+ */
+int
+sys_getrusage(int who, userptr_t user_rusage)
+{
+	struct schedstats ss;
+	struct rusage ru;
+
+	switch (who) {
+	    case RUSAGE_SELF:
+		schedstats_proc(curproc, &ss);
+		break;
+	    case RUSAGE_THREAD:
+		schedstats_thread(&ss);
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	bzero(&ru, sizeof(ru));
+	ticks_to_timeval(ss.ss_runticks, &ru.ru_utime);
+	ticks_to_timeval(ss.ss_waitticks, &ru.ru_wtime);
+	ru.ru_nvcsw = ss.ss_nvcsw;
+	ru.ru_nivcsw = ss.ss_nivcsw;
+
+	return copyout(&ru, user_rusage, sizeof(ru));
+}
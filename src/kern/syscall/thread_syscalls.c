@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * User-level threads.
+ *
+ * A process starts with one thread; thread_create adds more, each a
+ * kernel thread in the same struct proc (so sharing the address
+ * space) with its own user stack and, once it enters user mode, its
+ * own trapframe on its own kernel stack. The extra threads live in
+ * the proc's p_uthreads table while they run. One that exits before
+ * it's joined moves to p_uzombies, so its slot (and stack) can be
+ * used again even if the process never joins it; a detached one just
+ * goes away.
+ *
+ * The first thread isn't in the table. It can call thread_exit, but
+ * can't be joined.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <wchan.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/* Each table slot uses the thread stack with the same number. */
+#if PROC_MAXUTHREADS > AS_THREADSTACKS
+#error "Not enough thread stacks for PROC_MAXUTHREADS"
+#endif
+
+/*
+ * Find the user thread with id TID. Call with p_lock held.
+ */
+static
+struct uthread *
+uthread_find(struct proc *proc, int tid)
+{
+	unsigned i;
+
+	KASSERT(spinlock_do_i_hold(&proc->p_lock));
+
+	for (i=0; i<PROC_MAXUTHREADS; i++) {
+		if (proc->p_uthreads[i].ut_tid == tid) {
+			return &proc->p_uthreads[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Take the exit record of thread TID off the zombie list, if it's
+ * there. Call with p_lock held; the caller frees it.
+ */
+static
+struct uzombie *
+uzombie_take(struct proc *proc, int tid)
+{
+	struct uzombie **uzp, *uz;
+
+	KASSERT(spinlock_do_i_hold(&proc->p_lock));
+
+	for (uzp = &proc->p_uzombies; *uzp != NULL; uzp = &(*uzp)->uz_next) {
+		uz = *uzp;
+		if (uz->uz_tid == tid) {
+			*uzp = uz->uz_next;
+			return uz;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * First function run by a new user thread: go to user mode at the
+ * start routine the creator handed us, on our own stack.
+ */
+static
+void
+uthread_start(void *data1, unsigned long slot)
+{
+	struct proc *proc = data1;
+	struct uthread *ut;
+	vaddr_t entry, func, arg, stack;
+
+	KASSERT(proc == curproc);
+	KASSERT(slot < PROC_MAXUTHREADS);
+
+	spinlock_acquire(&proc->p_lock);
+	ut = &proc->p_uthreads[slot];
+	ut->ut_thread = curthread;
+	entry = ut->ut_entry;
+	func = ut->ut_func;
+	arg = ut->ut_arg;
+	stack = ut->ut_stack;
+	spinlock_release(&proc->p_lock);
+
+	/*
+	 * enter_new_process builds a fresh trapframe on this thread's
+	 * stack and puts its first two arguments in a0 and a1, which
+	 * is exactly what the start routine wants.
+	 */
+	enter_new_process((int)func, (userptr_t)arg, NULL, stack, entry);
+}
+
+/*
+ * Create a new thread in the current process. It starts at ENTRY (the
+ * libc start routine) with FUNC and ARG as its arguments. Hands back
+ * the new thread's id.
+ */
+int
+sys___thread_create(userptr_t entry, userptr_t func, userptr_t arg,
+		    int32_t *retval)
+{
+	struct proc *proc = curproc;
+	struct addrspace *as;
+	struct uthread *ut;
+	vaddr_t stack;
+	unsigned slot;
+	int tid, result;
+
+	as = proc_getas();
+	if (as == NULL) {
+		return EINVAL;
+	}
+
+	spinlock_acquire(&proc->p_lock);
+	for (slot=0; slot<PROC_MAXUTHREADS; slot++) {
+		if (proc->p_uthreads[slot].ut_tid == 0) {
+			break;
+		}
+	}
+	if (slot == PROC_MAXUTHREADS) {
+		spinlock_release(&proc->p_lock);
+		return EAGAIN;
+	}
+	tid = proc->p_nexttid++;
+	ut = &proc->p_uthreads[slot];
+	ut->ut_tid = tid;
+	ut->ut_thread = NULL;
+	ut->ut_exited = false;
+	ut->ut_joining = false;
+	ut->ut_detached = false;
+	ut->ut_entry = (vaddr_t)entry;
+	ut->ut_func = (vaddr_t)func;
+	ut->ut_arg = (vaddr_t)arg;
+	ut->ut_retval = NULL;
+	spinlock_release(&proc->p_lock);
+
+	/* Nobody else touches the slot's stack until the thread runs. */
+	result = as_define_thread_stack(as, slot, &stack);
+	if (result) {
+		goto fail;
+	}
+	ut->ut_stack = stack;
+
+	/* thread_fork does the proc_addthread for us. */
+	result = thread_fork(proc->p_name, proc, uthread_start, proc, slot);
+	if (result) {
+		goto fail;
+	}
+
+	*retval = tid;
+	return 0;
+
+ fail:
+	/* Free the slot; a thread_join already waiting will get ESRCH. */
+	spinlock_acquire(&proc->p_lock);
+	ut->ut_tid = 0;
+	wchan_wakeall(proc->p_uthreadwc, &proc->p_lock);
+	spinlock_release(&proc->p_lock);
+	return result;
+}
+
+/*
+ * Wait for thread TID to exit, and hand back the value it passed to
+ * thread_exit. Each thread can be joined once.
+ */
+int
+sys_thread_join(int tid, userptr_t user_retval)
+{
+	struct proc *proc = curproc;
+	struct uthread *ut;
+	struct uzombie *uz;
+	userptr_t val;
+	int result;
+
+	if (tid <= 0) {
+		return ESRCH;
+	}
+
+	spinlock_acquire(&proc->p_lock);
+	ut = uthread_find(proc, tid);
+	if (ut == NULL) {
+		/* Already exited, maybe. */
+		uz = uzombie_take(proc, tid);
+		spinlock_release(&proc->p_lock);
+		if (uz == NULL) {
+			return ESRCH;
+		}
+		val = uz->uz_retval;
+		kfree(uz);
+		goto done;
+	}
+	if (ut->ut_thread == curthread || ut->ut_joining ||
+	    ut->ut_detached) {
+		spinlock_release(&proc->p_lock);
+		return EINVAL;
+	}
+	ut->ut_joining = true;
+	while (ut->ut_tid == tid && !ut->ut_exited) {
+		wchan_sleep(proc->p_uthreadwc, &proc->p_lock);
+	}
+	if (ut->ut_tid != tid) {
+		/* thread_fork failed after all */
+		spinlock_release(&proc->p_lock);
+		return ESRCH;
+	}
+	val = ut->ut_retval;
+	ut->ut_tid = 0;
+	spinlock_release(&proc->p_lock);
+
+ done:
+	if (user_retval != NULL) {
+		result = copyout(&val, user_retval, sizeof(val));
+		if (result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Let thread TID's slot go as soon as it exits, without a join. If
+ * it's already exited, that throws its exit value away.
+ */
+int
+sys_thread_detach(int tid)
+{
+	struct proc *proc = curproc;
+	struct uthread *ut;
+	struct uzombie *uz;
+
+	if (tid <= 0) {
+		return ESRCH;
+	}
+
+	spinlock_acquire(&proc->p_lock);
+	ut = uthread_find(proc, tid);
+	if (ut == NULL) {
+		uz = uzombie_take(proc, tid);
+		spinlock_release(&proc->p_lock);
+		if (uz == NULL) {
+			return ESRCH;
+		}
+		kfree(uz);
+		return 0;
+	}
+	if (ut->ut_joining || ut->ut_detached) {
+		spinlock_release(&proc->p_lock);
+		return EINVAL;
+	}
+	if (ut->ut_exited) {
+		/* Exited while out of memory for a zombie record */
+		ut->ut_tid = 0;
+	}
+	else {
+		ut->ut_detached = true;
+	}
+	spinlock_release(&proc->p_lock);
+	return 0;
+}
+
+/*
+ * Exit the current thread, leaving RETVAL for thread_join.
+ */
+void
+sys_thread_exit(userptr_t retval)
+{
+	struct proc *proc = curproc;
+	struct uthread *ut;
+	struct uzombie *uz;
+	unsigned i;
+
+	/* Can't kmalloc under p_lock; it's freed below if not needed. */
+	uz = kmalloc(sizeof(*uz));
+
+	spinlock_acquire(&proc->p_lock);
+	for (i=0; i<PROC_MAXUTHREADS; i++) {
+		ut = &proc->p_uthreads[i];
+		if (ut->ut_tid == 0 || ut->ut_thread != curthread) {
+			continue;
+		}
+		if (ut->ut_detached) {
+			ut->ut_tid = 0;
+		}
+		else if (ut->ut_joining || uz == NULL) {
+			/* The joiner frees the slot. */
+			ut->ut_retval = retval;
+			ut->ut_exited = true;
+			wchan_wakeall(proc->p_uthreadwc, &proc->p_lock);
+		}
+		else {
+			uz->uz_tid = ut->ut_tid;
+			uz->uz_retval = retval;
+			uz->uz_next = proc->p_uzombies;
+			proc->p_uzombies = uz;
+			uz = NULL;
+			ut->ut_tid = 0;
+		}
+		break;
+	}
+	spinlock_release(&proc->p_lock);
+
+	if (uz != NULL) {
+		kfree(uz);
+	}
+
+	/* thread_exit does the proc_remthread. */
+	thread_exit();
+}
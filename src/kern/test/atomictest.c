@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Atomic operation and per-CPU counter test.
+ *
+ * Worker threads hammer one shared atomic with fetchadd, with a
+ * cas retry loop, and with xchg, and one per-CPU counter with adds
+ * and subtracts; then we check that no update was lost. The xchg
+ * part passes a single token around: each worker swaps in 0 and, if
+ * it got the token back, counts it and puts it back; the token must
+ * survive and the count must be positive.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <thread.h>
+#include <synch.h>
+#include <atomic.h>
+#include <percpu.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define NWORKERS	8
+#define NLOOPS		2000
+
+static struct atomic at_count;
+static struct atomic at_token;
+static struct atomic at_taken;
+static struct percpu_counter at_pcount;
+static struct semaphore *at_done;
+
+static
+void
+at_worker(void *junk, unsigned long num)
+{
+	unsigned i;
+	int old;
+
+	(void)junk;
+	(void)num;
+
+	for (i=0; i<NLOOPS; i++) {
+		atomic_fetchadd(&at_count, 1);
+
+		do {
+			old = atomic_load(&at_count);
+		} while (!atomic_cas(&at_count, old, old + 2));
+
+		if (atomic_xchg(&at_token, 0) == 1) {
+			atomic_fetchadd(&at_taken, 1);
+			atomic_store(&at_token, 1);
+		}
+
+		percpu_counter_add(&at_pcount, 3);
+		percpu_counter_add(&at_pcount, -1);
+
+		if (i % 64 == 0) {
+			thread_yield();
+		}
+	}
+	V(at_done);
+}
+
+int
+atomictest(int nargs, char **args)
+{
+	unsigned i;
+	int expected;
+	bool status;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting at1...\n");
+
+	at_done = sem_create("at1-done", 0);
+	if (at_done == NULL) {
+		panic("at1: out of memory\n");
+	}
+	atomic_store(&at_count, 0);
+	atomic_store(&at_token, 1);
+	atomic_store(&at_taken, 0);
+	percpu_counter_set(&at_pcount, 0);
+
+	for (i=0; i<NWORKERS; i++) {
+		result = thread_fork("at1-worker", NULL, at_worker, NULL, i);
+		if (result) {
+			panic("at1: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<NWORKERS; i++) {
+		P(at_done);
+	}
+
+	status = TEST161_SUCCESS;
+	expected = NWORKERS * NLOOPS * 3;
+	if (atomic_load(&at_count) != expected) {
+		kprintf_n("at1: atomic count %d, expected %d\n",
+			  atomic_load(&at_count), expected);
+		status = TEST161_FAIL;
+	}
+	if (atomic_load(&at_token) != 1 || atomic_load(&at_taken) == 0) {
+		kprintf_n("at1: token %d, taken %d times\n",
+			  atomic_load(&at_token), atomic_load(&at_taken));
+		status = TEST161_FAIL;
+	}
+	expected = NWORKERS * NLOOPS * 2;
+	if (percpu_counter_read(&at_pcount) != expected) {
+		kprintf_n("at1: per-CPU count %d, expected %d\n",
+			  (int)percpu_counter_read(&at_pcount), expected);
+		status = TEST161_FAIL;
+	}
+
+	sem_destroy(at_done);
+
+	success(status, SECRET, "at1");
+	return 0;
+}
@@ -40,7 +40,8 @@ bitmaptest(int nargs, char **args)
 	struct bitmap *b;
 	char data[TESTSIZE];
 	uint32_t x;
-	int i;
+	unsigned start, end, j;
+	int i, result;
 
 	(void)nargs;
 	(void)args;
@@ -89,6 +90,23 @@ bitmaptest(int nargs, char **args)
 		}
 	}
 
+	for (i=0; i<TESTSIZE; i++) {
+		start = random() % TESTSIZE;
+		end = start + random() % (TESTSIZE + 1 - start);
+		for (j=start; j<end && !data[j]; j++) {
+			/* nothing */
+		}
+		result = bitmap_findclear(b, start, end, &x);
+		if (j < end) {
+			KASSERT(result == 0);
+			KASSERT(x == j);
+			KASSERT(bitmap_isset(b, x)==0);
+		}
+		else {
+			KASSERT(result != 0);
+		}
+	}
+
 	while (bitmap_alloc(b, &x)==0) {
 		KASSERT(x < TESTSIZE);
 		KASSERT(bitmap_isset(b, x));
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Epoch test.
+ *
+ * Reader threads repeatedly look at a shared object in epoch read
+ * sections while the menu thread keeps replacing it, reclaiming the
+ * old one after a grace period, alternately with epoch_synchronize
+ * and with epoch_defer. Reclaiming poisons an object before freeing
+ * it, so a reader that sees the poison caught an object being freed
+ * too early.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <membar.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <epoch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define NREADERS	8
+#define NUPDATES	200
+#define READSPINS	100
+
+#define ET_LIVE		0x1ea5ed
+#define ET_DEAD		0xdeadbeef
+
+/* Ticks to wait for deferred frees to finish before giving up. */
+#define DRAIN_TICKS	(5 * HZ)
+
+struct et_obj {
+	volatile unsigned eo_magic;
+	struct epoch_cb eo_cb;
+};
+
+static struct et_obj *volatile et_current;
+static volatile bool et_stop;
+static struct semaphore *et_done;
+
+static struct spinlock et_lock = SPINLOCK_INITIALIZER;
+static unsigned et_bad;			/* poisoned objects seen */
+static unsigned et_freed;		/* objects reclaimed */
+
+static
+struct et_obj *
+et_create(void)
+{
+	struct et_obj *eo;
+
+	eo = kmalloc(sizeof(*eo));
+	if (eo == NULL) {
+		panic("ept1: out of memory\n");
+	}
+	eo->eo_magic = ET_LIVE;
+	return eo;
+}
+
+/* Reclaim; may run in interrupt context via epoch_defer. */
+static
+void
+et_free(void *vobj)
+{
+	struct et_obj *eo = vobj;
+
+	eo->eo_magic = ET_DEAD;
+	kfree(eo);
+
+	spinlock_acquire(&et_lock);
+	et_freed++;
+	spinlock_release(&et_lock);
+}
+
+static
+void
+et_reader(void *junk, unsigned long num)
+{
+	struct et_obj *eo;
+	unsigned i, bad;
+
+	(void)junk;
+	(void)num;
+
+	bad = 0;
+	while (!et_stop) {
+		epoch_enter();
+		eo = et_current;
+		membar_load_load();
+		for (i=0; i<READSPINS; i++) {
+			if (eo->eo_magic != ET_LIVE) {
+				bad++;
+				break;
+			}
+		}
+
+		/* Sections nest. */
+		epoch_enter();
+		if (eo->eo_magic != ET_LIVE) {
+			bad++;
+		}
+		epoch_exit();
+
+		epoch_exit();
+		thread_yield();
+	}
+
+	spinlock_acquire(&et_lock);
+	et_bad += bad;
+	spinlock_release(&et_lock);
+	V(et_done);
+}
+
+int
+epochtest(int nargs, char **args)
+{
+	struct et_obj *old, *eo;
+	unsigned i, ticks;
+	bool drained, status;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting ept1...\n");
+
+	et_done = sem_create("ept1-done", 0);
+	if (et_done == NULL) {
+		panic("ept1: out of memory\n");
+	}
+	et_bad = 0;
+	et_freed = 0;
+	et_stop = false;
+	et_current = et_create();
+
+	for (i=0; i<NREADERS; i++) {
+		result = thread_fork("ept1-reader", NULL, et_reader, NULL, i);
+		if (result) {
+			panic("ept1: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	for (i=0; i<NUPDATES; i++) {
+		eo = et_create();
+		membar_store_store();
+		old = et_current;
+		et_current = eo;
+		if (i % 2 == 0) {
+			epoch_synchronize();
+			et_free(old);
+		}
+		else {
+			epoch_defer(&old->eo_cb, et_free, old);
+		}
+		thread_yield();
+	}
+
+	et_stop = true;
+	for (i=0; i<NREADERS; i++) {
+		P(et_done);
+	}
+
+	/* Deferred frees run from hardclock; give them time. */
+	for (ticks = 0; ticks < DRAIN_TICKS; ticks++) {
+		spinlock_acquire(&et_lock);
+		drained = et_freed == NUPDATES;
+		spinlock_release(&et_lock);
+		if (drained) {
+			break;
+		}
+		thread_sleep_ns(NS_PER_TICK);
+	}
+
+	status = TEST161_SUCCESS;
+	if (et_bad > 0) {
+		kprintf_n("ept1: readers saw %u reclaimed objects\n", et_bad);
+		status = TEST161_FAIL;
+	}
+	if (et_freed != NUPDATES) {
+		kprintf_n("ept1: only %u of %u objects reclaimed\n",
+			  et_freed, NUPDATES);
+		status = TEST161_FAIL;
+	}
+
+	kfree(et_current);
+	et_current = NULL;
+	sem_destroy(et_done);
+
+	success(status, SECRET, "ept1");
+	return 0;
+}
@@ -41,7 +41,9 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/fcntl.h>
+#include <kern/stat.h>
 #include <lib.h>
+#include <atomic.h>
 #include <uio.h>
 #include <thread.h>
 #include <synch.h>
@@ -56,6 +58,14 @@
 #define NTHREADS 12
 #define NLONG    32
 #define NCREATE  24
+#define NOPENTHREADS 8
+#define NOPEN    256
+#define NTRUNCTHREADS 4
+#define NTRUNC   200
+#define TRUNCBLOCKS 16
+#define EVICTBLOCKS 320		/* more than the buffer cache holds */
+#define NCHURN   2000
+#define CHURNMAXSIZE 1024	/* bytes; a hashed SFS dir needs 512 */
 
 static struct semaphore *threadsem = NULL;
 
@@ -674,6 +684,378 @@ docreatestress(const char *filesys)
 
 ////////////////////////////////////////////////////////////
 
+/*
+ * Create lots of files and hold them all open at once, so the
+ * filesystem has thousands of live vnodes; then open each again,
+ * which must find the vnode already loaded.
+ */
+static
+void
+openstress_thread(void *fs, unsigned long num)
+{
+	const char *filesys = fs;
+	struct vnode **vns, *vn;
+	char namesuffix[16];
+	char name[32];
+	char buf[32];
+	unsigned i, numopen = 0, numfound = 0, numremoved = 0;
+	int err;
+
+	vns = kmalloc(NOPEN * sizeof(*vns));
+	if (vns == NULL) {
+		panic("openstress: Out of memory\n");
+	}
+
+	for (i=0; i<NOPEN; i++) {
+		snprintf(namesuffix, sizeof(namesuffix), "%lu-%u", num, i);
+		MAKENAME();
+
+		/* vfs_open destroys the string it's passed */
+		strcpy(buf, name);
+		err = vfs_open(buf, O_WRONLY|O_CREAT|O_TRUNC, 0664, &vns[i]);
+		if (err) {
+			kprintf("Could not open %s for write: %s\n",
+				name, strerror(err));
+			break;
+		}
+		numopen++;
+	}
+	kprintf("Thread %lu: %u files open\n", num, numopen);
+
+	for (i=0; i<numopen; i++) {
+		snprintf(namesuffix, sizeof(namesuffix), "%lu-%u", num, i);
+		MAKENAME();
+
+		strcpy(buf, name);
+		err = vfs_open(buf, O_RDONLY, 0664, &vn);
+		if (err) {
+			kprintf("Could not open %s for read: %s\n",
+				name, strerror(err));
+			continue;
+		}
+		if (vn != vns[i]) {
+			kprintf("%s: Test failed: opened it twice but got "
+				"two different vnodes\n", name);
+			vfs_close(vn);
+			continue;
+		}
+		vfs_close(vn);
+		numfound++;
+	}
+	kprintf("Thread %lu: %u open files found again\n", num, numfound);
+
+	for (i=0; i<numopen; i++) {
+		vfs_close(vns[i]);
+		snprintf(namesuffix, sizeof(namesuffix), "%lu-%u", num, i);
+		if (fstest_remove(filesys, namesuffix)) {
+			continue;
+		}
+		numremoved++;
+	}
+	kprintf("Thread %lu: %u files removed\n", num, numremoved);
+
+	kfree(vns);
+	V(threadsem);
+}
+
+static
+void
+doopenstress(const char *filesys)
+{
+	int i, err;
+
+	init_threadsem();
+
+	kprintf("*** Starting fs open files stress test on %s:\n", filesys);
+
+	for (i=0; i<NOPENTHREADS; i++) {
+		err = thread_fork("openstress", NULL,
+				  openstress_thread, (char *)filesys, i);
+		if (err) {
+			panic("openstress: thread_fork failed %s\n",
+			      strerror(err));
+		}
+	}
+
+	for (i=0; i<NOPENTHREADS; i++) {
+		P(threadsem);
+	}
+
+	kprintf("*** fs open files stress test done\n");
+}
+
+/*
+ * Free blocks while they're being written back. Each truncate thread
+ * dirties some blocks and truncates them away again, while one thread
+ * syncs over and over and another writes a file too big for the
+ * buffer cache, so dirty buffers are also written back to evict them.
+ * Either kind of write-back can be in progress on a block when it's
+ * freed.
+ */
+static struct atomic truncstress_running;
+
+static
+int
+truncstress_fill(struct vnode *vn, unsigned nblocks, char *buf)
+{
+	struct iovec iov;
+	struct uio ku;
+	unsigned i;
+	int err;
+
+	for (i=0; i<nblocks; i++) {
+		uio_kinit(&iov, &ku, buf, 512, (off_t)i * 512, UIO_WRITE);
+		err = VOP_WRITE(vn, &ku);
+		if (err) {
+			return err;
+		}
+		if (ku.uio_resid > 0) {
+			return ENOSPC;
+		}
+	}
+	return 0;
+}
+
+static
+void
+truncstress_thread(void *fs, unsigned long num)
+{
+	const char *filesys = fs;
+	struct vnode *vn;
+	char namesuffix[16];
+	char name[32];
+	char *buf;
+	unsigned i;
+	int err;
+
+	buf = kmalloc(512);
+	if (buf == NULL) {
+		panic("truncstress: Out of memory\n");
+	}
+	snprintf(namesuffix, sizeof(namesuffix), "trunc%lu", num);
+	MAKENAME();
+	memset(buf, 'a' + num, 512);
+
+	err = vfs_open(name, O_RDWR|O_CREAT|O_TRUNC, 0664, &vn);
+	if (err) {
+		kprintf("truncstress: open: %s\n", strerror(err));
+		goto done;
+	}
+	for (i=0; i<NTRUNC; i++) {
+		err = truncstress_fill(vn, TRUNCBLOCKS, buf);
+		if (err == 0) {
+			err = VOP_TRUNCATE(vn, 0);
+		}
+		if (err) {
+			kprintf("truncstress: thread %lu: %s\n", num,
+				strerror(err));
+			break;
+		}
+	}
+	vfs_close(vn);
+	fstest_remove(filesys, namesuffix);
+	kprintf("Thread %lu: %u truncates done\n", num, i);
+
+ done:
+	kfree(buf);
+	atomic_fetchadd(&truncstress_running, -1);
+	V(threadsem);
+}
+
+static
+void
+truncstress_syncer(void *fs, unsigned long num)
+{
+	unsigned nsyncs = 0;
+
+	(void)fs;
+	(void)num;
+
+	while (atomic_load(&truncstress_running) > 0) {
+		vfs_sync();
+		nsyncs++;
+		thread_yield();
+	}
+	kprintf("Syncer: %u syncs done\n", nsyncs);
+	V(threadsem);
+}
+
+static
+void
+truncstress_evicter(void *fs, unsigned long num)
+{
+	const char *filesys = fs;
+	struct vnode *vn;
+	char namesuffix[16];
+	char name[32];
+	char *buf;
+	unsigned npasses = 0;
+	int err;
+
+	(void)num;
+
+	buf = kmalloc(512);
+	if (buf == NULL) {
+		panic("truncstress: Out of memory\n");
+	}
+	strcpy(namesuffix, "evict");
+	MAKENAME();
+	memset(buf, 'z', 512);
+
+	err = vfs_open(name, O_RDWR|O_CREAT|O_TRUNC, 0664, &vn);
+	if (err) {
+		kprintf("truncstress: open: %s\n", strerror(err));
+		kfree(buf);
+		V(threadsem);
+		return;
+	}
+	while (atomic_load(&truncstress_running) > 0) {
+		err = truncstress_fill(vn, EVICTBLOCKS, buf);
+		if (err) {
+			kprintf("truncstress: evicter: %s\n", strerror(err));
+			break;
+		}
+		npasses++;
+	}
+	vfs_close(vn);
+	fstest_remove(filesys, namesuffix);
+	kfree(buf);
+	kprintf("Evicter: %u passes done\n", npasses);
+	V(threadsem);
+}
+
+static
+void
+dotruncstress(const char *filesys)
+{
+	int i, err;
+
+	init_threadsem();
+
+	kprintf("*** Starting fs truncate vs. write-back test on %s:\n",
+		filesys);
+
+	atomic_store(&truncstress_running, NTRUNCTHREADS);
+	for (i=0; i<NTRUNCTHREADS; i++) {
+		err = thread_fork("truncstress", NULL,
+				  truncstress_thread, (char *)filesys, i);
+		if (err) {
+			panic("truncstress: thread_fork failed %s\n",
+			      strerror(err));
+		}
+	}
+	err = thread_fork("truncstress-sync", NULL,
+			  truncstress_syncer, (char *)filesys, 0);
+	if (err) {
+		panic("truncstress: thread_fork failed %s\n", strerror(err));
+	}
+	err = thread_fork("truncstress-evict", NULL,
+			  truncstress_evicter, (char *)filesys, 0);
+	if (err) {
+		panic("truncstress: thread_fork failed %s\n", strerror(err));
+	}
+
+	for (i=0; i<NTRUNCTHREADS + 2; i++) {
+		P(threadsem);
+	}
+
+	kprintf("*** fs truncate vs. write-back test done\n");
+}
+
+/*
+ * Create and remove names in one directory over and over, with never
+ * more than one file in it, and check the directory doesn't grow.
+ * Deleted entries in a hashed SFS directory used to make every
+ * rebuild double it.
+ */
+static
+int
+dirchurn_size(const char *path, off_t *size)
+{
+	struct vnode *vn;
+	struct stat st;
+	char buf[32];
+	int err;
+
+	strcpy(buf, path);
+	err = vfs_lookup(buf, &vn);
+	if (err) {
+		return err;
+	}
+	err = VOP_STAT(vn, &st);
+	VOP_DECREF(vn);
+	if (err) {
+		return err;
+	}
+	*size = st.st_size;
+	return 0;
+}
+
+static
+void
+dodirchurn(const char *filesys)
+{
+	struct vnode *vn;
+	char dir[32], name[48], buf[48];
+	off_t size, maxsize;
+	unsigned i;
+	int err;
+
+	kprintf("*** Starting fs directory churn test on %s:\n", filesys);
+
+	snprintf(dir, sizeof(dir), "%s:%s.dir", filesys, FILENAME);
+	strcpy(buf, dir);
+	err = vfs_mkdir(buf, 0775);
+	if (err) {
+		kprintf("dirchurn: mkdir %s: %s\n", dir, strerror(err));
+		return;
+	}
+
+	maxsize = 0;
+	for (i=0; i<NCHURN; i++) {
+		snprintf(name, sizeof(name), "%s/churn%u", dir, i);
+		strcpy(buf, name);
+		err = vfs_open(buf, O_WRONLY|O_CREAT|O_EXCL, 0664, &vn);
+		if (err) {
+			kprintf("dirchurn: create %s: %s\n", name,
+				strerror(err));
+			break;
+		}
+		vfs_close(vn);
+		strcpy(buf, name);
+		err = vfs_remove(buf);
+		if (err) {
+			kprintf("dirchurn: remove %s: %s\n", name,
+				strerror(err));
+			break;
+		}
+		err = dirchurn_size(dir, &size);
+		if (err) {
+			kprintf("dirchurn: stat %s: %s\n", dir, strerror(err));
+			break;
+		}
+		if (size > maxsize) {
+			maxsize = size;
+		}
+	}
+
+	strcpy(buf, dir);
+	err = vfs_rmdir(buf);
+	if (err) {
+		kprintf("dirchurn: rmdir %s: %s\n", dir, strerror(err));
+	}
+
+	kprintf("%u names churned; directory size at most %llu bytes\n",
+		i, (unsigned long long)maxsize);
+	if (i < NCHURN || maxsize > CHURNMAXSIZE) {
+		kprintf("*** fs directory churn test FAILED\n");
+		return;
+	}
+	kprintf("*** fs directory churn test done\n");
+}
+
+////////////////////////////////////////////////////////////
+
 static
 int
 checkfilesystem(int nargs, char **args)
@@ -714,6 +1096,9 @@ DEFTEST(writestress);
 DEFTEST(writestress2);
 DEFTEST(longstress);
 DEFTEST(createstress);
+DEFTEST(openstress);
+DEFTEST(truncstress);
+DEFTEST(dirchurn);
 
 ////////////////////////////////////////////////////////////
 
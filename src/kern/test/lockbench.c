@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Lock contention benchmark.
+ *
+ * NTHREADS threads each acquire and release one lock ITERATIONS
+ * times around a short critical section, the way kprintf_lock and
+ * the console locks get used. The run is done once with adaptive
+ * spinning turned off (lock_spinlimit = 0) and once with the default
+ * limit, and the times are printed side by side. Spinning only
+ * matters with more than one CPU.
+ *
+ * Usage: lkb [nthreads [iterations]]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define DEFAULT_NTHREADS	8
+#define DEFAULT_ITERATIONS	2000
+
+/* Length of the critical section and of the work between sections. */
+#define INSIDE_WORK	20
+#define OUTSIDE_WORK	200
+
+static struct lock *lkb_lock;
+static struct semaphore *lkb_start;
+static struct semaphore *lkb_done;
+static volatile unsigned long lkb_counter;
+
+static
+void
+lkb_thread(void *junk, unsigned long iterations)
+{
+	volatile unsigned long dummy;
+	unsigned long i, j;
+
+	(void)junk;
+
+	P(lkb_start);
+	dummy = 0;
+	for (i=0; i<iterations; i++) {
+		lock_acquire(lkb_lock);
+		for (j=0; j<INSIDE_WORK; j++) {
+			lkb_counter++;
+		}
+		lock_release(lkb_lock);
+
+		for (j=0; j<OUTSIDE_WORK; j++) {
+			dummy++;
+		}
+	}
+	(void)dummy;
+	V(lkb_done);
+}
+
+/*
+ * Do one run and return the elapsed time in nanoseconds, or 0 if the
+ * counter came out wrong.
+ */
+static
+uint64_t
+lkb_run(unsigned nthreads, unsigned long iterations)
+{
+	struct timespec start, end, diff;
+	unsigned i;
+	int result;
+
+	lkb_counter = 0;
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork("lkb", NULL, lkb_thread, NULL, iterations);
+		if (result) {
+			panic("lkb: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	/* Let them all go at once. */
+	gettime(&start);
+	for (i=0; i<nthreads; i++) {
+		V(lkb_start);
+	}
+	for (i=0; i<nthreads; i++) {
+		P(lkb_done);
+	}
+	gettime(&end);
+
+	if (lkb_counter != nthreads * iterations * INSIDE_WORK) {
+		kprintf("lkb: counter is %lu, expected %lu\n", lkb_counter,
+			nthreads * iterations * INSIDE_WORK);
+		return 0;
+	}
+
+	timespec_sub(&end, &start, &diff);
+	return (uint64_t)diff.tv_sec * 1000000000 + diff.tv_nsec;
+}
+
+int
+lockbench(int nargs, char **args)
+{
+	unsigned nthreads;
+	unsigned long iterations;
+	uint64_t sleepns, spinns;
+	int savedlimit, spinlimit;
+
+	nthreads = DEFAULT_NTHREADS;
+	iterations = DEFAULT_ITERATIONS;
+	if (nargs > 1) {
+		nthreads = atoi(args[1]);
+	}
+	if (nargs > 2) {
+		iterations = atoi(args[2]);
+	}
+	if (nthreads == 0 || iterations == 0) {
+		kprintf("Usage: lkb [nthreads [iterations]]\n");
+		return EINVAL;
+	}
+
+	lkb_lock = lock_create("lkb");
+	lkb_start = sem_create("lkb-start", 0);
+	lkb_done = sem_create("lkb-done", 0);
+	if (lkb_lock == NULL || lkb_start == NULL || lkb_done == NULL) {
+		panic("lkb: out of memory\n");
+	}
+
+	kprintf_n("Starting lkb: %u threads, %lu iterations each...\n",
+		  nthreads, iterations);
+
+	savedlimit = lock_spinlimit;
+	spinlimit = savedlimit != 0 ? savedlimit : LOCK_SPINLIMIT;
+
+	lock_spinlimit = 0;
+	sleepns = lkb_run(nthreads, iterations);
+	lock_spinlimit = spinlimit;
+	spinns = lkb_run(nthreads, iterations);
+	lock_spinlimit = savedlimit;
+
+	kprintf("lkb: sleep only: %llu us; spin then sleep (limit %d): "
+		"%llu us\n", sleepns / 1000, spinlimit, spinns / 1000);
+
+	lock_destroy(lkb_lock);
+	sem_destroy(lkb_start);
+	sem_destroy(lkb_done);
+
+	success(sleepns != 0 && spinns != 0 ? TEST161_SUCCESS : TEST161_FAIL,
+		SECRET, "lkb");
+	return 0;
+}
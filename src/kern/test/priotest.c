@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Priority inheritance test.
+ *
+ * Sets up the chain
+ *
+ *      high (90) --waits for--> lock2, held by
+ *      mid  (30) --waits for--> lock1, held by
+ *      low  (10)
+ *
+ * and checks that low ends up running at 90 until it releases lock1,
+ * and that everyone drops back to their base priority afterwards.
+ *
+ * Run this on one CPU; otherwise the threads can run in parallel
+ * and the chain may never form.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define PRI_LOW		10
+#define PRI_MID		30
+#define PRI_HIGH	90
+
+/* How long low waits for the chain to form before giving up. */
+#define MAXYIELDS	10000
+
+static struct lock *lock1, *lock2;
+static struct semaphore *readysem, *donesem;
+
+static volatile int low_boosted, low_after;
+static volatile int mid_locked, mid_after;
+
+static
+void
+lowthread(void *junk, unsigned long num)
+{
+	unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	thread_setpriority(PRI_LOW);
+	lock_acquire(lock1);
+	V(readysem);
+
+	for (i=0; i<MAXYIELDS && curthread->t_priority < PRI_HIGH; i++) {
+		thread_yield();
+	}
+	low_boosted = curthread->t_priority;
+
+	lock_release(lock1);
+	low_after = curthread->t_priority;
+	V(donesem);
+}
+
+static
+void
+midthread(void *junk, unsigned long num)
+{
+	(void)junk;
+	(void)num;
+
+	thread_setpriority(PRI_MID);
+	lock_acquire(lock2);
+	V(readysem);
+
+	lock_acquire(lock1);
+	mid_locked = curthread->t_priority;
+	lock_release(lock1);
+
+	lock_release(lock2);
+	mid_after = curthread->t_priority;
+	V(donesem);
+}
+
+static
+void
+highthread(void *junk, unsigned long num)
+{
+	(void)junk;
+	(void)num;
+
+	thread_setpriority(PRI_HIGH);
+	lock_acquire(lock2);
+	lock_release(lock2);
+	V(donesem);
+}
+
+static
+void
+pifork(const char *name, void (*func)(void *, unsigned long))
+{
+	int result;
+
+	result = thread_fork(name, NULL, func, NULL, 0);
+	if (result) {
+		panic("pi1: thread_fork failed: %s\n", strerror(result));
+	}
+}
+
+int
+priotest(int nargs, char **args)
+{
+	bool status;
+	int i;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting pi1...\n");
+
+	lock1 = lock_create("pi1-lock1");
+	lock2 = lock_create("pi1-lock2");
+	readysem = sem_create("pi1-ready", 0);
+	donesem = sem_create("pi1-done", 0);
+	if (lock1 == NULL || lock2 == NULL ||
+	    readysem == NULL || donesem == NULL) {
+		panic("pi1: out of memory\n");
+	}
+
+	pifork("pi1-low", lowthread);
+	P(readysem);
+	pifork("pi1-mid", midthread);
+	P(readysem);
+	pifork("pi1-high", highthread);
+
+	for (i=0; i<3; i++) {
+		P(donesem);
+	}
+
+	kprintf_n("low: boosted to %d, then %d\n", low_boosted, low_after);
+	kprintf_n("mid: %d holding both locks, then %d\n",
+		  mid_locked, mid_after);
+
+	status = TEST161_SUCCESS;
+	if (low_boosted != PRI_HIGH || low_after != PRI_LOW ||
+	    mid_locked != PRI_HIGH || mid_after != PRI_MID) {
+		status = TEST161_FAIL;
+	}
+
+	lock_destroy(lock1);
+	lock_destroy(lock2);
+	sem_destroy(readysem);
+	sem_destroy(donesem);
+
+	success(status, SECRET, "pi1");
+	return 0;
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Parallel file read benchmark.
+ *
+ * Each thread reads its own file over and over; the files are small
+ * enough to stay in the buffer cache, so this measures the filesystem
+ * and buffer cache code rather than the disk. The run is repeated with
+ * 1, 2, 4, ... threads up to MAXTHREADS and the aggregate rate printed
+ * for each. With per-vnode locking in SFS the rate should go up with
+ * the number of CPUs instead of staying flat.
+ *
+ * Usage: rdb filesystem [maxthreads]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <uio.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define DEFAULT_NTHREADS	8
+#define MAX_NTHREADS		16
+
+#define RDB_FILESIZE		(8*512)
+#define RDB_PASSES		500
+
+static struct semaphore *rdb_start;
+static struct semaphore *rdb_done;
+static struct vnode *rdb_vns[MAX_NTHREADS];
+static char *rdb_bufs[MAX_NTHREADS];
+static volatile bool rdb_failed[MAX_NTHREADS];
+
+static
+char
+rdb_pattern(unsigned num, unsigned pos)
+{
+	return 'a' + (num + pos) % 26;
+}
+
+static
+void
+rdb_makename(char *buf, size_t len, const char *fs, unsigned num)
+{
+	snprintf(buf, len, "%s:rdb.%u", fs, num);
+}
+
+static
+void
+rdb_thread(void *junk, unsigned long num)
+{
+	struct iovec iov;
+	struct uio ku;
+	char *buf;
+	unsigned i;
+	int result;
+
+	(void)junk;
+
+	buf = rdb_bufs[num];
+
+	P(rdb_start);
+	for (i=0; i<RDB_PASSES; i++) {
+		uio_kinit(&iov, &ku, buf, RDB_FILESIZE, 0, UIO_READ);
+		result = VOP_READ(rdb_vns[num], &ku);
+		if (result) {
+			kprintf("rdb: thread %lu: read: %s\n", num,
+				strerror(result));
+			rdb_failed[num] = true;
+			break;
+		}
+		if (ku.uio_resid != 0 ||
+		    buf[i % RDB_FILESIZE] != rdb_pattern(num, i % RDB_FILESIZE)) {
+			kprintf("rdb: thread %lu: bad data\n", num);
+			rdb_failed[num] = true;
+			break;
+		}
+	}
+	V(rdb_done);
+}
+
+/*
+ * Do one run and return the elapsed time in nanoseconds, or 0 if
+ * any thread failed.
+ */
+static
+uint64_t
+rdb_run(unsigned nthreads)
+{
+	struct timespec start, end, diff;
+	unsigned i;
+	bool failed;
+	int result;
+
+	for (i=0; i<nthreads; i++) {
+		rdb_failed[i] = false;
+		result = thread_fork("rdb", NULL, rdb_thread, NULL, i);
+		if (result) {
+			panic("rdb: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	/* Let them all go at once. */
+	gettime(&start);
+	for (i=0; i<nthreads; i++) {
+		V(rdb_start);
+	}
+	for (i=0; i<nthreads; i++) {
+		P(rdb_done);
+	}
+	gettime(&end);
+
+	failed = false;
+	for (i=0; i<nthreads; i++) {
+		failed = failed || rdb_failed[i];
+	}
+	if (failed) {
+		return 0;
+	}
+
+	timespec_sub(&end, &start, &diff);
+	return (uint64_t)diff.tv_sec * 1000000000 + diff.tv_nsec;
+}
+
+/*
+ * Create and fill file NUM and leave it open in rdb_vns.
+ */
+static
+int
+rdb_setup(const char *fs, unsigned num)
+{
+	char name[32];
+	struct iovec iov;
+	struct uio ku;
+	char *buf;
+	unsigned i;
+	int result;
+
+	buf = kmalloc(RDB_FILESIZE);
+	if (buf == NULL) {
+		return ENOMEM;
+	}
+	for (i=0; i<RDB_FILESIZE; i++) {
+		buf[i] = rdb_pattern(num, i);
+	}
+
+	rdb_makename(name, sizeof(name), fs, num);
+	result = vfs_open(name, O_RDWR|O_CREAT|O_TRUNC, 0664, &rdb_vns[num]);
+	if (result) {
+		kprintf("rdb: %s: %s\n", name, strerror(result));
+		kfree(buf);
+		return result;
+	}
+
+	uio_kinit(&iov, &ku, buf, RDB_FILESIZE, 0, UIO_WRITE);
+	result = VOP_WRITE(rdb_vns[num], &ku);
+	if (result == 0 && ku.uio_resid != 0) {
+		result = ENOSPC;
+	}
+	if (result) {
+		kprintf("rdb: write: %s\n", strerror(result));
+		vfs_close(rdb_vns[num]);
+		rdb_vns[num] = NULL;
+		kfree(buf);
+		return result;
+	}
+
+	rdb_bufs[num] = buf;
+	return 0;
+}
+
+static
+void
+rdb_cleanup(const char *fs, unsigned num)
+{
+	char name[32];
+
+	if (rdb_vns[num] == NULL) {
+		return;
+	}
+	vfs_close(rdb_vns[num]);
+	rdb_vns[num] = NULL;
+	kfree(rdb_bufs[num]);
+	rdb_bufs[num] = NULL;
+
+	rdb_makename(name, sizeof(name), fs, num);
+	vfs_remove(name);
+}
+
+int
+readbench(int nargs, char **args)
+{
+	char *fs;
+	unsigned maxthreads, n, i;
+	uint64_t ns, kb, rate, baserate;
+	bool ok;
+	int result;
+
+	if (nargs < 2 || nargs > 3) {
+		kprintf("Usage: rdb filesystem [maxthreads]\n");
+		return EINVAL;
+	}
+	fs = args[1];
+	/* Allow (but do not require) colon after device name */
+	if (fs[strlen(fs)-1] == ':') {
+		fs[strlen(fs)-1] = 0;
+	}
+	maxthreads = DEFAULT_NTHREADS;
+	if (nargs > 2) {
+		maxthreads = atoi(args[2]);
+	}
+	if (maxthreads == 0 || maxthreads > MAX_NTHREADS) {
+		kprintf("rdb: maxthreads must be 1-%u\n", MAX_NTHREADS);
+		return EINVAL;
+	}
+
+	rdb_start = sem_create("rdb-start", 0);
+	rdb_done = sem_create("rdb-done", 0);
+	if (rdb_start == NULL || rdb_done == NULL) {
+		panic("rdb: out of memory\n");
+	}
+
+	kprintf_n("Starting rdb: up to %u threads, %u passes over %u "
+		  "bytes each...\n", maxthreads, RDB_PASSES, RDB_FILESIZE);
+
+	ok = true;
+	for (i=0; i<maxthreads; i++) {
+		result = rdb_setup(fs, i);
+		if (result) {
+			ok = false;
+			break;
+		}
+	}
+
+	/* One untimed run to get everything into the buffer cache. */
+	if (ok && rdb_run(maxthreads) == 0) {
+		ok = false;
+	}
+
+	baserate = 0;
+	n = 1;
+	while (ok) {
+		ns = rdb_run(n);
+		if (ns == 0) {
+			ok = false;
+			break;
+		}
+		kb = (uint64_t)n * RDB_PASSES * RDB_FILESIZE / 1024;
+		rate = kb * 1000000000 / ns;
+		if (baserate == 0) {
+			/* Avoid dividing by zero if the 1-thread run was glacial. */
+			baserate = rate > 0 ? rate : 1;
+		}
+		kprintf("rdb: %u threads: %llu us, %llu KB/s, speedup "
+			"%llu.%02llu\n", n, ns / 1000, rate,
+			rate / baserate, (rate * 100 / baserate) % 100);
+		if (n == maxthreads) {
+			break;
+		}
+		n = n*2 > maxthreads ? maxthreads : n*2;
+	}
+
+	for (i=0; i<maxthreads; i++) {
+		rdb_cleanup(fs, i);
+	}
+	sem_destroy(rdb_start);
+	sem_destroy(rdb_done);
+
+	success(ok ? TEST161_SUCCESS : TEST161_FAIL, SECRET, "rdb");
+	return 0;
+}
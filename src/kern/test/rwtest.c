@@ -20,7 +20,18 @@
 #define NLOCKLOOPS    20
 #define NTHREADS      32
 
+/*
+ * rwt2 wants to see readers overlap at least once. How many overlap
+ * depends on scheduling, so don't ask for more than two.
+ */
+#define MINREADERS     2
+
+/* Operations per thread in throughput mode. */
+#define BENCHOPS     2000
+
 static volatile unsigned long testval1;
+static unsigned readers_now, readers_max, writers_now;
+static unsigned long bench_ratio, bench_writes;
 
 static struct semaphore *donesem = NULL;
 static struct rwlock *testrw = NULL;
@@ -57,6 +68,15 @@ rwtestreader(void *junk, unsigned long num)
 	for (i=0; i<NLOCKLOOPS; i++) {
 		kprintf_t(".");
 		rwlock_acquire_read(testrw);
+		spinlock_acquire(&status_lock);
+		readers_now++;
+		if (readers_now > readers_max) {
+			readers_max = readers_now;
+		}
+		if (writers_now != 0) {
+			test_status = TEST161_FAIL;
+		}
+		spinlock_release(&status_lock);
     		tempval = testval1 ;
     		kprintf_n("for reader %lu, tempval1 = %u\n", num, tempval);
 
@@ -68,6 +88,9 @@ rwtestreader(void *junk, unsigned long num)
 			failif(true);
 		}
 
+		spinlock_acquire(&status_lock);
+		readers_now--;
+		spinlock_release(&status_lock);
 		rwlock_release_read(testrw);
 	}
 
@@ -88,6 +111,12 @@ rwtestwriter(void *junk, unsigned long num)
 	for (i=0; i<NLOCKLOOPS; i++) {
 		kprintf_t(".");
 		rwlock_acquire_write(testrw);
+		spinlock_acquire(&status_lock);
+		writers_now++;
+		if (writers_now != 1 || readers_now != 0) {
+			test_status = TEST161_FAIL;
+		}
+		spinlock_release(&status_lock);
 		testval1 = num ;
     		kprintf_n("for writer %lu, new testval1 = %lu\n", num, testval1);
     
@@ -99,6 +128,9 @@ rwtestwriter(void *junk, unsigned long num)
 			failif(true);
 		}
 
+		spinlock_acquire(&status_lock);
+		writers_now--;
+		spinlock_release(&status_lock);
 		rwlock_release_write(testrw);
 	}
 
@@ -106,14 +138,105 @@ rwtestwriter(void *junk, unsigned long num)
 	return;
 }
 
+/*
+ * Throughput mode: "rwtN bench [ratio ...]". For each ratio R, all
+ * NTHREADS threads do BENCHOPS operations each, one write for every R
+ * reads (R = 0 means all writes), and the overall rate is printed.
+ */
+static
+void
+rwbenchthread(void *junk, unsigned long num)
+{
+	unsigned long i, writes;
+
+	(void)junk;
+
+	writes = 0;
+	for (i=0; i<BENCHOPS; i++) {
+		if ((i + num) % (bench_ratio + 1) == 0) {
+			rwlock_acquire_write(testrw);
+			testval1++;
+			rwlock_release_write(testrw);
+			writes++;
+		}
+		else {
+			rwlock_acquire_read(testrw);
+			(void)testval1;
+			rwlock_release_read(testrw);
+		}
+	}
+
+	spinlock_acquire(&status_lock);
+	bench_writes += writes;
+	spinlock_release(&status_lock);
+	V(donesem);
+}
+
+static
+int
+rwbench(const char *name, int nargs, char **args)
+{
+	static const unsigned long defratios[] = { 0, 1, 4, 16, 64 };
+	struct timespec start, end, diff;
+	unsigned long ratio;
+	uint64_t ns;
+	int i, j, nratios, result;
+
+	nratios = nargs > 0 ? nargs : (int)(sizeof(defratios) / sizeof(defratios[0]));
+
+	spinlock_init(&status_lock);
+	test_status = TEST161_SUCCESS;
+
+	for (j=0; j<nratios; j++) {
+		ratio = nargs > 0 ? (unsigned long)atoi(args[j]) : defratios[j];
+
+		testrw = rwlock_create("testrw");
+		donesem = sem_create("donesem", 0);
+		if (testrw == NULL || donesem == NULL) {
+			panic("%s: out of memory\n", name);
+		}
+		testval1 = 0;
+		bench_writes = 0;
+		bench_ratio = ratio;
+
+		gettime(&start);
+		for (i=0; i<NTHREADS; i++) {
+			result = thread_fork(name, NULL, rwbenchthread, NULL, i);
+			if (result) {
+				panic("%s: thread_fork failed: %s\n",
+				      name, strerror(result));
+			}
+		}
+		for (i=0; i<NTHREADS; i++) {
+			P(donesem);
+		}
+		gettime(&end);
+
+		failif(testval1 != bench_writes);
+
+		timespec_sub(&end, &start, &diff);
+		ns = (uint64_t)diff.tv_sec * 1000000000 + diff.tv_nsec;
+		kprintf("%s: %lu reads per write: %llu ops/sec\n", name, ratio,
+			ns == 0 ? 0 :
+			(uint64_t)NTHREADS * BENCHOPS * 1000000000 / ns);
 
+		rwlock_destroy(testrw);
+		sem_destroy(donesem);
+		testrw = NULL;
+		donesem = NULL;
+	}
+
+	success(test_status, SECRET, name);
+	return 0;
+}
 
 
 int
 rwtest(int nargs, char **args)
 {
-	(void)nargs;
-	(void)args;
+	if (nargs > 1 && !strcmp(args[1], "bench")) {
+		return rwbench("rwt1", nargs - 2, args + 2);
+	}
 
   	testval1 = NTHREADS-1 ;
 
@@ -141,6 +264,8 @@ rwtest(int nargs, char **args)
 
 	spinlock_init(&status_lock);
 	test_status = TEST161_SUCCESS;
+	readers_now = 0;
+	writers_now = 0;
 
 	for (i=0; i<NTHREADS; i++) {
 		kprintf_t(".");
@@ -180,11 +305,9 @@ rwtest(int nargs, char **args)
 
 
 int rwtest2(int nargs, char **args) {
-	(void)nargs;
-	(void)args;
-
-	(void)nargs;
-	(void)args;
+	if (nargs > 1 && !strcmp(args[1], "bench")) {
+		return rwbench("rwt2", nargs - 2, args + 2);
+	}
 
   	testval1 = NTHREADS-1 ;
 
@@ -211,17 +334,14 @@ int rwtest2(int nargs, char **args) {
 	}
 
 	spinlock_init(&status_lock);
-	test_status = TEST161_FAIL;
+	test_status = TEST161_SUCCESS;
+	readers_now = 0;
+	readers_max = 0;
+	writers_now = 0;
 
 	for (i=0; i<NTHREADS; i++) {
 		kprintf_t(".");
       		result = thread_fork("rwtest2", NULL, rwtestreader, NULL, i);
-		if ( (!testrw->writer_count) && testrw->rw_sem->sem_count == 0 ){
-			kprintf_t("rw_sem->sem_count = %u\n", testrw->rw_sem->sem_count);
-			test_status = TEST161_SUCCESS;
-
-		}
-
 		if (result) {
 			panic("rwtest2: thread_fork failed: %s\n",
 			strerror(result));
@@ -234,6 +354,10 @@ int rwtest2(int nargs, char **args) {
 		P(donesem);                 // V(donesem) in rwtestreader
 	}
 
+	/* Readers only; they should have overlapped freely. */
+	kprintf_n("at most %u concurrent readers\n", readers_max);
+	failif(readers_max < MINREADERS);
+
   	rwlock_destroy(testrw);
 	sem_destroy(donesem);
 	testrw = NULL;
@@ -248,8 +372,9 @@ int rwtest2(int nargs, char **args) {
 
 
 int rwtest3(int nargs, char **args) {
-	(void)nargs;
-	(void)args;
+	if (nargs > 1 && !strcmp(args[1], "bench")) {
+		return rwbench("rwt3", nargs - 2, args + 2);
+	}
 
 
 
@@ -294,8 +419,9 @@ int rwtest3(int nargs, char **args) {
 
 
 int rwtest4(int nargs, char **args) {
-	(void)nargs;
-	(void)args;
+	if (nargs > 1 && !strcmp(args[1], "bench")) {
+		return rwbench("rwt4", nargs - 2, args + 2);
+	}
 
 	kprintf_n("Starting rwtest 4...\n");
 	for (int i=0; i<CREATELOOPS; i++) {
@@ -335,8 +461,9 @@ int rwtest4(int nargs, char **args) {
 }
 
 int rwtest5(int nargs, char **args) {
-	(void)nargs;
-	(void)args;
+	if (nargs > 1 && !strcmp(args[1], "bench")) {
+		return rwbench("rwt5", nargs - 2, args + 2);
+	}
 
 	kprintf_n("Starting rwtest 5...\n");
 	for (int i=0; i<CREATELOOPS; i++) {
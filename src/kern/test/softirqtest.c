@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Softirq test.
+ *
+ * First, on one CPU at splhigh: softirqs scheduled there must not run
+ * until the spl drops, must run in the order they were scheduled,
+ * and scheduling one that's already pending must do nothing.
+ *
+ * Then worker threads on all CPUs each repeatedly schedule a softirq
+ * of their own and wait on a semaphore it posts, so softirqs get run
+ * from every path (spl dropping, interrupt exit, idle loop); none may
+ * be lost.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <thread.h>
+#include <synch.h>
+#include <atomic.h>
+#include <softirq.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define NORDER		3
+#define NWORKERS	8
+#define NLOOPS		500
+
+static struct softirq si_order[NORDER];
+static unsigned si_ran[NORDER];
+static unsigned si_nran;
+
+static struct atomic si_count;
+static struct semaphore *si_done;
+
+static
+void
+si_orderfunc(void *arg)
+{
+	unsigned num = (uintptr_t)arg;
+
+	if (si_nran < NORDER) {
+		si_ran[si_nran] = num;
+	}
+	si_nran++;
+}
+
+static
+void
+si_workfunc(void *arg)
+{
+	struct semaphore *sem = arg;
+
+	atomic_fetchadd(&si_count, 1);
+	V(sem);
+}
+
+static
+void
+si_worker(void *junk, unsigned long num)
+{
+	struct softirq si;
+	struct semaphore *sem;
+	unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	sem = sem_create("si1-sem", 0);
+	if (sem == NULL) {
+		panic("si1: out of memory\n");
+	}
+	softirq_init(&si, si_workfunc, sem);
+
+	for (i=0; i<NLOOPS; i++) {
+		if (!softirq_schedule(&si)) {
+			panic("si1: idle softirq already pending\n");
+		}
+		P(sem);
+		if (i % 16 == 0) {
+			thread_yield();
+		}
+	}
+
+	sem_destroy(sem);
+	V(si_done);
+}
+
+int
+softirqtest(int nargs, char **args)
+{
+	unsigned i;
+	bool status;
+	bool again;
+	int result;
+	int s;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting si1...\n");
+	status = TEST161_SUCCESS;
+
+	for (i=0; i<NORDER; i++) {
+		softirq_init(&si_order[i], si_orderfunc, (void *)(uintptr_t)i);
+	}
+	si_nran = 0;
+
+	s = splhigh();
+	for (i=0; i<NORDER; i++) {
+		softirq_schedule(&si_order[i]);
+	}
+	again = softirq_schedule(&si_order[0]);
+	if (si_nran != 0) {
+		/* Don't print at splhigh. */
+		status = TEST161_FAIL;
+	}
+	splx(s);
+
+	if (status == TEST161_FAIL) {
+		kprintf_n("si1: softirq ran at splhigh\n");
+	}
+	if (again) {
+		kprintf_n("si1: pending softirq scheduled twice\n");
+		status = TEST161_FAIL;
+	}
+	if (si_nran != NORDER) {
+		kprintf_n("si1: %u softirqs ran, expected %u\n",
+			  si_nran, NORDER);
+		status = TEST161_FAIL;
+	}
+	for (i=0; i<NORDER && i<si_nran; i++) {
+		if (si_ran[i] != i) {
+			kprintf_n("si1: softirq %u ran in position %u\n",
+				  si_ran[i], i);
+			status = TEST161_FAIL;
+		}
+	}
+
+	si_done = sem_create("si1-done", 0);
+	if (si_done == NULL) {
+		panic("si1: out of memory\n");
+	}
+	atomic_store(&si_count, 0);
+
+	for (i=0; i<NWORKERS; i++) {
+		result = thread_fork("si1-worker", NULL, si_worker, NULL, i);
+		if (result) {
+			panic("si1: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<NWORKERS; i++) {
+		P(si_done);
+	}
+
+	if (atomic_load(&si_count) != NWORKERS * NLOOPS) {
+		kprintf_n("si1: %d softirqs ran, expected %d\n",
+			  atomic_load(&si_count), NWORKERS * NLOOPS);
+		status = TEST161_FAIL;
+	}
+
+	sem_destroy(si_done);
+
+	success(status, SECRET, "si1");
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Spinlock fairness and throughput benchmark.
+ *
+ * NTHREADS threads (one per CPU by default) hammer one spinlock for
+ * SECONDS seconds, each counting how many times it got the lock.
+ * Thread I is pinned to CPU I mod num_cpus, so the threads are spread
+ * evenly and the load balancer can't stack them up or move them
+ * around mid-run.
+ * Prints the total (throughput), the smallest and largest per-thread
+ * counts, and Jain's fairness index over the counts, scaled so that
+ * 1000 means every thread got exactly the same share.
+ *
+ * Usage: spb [nthreads [seconds]]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <cpu.h>
+#include <clock.h>
+#include <spinlock.h>
+#include <thread.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define MAXTHREADS	32
+#define DEFAULT_SECONDS	2
+
+/* Length of the critical section and of the work between sections. */
+#define INSIDE_WORK	10
+#define OUTSIDE_WORK	10
+
+static struct spinlock spb_lock = SPINLOCK_INITIALIZER;
+static struct semaphore *spb_done;
+static volatile bool spb_stop;
+static volatile unsigned long spb_shared;
+static unsigned long spb_counts[MAXTHREADS];
+
+static
+void
+spb_thread(void *junk, unsigned long num)
+{
+	volatile unsigned long dummy;
+	unsigned long count;
+	unsigned j;
+
+	(void)junk;
+
+	count = 0;
+	dummy = 0;
+	while (!spb_stop) {
+		spinlock_acquire(&spb_lock);
+		for (j=0; j<INSIDE_WORK; j++) {
+			spb_shared++;
+		}
+		spinlock_release(&spb_lock);
+		count++;
+
+		for (j=0; j<OUTSIDE_WORK; j++) {
+			dummy++;
+		}
+	}
+	(void)dummy;
+
+	spb_counts[num] = count;
+	V(spb_done);
+}
+
+int
+spinbench(int nargs, char **args)
+{
+	unsigned nthreads, seconds, i;
+	unsigned long min, max;
+	uint64_t sum, sumsq, jain;
+	int result;
+
+	nthreads = num_cpus;
+	seconds = DEFAULT_SECONDS;
+	if (nargs > 1) {
+		nthreads = atoi(args[1]);
+	}
+	if (nargs > 2) {
+		seconds = atoi(args[2]);
+	}
+	if (nthreads == 0 || nthreads > MAXTHREADS || seconds == 0) {
+		kprintf("Usage: spb [nthreads [seconds]], nthreads <= %d\n",
+			MAXTHREADS);
+		return EINVAL;
+	}
+
+	spb_done = sem_create("spb-done", 0);
+	if (spb_done == NULL) {
+		panic("spb: out of memory\n");
+	}
+	spb_stop = false;
+	spb_shared = 0;
+
+	kprintf_n("Starting spb: %u threads for %u seconds...\n",
+		  nthreads, seconds);
+
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork_pinned("spb", NULL, i % num_cpus,
+					    spb_thread, NULL, i);
+		if (result) {
+			panic("spb: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	thread_sleep_ns((uint64_t)seconds * 1000000000);
+	spb_stop = true;
+	for (i=0; i<nthreads; i++) {
+		P(spb_done);
+	}
+
+	sum = sumsq = 0;
+	min = max = spb_counts[0];
+	for (i=0; i<nthreads; i++) {
+		kprintf_n("spb: thread %u: %lu\n", i, spb_counts[i]);
+		sum += spb_counts[i];
+		sumsq += (uint64_t)spb_counts[i] * spb_counts[i];
+		if (spb_counts[i] < min) {
+			min = spb_counts[i];
+		}
+		if (spb_counts[i] > max) {
+			max = spb_counts[i];
+		}
+	}
+	jain = sumsq == 0 ? 0 : (sum * sum * 1000) / (nthreads * sumsq);
+
+	kprintf("spb: %llu acquires/sec, per thread min %lu max %lu, "
+		"fairness %llu/1000\n", sum / seconds, min, max, jain);
+
+	sem_destroy(spb_done);
+
+	success(spb_shared == sum * INSIDE_WORK ?
+		TEST161_SUCCESS : TEST161_FAIL, SECRET, "spb");
+	return 0;
+}
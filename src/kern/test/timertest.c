@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Timer wheel test.
+ *
+ * Checks that thread_sleep_ns, sem_timedP, and cv_timedwait neither
+ * return early nor hang, and that a batch of sleepers with deadlines
+ * spread across the first two levels of the wheel (so some of them
+ * have to cascade) all wake at or after their deadlines.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define NS_PER_MS	1000000ULL
+
+/* Number of sleepers in the cascade test, and the spacing between them. */
+#define NSLEEPERS	16
+#define SLEEP_STEP_MS	55
+
+/* Slack allowed past a deadline before we call a wakeup late. */
+#define SLACK_TICKS	(HZ / 2)
+
+static struct semaphore *donesem;
+static struct semaphore *tsem;
+static struct lock *tlock;
+static struct cv *tcv;
+static volatile bool tflag;
+static volatile bool sleeper_bad;
+
+/*
+ * Ticks elapsed since START, as a signed quantity.
+ */
+static
+int32_t
+ticks_since(uint32_t start)
+{
+	return (int32_t)(hardclock_ticks - start);
+}
+
+static
+void
+sleeper(void *junk, unsigned long ms)
+{
+	uint32_t start;
+	int32_t want, got;
+
+	(void)junk;
+
+	start = hardclock_ticks;
+	thread_sleep_ns(ms * NS_PER_MS);
+	got = ticks_since(start);
+	want = ns_to_ticks(ms * NS_PER_MS);
+	if (got < want || got > want + SLACK_TICKS) {
+		kprintf_n("tmt1: sleeper for %lu ms woke after %d ticks, "
+			  "expected %d\n", ms, (int)got, (int)want);
+		sleeper_bad = true;
+	}
+	V(donesem);
+}
+
+static
+void
+poster(void *junk, unsigned long ms)
+{
+	(void)junk;
+
+	thread_sleep_ns(ms * NS_PER_MS);
+	V(tsem);
+	V(donesem);
+}
+
+static
+void
+signaller(void *junk, unsigned long ms)
+{
+	(void)junk;
+
+	thread_sleep_ns(ms * NS_PER_MS);
+	lock_acquire(tlock);
+	tflag = true;
+	cv_signal(tcv, tlock);
+	lock_release(tlock);
+	V(donesem);
+}
+
+static
+void
+tmfork(const char *name, void (*func)(void *, unsigned long),
+       unsigned long arg)
+{
+	int result;
+
+	result = thread_fork(name, NULL, func, NULL, arg);
+	if (result) {
+		panic("tmt1: thread_fork failed: %s\n", strerror(result));
+	}
+}
+
+/*
+ * Check that a wait that started at START and was supposed to last at
+ * least MS milliseconds did, and didn't overshoot badly.
+ */
+static
+bool
+check_elapsed(const char *what, uint32_t start, unsigned long ms)
+{
+	int32_t got, want;
+
+	got = ticks_since(start);
+	want = ns_to_ticks(ms * NS_PER_MS);
+	kprintf_n("%s: %d ticks (wanted %d)\n", what, (int)got, (int)want);
+	return got >= want && got <= want + SLACK_TICKS;
+}
+
+int
+timertest(int nargs, char **args)
+{
+	bool status;
+	uint32_t start;
+	unsigned i;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting tmt1...\n");
+
+	donesem = sem_create("tmt1-done", 0);
+	tsem = sem_create("tmt1-sem", 0);
+	tlock = lock_create("tmt1-lock");
+	tcv = cv_create("tmt1-cv");
+	if (donesem == NULL || tsem == NULL || tlock == NULL || tcv == NULL) {
+		panic("tmt1: out of memory\n");
+	}
+	status = TEST161_SUCCESS;
+
+	/* Plain sleep. */
+	start = hardclock_ticks;
+	thread_sleep_ns(100 * NS_PER_MS);
+	if (!check_elapsed("thread_sleep_ns", start, 100)) {
+		status = TEST161_FAIL;
+	}
+
+	/* Semaphore timeout with nobody posting. */
+	start = hardclock_ticks;
+	result = sem_timedP(tsem, 50 * NS_PER_MS);
+	if (result != ETIMEDOUT || !check_elapsed("sem_timedP", start, 50)) {
+		status = TEST161_FAIL;
+	}
+
+	/* Semaphore posted well before the timeout. */
+	tmfork("tmt1-poster", poster, 20);
+	result = sem_timedP(tsem, 2000 * NS_PER_MS);
+	if (result != 0) {
+		kprintf_n("sem_timedP: timed out despite V\n");
+		status = TEST161_FAIL;
+	}
+	P(donesem);
+
+	/* CV timeout with nobody signalling. */
+	lock_acquire(tlock);
+	start = hardclock_ticks;
+	result = cv_timedwait(tcv, tlock, 50 * NS_PER_MS);
+	if (result != ETIMEDOUT || !check_elapsed("cv_timedwait", start, 50)) {
+		status = TEST161_FAIL;
+	}
+	if (!lock_do_i_hold(tlock)) {
+		kprintf_n("cv_timedwait: returned without the lock\n");
+		status = TEST161_FAIL;
+	}
+
+	/* CV signalled well before the timeout. */
+	tflag = false;
+	tmfork("tmt1-signaller", signaller, 20);
+	while (!tflag) {
+		result = cv_timedwait(tcv, tlock, 2000 * NS_PER_MS);
+		if (result == ETIMEDOUT) {
+			kprintf_n("cv_timedwait: timed out despite signal\n");
+			status = TEST161_FAIL;
+			break;
+		}
+	}
+	lock_release(tlock);
+	P(donesem);
+
+	/* Lots of sleepers; the later ones start out on level 1. */
+	sleeper_bad = false;
+	for (i=0; i<NSLEEPERS; i++) {
+		tmfork("tmt1-sleeper", sleeper,
+		       (NSLEEPERS - i) * SLEEP_STEP_MS);
+	}
+	for (i=0; i<NSLEEPERS; i++) {
+		P(donesem);
+	}
+	if (sleeper_bad) {
+		status = TEST161_FAIL;
+	}
+
+	sem_destroy(donesem);
+	sem_destroy(tsem);
+	lock_destroy(tlock);
+	cv_destroy(tcv);
+
+	success(status, SECRET, "tmt1");
+	return 0;
+}
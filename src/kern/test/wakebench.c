@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Wakeup benchmark.
+ *
+ * NTHREADS threads wait on one CV; the menu thread broadcasts and
+ * waits for all of them to run. Reports the average time spent in
+ * cv_broadcast itself and the average time until the last waiter
+ * has run. The waiters get spread across CPUs by the migration
+ * code, so on a multiprocessor this exercises cross-CPU wakeups.
+ *
+ * Usage: wb1 [nthreads [rounds]]
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define DEFAULT_NTHREADS	64
+#define DEFAULT_ROUNDS		100
+
+static struct lock *wb_lock;
+static struct cv *wb_cv;		/* waiters sleep here */
+static struct cv *wb_ready;		/* the menu thread sleeps here */
+static struct semaphore *wb_done;
+
+static unsigned wb_nthreads;
+static unsigned wb_gen;
+static unsigned wb_waiting;
+static unsigned wb_woken;
+
+static
+void
+wb_waiter(void *junk, unsigned long rounds)
+{
+	unsigned gen;
+
+	(void)junk;
+
+	lock_acquire(wb_lock);
+	while (rounds-- > 0) {
+		gen = wb_gen;
+		wb_waiting++;
+		if (wb_waiting == wb_nthreads) {
+			cv_signal(wb_ready, wb_lock);
+		}
+		while (wb_gen == gen) {
+			cv_wait(wb_cv, wb_lock);
+		}
+		wb_woken++;
+		if (wb_woken == wb_nthreads) {
+			cv_signal(wb_ready, wb_lock);
+		}
+	}
+	lock_release(wb_lock);
+	V(wb_done);
+}
+
+static
+uint64_t
+wb_ns(const struct timespec *from, const struct timespec *to)
+{
+	struct timespec diff;
+
+	timespec_sub(to, from, &diff);
+	return (uint64_t)diff.tv_sec * 1000000000 + diff.tv_nsec;
+}
+
+int
+wakebench(int nargs, char **args)
+{
+	struct timespec t0, t1, t2;
+	uint64_t bcast_ns, total_ns;
+	unsigned rounds, i;
+	int result;
+
+	wb_nthreads = DEFAULT_NTHREADS;
+	rounds = DEFAULT_ROUNDS;
+	if (nargs > 1) {
+		wb_nthreads = atoi(args[1]);
+	}
+	if (nargs > 2) {
+		rounds = atoi(args[2]);
+	}
+	if (wb_nthreads == 0 || rounds == 0) {
+		kprintf("Usage: wb1 [nthreads [rounds]]\n");
+		return EINVAL;
+	}
+
+	kprintf_n("Starting wb1: %u waiters, %u rounds...\n",
+		  wb_nthreads, rounds);
+
+	wb_lock = lock_create("wb1-lock");
+	wb_cv = cv_create("wb1-cv");
+	wb_ready = cv_create("wb1-ready");
+	wb_done = sem_create("wb1-done", 0);
+	if (wb_lock == NULL || wb_cv == NULL || wb_ready == NULL ||
+	    wb_done == NULL) {
+		panic("wb1: out of memory\n");
+	}
+	wb_gen = 0;
+	wb_waiting = 0;
+	wb_woken = 0;
+
+	for (i=0; i<wb_nthreads; i++) {
+		result = thread_fork("wb1-waiter", NULL, wb_waiter,
+				     NULL, rounds);
+		if (result) {
+			panic("wb1: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	bcast_ns = 0;
+	total_ns = 0;
+	lock_acquire(wb_lock);
+	for (i=0; i<rounds; i++) {
+		while (wb_waiting < wb_nthreads) {
+			cv_wait(wb_ready, wb_lock);
+		}
+		wb_waiting = 0;
+		wb_woken = 0;
+
+		gettime(&t0);
+		wb_gen++;
+		cv_broadcast(wb_cv, wb_lock);
+		gettime(&t1);
+
+		while (wb_woken < wb_nthreads) {
+			cv_wait(wb_ready, wb_lock);
+		}
+		gettime(&t2);
+
+		bcast_ns += wb_ns(&t0, &t1);
+		total_ns += wb_ns(&t0, &t2);
+	}
+	lock_release(wb_lock);
+
+	for (i=0; i<wb_nthreads; i++) {
+		P(wb_done);
+	}
+
+	kprintf("wb1: cv_broadcast: %llu ns avg; all %u waiters run: "
+		"%llu ns avg\n", bcast_ns / rounds, wb_nthreads,
+		total_ns / rounds);
+
+	lock_destroy(wb_lock);
+	cv_destroy(wb_cv);
+	cv_destroy(wb_ready);
+	sem_destroy(wb_done);
+
+	success(TEST161_SUCCESS, SECRET, "wb1");
+	return 0;
+}
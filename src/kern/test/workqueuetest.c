@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Work queue test.
+ *
+ * Queues items on every CPU and checks that each runs exactly once
+ * and on the CPU it was queued for; checks that a second enqueue of a
+ * pending item fails; runs and cancels delayed work; and runs a
+ * parallel_for that marks each index, then the same marking done by
+ * a parallel_for nested in one per row. Finally it times NCOMPARE
+ * trivial jobs done with thread_fork and with the work queue.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <clock.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <workqueue.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define NPERCPU		32
+#define NINDICES	1000
+#define NROWS		10		/* NINDICES split for nesting */
+#define NCOMPARE	200
+#define DELAY_TICKS	5
+
+struct wq_item {
+	struct work wi_work;
+	unsigned wi_cpu;		/* where it should run */
+	unsigned wi_runs;		/* how often it did */
+	bool wi_wrongcpu;		/* ran somewhere else */
+};
+
+static struct semaphore *wq_done;
+static struct semaphore *wq_gate;
+static volatile uint32_t wq_ranat;
+static unsigned wq_marks[NINDICES];
+static volatile int wq_nesterr;
+
+static
+void
+wq_itemfunc(void *vitem)
+{
+	struct wq_item *wi = vitem;
+
+	wi->wi_runs++;
+	if (curcpu->c_number != wi->wi_cpu) {
+		wi->wi_wrongcpu = true;
+	}
+	V(wq_done);
+}
+
+/* Holds up its CPU's queue until wq_gate is V'd. */
+static
+void
+wq_blocker(void *junk)
+{
+	(void)junk;
+	P(wq_gate);
+	V(wq_done);
+}
+
+static
+void
+wq_delayed(void *junk)
+{
+	(void)junk;
+	wq_ranat = hardclock_ticks;
+	V(wq_done);
+}
+
+static
+void
+wq_mark(void *junk, unsigned i)
+{
+	(void)junk;
+	wq_marks[i]++;
+}
+
+static
+void
+wq_markrow(void *vrow, unsigned i)
+{
+	unsigned *row = vrow;
+
+	row[i]++;
+}
+
+/* Runs in the workers, so the inner calls nest. */
+static
+void
+wq_row(void *junk, unsigned row)
+{
+	int result;
+
+	(void)junk;
+	result = parallel_for(NINDICES / NROWS, wq_markrow,
+			      &wq_marks[row * (NINDICES / NROWS)]);
+	if (result) {
+		wq_nesterr = result;
+	}
+}
+
+static
+bool
+wq_checkmarks(const char *what)
+{
+	unsigned i;
+
+	for (i=0; i<NINDICES; i++) {
+		if (wq_marks[i] != 1) {
+			kprintf_n("wq1: %s: index %u done %u times\n", what,
+				  i, wq_marks[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static
+void
+wq_nothing(void *junk)
+{
+	(void)junk;
+	V(wq_done);
+}
+
+static
+void
+wq_forked(void *junk, unsigned long num)
+{
+	(void)junk;
+	(void)num;
+	V(wq_done);
+}
+
+static
+uint64_t
+wq_ns(const struct timespec *from, const struct timespec *to)
+{
+	struct timespec diff;
+
+	timespec_sub(to, from, &diff);
+	return (uint64_t)diff.tv_sec * 1000000000 + diff.tv_nsec;
+}
+
+int
+workqueuetest(int nargs, char **args)
+{
+	struct wq_item *items, *wi;
+	struct work blocker, delayed, cancelled, *works;
+	struct timespec t0, t1, t2;
+	uint32_t start;
+	unsigned nitems, i;
+	bool status;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting wq1...\n");
+	status = TEST161_SUCCESS;
+
+	wq_done = sem_create("wq1-done", 0);
+	wq_gate = sem_create("wq1-gate", 0);
+	nitems = num_cpus * NPERCPU;
+	items = kmalloc(nitems * sizeof(*items));
+	works = kmalloc(NCOMPARE * sizeof(*works));
+	if (wq_done == NULL || wq_gate == NULL || items == NULL ||
+	    works == NULL) {
+		panic("wq1: out of memory\n");
+	}
+
+	/* Items on every CPU. */
+	for (i=0; i<nitems; i++) {
+		wi = &items[i];
+		work_init(&wi->wi_work, wq_itemfunc, wi);
+		wi->wi_cpu = i % num_cpus;
+		wi->wi_runs = 0;
+		wi->wi_wrongcpu = false;
+		workqueue_enqueue_cpu(&wi->wi_work, wi->wi_cpu);
+	}
+	for (i=0; i<nitems; i++) {
+		P(wq_done);
+	}
+	for (i=0; i<nitems; i++) {
+		if (items[i].wi_runs != 1 || items[i].wi_wrongcpu) {
+			kprintf_n("wq1: item %u ran %u times%s\n", i,
+				  items[i].wi_runs,
+				  items[i].wi_wrongcpu ? " on the wrong cpu" : "");
+			status = TEST161_FAIL;
+		}
+	}
+
+	/* Double enqueue, with the queue held up so the item stays put. */
+	work_init(&blocker, wq_blocker, NULL);
+	wi = &items[0];
+	work_init(&wi->wi_work, wq_itemfunc, wi);
+	wi->wi_cpu = curcpu->c_number;
+	wi->wi_runs = 0;
+	workqueue_enqueue_cpu(&blocker, wi->wi_cpu);
+	if (!workqueue_enqueue_cpu(&wi->wi_work, wi->wi_cpu) ||
+	    workqueue_enqueue_cpu(&wi->wi_work, wi->wi_cpu)) {
+		kprintf_n("wq1: double enqueue not refused\n");
+		status = TEST161_FAIL;
+	}
+	V(wq_gate);
+	P(wq_done);
+	P(wq_done);
+	if (wi->wi_runs != 1) {
+		kprintf_n("wq1: doubly queued item ran %u times\n",
+			  wi->wi_runs);
+		status = TEST161_FAIL;
+	}
+
+	/* Delayed work, and cancelling it. */
+	work_init(&delayed, wq_delayed, NULL);
+	work_init(&cancelled, wq_delayed, NULL);
+	start = hardclock_ticks;
+	workqueue_enqueue_delayed(&delayed, DELAY_TICKS);
+	workqueue_enqueue_delayed(&cancelled, DELAY_TICKS);
+	if (!workqueue_cancel_delayed(&cancelled)) {
+		kprintf_n("wq1: couldn't cancel delayed work\n");
+		status = TEST161_FAIL;
+	}
+	P(wq_done);
+	if ((int32_t)(wq_ranat - start) < DELAY_TICKS) {
+		kprintf_n("wq1: delayed work ran after %d ticks, not %d\n",
+			  (int)(wq_ranat - start), DELAY_TICKS);
+		status = TEST161_FAIL;
+	}
+	thread_sleep_ns(2 * DELAY_TICKS * NS_PER_TICK);
+	if (!workqueue_enqueue_delayed(&cancelled, 1)) {
+		kprintf_n("wq1: cancelled work still pending\n");
+		status = TEST161_FAIL;
+	}
+	P(wq_done);
+
+	/* parallel_for. */
+	for (i=0; i<NINDICES; i++) {
+		wq_marks[i] = 0;
+	}
+	result = parallel_for(NINDICES, wq_mark, NULL);
+	if (result) {
+		kprintf_n("wq1: parallel_for: %s\n", strerror(result));
+		status = TEST161_FAIL;
+	}
+	if (!wq_checkmarks("parallel_for")) {
+		status = TEST161_FAIL;
+	}
+
+	/* Nested parallel_for. */
+	for (i=0; i<NINDICES; i++) {
+		wq_marks[i] = 0;
+	}
+	wq_nesterr = 0;
+	result = parallel_for(NROWS, wq_row, NULL);
+	if (result == 0) {
+		result = wq_nesterr;
+	}
+	if (result) {
+		kprintf_n("wq1: nested parallel_for: %s\n",
+			  strerror(result));
+		status = TEST161_FAIL;
+	}
+	if (!wq_checkmarks("nested parallel_for")) {
+		status = TEST161_FAIL;
+	}
+
+	/* Cost of small jobs: fork a thread each, or queue work. */
+	gettime(&t0);
+	for (i=0; i<NCOMPARE; i++) {
+		result = thread_fork("wq1-job", NULL, wq_forked, NULL, i);
+		if (result) {
+			panic("wq1: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<NCOMPARE; i++) {
+		P(wq_done);
+	}
+	gettime(&t1);
+	for (i=0; i<NCOMPARE; i++) {
+		work_init(&works[i], wq_nothing, NULL);
+		workqueue_enqueue_cpu(&works[i], i % num_cpus);
+	}
+	for (i=0; i<NCOMPARE; i++) {
+		P(wq_done);
+	}
+	gettime(&t2);
+	kprintf_n("wq1: %u jobs: thread_fork %llu ns/job, "
+		  "workqueue %llu ns/job\n", NCOMPARE,
+		  wq_ns(&t0, &t1) / NCOMPARE, wq_ns(&t1, &t2) / NCOMPARE);
+
+	kfree(works);
+	kfree(items);
+	sem_destroy(wq_gate);
+	sem_destroy(wq_done);
+
+	success(status, SECRET, "wq1");
+	return 0;
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Hierarchical timer wheel for callouts.
+ *
+ * There are CALLOUT_LEVELS wheels of CALLOUT_SLOTS slots each. A
+ * callout due within CALLOUT_SLOTS ticks goes on level 0, in the slot
+ * for its expiry tick; one due within CALLOUT_SLOTS^2 ticks goes on
+ * level 1, in the slot for its expiry tick divided by CALLOUT_SLOTS;
+ * and so on. Each time the low bits of the current tick wrap to zero,
+ * the matching slot of the next level up is emptied and its callouts
+ * re-inserted, which moves them down a level ("cascading"). With 4
+ * levels of 64 slots the wheel covers 2^24 ticks (about 46 hours at
+ * HZ=100); anything further out is parked on the top level and
+ * re-parked each time it cascades until it gets close enough.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <clock.h>
+#include <callout.h>
+
+#define CALLOUT_BITS	6
+#define CALLOUT_SLOTS	(1U << CALLOUT_BITS)
+#define CALLOUT_MASK	(CALLOUT_SLOTS - 1)
+#define CALLOUT_LEVELS	4
+
+/* Furthest-out delta the top level can hold. */
+#define CALLOUT_MAXDELTA ((1U << (CALLOUT_BITS * CALLOUT_LEVELS)) - 1)
+
+static struct spinlock callout_lock = SPINLOCK_INITIALIZER;
+static struct callout *callout_wheel[CALLOUT_LEVELS][CALLOUT_SLOTS];
+
+/* The tick most recently processed. Protected by callout_lock. */
+static uint32_t callout_now;
+
+/* The callout whose function is being run, if any. */
+static struct callout *volatile callout_running;
+
+/*
+ * Put a callout on the appropriate wheel slot.
+ */
+static
+void
+callout_insert(struct callout *co)
+{
+	struct callout **head;
+	uint32_t delta, when;
+	unsigned level;
+
+	KASSERT(spinlock_do_i_hold(&callout_lock));
+
+	delta = co->co_expire - callout_now;
+	when = co->co_expire;
+	if (delta > CALLOUT_MAXDELTA) {
+		/* Too far out; park it and look again later. */
+		when = callout_now + CALLOUT_MAXDELTA;
+		delta = CALLOUT_MAXDELTA;
+	}
+
+	for (level = 0; level < CALLOUT_LEVELS - 1; level++) {
+		if (delta < (1U << (CALLOUT_BITS * (level + 1)))) {
+			break;
+		}
+	}
+
+	head = &callout_wheel[level][(when >> (CALLOUT_BITS * level))
+				     & CALLOUT_MASK];
+	co->co_next = *head;
+	co->co_prevp = head;
+	if (*head != NULL) {
+		(*head)->co_prevp = &co->co_next;
+	}
+	*head = co;
+}
+
+/*
+ * Take a callout off whatever slot it's on.
+ */
+static
+void
+callout_unlink(struct callout *co)
+{
+	KASSERT(spinlock_do_i_hold(&callout_lock));
+
+	*co->co_prevp = co->co_next;
+	if (co->co_next != NULL) {
+		co->co_next->co_prevp = co->co_prevp;
+	}
+	co->co_next = NULL;
+	co->co_prevp = NULL;
+}
+
+void
+callout_init(struct callout *co)
+{
+	co->co_next = NULL;
+	co->co_prevp = NULL;
+	co->co_expire = 0;
+	co->co_func = NULL;
+	co->co_arg = NULL;
+	co->co_pending = false;
+}
+
+void
+callout_schedule(struct callout *co, uint32_t ticks,
+		 void (*func)(void *), void *arg)
+{
+	KASSERT(func != NULL);
+
+	if (ticks == 0) {
+		/* The current tick has already been processed. */
+		ticks = 1;
+	}
+
+	spinlock_acquire(&callout_lock);
+	KASSERT(!co->co_pending);
+	co->co_func = func;
+	co->co_arg = arg;
+	co->co_expire = callout_now + ticks;
+	co->co_pending = true;
+	callout_insert(co);
+	spinlock_release(&callout_lock);
+}
+
+bool
+callout_stop(struct callout *co)
+{
+	spinlock_acquire(&callout_lock);
+	if (co->co_pending) {
+		callout_unlink(co);
+		co->co_pending = false;
+		spinlock_release(&callout_lock);
+		return true;
+	}
+
+	/*
+	 * Not pending, but it might be running on CPU 0 right now.
+	 * (It can't be running on *this* CPU: callouts run from the
+	 * timer interrupt, which would have to finish first.) Wait
+	 * for it so the caller can safely throw the callout away.
+	 */
+	while (callout_running == co) {
+		spinlock_release(&callout_lock);
+		while (callout_running == co) {
+			/* spin */
+		}
+		spinlock_acquire(&callout_lock);
+	}
+	spinlock_release(&callout_lock);
+	return false;
+}
+
+/*
+ * Empty slot SLOT of wheel LEVEL and re-insert everything in it.
+ */
+static
+void
+callout_cascade(unsigned level, unsigned slot)
+{
+	struct callout *list, *co;
+
+	list = callout_wheel[level][slot];
+	callout_wheel[level][slot] = NULL;
+	while (list != NULL) {
+		co = list;
+		list = co->co_next;
+		callout_insert(co);
+	}
+}
+
+void
+callout_hardclock(void)
+{
+	struct callout **head, *co;
+	void (*func)(void *);
+	void *arg;
+	unsigned level;
+
+	spinlock_acquire(&callout_lock);
+	callout_now++;
+
+	for (level = 1; level < CALLOUT_LEVELS; level++) {
+		if ((callout_now & ((1U << (CALLOUT_BITS * level)) - 1)) != 0) {
+			break;
+		}
+		callout_cascade(level,
+			(callout_now >> (CALLOUT_BITS * level)) & CALLOUT_MASK);
+	}
+
+	/*
+	 * Run everything due now. Drop the lock around each call so
+	 * the function can schedule or stop callouts; take the first
+	 * entry afresh each time since the list may change meanwhile.
+	 */
+	head = &callout_wheel[0][callout_now & CALLOUT_MASK];
+	while ((co = *head) != NULL) {
+		KASSERT(co->co_expire == callout_now);
+		callout_unlink(co);
+		co->co_pending = false;
+		func = co->co_func;
+		arg = co->co_arg;
+		callout_running = co;
+		spinlock_release(&callout_lock);
+
+		func(arg);
+
+		spinlock_acquire(&callout_lock);
+		callout_running = NULL;
+	}
+	spinlock_release(&callout_lock);
+}
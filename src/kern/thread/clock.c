@@ -29,18 +29,21 @@
 
 #include <types.h>
 #include <lib.h>
+#include <platform/maxcpus.h>
 #include <cpu.h>
 #include <wchan.h>
 #include <clock.h>
+#include <callout.h>
+#include <epoch.h>
 #include <thread.h>
 #include <current.h>
 
 /*
  * Time handling.
  *
- * This is pretty primitive. A real kernel will typically have some
- * kind of support for scheduling callbacks to happen at specific
- * points in the future, usually with more resolution than one second.
+ * Callbacks at specific points in the future are handled by the
+ * callout wheel (callout.c), which hardclock advances on CPU 0; the
+ * resolution is one hardclock.
  *
  * A real kernel also has to maintain the time of day; in OS/161 we
  * skimp on that because we have a known-good hardware clock.
@@ -59,6 +62,40 @@
 static struct wchan *lbolt;
 static struct spinlock lbolt_lock;
 
+/*
+ * Global tick counter. Only CPU 0 writes it, so it needs no lock;
+ * readers on other CPUs may see a value a tick out of date.
+ */
+volatile uint32_t hardclock_ticks;
+
+/*
+ * Threads in thread_sleep_ns sleep here. Nobody wakes the channel as
+ * a whole: each sleeper has its own callout, which wakes only that
+ * thread (see thread_sleep_ns).
+ */
+static struct wchan *sleepers;
+static struct spinlock sleepers_lock;
+
+/*
+ * A thread in thread_sleep_ns. Lives on the sleeper's stack.
+ */
+struct sleeper {
+	struct thread *sl_thread;
+	bool sl_done;
+};
+
+/*
+ * Timer interrupt latency, in cycles. Each CPU only writes its own
+ * entry; print and reset don't lock, so their results are only
+ * approximate while the system is busy.
+ */
+struct hardclock_lat {
+	uint32_t hl_count;
+	uint32_t hl_max;
+	uint64_t hl_total;
+};
+static struct hardclock_lat hardclock_lat[MAXCPUS];
+
 /*
  * Setup.
  */
@@ -70,6 +107,12 @@ hardclock_bootstrap(void)
 	if (lbolt == NULL) {
 		panic("Couldn't create lbolt\n");
 	}
+
+	spinlock_init(&sleepers_lock);
+	sleepers = wchan_create("nanosleep");
+	if (sleepers == NULL) {
+		panic("Couldn't create nanosleep wchan\n");
+	}
 }
 
 /*
@@ -97,13 +140,71 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+	if (curthread->t_epochdepth == 0) {
+		/* We didn't interrupt an epoch read section. */
+		epoch_quiescent();
+	}
+	if (curcpu->c_number == 0) {
+		hardclock_ticks++;
+		callout_hardclock();
+		epoch_hardclock();
+	}
 	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
 		thread_consider_migration();
 	}
 	if ((curcpu->c_hardclocks % SCHEDULE_HARDCLOCKS) == 0) {
 		schedule();
 	}
-	thread_yield();
+	if (curthread->t_epochdepth == 0 && !curcpu->c_insoftirq) {
+		/* Read sections and softirqs aren't preemptible. */
+		thread_yield();
+	}
+}
+
+/*
+ * Record the latency of a timer interrupt. Called at splhigh.
+ */
+void
+hardclock_latency(uint32_t cycles)
+{
+	struct hardclock_lat *hl = &hardclock_lat[curcpu->c_number];
+
+	hl->hl_count++;
+	hl->hl_total += cycles;
+	if (cycles > hl->hl_max) {
+		hl->hl_max = cycles;
+	}
+}
+
+void
+hardclock_latency_print(void)
+{
+	struct hardclock_lat *hl;
+	unsigned i;
+
+	kprintf("Timer interrupt latency (cycles):\n");
+	for (i=0; i<num_cpus; i++) {
+		hl = &hardclock_lat[i];
+		if (hl->hl_count == 0) {
+			continue;
+		}
+		kprintf("cpu%u: %u interrupts, mean %llu, max %u\n", i,
+			hl->hl_count,
+			(unsigned long long)(hl->hl_total / hl->hl_count),
+			hl->hl_max);
+	}
+}
+
+void
+hardclock_latency_reset(void)
+{
+	unsigned i;
+
+	for (i=0; i<num_cpus; i++) {
+		hardclock_lat[i].hl_count = 0;
+		hardclock_lat[i].hl_total = 0;
+		hardclock_lat[i].hl_max = 0;
+	}
 }
 
 /*
@@ -119,3 +220,70 @@ clocksleep(int num_secs)
 	}
 	spinlock_release(&lbolt_lock);
 }
+
+/*
+ * Convert nanoseconds to hardclock ticks, rounding up so that a
+ * timeout never expires early. Saturates rather than wrapping.
+ */
+uint32_t
+ns_to_ticks(uint64_t ns)
+{
+	uint64_t ticks;
+
+	ticks = DIVROUNDUP(ns, NS_PER_TICK);
+	if (ticks > 0x7fffffff) {
+		ticks = 0x7fffffff;
+	}
+	return ticks;
+}
+
+/*
+ * Callout function for thread_sleep_ns: wake the one sleeper. It's
+ * on the channel, because the callout was scheduled with
+ * sleepers_lock held before it went to sleep, and nothing else wakes
+ * threads there.
+ */
+static
+void
+thread_sleep_expire(void *arg)
+{
+	struct sleeper *sl = arg;
+
+	spinlock_acquire(&sleepers_lock);
+	sl->sl_done = true;
+	wchan_wakethread(sleepers, &sleepers_lock, sl->sl_thread);
+	spinlock_release(&sleepers_lock);
+}
+
+/*
+ * Suspend execution for NS nanoseconds, rounded up to whole ticks.
+ *
+ * Each sleeper schedules its own callout, so a wakeup costs the same
+ * however many other threads are asleep.
+ */
+void
+thread_sleep_ns(uint64_t ns)
+{
+	struct sleeper sl;
+	struct callout co;
+	uint32_t ticks;
+
+	ticks = ns_to_ticks(ns);
+	if (ticks == 0) {
+		return;
+	}
+
+	sl.sl_thread = curthread;
+	sl.sl_done = false;
+	callout_init(&co);
+
+	spinlock_acquire(&sleepers_lock);
+	callout_schedule(&co, ticks, thread_sleep_expire, &sl);
+	while (!sl.sl_done) {
+		wchan_sleep(sleepers, &sleepers_lock);
+	}
+	spinlock_release(&sleepers_lock);
+
+	/* The callout may not have quite returned yet; wait for it. */
+	callout_stop(&co);
+}
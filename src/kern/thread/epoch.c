@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Epoch-based deferred reclamation. See epoch.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <membar.h>
+#include <thread.h>
+#include <current.h>
+#include <clock.h>
+#include <epoch.h>
+
+/* Per-CPU state: the last epoch this CPU has been quiescent in. */
+struct epoch_cpu {
+	volatile uint32_t ep_seen;
+	struct epoch_cpu *ep_next;
+};
+
+/*
+ * epoch_current moves forward whenever a writer needs a grace period.
+ * The grace period for value E is over once every CPU's ep_seen has
+ * reached E, since each CPU set ep_seen at a quiescent point after E
+ * was made current (and after whatever the writer unlinked before
+ * advancing it was gone).
+ *
+ * epoch_lock protects advancing epoch_current, the CPU list, and the
+ * list of deferred calls, which is in epoch order.
+ */
+static struct spinlock epoch_lock = SPINLOCK_INITIALIZER;
+static volatile uint32_t epoch_current = 1;
+static struct epoch_cpu *epoch_cpus;
+static struct epoch_cb *epoch_pending;
+static struct epoch_cb **epoch_pendingtail = &epoch_pending;
+
+struct epoch_cpu *
+epoch_cpu_create(void)
+{
+	struct epoch_cpu *ep;
+
+	ep = kmalloc(sizeof(*ep));
+	if (ep == NULL) {
+		return NULL;
+	}
+
+	spinlock_acquire(&epoch_lock);
+	ep->ep_seen = epoch_current;
+	ep->ep_next = epoch_cpus;
+	epoch_cpus = ep;
+	spinlock_release(&epoch_lock);
+
+	return ep;
+}
+
+void
+epoch_enter(void)
+{
+	curthread->t_epochdepth++;
+}
+
+void
+epoch_exit(void)
+{
+	KASSERT(curthread->t_epochdepth > 0);
+	curthread->t_epochdepth--;
+}
+
+void
+epoch_quiescent(void)
+{
+	struct epoch_cpu *ep;
+
+	KASSERT(curthread->t_epochdepth == 0);
+
+	ep = curcpu->c_epoch;
+	if (ep == NULL) {
+		/* Too early in cpu_create. */
+		return;
+	}
+
+	/* Everything read in earlier sections is done with. */
+	membar_any_any();
+	ep->ep_seen = epoch_current;
+}
+
+/*
+ * Start a new grace period and return its epoch. Call with
+ * epoch_lock held, after unlinking whatever is to be freed.
+ */
+static
+uint32_t
+epoch_advance(void)
+{
+	KASSERT(spinlock_do_i_hold(&epoch_lock));
+
+	membar_any_any();
+	return ++epoch_current;
+}
+
+/*
+ * Check if the grace period for epoch E is over. Call with
+ * epoch_lock held.
+ */
+static
+bool
+epoch_passed(uint32_t e)
+{
+	struct epoch_cpu *ep;
+
+	KASSERT(spinlock_do_i_hold(&epoch_lock));
+
+	for (ep = epoch_cpus; ep != NULL; ep = ep->ep_next) {
+		if ((int32_t)(ep->ep_seen - e) < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+epoch_synchronize(void)
+{
+	uint32_t target;
+	bool done;
+
+	KASSERT(curthread->t_epochdepth == 0);
+	KASSERT(curthread->t_in_interrupt == false);
+
+	spinlock_acquire(&epoch_lock);
+	target = epoch_advance();
+	spinlock_release(&epoch_lock);
+
+	/* We aren't in a read section, so this CPU needn't wait. */
+	epoch_quiescent();
+
+	while (1) {
+		spinlock_acquire(&epoch_lock);
+		done = epoch_passed(target);
+		spinlock_release(&epoch_lock);
+		if (done) {
+			break;
+		}
+		thread_sleep_ns(NS_PER_TICK);
+	}
+}
+
+void
+epoch_defer(struct epoch_cb *cb, void (*func)(void *), void *arg)
+{
+	cb->ec_next = NULL;
+	cb->ec_func = func;
+	cb->ec_arg = arg;
+
+	spinlock_acquire(&epoch_lock);
+	cb->ec_epoch = epoch_advance();
+	*epoch_pendingtail = cb;
+	epoch_pendingtail = &cb->ec_next;
+	spinlock_release(&epoch_lock);
+}
+
+void
+epoch_hardclock(void)
+{
+	struct epoch_cb *done, **donetail, *cb;
+
+	done = NULL;
+	donetail = &done;
+
+	spinlock_acquire(&epoch_lock);
+	while (epoch_pending != NULL && epoch_passed(epoch_pending->ec_epoch)) {
+		cb = epoch_pending;
+		epoch_pending = cb->ec_next;
+		cb->ec_next = NULL;
+		*donetail = cb;
+		donetail = &cb->ec_next;
+	}
+	if (epoch_pending == NULL) {
+		epoch_pendingtail = &epoch_pending;
+	}
+	spinlock_release(&epoch_lock);
+
+	/* The functions may well free CB, so get the next one first. */
+	while (done != NULL) {
+		cb = done;
+		done = cb->ec_next;
+		cb->ec_func(cb->ec_arg);
+	}
+}
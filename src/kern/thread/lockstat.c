@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Lock contention statistics. See lockstat.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <membar.h>
+#include <current.h>
+#include <lockstat.h>
+
+/* Per-site counters, one set per CPU. */
+struct lockstat_rec {
+	uint32_t lr_acquires;		/* times acquired */
+	uint32_t lr_contended;		/* times we had to wait */
+	uint32_t lr_releases;		/* times released */
+	uint32_t lr_maxwait;		/* longest single wait */
+	uint64_t lr_waittime;		/* total wait */
+	uint64_t lr_holdtime;		/* total hold */
+};
+
+struct lockstat_cpu {
+	struct lockstat_rec lc_recs[LOCKSTAT_NSITES];
+	struct lockstat_cpu *lc_next;
+};
+
+/* Sites registered after the table fills up all land here. */
+#define LOCKSTAT_OVERFLOW  (LOCKSTAT_NSITES - 1)
+
+/*
+ * The site table and the list of per-CPU tables. Both only ever grow,
+ * so anything below a value of lockstat_nsites read under the lock,
+ * or on a list read under the lock, can be looked at afterwards
+ * without it.
+ *
+ * The lock can't be a struct spinlock, because spinlocks call in
+ * here; it's a bare spinlock word taken with interrupts off.
+ */
+static volatile spinlock_data_t lockstat_lock = SPINLOCK_DATA_INITIALIZER;
+static const char *lockstat_kinds[LOCKSTAT_NSITES];
+static char lockstat_names[LOCKSTAT_NSITES][LOCKSTAT_NAMELEN];
+static unsigned lockstat_nsites = 1;	/* 0 is LOCKSTAT_NOSITE */
+static struct lockstat_cpu *lockstat_cpus;
+
+static
+int
+lockstat_lock_acquire(void)
+{
+	int s;
+
+	s = splhigh();
+	while (spinlock_data_testandset(&lockstat_lock) != 0) {
+		/* spin */
+	}
+	membar_any_any();
+	return s;
+}
+
+static
+void
+lockstat_lock_release(int s)
+{
+	membar_any_any();
+	spinlock_data_set(&lockstat_lock, 0);
+	splx(s);
+}
+
+/*
+ * Cycles from THEN to NOW. A thread that moved to another CPU while
+ * waiting or holding a lock reads a different CPU's clock at each
+ * end; they can be up to a tick apart, and if that makes the interval
+ * come out negative, call it zero.
+ */
+static
+uint32_t
+lockstat_elapsed(uint32_t then, uint32_t now)
+{
+	uint32_t diff;
+
+	diff = now - then;
+	return diff > 0x7fffffff ? 0 : diff;
+}
+
+struct lockstat_cpu *
+lockstat_cpu_create(void)
+{
+	struct lockstat_cpu *lc;
+	int s;
+
+	lc = kmalloc(sizeof(*lc));
+	if (lc == NULL) {
+		return NULL;
+	}
+	bzero(lc->lc_recs, sizeof(lc->lc_recs));
+
+	s = lockstat_lock_acquire();
+	lc->lc_next = lockstat_cpus;
+	lockstat_cpus = lc;
+	lockstat_lock_release(s);
+
+	return lc;
+}
+
+unsigned
+lockstat_register(const char *kind, const char *name)
+{
+	char buf[LOCKSTAT_NAMELEN];
+	const char *slash;
+	unsigned site;
+	size_t len;
+	int s;
+
+	if (name == NULL) {
+		name = "(unnamed)";
+	}
+
+	/* Spinlock sites are source paths; keep just the file name. */
+	slash = strrchr(name, '/');
+	if (slash != NULL) {
+		name = slash + 1;
+	}
+
+	len = strlen(name);
+	if (len >= LOCKSTAT_NAMELEN) {
+		len = LOCKSTAT_NAMELEN - 1;
+	}
+	memcpy(buf, name, len);
+	buf[len] = 0;
+
+	s = lockstat_lock_acquire();
+	for (site = 1; site < lockstat_nsites; site++) {
+		if (!strcmp(lockstat_kinds[site], kind) &&
+		    !strcmp(lockstat_names[site], buf)) {
+			break;
+		}
+	}
+	if (site == lockstat_nsites) {
+		if (lockstat_nsites < LOCKSTAT_OVERFLOW) {
+			lockstat_kinds[site] = kind;
+			strcpy(lockstat_names[site], buf);
+			lockstat_nsites++;
+		}
+		else {
+			site = LOCKSTAT_OVERFLOW;
+		}
+	}
+	lockstat_lock_release(s);
+
+	return site;
+}
+
+uint32_t
+lockstat_now(void)
+{
+	return cpu_cycles();
+}
+
+/*
+ * The counters are only touched by their own CPU; turning interrupts
+ * off keeps both interrupt handlers and migration away while we do.
+ */
+uint32_t
+lockstat_acquired(unsigned site, bool contended, uint32_t start)
+{
+	struct lockstat_rec *lr;
+	uint32_t now, wait;
+	int s;
+
+	KASSERT(site != LOCKSTAT_NOSITE && site < LOCKSTAT_NSITES);
+
+	now = cpu_cycles();
+
+	s = splhigh();
+	if (curcpu->c_lockstat != NULL) {
+		lr = &curcpu->c_lockstat->lc_recs[site];
+		lr->lr_acquires++;
+		if (contended) {
+			wait = lockstat_elapsed(start, now);
+			lr->lr_contended++;
+			lr->lr_waittime += wait;
+			if (wait > lr->lr_maxwait) {
+				lr->lr_maxwait = wait;
+			}
+		}
+	}
+	splx(s);
+
+	return now;
+}
+
+void
+lockstat_released(unsigned site, uint32_t stamp)
+{
+	struct lockstat_rec *lr;
+	uint32_t now;
+	int s;
+
+	KASSERT(site != LOCKSTAT_NOSITE && site < LOCKSTAT_NSITES);
+
+	now = cpu_cycles();
+
+	s = splhigh();
+	if (curcpu->c_lockstat != NULL) {
+		lr = &curcpu->c_lockstat->lc_recs[site];
+		lr->lr_releases++;
+		lr->lr_holdtime += lockstat_elapsed(stamp, now);
+	}
+	splx(s);
+}
+
+/*
+ * Print the MAX sites with the most contended acquisitions, ties
+ * broken by total wait. The per-CPU counters are read without
+ * stopping anyone, so the totals are only a snapshot.
+ */
+void
+lockstat_print(unsigned max)
+{
+	struct lockstat_rec *totals, *lr, *tot;
+	struct lockstat_cpu *lc, *cpus;
+	unsigned *order;
+	unsigned nsites, nshown, site, i, j;
+	const char *name;
+	int s;
+
+	totals = kmalloc(LOCKSTAT_NSITES * sizeof(*totals));
+	order = kmalloc(LOCKSTAT_NSITES * sizeof(*order));
+	if (totals == NULL || order == NULL) {
+		kprintf("lockstat: Out of memory\n");
+		kfree(totals);
+		kfree(order);
+		return;
+	}
+	bzero(totals, LOCKSTAT_NSITES * sizeof(*totals));
+
+	s = lockstat_lock_acquire();
+	nsites = lockstat_nsites;
+	cpus = lockstat_cpus;
+	lockstat_lock_release(s);
+
+	for (lc = cpus; lc != NULL; lc = lc->lc_next) {
+		for (site = 1; site < LOCKSTAT_NSITES; site++) {
+			lr = &lc->lc_recs[site];
+			tot = &totals[site];
+			tot->lr_acquires += lr->lr_acquires;
+			tot->lr_contended += lr->lr_contended;
+			tot->lr_releases += lr->lr_releases;
+			tot->lr_waittime += lr->lr_waittime;
+			tot->lr_holdtime += lr->lr_holdtime;
+			if (lr->lr_maxwait > tot->lr_maxwait) {
+				tot->lr_maxwait = lr->lr_maxwait;
+			}
+		}
+	}
+
+	/* Insertion sort of the sites that have been used at all. */
+	nshown = 0;
+	for (site = 1; site < LOCKSTAT_NSITES; site++) {
+		if (site >= nsites && site != LOCKSTAT_OVERFLOW) {
+			continue;
+		}
+		tot = &totals[site];
+		if (tot->lr_acquires == 0) {
+			continue;
+		}
+		for (i = nshown; i > 0; i--) {
+			lr = &totals[order[i-1]];
+			if (lr->lr_contended > tot->lr_contended ||
+			    (lr->lr_contended == tot->lr_contended &&
+			     lr->lr_waittime >= tot->lr_waittime)) {
+				break;
+			}
+			order[i] = order[i-1];
+		}
+		order[i] = site;
+		nshown++;
+	}
+
+	kprintf("%-31s %-8s %10s %10s %12s %10s %10s\n",
+		"site", "kind", "acquires", "contended",
+		"wait", "maxwait", "avghold");
+	for (j = 0; j < nshown && j < max; j++) {
+		site = order[j];
+		tot = &totals[site];
+		name = site == LOCKSTAT_OVERFLOW ?
+			"(other)" : lockstat_names[site];
+		kprintf("%-31s %-8s %10u %10u %12llu %10u %10llu\n",
+			name,
+			site == LOCKSTAT_OVERFLOW ? "-" : lockstat_kinds[site],
+			tot->lr_acquires, tot->lr_contended,
+			(unsigned long long)tot->lr_waittime,
+			tot->lr_maxwait,
+			tot->lr_releases == 0 ? 0ULL :
+			(unsigned long long)(tot->lr_holdtime /
+					     tot->lr_releases));
+	}
+	kprintf("(times in cycles; %u of %u sites shown)\n",
+		j, nshown);
+
+	kfree(totals);
+	kfree(order);
+}
+
+/*
+ * Zero everything. Other CPUs may be counting at the same time, so a
+ * count or two can survive the reset; that's fine for statistics.
+ */
+void
+lockstat_reset(void)
+{
+	struct lockstat_cpu *lc, *cpus;
+	int s;
+
+	s = lockstat_lock_acquire();
+	cpus = lockstat_cpus;
+	lockstat_lock_release(s);
+
+	for (lc = cpus; lc != NULL; lc = lc->lc_next) {
+		bzero(lc->lc_recs, sizeof(lc->lc_recs));
+	}
+}
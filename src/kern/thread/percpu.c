@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Per-CPU counters. See percpu.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spl.h>
+#include <membar.h>
+#include <cpu.h>
+#include <current.h>
+#include <percpu.h>
+
+/*
+ * Add to the counter. Interrupts are off across the update so we
+ * can't be preempted and moved to another CPU between reading and
+ * writing our slot. Before curcpu is set up there's only the boot
+ * CPU, which is number 0.
+ */
+void
+percpu_counter_add(struct percpu_counter *pc, int32_t delta)
+{
+	unsigned num;
+	int spl;
+
+	spl = splhigh();
+	num = CURCPU_EXISTS() ? curcpu->c_number : 0;
+	KASSERT(num < MAXCPUS);
+	pc->pc_slots[num].ps_val += delta;
+	splx(spl);
+}
+
+/*
+ * Sum the slots.
+ */
+int32_t
+percpu_counter_read(struct percpu_counter *pc)
+{
+	int32_t sum;
+	unsigned i;
+
+	membar_load_load();
+	sum = 0;
+	for (i=0; i<MAXCPUS; i++) {
+		sum += pc->pc_slots[i].ps_val;
+	}
+	return sum;
+}
+
+/*
+ * Set the counter, by putting the whole value in slot 0.
+ */
+void
+percpu_counter_set(struct percpu_counter *pc, int32_t val)
+{
+	unsigned i;
+
+	pc->pc_slots[0].ps_val = val;
+	for (i=1; i<MAXCPUS; i++) {
+		pc->pc_slots[i].ps_val = 0;
+	}
+	membar_store_store();
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Softirqs. See softirq.h.
+ *
+ * Each CPU's queue is a singly linked list hanging off its struct
+ * cpu. Only that CPU touches it, and only with interrupts off, so it
+ * doesn't need a lock.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spl.h>
+#include <atomic.h>
+#include <thread.h>
+#include <current.h>
+#include <softirq.h>
+
+/*
+ * Set up a softirq.
+ */
+void
+softirq_init(struct softirq *si, void (*func)(void *), void *arg)
+{
+	si->si_next = NULL;
+	si->si_func = func;
+	si->si_arg = arg;
+	atomic_store(&si->si_pending, 0);
+}
+
+/*
+ * Set up a CPU's queue.
+ */
+void
+softirq_cpu_init(struct cpu *c)
+{
+	c->c_softirqs = NULL;
+	c->c_softirqs_tail = &c->c_softirqs;
+	c->c_insoftirq = false;
+}
+
+/*
+ * Queue a softirq on the current CPU.
+ *
+ * If we're at spl0 this runs it before returning, because lowering
+ * the spl again runs anything pending.
+ */
+bool
+softirq_schedule(struct softirq *si)
+{
+	struct cpu *c;
+	int s;
+
+	if (!atomic_cas(&si->si_pending, 0, 1)) {
+		return false;
+	}
+
+	s = splhigh();
+	c = curcpu->c_self;
+	si->si_next = NULL;
+	*c->c_softirqs_tail = si;
+	c->c_softirqs_tail = &si->si_next;
+	splx(s);
+
+	return true;
+}
+
+/*
+ * Run the current CPU's pending softirqs, including any scheduled by
+ * interrupts that come in while we're at it.
+ *
+ * c_insoftirq keeps an interrupt that arrives while a softirq is
+ * running from starting the queue over underneath it, and tells
+ * hardclock not to switch threads, so we can't change CPUs partway
+ * through. t_in_interrupt makes wchan_sleep complain if a softirq
+ * tries to sleep.
+ */
+void
+softirq_run(bool irqon)
+{
+	struct thread *cur = curthread;
+	struct cpu *c = curcpu->c_self;
+	struct softirq *si;
+	bool old_in;
+
+	KASSERT(cur->t_curspl > 0);
+
+	if (c->c_insoftirq) {
+		return;
+	}
+	c->c_insoftirq = true;
+	old_in = cur->t_in_interrupt;
+	cur->t_in_interrupt = true;
+
+	while ((si = c->c_softirqs) != NULL) {
+		c->c_softirqs = si->si_next;
+		if (c->c_softirqs == NULL) {
+			c->c_softirqs_tail = &c->c_softirqs;
+		}
+		si->si_next = NULL;
+		atomic_store(&si->si_pending, 0);
+
+		if (irqon) {
+			spl0();
+		}
+		si->si_func(si->si_arg);
+		if (irqon) {
+			splhigh();
+		}
+		KASSERT(cur->t_curspl > 0);
+	}
+
+	cur->t_in_interrupt = old_in;
+	c->c_insoftirq = false;
+}
@@ -30,6 +30,7 @@
 /* Make sure to build out-of-line versions of inline functions */
 #define SPINLOCK_INLINE   /* empty */
 #define MEMBAR_INLINE     /* empty */
+#define ATOMIC_INLINE     /* empty */
 
 #include <types.h>
 #include <lib.h>
@@ -37,6 +38,7 @@
 #include <spl.h>
 #include <spinlock.h>
 #include <membar.h>
+#include <atomic.h>
 #include <current.h>	/* for curcpu */
 
 /*
@@ -47,11 +49,22 @@
 /*
  * Initialize spinlock.
  */
+#if OPT_LOCKSTAT
+void
+spinlock_init_at(struct spinlock *splk, const char *site)
+#else
 void
 spinlock_init(struct spinlock *splk)
+#endif
 {
-	spinlock_data_set(&splk->splk_lock, 0);
+	spinlock_data_set(&splk->splk_next, 0);
+	spinlock_data_set(&splk->splk_owner, 0);
 	splk->splk_holder = NULL;
+#if OPT_LOCKSTAT
+	splk->splk_site = site;
+	splk->splk_stat = LOCKSTAT_NOSITE;
+	splk->splk_stamp = 0;
+#endif
 }
 
 /*
@@ -61,7 +74,8 @@ void
 spinlock_cleanup(struct spinlock *splk)
 {
 	KASSERT(splk->splk_holder == NULL);
-	KASSERT(spinlock_data_get(&splk->splk_lock) == 0);
+	KASSERT(spinlock_data_get(&splk->splk_next) ==
+		spinlock_data_get(&splk->splk_owner));
 }
 
 /*
@@ -69,12 +83,17 @@ spinlock_cleanup(struct spinlock *splk)
  *
  * First disable interrupts (otherwise, if we get a timer interrupt we
  * might come back to this lock and deadlock), then use a machine-level
- * atomic operation to wait for the lock to be free.
+ * atomic operation to take a ticket, and wait for our turn.
  */
 void
 spinlock_acquire(struct spinlock *splk)
 {
 	struct cpu *mycpu;
+	spinlock_data_t ticket;
+#if OPT_LOCKSTAT
+	uint32_t start;
+	bool contended;
+#endif
 
 	splraise(IPL_NONE, IPL_HIGH);
 
@@ -90,28 +109,41 @@ spinlock_acquire(struct spinlock *splk)
 		mycpu = NULL;
 	}
 
-	while (1) {
-		/*
-		 * Do test-test-and-set, that is, read first before
-		 * doing test-and-set, to reduce bus contention.
-		 *
-		 * Test-and-set is a machine-level atomic operation
-		 * that writes 1 into the lock word and returns the
-		 * previous value. If that value was 0, the lock was
-		 * previously unheld and we now own it. If it was 1,
-		 * we don't.
-		 */
-		if (spinlock_data_get(&splk->splk_lock) != 0) {
-			continue;
-		}
-		if (spinlock_data_testandset(&splk->splk_lock) != 0) {
-			continue;
-		}
-		break;
+	/*
+	 * Fetch-and-add is the only atomic operation needed; after
+	 * that we just read splk_owner until it's our number. The
+	 * counters wrap harmlessly as long as there are fewer than
+	 * 2^32 CPUs waiting.
+	 */
+#if OPT_LOCKSTAT
+	start = lockstat_now();
+#endif
+	ticket = spinlock_data_fetchadd(&splk->splk_next, 1);
+#if OPT_LOCKSTAT
+	contended = spinlock_data_get(&splk->splk_owner) != ticket;
+#endif
+	while (spinlock_data_get(&splk->splk_owner) != ticket) {
+		/* spin */
 	}
 
 	membar_store_any();
 	splk->splk_holder = mycpu;
+
+#if OPT_LOCKSTAT
+	/*
+	 * Static spinlocks never see spinlock_init, so look up the
+	 * site on first use rather than at init time. We hold the
+	 * lock, so nobody else is doing this at the same time.
+	 */
+	if (mycpu != NULL) {
+		if (splk->splk_stat == LOCKSTAT_NOSITE) {
+			splk->splk_stat = lockstat_register("spinlock",
+							    splk->splk_site);
+		}
+		splk->splk_stamp = lockstat_acquired(splk->splk_stat,
+						     contended, start);
+	}
+#endif
 }
 
 /*
@@ -125,11 +157,17 @@ spinlock_release(struct spinlock *splk)
 		KASSERT(splk->splk_holder == curcpu->c_self);
 		KASSERT(curcpu->c_spinlocks > 0);
 		curcpu->c_spinlocks--;
+#if OPT_LOCKSTAT
+		if (splk->splk_stat != LOCKSTAT_NOSITE) {
+			lockstat_released(splk->splk_stat, splk->splk_stamp);
+		}
+#endif
 	}
 
 	splk->splk_holder = NULL;
 	membar_any_store();
-	spinlock_data_set(&splk->splk_lock, 0);
+	spinlock_data_set(&splk->splk_owner,
+			  spinlock_data_get(&splk->splk_owner) + 1);
 	spllower(IPL_HIGH, IPL_NONE);
 }
 
@@ -36,6 +36,7 @@
 #include <spl.h>
 #include <thread.h>
 #include <current.h>
+#include <softirq.h>
 
 /*
  * Machine-independent interrupt handling functions.
@@ -120,6 +121,28 @@ spllower(int oldspl, int newspl)
 	cur->t_iplhigh_count--;
 	if (cur->t_iplhigh_count == 0) {
 		cpu_irqon();
+
+		/*
+		 * Back at spl0 in thread context: run any softirqs an
+		 * interrupt queued while we had interrupts off, until
+		 * there are none left. Raise and lower the spl by hand
+		 * rather than with splhigh and spl0, or lowering it
+		 * again would come back in here, a stack frame deeper
+		 * for every softirq raised while we were draining.
+		 * (Inside softirq_run t_in_interrupt is set, so its own
+		 * spl0 calls don't drain either.)
+		 */
+		while (cur->t_curspl == 0 && !cur->t_in_interrupt &&
+		       curcpu->c_softirqs != NULL) {
+			cpu_irqoff();
+			cur->t_iplhigh_count++;
+			cur->t_curspl = IPL_HIGH;
+			softirq_run(true);
+			cur->t_curspl = IPL_NONE;
+			cur->t_iplhigh_count--;
+			KASSERT(cur->t_iplhigh_count == 0);
+			cpu_irqon();
+		}
 	}
 }
 
@@ -33,11 +33,15 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <spinlock.h>
+#include <membar.h>
 #include <wchan.h>
 #include <thread.h>
+#include <cpu.h>
 #include <current.h>
+#include <clock.h>
 #include <synch.h>
 
 ////////////////////////////////////////////////////////////
@@ -120,6 +124,32 @@ P(struct semaphore *sem)
 	spinlock_release(&sem->sem_lock);
 }
 
+int
+sem_timedP(struct semaphore *sem, uint64_t ns)
+{
+	uint32_t deadline;
+	int32_t left;
+
+	KASSERT(sem != NULL);
+	KASSERT(curthread->t_in_interrupt == false);
+
+	deadline = hardclock_ticks + ns_to_ticks(ns);
+
+	spinlock_acquire(&sem->sem_lock);
+	while (sem->sem_count == 0) {
+		left = (int32_t)(deadline - hardclock_ticks);
+		if (left <= 0) {
+			spinlock_release(&sem->sem_lock);
+			return ETIMEDOUT;
+		}
+		wchan_sleep_timeout(sem->sem_wchan, &sem->sem_lock, left);
+	}
+	KASSERT(sem->sem_count > 0);
+	sem->sem_count--;
+	spinlock_release(&sem->sem_lock);
+	return 0;
+}
+
 void
 V(struct semaphore *sem)
 {
@@ -138,6 +168,90 @@ V(struct semaphore *sem)
 //
 // Lock.
 
+/*
+ * Priority inheritance.
+ *
+ * A thread waiting in lock_acquire donates its effective priority to
+ * the lock's holder; if the holder is itself waiting for another lock
+ * the donation continues down the chain. When a thread releases a
+ * lock it drops back to the highest of its base priority and the
+ * waiters of the locks it still holds.
+ *
+ * thread_priority_lock is global, so it's kept off the uncontended
+ * path: a donation only ever reaches a lock through a thread blocked
+ * on it, so while a lock's lk_nblocked is 0 nobody else looks at its
+ * holder, and taking or releasing it only needs lk_lock. Otherwise
+ * the priority fields of threads and locks, lk_holderthread included,
+ * are only changed with thread_priority_lock held. Lock order is
+ * lk_lock, then thread_priority_lock, then the run queue locks.
+ */
+
+/*
+ * Donate priority PRI through LOCK. Stops at the first holder that
+ * is already running at PRI or better; everything further down the
+ * chain has been boosted at least that far already. (This also makes
+ * a deadlock cycle terminate.)
+ */
+static
+void
+lock_donate(struct lock *lock, int pri)
+{
+	struct thread *holder;
+
+	KASSERT(spinlock_do_i_hold(&thread_priority_lock));
+
+	while (lock != NULL) {
+		if (lock->lk_maxwaitprio < pri) {
+			lock->lk_maxwaitprio = pri;
+		}
+		holder = (struct thread *)lock->lk_holderthread;
+		if (holder == NULL || holder->t_priority >= pri) {
+			break;
+		}
+		holder->t_priority = pri;
+		if (holder->t_state == S_READY) {
+			/* Don't wait for schedule() to move it up. */
+			thread_priority_raised(holder);
+		}
+		lock = holder->t_blockedon;
+	}
+}
+
+/*
+ * Remove LOCK from T's list of held locks.
+ */
+static
+void
+lock_unlink_held(struct thread *t, struct lock *lock)
+{
+	struct lock **lkp;
+
+	KASSERT(t == curthread);
+
+	for (lkp = &t->t_heldlocks; *lkp != lock; lkp = &(*lkp)->lk_nextheld) {
+		KASSERT(*lkp != NULL);
+	}
+	*lkp = lock->lk_nextheld;
+	lock->lk_nextheld = NULL;
+}
+
+int
+lock_heldpriority(const struct thread *t)
+{
+	struct lock *lk;
+	int pri;
+
+	KASSERT(spinlock_do_i_hold(&thread_priority_lock));
+
+	pri = -1;
+	for (lk = t->t_heldlocks; lk != NULL; lk = lk->lk_nextheld) {
+		if (lk->lk_maxwaitprio > pri) {
+			pri = lk->lk_maxwaitprio;
+		}
+	}
+	return pri;
+}
+
 struct lock *
 lock_create(const char *name)
 {
@@ -166,6 +280,13 @@ lock_create(const char *name)
 	spinlock_init(&lock->lk_lock);
 	lock->lk_locked = false;
 	lock->lk_holderthread = NULL ;
+	lock->lk_maxwaitprio = -1;
+	lock->lk_nblocked = 0;
+	lock->lk_nextheld = NULL;
+#if OPT_LOCKSTAT
+	lock->lk_stat = lockstat_register("lock", name);
+	lock->lk_stamp = 0;
+#endif
 
 	return lock;
 }
@@ -188,24 +309,111 @@ lock_destroy(struct lock *lock)
 	kfree(lock); 
 }
 
+/*
+ * Adaptive spinning. If the holder of a lock we want is running on
+ * another CPU it will probably release the lock before we could get
+ * through a sleep and wakeup, so poll the lock for a while first.
+ * Sleep once the holder isn't running or we've polled lock_spinlimit
+ * times in total.
+ */
+int lock_spinlimit = LOCK_SPINLIMIT;
+
+/*
+ * Poll LOCK until it's free or BUDGET polls are used up. Call without
+ * lk_lock held. Returns the number of polls made.
+ */
+static
+int
+lock_spin(struct lock *lock, int budget)
+{
+	int i;
+
+	for (i=0; i<budget && lock->lk_locked; i++) {
+		/* spin */
+	}
+	return i;
+}
+
 void
 lock_acquire(struct lock *lock)
 {
+	int spins;
+#if OPT_LOCKSTAT
+	uint32_t start;
+	bool contended;
+#endif
+
 	// Write this
   	KASSERT(lock != NULL);
 	KASSERT(curthread->t_in_interrupt == false);
 
+#if OPT_LOCKSTAT
+	start = lockstat_now();
+#endif
 	spinlock_acquire(&lock->lk_lock);
+#if OPT_LOCKSTAT
+	contended = lock->lk_locked;
+#endif
 
+	spins = 0;
 	while ( lock->lk_locked ) {
 
+			/*
+			 * The holder can't go away while it holds the
+			 * lock, and we hold lk_lock, so it's safe to
+			 * look at it here (but not while spinning).
+			 */
+			if (spins < lock_spinlimit &&
+			    thread_oncpu((struct thread *)lock->lk_holderthread)) {
+				spinlock_release(&lock->lk_lock);
+				spins += lock_spin(lock, lock_spinlimit - spins);
+				spinlock_acquire(&lock->lk_lock);
+				continue;
+			}
+
+			spinlock_acquire(&thread_priority_lock);
+			if (curthread->t_blockedon == NULL) {
+				curthread->t_blockedon = lock;
+				lock->lk_nblocked++;
+			}
+			lock_donate(lock, curthread->t_priority);
+			spinlock_release(&thread_priority_lock);
+
 			wchan_sleep(lock->lk_wchan, &lock->lk_lock);
 
 	}
 
 	KASSERT(lock->lk_locked != true);
 	lock->lk_locked = true ;
+#if OPT_LOCKSTAT
+	lock->lk_stamp = lockstat_acquired(lock->lk_stat, contended, start);
+#endif
+	lock->lk_nextheld = curthread->t_heldlocks;
+	curthread->t_heldlocks = lock;
+
+	if (curthread->t_blockedon == NULL && lock->lk_nblocked == 0) {
+		/* Nobody's waiting, so nobody can be donating. */
+		lock->lk_holderthread = curthread;
+		lock->lk_maxwaitprio = -1;
+		spinlock_release(&lock->lk_lock);
+		return;
+	}
+
+	/*
+	 * We're no longer waiting; inherit from whoever still is.
+	 */
+	spinlock_acquire(&thread_priority_lock);
+	if (curthread->t_blockedon != NULL) {
+		KASSERT(curthread->t_blockedon == lock);
+		curthread->t_blockedon = NULL;
+		lock->lk_nblocked--;
+	}
 	lock->lk_holderthread = curthread ;
+	lock->lk_maxwaitprio = wchan_maxpriority(lock->lk_wchan, &lock->lk_lock);
+	if (lock->lk_maxwaitprio > curthread->t_priority) {
+		curthread->t_priority = lock->lk_maxwaitprio;
+	}
+	spinlock_release(&thread_priority_lock);
 
 	spinlock_release(&lock->lk_lock);
 
@@ -215,20 +423,63 @@ lock_acquire(struct lock *lock)
 void
 lock_release(struct lock *lock)
 {
+	int wakepri;
+
 	// Write this
 	KASSERT(lock != NULL);
 	KASSERT( lock->lk_locked );
 
 	spinlock_acquire(&lock->lk_lock);
 
+	wakepri = -1;
 	if( lock_do_i_hold(lock) ) {
+			int pri;
+
+#if OPT_LOCKSTAT
+			lockstat_released(lock->lk_stat, lock->lk_stamp);
+#endif
 			lock->lk_locked = false;
-                        lock->lk_holderthread = NULL;
+			lock_unlink_held(curthread, lock);
+
+			if (lock->lk_nblocked == 0) {
+				/*
+				 * No waiters, so nothing was donated
+				 * through this lock.
+				 */
+				lock->lk_holderthread = NULL;
+				spinlock_release(&lock->lk_lock);
+				return;
+			}
+
+			/* Give back whatever this lock's waiters donated. */
+			spinlock_acquire(&thread_priority_lock);
+			lock->lk_holderthread = NULL;
+			pri = lock_heldpriority(curthread);
+			if (pri < curthread->t_basepriority) {
+				pri = curthread->t_basepriority;
+			}
+			curthread->t_priority = pri;
+			wakepri = wchan_maxpriority(lock->lk_wchan,
+						    &lock->lk_lock);
+			spinlock_release(&thread_priority_lock);
+
 			wchan_wakeone(lock->lk_wchan, &lock->lk_lock);
 	}
 
 	spinlock_release(&lock->lk_lock);
 
+	/*
+	 * If we just woke something more important than us, let it
+	 * have the CPU now, not at the end of our quantum; otherwise
+	 * the priority it donated bought it nothing. Not if we can't
+	 * switch here, though.
+	 */
+	if (wakepri > curthread->t_priority &&
+	    curcpu->c_spinlocks == 0 && curthread->t_epochdepth == 0 &&
+	    !curthread->t_in_interrupt) {
+		thread_yield();
+	}
+
 // 	(void)lock;  // suppress warning until code gets written
 }
 
@@ -277,6 +528,9 @@ cv_create(const char *name)
 	}
 
 	spinlock_init(&cv->cv_lock);  // comment / decomment 
+#if OPT_LOCKSTAT
+	cv->cv_stat = lockstat_register("cv", name);
+#endif
 
 	return cv;
 }
@@ -297,6 +551,10 @@ cv_destroy(struct cv *cv)
 void
 cv_wait(struct cv *cv, struct lock *lock)
 {
+#if OPT_LOCKSTAT
+	uint32_t start;
+#endif
+
 	// Write this
 	KASSERT( cv != NULL );
 	KASSERT( lock != NULL );
@@ -307,11 +565,17 @@ cv_wait(struct cv *cv, struct lock *lock)
 
 	if ( lock_do_i_hold(lock) ){
 
+#if OPT_LOCKSTAT
+                     start = lockstat_now();
+#endif
                      lock_release(lock);
 		     wchan_sleep(cv->cv_wchan, &cv->cv_lock);  // comment / decomment 	
 //                     wchan_sleep(cv->cv_wchan, &lock->lk_lock);
                      spinlock_release(&cv->cv_lock);
                      lock_acquire(lock);
+#if OPT_LOCKSTAT
+                     lockstat_acquired(cv->cv_stat, true, start);
+#endif
 	    	     spinlock_acquire(&cv->cv_lock); 
 
 	}
@@ -322,6 +586,40 @@ cv_wait(struct cv *cv, struct lock *lock)
 //	(void)lock;  // suppress warning until code gets written
 }
 
+/*
+ * As cv_wait, but give up after NS nanoseconds. Like cv_wait this
+ * can return without anyone having signalled, so callers recheck
+ * their condition either way.
+ */
+int
+cv_timedwait(struct cv *cv, struct lock *lock, uint64_t ns)
+{
+	bool expired;
+#if OPT_LOCKSTAT
+	uint32_t start;
+#endif
+
+	KASSERT(cv != NULL);
+	KASSERT(lock != NULL);
+	KASSERT(lock_do_i_hold(lock));
+	KASSERT(curthread->t_in_interrupt == false);
+
+#if OPT_LOCKSTAT
+	start = lockstat_now();
+#endif
+	spinlock_acquire(&cv->cv_lock);
+	lock_release(lock);
+	expired = wchan_sleep_timeout(cv->cv_wchan, &cv->cv_lock,
+				      ns_to_ticks(ns));
+	spinlock_release(&cv->cv_lock);
+	lock_acquire(lock);
+#if OPT_LOCKSTAT
+	lockstat_acquired(cv->cv_stat, true, start);
+#endif
+
+	return expired ? ETIMEDOUT : 0;
+}
+
 void
 cv_signal(struct cv *cv, struct lock *lock)
 {
@@ -375,7 +673,8 @@ cv_broadcast(struct cv *cv, struct lock *lock)
 /// read-write lock
 
 
-struct rwlock * rwlock_create(const char * name )
+struct rwlock *
+rwlock_create(const char *name)
 {
 	struct rwlock *rw;
 
@@ -390,138 +689,284 @@ struct rwlock * rwlock_create(const char * name )
 		return NULL;
 	}
 
-	rw->rw_wchan = wchan_create(rw->rw_name);
-	if (rw->rw_wchan == NULL) {
+	rw->rw_readwchan = wchan_create(rw->rw_name);
+	if (rw->rw_readwchan == NULL) {
 		kfree(rw->rw_name);
 		kfree(rw);
 		return NULL;
 	}
 
-	rw->rw_lock= lock_create(rw->rw_name);
-	if (rw->rw_lock == NULL) {
-		wchan_destroy(rw->rw_wchan);
+	rw->rw_writewchan = wchan_create(rw->rw_name);
+	if (rw->rw_writewchan == NULL) {
+		wchan_destroy(rw->rw_readwchan);
 		kfree(rw->rw_name);
 		kfree(rw);
 		return NULL;
 	}
 
-	rw->max_readers = 5;
-
-	rw->rw_sem = sem_create(rw->rw_name, rw->max_readers);
-	if (rw->rw_sem == NULL) {
-		wchan_destroy(rw->rw_wchan);
-		lock_destroy(rw->rw_lock);
-		kfree(rw->rw_name);
-		kfree(rw);
-		return NULL;
-	}
-
-	rw->writer_count= false;
-  	rw->writer_aging= 0;
-	spinlock_init(&rw->rw_spinlock);  
+	spinlock_data_set(&rw->rw_state, 0);
+	rw->rw_writer = NULL;
+	spinlock_init(&rw->rw_interlock);
+	rw->rw_readwaiters = 0;
+	rw->rw_writewaiters = 0;
+	rw->rw_writegrants = 0;
+	rw->rw_readgen = 0;
+	rw->rw_bypass = 0;
+#if OPT_LOCKSTAT
+	rw->rw_stat = lockstat_register("rwlock", name);
+	rw->rw_stamp = 0;
+#endif
 
 	return rw;
 }
 
-
-
-void rwlock_destroy(struct rwlock * rw){
-
+void
+rwlock_destroy(struct rwlock *rw)
+{
 	KASSERT(rw != NULL);
+	KASSERT(spinlock_data_get(&rw->rw_state) == 0);
+	KASSERT(rw->rw_readwaiters == 0);
+	KASSERT(rw->rw_writewaiters == 0);
 
-	wchan_destroy(rw->rw_wchan);
-	spinlock_cleanup(&rw->rw_spinlock);
-	lock_destroy(rw->rw_lock);
-	sem_destroy(rw->rw_sem);
+	spinlock_cleanup(&rw->rw_interlock);
+	wchan_destroy(rw->rw_readwchan);
+	wchan_destroy(rw->rw_writewchan);
 	kfree(rw->rw_name);
 	kfree(rw);
-
 }
 
+/*
+ * Waiter bits for the current bookkeeping.
+ */
+static
+spinlock_data_t
+rwlock_waitbits(struct rwlock *rw)
+{
+	KASSERT(spinlock_do_i_hold(&rw->rw_interlock));
 
+	return (rw->rw_writewaiters > 0 ? RW_WWAITERS : 0) |
+		(rw->rw_readwaiters > 0 ? RW_RWAITERS : 0);
+}
 
-void rwlock_acquire_read(struct rwlock * rw){
-
-	lock_acquire(rw->rw_lock);
-	while( (rw->rw_sem->sem_count <= 0) || rw->writer_aging >= rw->max_readers ){   // prevent starvation
- 
-		lock_release(rw->rw_lock);
-		spinlock_acquire(&rw->rw_spinlock);  // protect wchan_sleep or wakeall
-		wchan_sleep(rw->rw_wchan, &rw->rw_spinlock);
-		spinlock_release(&rw->rw_spinlock); 
-		lock_acquire(rw->rw_lock);
+/*
+ * The lock has just become free (no writer, no readers) and someone
+ * is, or may be, waiting: decide who gets it and hand it over. Call
+ * with rw_interlock held.
+ *
+ * Nothing changes rw_state without rw_interlock while the waiter bits
+ * or RW_WRITER are set, so plain stores are safe here.
+ */
+static
+void
+rwlock_handoff(struct rwlock *rw)
+{
+	unsigned nreaders;
+
+	KASSERT(spinlock_do_i_hold(&rw->rw_interlock));
+	KASSERT((spinlock_data_get(&rw->rw_state) & RW_READMASK) == 0);
+
+	if (rw->rw_readwaiters > 0 &&
+	    (rw->rw_writewaiters == 0 || rw->rw_bypass >= RW_MAXBYPASS)) {
+		/* Let in all the waiting readers at once. */
+		nreaders = rw->rw_readwaiters;
+		rw->rw_readwaiters = 0;
+		rw->rw_bypass = 0;
+		rw->rw_writer = NULL;
+		spinlock_data_set(&rw->rw_state,
+				  nreaders | rwlock_waitbits(rw));
+		rw->rw_readgen++;
+		wchan_wakeall(rw->rw_readwchan, &rw->rw_interlock);
 	}
- 	P(rw->rw_sem);
-
-	if ( rw->writer_count ) {
-  	rw->writer_aging++ ;
+	else if (rw->rw_writewaiters > 0) {
+		/* Give it to one waiting writer. */
+		if (rw->rw_readwaiters > 0) {
+			rw->rw_bypass++;
+		}
+		rw->rw_writewaiters--;
+		rw->rw_writegrants++;
+		rw->rw_writer = NULL;
+		spinlock_data_set(&rw->rw_state,
+				  RW_WRITER | rwlock_waitbits(rw));
+		wchan_wakeone(rw->rw_writewchan, &rw->rw_interlock);
+	}
+	else {
+		rw->rw_writer = NULL;
+		spinlock_data_set(&rw->rw_state, 0);
 	}
-
-	lock_release(rw->rw_lock);
 }
 
+void
+rwlock_acquire_read(struct rwlock *rw)
+{
+	spinlock_data_t state;
+	unsigned gen;
+#if OPT_LOCKSTAT
+	uint32_t start;
+	bool contended = false;
+#endif
 
-void rwlock_release_read(struct rwlock * rw){
-
-	KASSERT( rw->rw_sem->sem_count < rw->max_readers );
-
-	lock_acquire(rw->rw_lock);
-	V(rw->rw_sem);
-
+	KASSERT(rw != NULL);
+	KASSERT(curthread->t_in_interrupt == false);
 
-//	if( !wchan_isempty(rw->rw_wchan, &rw->rw_spinlock) ){
+#if OPT_LOCKSTAT
+	start = lockstat_now();
+#endif
+
+	/* Fast path: nobody writing or waiting to write. */
+	state = spinlock_data_get(&rw->rw_state);
+	if ((state & (RW_WRITER | RW_WWAITERS)) == 0 &&
+	    spinlock_data_cas(&rw->rw_state, state, state + 1)) {
+		membar_any_any();
+#if OPT_LOCKSTAT
+		lockstat_acquired(rw->rw_stat, false, start);
+#endif
+		return;
+	}
 
-		spinlock_acquire(&rw->rw_spinlock);
-		wchan_wakeall(rw->rw_wchan, &rw->rw_spinlock);
-		spinlock_release(&rw->rw_spinlock);
-//	}
-	lock_release(rw->rw_lock);
+	spinlock_acquire(&rw->rw_interlock);
+	while (1) {
+		state = spinlock_data_get(&rw->rw_state);
+		if ((state & (RW_WRITER | RW_WWAITERS)) == 0) {
+			if (spinlock_data_cas(&rw->rw_state, state, state + 1)) {
+				break;
+			}
+			continue;
+		}
+		if (!spinlock_data_cas(&rw->rw_state, state,
+				       state | RW_RWAITERS)) {
+			continue;
+		}
 
+		/*
+		 * Wait for rwlock_handoff to let us in; it counts us
+		 * as a reader before bumping rw_readgen.
+		 */
+		rw->rw_readwaiters++;
+		gen = rw->rw_readgen;
+#if OPT_LOCKSTAT
+		contended = true;
+#endif
+		do {
+			wchan_sleep(rw->rw_readwchan, &rw->rw_interlock);
+		} while (rw->rw_readgen == gen);
+		break;
+	}
+	spinlock_release(&rw->rw_interlock);
+	membar_any_any();
+#if OPT_LOCKSTAT
+	lockstat_acquired(rw->rw_stat, contended, start);
+#endif
 }
 
-void rwlock_acquire_write(struct rwlock * rw){
-
-	lock_acquire(rw->rw_lock);
-	rw->writer_count = true; 
+void
+rwlock_release_read(struct rwlock *rw)
+{
+	spinlock_data_t state;
 
- 	while ( rw->rw_sem->sem_count < rw->max_readers ) {
+	KASSERT(rw != NULL);
 
-		lock_release(rw->rw_lock);
-		spinlock_acquire(&rw->rw_spinlock);
-		wchan_sleep(rw->rw_wchan, &rw->rw_spinlock);
-		spinlock_release(&rw->rw_spinlock);
-		lock_acquire(rw->rw_lock);     		
-	}
+	membar_any_any();
+	do {
+		state = spinlock_data_get(&rw->rw_state);
+		KASSERT((state & RW_READMASK) > 0);
+		KASSERT((state & RW_WRITER) == 0);
+	} while (!spinlock_data_cas(&rw->rw_state, state, state - 1));
 
-	for( unsigned int i = 0 ; i < rw->max_readers ; i++) {
-		P(rw->rw_sem);
+	/*
+	 * If we were the last reader and someone is waiting, they
+	 * were waiting for us. (Readers only wait while a writer is
+	 * waiting too.)
+	 */
+	if ((state & RW_READMASK) == 1 &&
+	    (state & (RW_WWAITERS | RW_RWAITERS)) != 0) {
+		spinlock_acquire(&rw->rw_interlock);
+		rwlock_handoff(rw);
+		spinlock_release(&rw->rw_interlock);
 	}
-	rw->writer_aging = 0;
-       
-	lock_release(rw->rw_lock);
-
 }
 
+void
+rwlock_acquire_write(struct rwlock *rw)
+{
+	spinlock_data_t state;
+#if OPT_LOCKSTAT
+	uint32_t start;
+	bool contended = false;
+#endif
 
-void rwlock_release_write(struct rwlock * rw){
-
-	lock_acquire(rw->rw_lock);
-	KASSERT( rw->rw_sem->sem_count == 0);
-	rw->writer_count = false; 
+	KASSERT(rw != NULL);
+	KASSERT(curthread->t_in_interrupt == false);
 
-	for(unsigned int  i = 0 ; i < rw->max_readers ; i++)
-	{
-		V(rw->rw_sem);
+#if OPT_LOCKSTAT
+	start = lockstat_now();
+#endif
+
+	/* Fast path: completely free. */
+	if (spinlock_data_cas(&rw->rw_state, 0, RW_WRITER)) {
+		membar_any_any();
+		rw->rw_writer = curthread;
+#if OPT_LOCKSTAT
+		rw->rw_stamp = lockstat_acquired(rw->rw_stat, false, start);
+#endif
+		return;
 	}
 
-//	if( !wchan_isempty(rw->rw_wchan, &rw->rw_spinlock) ){
+	spinlock_acquire(&rw->rw_interlock);
+	while (1) {
+		state = spinlock_data_get(&rw->rw_state);
+		if (state == 0) {
+			if (spinlock_data_cas(&rw->rw_state, 0, RW_WRITER)) {
+				break;
+			}
+			continue;
+		}
+		if (!spinlock_data_cas(&rw->rw_state, state,
+				       state | RW_WWAITERS)) {
+			continue;
+		}
 
-		spinlock_acquire(&rw->rw_spinlock);
-		wchan_wakeall(rw->rw_wchan, &rw->rw_spinlock);
-		spinlock_release(&rw->rw_spinlock);
-//	}
+		/*
+		 * Wait for a handoff. Always sleep at least once, so a
+		 * grant meant for a writer already asleep isn't taken
+		 * by us instead.
+		 */
+		rw->rw_writewaiters++;
+#if OPT_LOCKSTAT
+		contended = true;
+#endif
+		do {
+			wchan_sleep(rw->rw_writewchan, &rw->rw_interlock);
+		} while (rw->rw_writegrants == 0);
+		rw->rw_writegrants--;
+		break;
+	}
+	spinlock_release(&rw->rw_interlock);
+	membar_any_any();
+	rw->rw_writer = curthread;
+#if OPT_LOCKSTAT
+	rw->rw_stamp = lockstat_acquired(rw->rw_stat, contended, start);
+#endif
+}
+
+void
+rwlock_release_write(struct rwlock *rw)
+{
+	KASSERT(rw != NULL);
+	KASSERT(rw->rw_writer == curthread);
 
-	lock_release(rw->rw_lock);
+#if OPT_LOCKSTAT
+	lockstat_released(rw->rw_stat, rw->rw_stamp);
+#endif
+	membar_any_any();
 
+	/* Fast path: nobody waiting. */
+	rw->rw_writer = NULL;
+	if (spinlock_data_cas(&rw->rw_state, RW_WRITER, 0)) {
+		return;
+	}
 
+	spinlock_acquire(&rw->rw_interlock);
+	KASSERT(spinlock_data_get(&rw->rw_state) & RW_WRITER);
+	rwlock_handoff(rw);
+	spinlock_release(&rw->rw_interlock);
 }
@@ -40,6 +40,7 @@
 #include <cpu.h>
 #include <spl.h>
 #include <spinlock.h>
+#include <atomic.h>
 #include <wchan.h>
 #include <thread.h>
 #include <threadlist.h>
@@ -50,6 +51,11 @@
 #include <addrspace.h>
 #include <mainbus.h>
 #include <vnode.h>
+#include <clock.h>
+#include <callout.h>
+#include <epoch.h>
+#include <softirq.h>
+#include <workqueue.h>
 
 
 /* Magic number used as a guard value on kernel thread stacks. */
@@ -70,11 +76,25 @@ unsigned num_cpus;
 /* Used to wait for secondary CPUs to come online. */
 static struct semaphore *cpu_startup_sem;
 
-/* Used to synchronize exit cleanup. */
-unsigned thread_count = 0;
+/*
+ * Used to synchronize exit cleanup. Every fork and exit changes the
+ * count; the lock and wchan are only touched when someone is waiting.
+ * It's one atomic word, not a percpu_counter: thread_wait_for_count
+ * waits for an exact value, which a sum of per-CPU slots read one at
+ * a time might show without the count ever having had it.
+ */
+static struct atomic thread_count = ATOMIC_INITIALIZER(0);
+static struct atomic thread_count_waiters = ATOMIC_INITIALIZER(0);
 static struct spinlock thread_count_lock = SPINLOCK_INITIALIZER;
 static struct wchan *thread_count_wchan;
 
+/* List of all threads, for accounting. */
+static struct thread *allthreads;
+static struct spinlock allthreads_lock = SPINLOCK_INITIALIZER;
+
+/* Protects thread and lock priority fields; see synch.c. */
+struct spinlock thread_priority_lock = SPINLOCK_INITIALIZER;
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -114,6 +134,139 @@ thread_checkstack(struct thread *thread)
 	}
 }
 
+/*
+ * Accounting.
+ */
+
+static
+void
+schedstats_add(struct schedstats *total, const struct schedstats *ss)
+{
+	total->ss_runticks += ss->ss_runticks;
+	total->ss_waitticks += ss->ss_waitticks;
+	total->ss_nvcsw += ss->ss_nvcsw;
+	total->ss_nivcsw += ss->ss_nivcsw;
+}
+
+/*
+ * Get T's statistics, including the time it has been running since
+ * the last switch if it is running now. This peeks at threads on
+ * other cpus without locking them; the numbers are only statistics.
+ */
+static
+void
+thread_getstats(struct thread *t, struct schedstats *ret)
+{
+	*ret = t->t_stats;
+	if (t->t_state == S_RUN) {
+		ret->ss_runticks += hardclock_ticks - t->t_oncpustamp;
+	}
+}
+
+void
+schedstats_thread(struct schedstats *ret)
+{
+	thread_getstats(curthread, ret);
+}
+
+void
+schedstats_proc(struct proc *p, struct schedstats *ret)
+{
+	struct schedstats ss;
+	struct thread *t;
+
+	spinlock_acquire(&allthreads_lock);
+	spinlock_acquire(&p->p_lock);
+	*ret = p->p_stats;
+	spinlock_release(&p->p_lock);
+	for (t = allthreads; t != NULL; t = t->t_allnext) {
+		if (t->t_proc == p) {
+			thread_getstats(t, &ss);
+			schedstats_add(ret, &ss);
+		}
+	}
+	spinlock_release(&allthreads_lock);
+}
+
+/*
+ * Snapshot of one thread for thread_printstats. We can't print while
+ * holding allthreads_lock, so copy everything out first.
+ */
+struct threadsnap {
+	char ts_name[16];
+	char ts_proc[sizeof(((struct thread *)NULL)->t_procname)];
+	threadstate_t ts_state;
+	unsigned ts_cpu;
+	int ts_priority;
+	struct schedstats ts_stats;
+};
+
+void
+thread_printstats(void)
+{
+	static const char *const statenames[] = {
+		"run", "ready", "sleep", "zombie",
+	};
+	struct threadsnap *snaps;
+	struct thread *t;
+	unsigned i, num, max;
+
+	/* Count, allocate, and then copy at most that many. */
+	max = 0;
+	spinlock_acquire(&allthreads_lock);
+	for (t = allthreads; t != NULL; t = t->t_allnext) {
+		max++;
+	}
+	spinlock_release(&allthreads_lock);
+
+	snaps = kmalloc(max * sizeof(*snaps));
+	if (snaps == NULL) {
+		kprintf("ps: Out of memory\n");
+		return;
+	}
+
+	num = 0;
+	spinlock_acquire(&allthreads_lock);
+	for (t = allthreads; t != NULL && num < max; t = t->t_allnext) {
+		snprintf(snaps[num].ts_name, sizeof(snaps[num].ts_name),
+			 "%s", t->t_name);
+		/*
+		 * Not t_proc->p_name: nothing stops the process from
+		 * being destroyed under us. The copy in the thread
+		 * can only be torn by a concurrent attach or detach,
+		 * so just make sure it's terminated.
+		 */
+		memcpy(snaps[num].ts_proc, t->t_procname,
+		       sizeof(snaps[num].ts_proc));
+		snaps[num].ts_proc[sizeof(snaps[num].ts_proc) - 1] = '\0';
+		if (snaps[num].ts_proc[0] == '\0') {
+			strcpy(snaps[num].ts_proc, "-");
+		}
+		snaps[num].ts_state = t->t_state;
+		snaps[num].ts_cpu = t->t_cpu != NULL ? t->t_cpu->c_number : 0;
+		snaps[num].ts_priority = t->t_priority;
+		thread_getstats(t, &snaps[num].ts_stats);
+		num++;
+	}
+	spinlock_release(&allthreads_lock);
+
+	kprintf("%-15s %-15s %-6s %3s %3s %8s %8s %7s %7s\n",
+		"THREAD", "PROC", "STATE", "CPU", "PRI",
+		"RUN(ms)", "WAIT(ms)", "VCSW", "IVCSW");
+	for (i=0; i<num; i++) {
+		kprintf("%-15s %-15s %-6s %3u %3d %8u %8u %7u %7u\n",
+			snaps[i].ts_name, snaps[i].ts_proc,
+			statenames[snaps[i].ts_state],
+			snaps[i].ts_cpu, snaps[i].ts_priority,
+			snaps[i].ts_stats.ss_runticks * (1000 / HZ),
+			snaps[i].ts_stats.ss_waitticks * (1000 / HZ),
+			snaps[i].ts_stats.ss_nvcsw,
+			snaps[i].ts_stats.ss_nivcsw);
+	}
+
+	kfree(snaps);
+}
+
 /*
  * Create a thread. This is used both to create a first thread
  * for each CPU and to create subsequent forked threads.
@@ -144,12 +297,35 @@ thread_create(const char *name)
 	thread->t_stack = NULL;
 	thread->t_context = NULL;
 	thread->t_cpu = NULL;
+	thread->t_pinned = false;
 	thread->t_proc = NULL;
+	thread->t_procname[0] = '\0';
 
 	/* Interrupt state fields */
 	thread->t_in_interrupt = false;
 	thread->t_curspl = IPL_HIGH;
 	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
+	thread->t_epochdepth = 0;
+
+	/* Scheduling priority fields */
+	thread->t_basepriority = THREAD_PRI_DEFAULT;
+	thread->t_priority = THREAD_PRI_DEFAULT;
+	thread->t_blockedon = NULL;
+	thread->t_heldlocks = NULL;
+
+	/* Accounting fields */
+	thread->t_oncpustamp = hardclock_ticks;
+	thread->t_readystamp = hardclock_ticks;
+	bzero(&thread->t_stats, sizeof(thread->t_stats));
+
+	spinlock_acquire(&allthreads_lock);
+	thread->t_allprev = NULL;
+	thread->t_allnext = allthreads;
+	if (allthreads != NULL) {
+		allthreads->t_allprev = thread;
+	}
+	allthreads = thread;
+	spinlock_release(&allthreads_lock);
 
 	/* If you add to struct thread, be sure to initialize here */
 
@@ -182,6 +358,7 @@ cpu_create(unsigned hardware_number)
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
 	c->c_hardclocks = 0;
+	c->c_tickbase = 0;
 	c->c_spinlocks = 0;
 
 	c->c_isidle = false;
@@ -192,11 +369,27 @@ cpu_create(unsigned hardware_number)
 	c->c_numshootdown = 0;
 	spinlock_init(&c->c_ipi_lock);
 
+	c->c_epoch = epoch_cpu_create();
+	if (c->c_epoch == NULL) {
+		panic("cpu_create: Out of memory\n");
+	}
+
+	softirq_cpu_init(c);
+
+#if OPT_LOCKSTAT
+	c->c_lockstat = lockstat_cpu_create();
+	if (c->c_lockstat == NULL) {
+		panic("cpu_create: Out of memory\n");
+	}
+#endif
+
 	result = cpuarray_add(&allcpus, c, &c->c_number);
 	if (result != 0) {
 		panic("cpu_create: array_add: %s\n", strerror(result));
 	}
 
+	workqueue_cpu_create(c->c_number);
+
 	snprintf(namebuf, sizeof(namebuf), "<boot #%d>", c->c_number);
 	c->c_curthread = thread_create(namebuf);
 	if (c->c_curthread == NULL) {
@@ -274,6 +467,21 @@ thread_destroy(struct thread *thread)
 
 	/* Thread subsystem fields */
 	KASSERT(thread->t_proc == NULL);
+	KASSERT(thread->t_heldlocks == NULL);
+	KASSERT(thread->t_blockedon == NULL);
+
+	spinlock_acquire(&allthreads_lock);
+	if (thread->t_allprev != NULL) {
+		thread->t_allprev->t_allnext = thread->t_allnext;
+	}
+	else {
+		KASSERT(allthreads == thread);
+		allthreads = thread->t_allnext;
+	}
+	if (thread->t_allnext != NULL) {
+		thread->t_allnext->t_allprev = thread->t_allprev;
+	}
+	spinlock_release(&allthreads_lock);
 	if (thread->t_stack != NULL) {
 		kfree(thread->t_stack);
 	}
@@ -410,6 +618,9 @@ cpu_hatch(unsigned software_number)
 	KASSERT(curthread != NULL);
 	KASSERT(curcpu->c_number == software_number);
 
+	/* Count ticks from where CPU 0 is, for cpu_cycles. */
+	curcpu->c_tickbase = hardclock_ticks - curcpu->c_hardclocks;
+
 	spl0();
 	cpu_identify(buf, sizeof(buf));
 
@@ -417,6 +628,22 @@ cpu_hatch(unsigned software_number)
 	thread_exit();
 }
 
+/*
+ * Change the thread count, and wake anyone in thread_wait_for_count.
+ */
+static
+void
+thread_count_add(int32_t delta)
+{
+	/* fetchadd is a full barrier; the waiter check can't pass it. */
+	atomic_fetchadd(&thread_count, delta);
+	if (atomic_load(&thread_count_waiters) > 0) {
+		spinlock_acquire(&thread_count_lock);
+		wchan_wakeall(thread_count_wchan, &thread_count_lock);
+		spinlock_release(&thread_count_lock);
+	}
+}
+
 /*
  * Start up secondary cpus. Called from boot().
  */
@@ -449,7 +676,44 @@ thread_start_cpus(void)
 	// to 1 so the inc/dec properly works in thread_[fork/exit]. The one thread
 	// is the cpu0 boot thread (menu), which is the only thread that hasn't
 	// exited yet.
-	thread_count = 1;
+	atomic_store(&thread_count, 1);
+}
+
+/*
+ * Put a thread on a run queue, keeping the queue sorted by priority.
+ * Threads of equal priority stay in FIFO order. Most threads run at
+ * the default priority, so scan from the tail, where the common case
+ * stops right away.
+ */
+static
+void
+thread_enqueue(struct threadlist *rq, struct thread *target)
+{
+	struct thread *t;
+
+	THREADLIST_FORALL_REV(t, *rq) {
+		if (t->t_priority >= target->t_priority) {
+			threadlist_insertafter(rq, t, target);
+			return;
+		}
+	}
+	threadlist_addhead(rq, target);
+}
+
+/*
+ * Mark TARGET ready to run and put it on TARGETCPU's run queue, which
+ * must be locked.
+ */
+static
+void
+thread_setready(struct cpu *targetcpu, struct thread *target)
+{
+	KASSERT(spinlock_do_i_hold(&targetcpu->c_runqueue_lock));
+	KASSERT(target->t_cpu == targetcpu);
+
+	target->t_state = S_READY;
+	target->t_readystamp = hardclock_ticks;
+	thread_enqueue(&targetcpu->c_runqueue, target);
 }
 
 /*
@@ -474,9 +738,7 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 		spinlock_acquire(&targetcpu->c_runqueue_lock);
 	}
 
-	/* Target thread is now ready to run; put it on the run queue. */
-	target->t_state = S_READY;
-	threadlist_addtail(&targetcpu->c_runqueue, target);
+	thread_setready(targetcpu, target);
 
 	if (targetcpu->c_isidle) {
 		/*
@@ -498,14 +760,16 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
  * ENTRYPOINT. DATA1 and DATA2 are passed to ENTRYPOINT.
  *
  * The new thread is created in the process P. If P is null, the
- * process is inherited from the caller. It will start on the same CPU
- * as the caller, unless the scheduler intervenes first.
+ * process is inherited from the caller. It starts on CPU TARGET; if
+ * PINNED, it stays there.
  */
+static
 int
-thread_fork(const char *name,
-	    struct proc *proc,
-	    void (*entrypoint)(void *data1, unsigned long data2),
-	    void *data1, unsigned long data2)
+thread_fork_on(const char *name,
+	       struct proc *proc,
+	       struct cpu *target, bool pinned,
+	       void (*entrypoint)(void *data1, unsigned long data2),
+	       void *data1, unsigned long data2)
 {
 	struct thread *newthread;
 	int result;
@@ -528,7 +792,12 @@ thread_fork(const char *name,
 	 */
 
 	/* Thread subsystem fields */
-	newthread->t_cpu = curthread->t_cpu;
+	newthread->t_cpu = target;
+	newthread->t_pinned = pinned;
+
+	/* New threads start at their parent's base priority */
+	newthread->t_basepriority = curthread->t_basepriority;
+	newthread->t_priority = curthread->t_basepriority;
 
 	/* Attach the new thread to its process */
 	if (proc == NULL) {
@@ -548,20 +817,46 @@ thread_fork(const char *name,
 	 */
 	newthread->t_iplhigh_count++;
 
-	spinlock_acquire(&thread_count_lock);
-	++thread_count;
-	wchan_wakeall(thread_count_wchan, &thread_count_lock);
-	spinlock_release(&thread_count_lock);
+	thread_count_add(1);
 
 	/* Set up the switchframe so entrypoint() gets called */
 	switchframe_init(newthread, entrypoint, data1, data2);
 
-	/* Lock the current cpu's run queue and make the new thread runnable */
+	/* Lock the target cpu's run queue and make the new thread runnable */
 	thread_make_runnable(newthread, false);
 
 	return 0;
 }
 
+/*
+ * Create a new thread on the same CPU as the caller. It will start
+ * there, unless the scheduler intervenes first.
+ */
+int
+thread_fork(const char *name,
+	    struct proc *proc,
+	    void (*entrypoint)(void *data1, unsigned long data2),
+	    void *data1, unsigned long data2)
+{
+	return thread_fork_on(name, proc, curthread->t_cpu, false,
+			      entrypoint, data1, data2);
+}
+
+/*
+ * Create a new thread that runs only on CPU number CPUNUM.
+ */
+int
+thread_fork_pinned(const char *name,
+		   struct proc *proc,
+		   unsigned cpunum,
+		   void (*entrypoint)(void *data1, unsigned long data2),
+		   void *data1, unsigned long data2)
+{
+	KASSERT(cpunum < cpuarray_num(&allcpus));
+	return thread_fork_on(name, proc, cpuarray_get(&allcpus, cpunum), true,
+			      entrypoint, data1, data2);
+}
+
 /*
  * High level, machine-independent context switch code.
  *
@@ -577,6 +872,7 @@ void
 thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 {
 	struct thread *cur, *next;
+	uint32_t now;
 	int spl;
 
 	DEBUGASSERT(curcpu->c_curthread == curthread);
@@ -599,6 +895,13 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	/* Check the stack guard band. */
 	thread_checkstack(cur);
 
+	/*
+	 * Epoch read sections can't sleep or yield; since this thread
+	 * isn't in one, neither is this CPU.
+	 */
+	KASSERT(cur->t_epochdepth == 0);
+	epoch_quiescent();
+
 	/* Lock the run queue. */
 	spinlock_acquire(&curcpu->c_runqueue_lock);
 
@@ -609,14 +912,27 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		return;
 	}
 
+	/* Charge the time we've been running. */
+	now = hardclock_ticks;
+	cur->t_stats.ss_runticks += now - cur->t_oncpustamp;
+	cur->t_oncpustamp = now;
+
 	/* Put the thread in the right place. */
 	switch (newstate) {
 	    case S_RUN:
 		panic("Illegal S_RUN in thread_switch\n");
 	    case S_READY:
+		/* Yielding from the timer interrupt is preemption. */
+		if (cur->t_in_interrupt) {
+			cur->t_stats.ss_nivcsw++;
+		}
+		else {
+			cur->t_stats.ss_nvcsw++;
+		}
 		thread_make_runnable(cur, true /*have lock*/);
 		break;
 	    case S_SLEEP:
+		cur->t_stats.ss_nvcsw++;
 		cur->t_wchan_name = wc->wc_name;
 		/*
 		 * Add the thread to the list in the wait channel, and
@@ -660,11 +976,25 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
 			cpu_idle();
+			/*
+			 * Do whatever the interrupt left for later.
+			 * If we came from spl0 in thread context the
+			 * only thing keeping interrupts off is our
+			 * own splhigh, so let softirq_run turn them
+			 * on around each handler.
+			 */
+			softirq_run(cur->t_iplhigh_count == 1 &&
+				    !cur->t_in_interrupt);
 			spinlock_acquire(&curcpu->c_runqueue_lock);
 		}
 	} while (next == NULL);
 	curcpu->c_isidle = false;
 
+	/* Charge the time NEXT sat on a run queue. */
+	now = hardclock_ticks;
+	next->t_stats.ss_waitticks += now - next->t_readystamp;
+	next->t_oncpustamp = now;
+
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
 	 * curthread and it may not be, depending on how curthread and
@@ -802,13 +1132,27 @@ thread_exit(void)
 {
 	struct thread *cur;
 
+	struct proc *proc;
+	struct schedstats stats;
+
 	cur = curthread;
 
 	/*
 	 * Detach from our process. You might need to move this action
 	 * around, depending on how your wait/exit works.
+	 *
+	 * Fold our statistics into the process first. Hold
+	 * allthreads_lock across both steps so schedstats_proc never
+	 * sees us counted twice or not at all.
 	 */
+	spinlock_acquire(&allthreads_lock);
+	proc = cur->t_proc;
+	thread_getstats(cur, &stats);
+	spinlock_acquire(&proc->p_lock);
+	schedstats_add(&proc->p_stats, &stats);
+	spinlock_release(&proc->p_lock);
 	proc_remthread(cur);
+	spinlock_release(&allthreads_lock);
 
 	/* Make sure we *are* detached (move this only if you're sure!) */
 	KASSERT(cur->t_proc == NULL);
@@ -817,12 +1161,7 @@ thread_exit(void)
 	thread_checkstack(cur);
 
 	// Decrement the thread count and notify anyone interested.
-	if (thread_count) {
-		spinlock_acquire(&thread_count_lock);
-		--thread_count;
-		wchan_wakeall(thread_count_wchan, &thread_count_lock);
-		spinlock_release(&thread_count_lock);
-	}
+	thread_count_add(-1);
 
 	/* Interrupts off on this processor */
 	splhigh();
@@ -839,6 +1178,75 @@ thread_yield(void)
 	thread_switch(S_READY, NULL, NULL);
 }
 
+/*
+ * Check if T is running. t_state is only S_RUN while the thread is
+ * some CPU's c_curthread.
+ */
+bool
+thread_oncpu(const struct thread *t)
+{
+	return *(volatile const threadstate_t *)&t->t_state == S_RUN;
+}
+
+void
+thread_priority_raised(struct thread *t)
+{
+	struct cpu *c;
+	struct thread *t2;
+
+	KASSERT(spinlock_do_i_hold(&thread_priority_lock));
+
+	/*
+	 * If it's being migrated, it's on neither queue for the
+	 * moment, and will be sorted in when it lands. So look for
+	 * it rather than assuming it's there.
+	 */
+	c = t->t_cpu;
+	spinlock_acquire(&c->c_runqueue_lock);
+	THREADLIST_FORALL(t2, c->c_runqueue) {
+		if (t2 == t) {
+			threadlist_remove(&c->c_runqueue, t);
+			thread_enqueue(&c->c_runqueue, t);
+			break;
+		}
+	}
+	spinlock_release(&c->c_runqueue_lock);
+}
+
+/*
+ * Return the base priority of the current thread.
+ */
+int
+thread_getpriority(void)
+{
+	return curthread->t_basepriority;
+}
+
+/*
+ * Set the base priority of the current thread. The effective priority
+ * never drops below the highest priority of any thread waiting for a
+ * lock we hold; lk_maxwaitprio tracks that per lock.
+ */
+void
+thread_setpriority(int priority)
+{
+	int effective;
+
+	KASSERT(priority >= THREAD_PRI_MIN && priority <= THREAD_PRI_MAX);
+
+	spinlock_acquire(&thread_priority_lock);
+	curthread->t_basepriority = priority;
+	effective = lock_heldpriority(curthread);
+	if (effective < priority) {
+		effective = priority;
+	}
+	curthread->t_priority = effective;
+	spinlock_release(&thread_priority_lock);
+
+	/* If we dropped, let anything more important run now. */
+	thread_yield();
+}
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -851,10 +1259,26 @@ thread_yield(void)
 void
 schedule(void)
 {
+	struct threadlist sorted;
+	struct thread *t;
+
 	/*
-	 * You can write this. If we do nothing, threads will run in
-	 * round-robin fashion.
+	 * Effective priorities can change while threads sit on the
+	 * run queue (a ready thread that holds a lock can inherit a
+	 * higher priority), and thread_consider_migration appends
+	 * without regard to priority. Re-sort the queue. Within a
+	 * priority level threads still run round-robin.
 	 */
+	threadlist_init(&sorted);
+	spinlock_acquire(&curcpu->c_runqueue_lock);
+	while ((t = threadlist_remhead(&curcpu->c_runqueue)) != NULL) {
+		thread_enqueue(&sorted, t);
+	}
+	while ((t = threadlist_remhead(&sorted)) != NULL) {
+		threadlist_addtail(&curcpu->c_runqueue, t);
+	}
+	spinlock_release(&curcpu->c_runqueue_lock);
+	threadlist_cleanup(&sorted);
 }
 
 /*
@@ -873,11 +1297,31 @@ schedule(void)
  * For here and now, because we know we're running on System/161 and
  * System/161 does not (yet) model such cache effects, we'll be very
  * aggressive.
+ *
+ * Every CPU does this every MIGRATE_HARDCLOCKS, and usually decides
+ * there's nothing to do, so the run queue lengths are read without
+ * taking every CPU's run queue lock. The locks are only taken to
+ * actually move threads.
+ */
+
+/*
+ * Read the length of C's run queue without locking it. It's one
+ * word, so a single load gets some value it really had; it may be
+ * stale by the time we use it (or caught while schedule() re-sorts
+ * the queue), but it's only a hint, and everything that acts on it
+ * is rechecked under the lock.
  */
+static
+unsigned
+thread_runqueue_len(const struct cpu *c)
+{
+	return *(volatile const unsigned *)&c->c_runqueue.tl_count;
+}
+
 void
 thread_consider_migration(void)
 {
-	unsigned my_count, total_count, one_share, to_send;
+	unsigned my_count, total_count, one_share, to_send, count;
 	unsigned i, numcpus;
 	struct cpu *c;
 	struct threadlist victims;
@@ -887,12 +1331,11 @@ thread_consider_migration(void)
 	numcpus = cpuarray_num(&allcpus);
 	for (i=0; i<numcpus; i++) {
 		c = cpuarray_get(&allcpus, i);
-		spinlock_acquire(&c->c_runqueue_lock);
-		total_count += c->c_runqueue.tl_count;
+		count = thread_runqueue_len(c);
+		total_count += count;
 		if (c == curcpu->c_self) {
-			my_count = c->c_runqueue.tl_count;
+			my_count = count;
 		}
-		spinlock_release(&c->c_runqueue_lock);
 	}
 
 	one_share = DIVROUNDUP(total_count, numcpus);
@@ -905,15 +1348,24 @@ thread_consider_migration(void)
 	spinlock_acquire(&curcpu->c_runqueue_lock);
 	for (i=0; i<to_send; i++) {
 		t = threadlist_remtail(&curcpu->c_runqueue);
+		if (t == NULL) {
+			/* It shrank since we looked. */
+			break;
+		}
 		threadlist_addhead(&victims, t);
 	}
 	spinlock_release(&curcpu->c_runqueue_lock);
+	to_send = i;
 
 	for (i=0; i < numcpus && to_send > 0; i++) {
 		c = cpuarray_get(&allcpus, i);
 		if (c == curcpu->c_self) {
 			continue;
 		}
+		if (thread_runqueue_len(c) >= one_share) {
+			/* Full already; don't bother locking it. */
+			continue;
+		}
 		spinlock_acquire(&c->c_runqueue_lock);
 		while (c->c_runqueue.tl_count < one_share && to_send > 0) {
 			t = threadlist_remhead(&victims);
@@ -938,8 +1390,10 @@ thread_consider_migration(void)
 			 * the list and decrement to_send in order to
 			 * skip it. Then it goes back on our own run
 			 * queue below.
+			 *
+			 * Pinned threads get the same treatment.
 			 */
-			if (t == curthread) {
+			if (t == curthread || t->t_pinned) {
 				threadlist_addtail(&victims, t);
 				to_send--;
 				continue;
@@ -1043,22 +1497,102 @@ wchan_sleep(struct wchan *wc, struct spinlock *lk)
 }
 
 /*
- * Wake up one thread sleeping on a wait channel.
+ * Timeout for wchan_sleep_timeout. Lives on the sleeper's stack.
+ */
+struct wchan_timeout {
+	struct wchan *wt_wc;
+	struct spinlock *wt_lk;
+	struct thread *wt_thread;
+	bool wt_expired;
+};
+
+/*
+ * Callout function: if the sleeper is still on the channel, take it
+ * off and wake it. If it's not there someone else already woke it.
+ */
+static
+void
+wchan_timeout_expire(void *arg)
+{
+	struct wchan_timeout *wt = arg;
+	struct thread *t;
+
+	spinlock_acquire(wt->wt_lk);
+	THREADLIST_FORALL(t, wt->wt_wc->wc_threads) {
+		if (t == wt->wt_thread) {
+			threadlist_remove(&wt->wt_wc->wc_threads, t);
+			wt->wt_expired = true;
+			thread_make_runnable(t, false);
+			break;
+		}
+	}
+	spinlock_release(wt->wt_lk);
+}
+
+/*
+ * Sleep on WC, as wchan_sleep, for at most TICKS hardclocks.
+ *
+ * The callout is scheduled while we hold LK, so it can't find us
+ * before we're on the channel. Afterwards, stop it before retaking
+ * LK: the callout function takes LK itself, and callout_stop may wait
+ * for it to finish.
+ */
+bool
+wchan_sleep_timeout(struct wchan *wc, struct spinlock *lk, uint32_t ticks)
+{
+	struct wchan_timeout wt;
+	struct callout co;
+
+	/* may not sleep in an interrupt handler */
+	KASSERT(!curthread->t_in_interrupt);
+
+	/* must hold the spinlock */
+	KASSERT(spinlock_do_i_hold(lk));
+
+	/* must not hold other spinlocks */
+	KASSERT(curcpu->c_spinlocks == 1);
+
+	wt.wt_wc = wc;
+	wt.wt_lk = lk;
+	wt.wt_thread = curthread;
+	wt.wt_expired = false;
+
+	callout_init(&co);
+	callout_schedule(&co, ticks, wchan_timeout_expire, &wt);
+
+	thread_switch(S_SLEEP, wc, lk);
+
+	callout_stop(&co);
+	spinlock_acquire(lk);
+
+	return wt.wt_expired;
+}
+
+/*
+ * Wake up one thread sleeping on a wait channel: the one with the
+ * highest effective priority, and among those the one that has been
+ * waiting longest.
  */
 void
 wchan_wakeone(struct wchan *wc, struct spinlock *lk)
 {
-	struct thread *target;
+	struct thread *target, *t;
 
 	KASSERT(spinlock_do_i_hold(lk));
 
 	/* Grab a thread from the channel */
-	target = threadlist_remhead(&wc->wc_threads);
+	target = NULL;
+	THREADLIST_FORALL(t, wc->wc_threads) {
+		if (target == NULL || t->t_priority > target->t_priority) {
+			target = t;
+		}
+	}
 
 	if (target == NULL) {
 		/* Nobody was sleeping. */
 		return;
 	}
+	threadlist_remove(&wc->wc_threads, target);
 
 	/*
 	 * Note that thread_make_runnable acquires a runqueue lock
@@ -1071,6 +1605,22 @@ wchan_wakeone(struct wchan *wc, struct spinlock *lk)
 	thread_make_runnable(target, false);
 }
 
+/*
+ * Wake up T, which must be sleeping on WC. Unlike the other wakeups
+ * this doesn't look at the rest of the channel, so it's constant
+ * time however many threads are asleep there.
+ */
+void
+wchan_wakethread(struct wchan *wc, struct spinlock *lk, struct thread *t)
+{
+	KASSERT(spinlock_do_i_hold(lk));
+	KASSERT(t->t_state == S_SLEEP);
+	KASSERT(t->t_wchan_name == wc->wc_name);
+
+	threadlist_remove(&wc->wc_threads, t);
+	thread_make_runnable(t, false);
+}
+
 /*
  * Wake up all threads sleeping on a wait channel.
  */
@@ -1079,6 +1629,8 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 {
 	struct thread *target;
 	struct threadlist list;
+	struct cpu *targetcpu;
+	unsigned n;
 
 	KASSERT(spinlock_do_i_hold(lk));
 
@@ -1093,17 +1645,58 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 	}
 
 	/*
-	 * We could conceivably sort by cpu first to cause fewer lock
-	 * ops and fewer IPIs, but for now at least don't bother. Just
-	 * make each thread runnable.
+	 * Hand them to their CPUs one CPU at a time, so each run
+	 * queue lock is taken once and each idle CPU gets at most one
+	 * IPI no matter how many threads we wake. A sleeping thread's
+	 * t_cpu can't change under us: only threads on a run queue
+	 * get migrated.
 	 */
 	while ((target = threadlist_remhead(&list)) != NULL) {
-		thread_make_runnable(target, false);
+		targetcpu = target->t_cpu;
+		spinlock_acquire(&targetcpu->c_runqueue_lock);
+		thread_setready(targetcpu, target);
+
+		n = list.tl_count;
+		while (n-- > 0) {
+			target = threadlist_remhead(&list);
+			if (target->t_cpu == targetcpu) {
+				thread_setready(targetcpu, target);
+			}
+			else {
+				threadlist_addtail(&list, target);
+			}
+		}
+
+		if (targetcpu->c_isidle) {
+			ipi_send(targetcpu, IPI_UNIDLE);
+		}
+		spinlock_release(&targetcpu->c_runqueue_lock);
 	}
 
 	threadlist_cleanup(&list);
 }
 
+/*
+ * Return the highest effective priority of any thread sleeping on
+ * the channel, or -1 if it is empty.
+ */
+int
+wchan_maxpriority(struct wchan *wc, struct spinlock *lk)
+{
+	struct thread *t;
+	int ret;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	ret = -1;
+	THREADLIST_FORALL(t, wc->wc_threads) {
+		if (t->t_priority > ret) {
+			ret = t->t_priority;
+		}
+	}
+	return ret;
+}
+
 /*
  * Return nonzero if there are no threads sleeping on the channel.
  * This is meant to be used only for diagnostic purposes.
@@ -1222,14 +1815,31 @@ interprocessor_interrupt(void)
 	spinlock_release(&curcpu->c_ipi_lock);
 }
 
+/*
+ * Return the number of threads.
+ */
+unsigned
+thread_get_count(void)
+{
+	return atomic_load(&thread_count);
+}
+
 /*
  * Wait for the thread count to equal tc.
+ *
+ * We count ourselves in thread_count_waiters before reading the count,
+ * and thread_count_add changes the count before checking for waiters,
+ * with a barrier in between on both sides; so either it sees us and
+ * wakes us (it can't get the lock until we're asleep), or we see its
+ * change.
  */
 void thread_wait_for_count(unsigned tc)
 {
 	spinlock_acquire(&thread_count_lock);
-	while (thread_count != tc) {
+	atomic_fetchadd(&thread_count_waiters, 1);
+	while (thread_get_count() != tc) {
 		wchan_sleep(thread_count_wchan, &thread_count_lock);
 	}
+	atomic_fetchadd(&thread_count_waiters, -1);
 	spinlock_release(&thread_count_lock);
 }
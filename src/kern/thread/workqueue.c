@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Work queues. See workqueue.h.
+ *
+ * Each CPU's queue is a FIFO list under a spinlock, so it can be
+ * added to from interrupt handlers; the worker sleeps on a wchan
+ * when the list is empty. wk_pending is only ever changed with
+ * atomic operations, which is what makes double enqueues fail
+ * cleanly even when they race on different CPUs.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <thread.h>
+#include <current.h>
+#include <synch.h>
+#include <platform/maxcpus.h>
+#include <workqueue.h>
+
+struct workqueue_cpu {
+	struct spinlock wq_lock;
+	struct work *wq_head;
+	struct work **wq_tail;
+	struct wchan *wq_wchan;
+};
+
+static struct workqueue_cpu *workqueue_cpus[MAXCPUS];
+
+/* Set once the workers are running. */
+static bool workqueue_started;
+
+void
+workqueue_cpu_create(unsigned cpunum)
+{
+	struct workqueue_cpu *wq;
+
+	KASSERT(cpunum < MAXCPUS);
+	KASSERT(workqueue_cpus[cpunum] == NULL);
+
+	wq = kmalloc(sizeof(*wq));
+	if (wq == NULL) {
+		panic("workqueue_cpu_create: Out of memory\n");
+	}
+	spinlock_init(&wq->wq_lock);
+	wq->wq_head = NULL;
+	wq->wq_tail = &wq->wq_head;
+	wq->wq_wchan = wchan_create("workqueue");
+	if (wq->wq_wchan == NULL) {
+		panic("workqueue_cpu_create: Out of memory\n");
+	}
+	workqueue_cpus[cpunum] = wq;
+}
+
+void
+work_init(struct work *wk, void (*func)(void *), void *arg)
+{
+	wk->wk_next = NULL;
+	wk->wk_func = func;
+	wk->wk_arg = arg;
+	wk->wk_cpu = 0;
+	atomic_store(&wk->wk_pending, 0);
+	callout_init(&wk->wk_callout);
+}
+
+/*
+ * Put a pending work item on its CPU's queue and wake the worker.
+ */
+static
+void
+workqueue_insert(struct work *wk)
+{
+	struct workqueue_cpu *wq;
+
+	wq = workqueue_cpus[wk->wk_cpu];
+	KASSERT(wq != NULL);
+
+	spinlock_acquire(&wq->wq_lock);
+	wk->wk_next = NULL;
+	*wq->wq_tail = wk;
+	wq->wq_tail = &wk->wk_next;
+	wchan_wakeone(wq->wq_wchan, &wq->wq_lock);
+	spinlock_release(&wq->wq_lock);
+}
+
+/*
+ * Take a work item back off its CPU's queue before its worker gets to
+ * it. Returns false if it isn't there, i.e., the worker has already
+ * taken it and is running it (or about to). On success the item is
+ * idle and its function will not be called.
+ */
+static
+bool
+workqueue_remove(struct work *wk)
+{
+	struct workqueue_cpu *wq;
+	struct work **pp;
+	bool found;
+
+	wq = workqueue_cpus[wk->wk_cpu];
+	KASSERT(wq != NULL);
+
+	found = false;
+	spinlock_acquire(&wq->wq_lock);
+	for (pp = &wq->wq_head; *pp != NULL; pp = &(*pp)->wk_next) {
+		if (*pp == wk) {
+			*pp = wk->wk_next;
+			if (wq->wq_tail == &wk->wk_next) {
+				wq->wq_tail = pp;
+			}
+			wk->wk_next = NULL;
+			found = true;
+			break;
+		}
+	}
+	spinlock_release(&wq->wq_lock);
+
+	if (found) {
+		atomic_store(&wk->wk_pending, 0);
+	}
+	return found;
+}
+
+bool
+workqueue_enqueue_cpu(struct work *wk, unsigned cpunum)
+{
+	if (!atomic_cas(&wk->wk_pending, 0, 1)) {
+		return false;
+	}
+	wk->wk_cpu = cpunum;
+	workqueue_insert(wk);
+	return true;
+}
+
+bool
+workqueue_enqueue(struct work *wk)
+{
+	return workqueue_enqueue_cpu(wk, curcpu->c_number);
+}
+
+/*
+ * Callout function for delayed work. Runs in interrupt context on
+ * CPU 0, which is fine for workqueue_insert.
+ */
+static
+void
+workqueue_timeout(void *vwk)
+{
+	workqueue_insert(vwk);
+}
+
+bool
+workqueue_enqueue_delayed(struct work *wk, uint32_t ticks)
+{
+	if (!atomic_cas(&wk->wk_pending, 0, 1)) {
+		return false;
+	}
+	wk->wk_cpu = curcpu->c_number;
+	callout_schedule(&wk->wk_callout, ticks, workqueue_timeout, wk);
+	return true;
+}
+
+bool
+workqueue_cancel_delayed(struct work *wk)
+{
+	/*
+	 * If the callout hasn't fired, nothing else can touch the
+	 * item, so it's ours to mark idle. If it has, the item is on
+	 * a queue (or done) and we're too late.
+	 */
+	if (callout_stop(&wk->wk_callout)) {
+		atomic_store(&wk->wk_pending, 0);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Worker thread: one per CPU, pinned there.
+ */
+static
+void
+workqueue_thread(void *junk, unsigned long cpunum)
+{
+	struct workqueue_cpu *wq;
+	struct work *wk;
+	void (*func)(void *);
+	void *arg;
+
+	(void)junk;
+
+	KASSERT(curcpu->c_number == cpunum);
+	wq = workqueue_cpus[cpunum];
+
+	spinlock_acquire(&wq->wq_lock);
+	while (1) {
+		while (wq->wq_head == NULL) {
+			wchan_sleep(wq->wq_wchan, &wq->wq_lock);
+		}
+		wk = wq->wq_head;
+		wq->wq_head = wk->wk_next;
+		if (wq->wq_head == NULL) {
+			wq->wq_tail = &wq->wq_head;
+		}
+		spinlock_release(&wq->wq_lock);
+
+		/* Once it's no longer pending it may be freed or requeued. */
+		func = wk->wk_func;
+		arg = wk->wk_arg;
+		atomic_store(&wk->wk_pending, 0);
+		func(arg);
+
+		spinlock_acquire(&wq->wq_lock);
+	}
+}
+
+void
+workqueue_bootstrap(void)
+{
+	unsigned i;
+	int result;
+
+	for (i=0; i<num_cpus; i++) {
+		result = thread_fork_pinned("workqueue", NULL, i,
+					    workqueue_thread, NULL, i);
+		if (result) {
+			panic("workqueue_bootstrap: thread_fork: %s\n",
+			      strerror(result));
+		}
+	}
+	workqueue_started = true;
+}
+
+////////////////////////////////////////////////////////////
+// parallel_for
+
+struct pf_chunk {
+	struct work pc_work;
+	void (*pc_func)(void *, unsigned);
+	void *pc_arg;
+	unsigned pc_start;
+	unsigned pc_end;
+	struct semaphore *pc_done;	/* shared; V'd when finished */
+};
+
+static
+void
+pf_run(void *vchunk)
+{
+	struct pf_chunk *pc = vchunk;
+	unsigned i;
+
+	for (i = pc->pc_start; i < pc->pc_end; i++) {
+		pc->pc_func(pc->pc_arg, i);
+	}
+	if (pc->pc_done != NULL) {
+		V(pc->pc_done);
+	}
+}
+
+/*
+ * Chunk I of NCHUNKS goes to CPU I, except that the caller takes the
+ * one for its own CPU and runs it inline. Before the workers start,
+ * the caller does everything.
+ *
+ * Once its own chunk is done, the caller takes back every chunk that
+ * is still sitting on a queue and runs it too, so it only ever sleeps
+ * waiting for chunks a worker has already started. That's what makes
+ * nested calls safe: if work functions on two CPUs both call
+ * parallel_for, neither waits for the other's worker (which is busy
+ * running the other call) to get to a queued chunk.
+ */
+int
+parallel_for(unsigned n, void (*func)(void *arg, unsigned i), void *arg)
+{
+	struct pf_chunk *chunks;
+	struct semaphore *done;
+	unsigned nchunks, i, me;
+
+	if (n == 0) {
+		return 0;
+	}
+
+	nchunks = workqueue_started ? num_cpus : 1;
+	if (nchunks > n) {
+		nchunks = n;
+	}
+
+	chunks = kmalloc(nchunks * sizeof(*chunks));
+	if (chunks == NULL) {
+		return ENOMEM;
+	}
+	done = NULL;
+	if (nchunks > 1) {
+		done = sem_create("parallel_for", 0);
+		if (done == NULL) {
+			kfree(chunks);
+			return ENOMEM;
+		}
+	}
+
+	/* Which CPU we're on doesn't matter for correctness, only cost. */
+	me = curcpu->c_number % nchunks;
+
+	for (i=0; i<nchunks; i++) {
+		work_init(&chunks[i].pc_work, pf_run, &chunks[i]);
+		chunks[i].pc_func = func;
+		chunks[i].pc_arg = arg;
+		chunks[i].pc_start = (uint64_t)n * i / nchunks;
+		chunks[i].pc_end = (uint64_t)n * (i + 1) / nchunks;
+		chunks[i].pc_done = (i == me) ? NULL : done;
+	}
+	for (i=0; i<nchunks; i++) {
+		if (i != me) {
+			workqueue_enqueue_cpu(&chunks[i].pc_work, i);
+		}
+	}
+
+	pf_run(&chunks[me]);
+
+	/* Help with whatever the workers haven't started yet. */
+	for (i=0; i<nchunks; i++) {
+		if (i != me && workqueue_remove(&chunks[i].pc_work)) {
+			pf_run(&chunks[i]);
+		}
+	}
+
+	/*
+	 * The barrier: wait for everyone else's share. Chunks we ran
+	 * ourselves have already V'd, so this only sleeps for ones a
+	 * worker is running.
+	 */
+	for (i=1; i<nchunks; i++) {
+		P(done);
+	}
+
+	if (done != NULL) {
+		sem_destroy(done);
+	}
+	kfree(chunks);
+	return 0;
+}
@@ -0,0 +1,893 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Buffer cache. See buf.h.
+ *
+ * Buffers are found through a hash table on (device, block). Those
+ * that nobody has pinned sit on an LRU list, oldest first; when the
+ * cache is full, the oldest is reused, after writing it back if it's
+ * dirty.
+ *
+ * buf_lock protects all the cache's own state. It's dropped during
+ * device I/O: a buffer being read in is marked busy, and anyone else
+ * who wants it waits on buf_cv; a buffer being written out is pinned
+ * for the duration, so it stays put but others can still use it.
+ *
+ * Read-ahead reads are done by the work queue, using a work item in
+ * each buffer; the buffer is pinned and busy until the read is done.
+ *
+ * Dirty buffers are normally written back by the syncer thread rather
+ * than by whoever dirtied them. It wakes up every BUF_SYNCINTERVAL
+ * seconds and syncs all filesystems (vfs_sync) if it's been at least
+ * buf_maxage seconds since it last did, or sooner if the number of
+ * dirty buffers reaches BUF_DIRTYHIGH. That pushes each filesystem's
+ * in-memory metadata into the cache and then writes the cache back in
+ * block order, so nothing stays dirty much longer than buf_maxage.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <uio.h>
+#include <clock.h>
+#include <synch.h>
+#include <wchan.h>
+#include <thread.h>
+#include <device.h>
+#include <vfs.h>
+#include <workqueue.h>
+#include <buf.h>
+
+/* Maximum number of buffers (each BUFFER_SIZE bytes of data). */
+#define BUF_MAX		256
+
+/* Number of hash chains. */
+#define BUF_HASHSIZE	128
+
+/* How many times to try an I/O that fails with EIO. */
+#define BUF_TRIES	10
+
+/* How many dirty buffers buffer_sync sorts and writes at a time. */
+#define BUF_SYNCBATCH	32
+
+/* How often the syncer wakes up, in seconds. */
+#define BUF_SYNCINTERVAL	1
+
+/* Default maximum age of dirty data, in seconds. */
+#define BUF_MAXAGE	5
+
+/* Number of dirty buffers that wakes the syncer early. */
+#define BUF_DIRTYHIGH	(BUF_MAX / 2)
+
+struct buf {
+	struct buf *b_hashnext;		/* hash chain */
+	struct buf *b_lruprev;		/* LRU list, if unpinned */
+	struct buf *b_lrunext;
+	struct device *b_dev;		/* key: device */
+	daddr_t b_block;		/* key: block number */
+	void *b_data;			/* BUFFER_SIZE bytes */
+	unsigned b_pins;		/* number of pins */
+	bool b_valid;			/* b_data holds the block */
+	bool b_dirty;			/* b_data is newer than the disk */
+	bool b_busy;			/* being read in */
+	uint32_t b_dirtytime;		/* hardclock_ticks when dirtied */
+	struct work b_work;		/* for read-ahead */
+};
+
+static struct lock *buf_lock;
+static struct cv *buf_cv;
+
+static struct buf *buf_hash[BUF_HASHSIZE];
+static struct buf *buf_lruhead;		/* oldest */
+static struct buf *buf_lrutail;		/* newest */
+static unsigned buf_count;
+static unsigned buf_ndirty;
+
+/* Syncer state; buf_maxage is protected by buf_lock. */
+static unsigned buf_maxage = BUF_MAXAGE;
+
+/* Whether buffer_readahead does anything; protected by buf_lock. */
+static bool buf_readahead_on = true;
+static struct wchan *buf_syncer_wchan;
+static struct spinlock buf_syncer_lock;
+static bool buf_syncer_kicked;
+
+static struct {
+	unsigned bs_lookups;
+	unsigned bs_hits;
+	unsigned bs_reads;
+	unsigned bs_writes;
+	unsigned bs_evictions;
+	unsigned bs_readaheads;
+	unsigned bs_syncs;
+	unsigned bs_kicks;
+	uint32_t bs_maxdirtyage;
+} buf_stats;
+
+////////////////////////////////////////////////////////////
+// Device I/O
+
+/*
+ * Read or write one block, retrying I/O errors.
+ */
+static
+int
+buffer_devio(struct device *dev, daddr_t block, void *data, enum uio_rw rw)
+{
+	struct iovec iov;
+	struct uio ku;
+	int tries;
+	int result;
+
+	KASSERT(dev->d_blocksize == BUFFER_SIZE);
+
+	for (tries = 1; ; tries++) {
+		uio_kinit(&iov, &ku, data, BUFFER_SIZE,
+			  (off_t)block * BUFFER_SIZE, rw);
+		result = DEVOP_IO(dev, &ku);
+		if (result != EIO || tries == BUF_TRIES) {
+			break;
+		}
+		if (tries == 1) {
+			kprintf("buf: block %u I/O error, retrying\n", block);
+		}
+	}
+
+	if (result == EINVAL) {
+		/* Bad block number or alignment; that's a bug. */
+		panic("buf: block %u: DEVOP_IO returned EINVAL\n", block);
+	}
+	if (result == EIO) {
+		kprintf("buf: block %u I/O error, giving up after %d "
+			"tries\n", block, tries);
+	}
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+// Tables
+
+static
+unsigned
+buffer_hashval(struct device *dev, daddr_t block)
+{
+	return (block ^ ((uintptr_t)dev >> 4)) % BUF_HASHSIZE;
+}
+
+static
+struct buf *
+buffer_find(struct device *dev, daddr_t block)
+{
+	struct buf *b;
+
+	for (b = buf_hash[buffer_hashval(dev, block)];
+	     b != NULL; b = b->b_hashnext) {
+		if (b->b_dev == dev && b->b_block == block) {
+			return b;
+		}
+	}
+	return NULL;
+}
+
+static
+void
+buffer_hash_add(struct buf *b)
+{
+	unsigned hv = buffer_hashval(b->b_dev, b->b_block);
+
+	b->b_hashnext = buf_hash[hv];
+	buf_hash[hv] = b;
+}
+
+static
+void
+buffer_hash_remove(struct buf *b)
+{
+	struct buf **pp;
+
+	pp = &buf_hash[buffer_hashval(b->b_dev, b->b_block)];
+	while (*pp != b) {
+		KASSERT(*pp != NULL);
+		pp = &(*pp)->b_hashnext;
+	}
+	*pp = b->b_hashnext;
+	b->b_hashnext = NULL;
+}
+
+static
+void
+buffer_lru_remove(struct buf *b)
+{
+	if (b->b_lruprev != NULL) {
+		b->b_lruprev->b_lrunext = b->b_lrunext;
+	}
+	else {
+		buf_lruhead = b->b_lrunext;
+	}
+	if (b->b_lrunext != NULL) {
+		b->b_lrunext->b_lruprev = b->b_lruprev;
+	}
+	else {
+		buf_lrutail = b->b_lruprev;
+	}
+	b->b_lruprev = b->b_lrunext = NULL;
+}
+
+/*
+ * Put B on the LRU list: at the new end normally, or at the old end
+ * if it should be reused first.
+ */
+static
+void
+buffer_lru_add(struct buf *b, bool oldest)
+{
+	if (oldest) {
+		b->b_lruprev = NULL;
+		b->b_lrunext = buf_lruhead;
+		if (buf_lruhead != NULL) {
+			buf_lruhead->b_lruprev = b;
+		}
+		else {
+			buf_lrutail = b;
+		}
+		buf_lruhead = b;
+	}
+	else {
+		b->b_lrunext = NULL;
+		b->b_lruprev = buf_lrutail;
+		if (buf_lrutail != NULL) {
+			buf_lrutail->b_lrunext = b;
+		}
+		else {
+			buf_lruhead = b;
+		}
+		buf_lrutail = b;
+	}
+}
+
+static
+void
+buffer_pin(struct buf *b)
+{
+	if (b->b_pins == 0) {
+		buffer_lru_remove(b);
+	}
+	b->b_pins++;
+}
+
+static
+void
+buffer_unpin(struct buf *b, bool oldest)
+{
+	KASSERT(b->b_pins > 0);
+	b->b_pins--;
+	if (b->b_pins == 0) {
+		buffer_lru_add(b, oldest);
+		/*
+		 * Someone may be waiting for a buffer to reuse, or
+		 * in buffer_drop for this one.
+		 */
+		cv_broadcast(buf_cv, buf_lock);
+	}
+}
+
+static void buffer_syncer_kick(void);
+
+/*
+ * Change a buffer's dirty state, keeping count. A buffer that's made
+ * dirty again because its write-back failed keeps its old timestamp.
+ */
+static
+void
+buffer_setdirty(struct buf *b, bool newlydirtied)
+{
+	if (b->b_dirty) {
+		return;
+	}
+	b->b_dirty = true;
+	if (newlydirtied) {
+		b->b_dirtytime = hardclock_ticks;
+	}
+	buf_ndirty++;
+	if (buf_ndirty == BUF_DIRTYHIGH) {
+		buffer_syncer_kick();
+	}
+}
+
+static
+void
+buffer_setclean(struct buf *b)
+{
+	uint32_t age;
+
+	KASSERT(b->b_dirty);
+	KASSERT(buf_ndirty > 0);
+	b->b_dirty = false;
+	buf_ndirty--;
+
+	age = hardclock_ticks - b->b_dirtytime;
+	if (age > buf_stats.bs_maxdirtyage) {
+		buf_stats.bs_maxdirtyage = age;
+	}
+}
+
+/*
+ * Throw away an unpinned buffer.
+ */
+static
+void
+buffer_destroy(struct buf *b)
+{
+	KASSERT(b->b_pins == 0);
+	KASSERT(!b->b_busy);
+	if (b->b_dirty) {
+		/* Dropped; it never needs writing now. */
+		b->b_dirty = false;
+		buf_ndirty--;
+	}
+	buffer_lru_remove(b);
+	buffer_hash_remove(b);
+	kfree(b->b_data);
+	kfree(b);
+	buf_count--;
+}
+
+/*
+ * Give a new or reused buffer its identity: pinned once, not valid.
+ */
+static
+void
+buffer_setkey(struct buf *b, struct device *dev, daddr_t block)
+{
+	b->b_dev = dev;
+	b->b_block = block;
+	b->b_pins = 1;
+	b->b_valid = false;
+	b->b_dirty = false;
+	b->b_busy = false;
+	buffer_hash_add(b);
+}
+
+static void buffer_readahead_work(void *vb);
+
+static
+struct buf *
+buffer_create(void)
+{
+	struct buf *b;
+
+	b = kmalloc(sizeof(*b));
+	if (b == NULL) {
+		return NULL;
+	}
+	b->b_data = kmalloc(BUFFER_SIZE);
+	if (b->b_data == NULL) {
+		kfree(b);
+		return NULL;
+	}
+	b->b_hashnext = b->b_lruprev = b->b_lrunext = NULL;
+	work_init(&b->b_work, buffer_readahead_work, b);
+	buf_count++;
+	return b;
+}
+
+////////////////////////////////////////////////////////////
+// Lookup
+
+/*
+ * Find the buffer for BLOCK of DEV, or make one, and pin it. A new
+ * buffer isn't valid yet. Called with buf_lock held; may drop it.
+ */
+static
+int
+buffer_lookup(struct device *dev, daddr_t block, struct buf **ret)
+{
+	struct buf *b;
+	int result;
+
+	KASSERT(lock_do_i_hold(buf_lock));
+	buf_stats.bs_lookups++;
+
+	while (1) {
+		b = buffer_find(dev, block);
+		if (b != NULL) {
+			if (b->b_busy) {
+				cv_wait(buf_cv, buf_lock);
+				continue;
+			}
+			if (b->b_valid) {
+				buf_stats.bs_hits++;
+			}
+			buffer_pin(b);
+			*ret = b;
+			return 0;
+		}
+
+		/* Not cached. Make a new buffer if we're allowed. */
+		b = NULL;
+		if (buf_count < BUF_MAX) {
+			b = buffer_create();
+		}
+		if (b == NULL) {
+			/* Reuse the least recently used one. */
+			b = buf_lruhead;
+			if (b == NULL) {
+				/* Everything's pinned; wait. */
+				cv_wait(buf_cv, buf_lock);
+				continue;
+			}
+			if (b->b_dirty) {
+				/*
+				 * Write it back, then start over: we
+				 * slept, so somebody else may have
+				 * loaded our block or pinned this one.
+				 */
+				buffer_pin(b);
+				buffer_setclean(b);
+				lock_release(buf_lock);
+				result = buffer_devio(b->b_dev, b->b_block,
+						      b->b_data, UIO_WRITE);
+				lock_acquire(buf_lock);
+				buf_stats.bs_writes++;
+				if (result) {
+					buffer_setdirty(b, false);
+					buffer_unpin(b, false);
+					return result;
+				}
+				buffer_unpin(b, true);
+				continue;
+			}
+			buffer_lru_remove(b);
+			buffer_hash_remove(b);
+			buf_stats.bs_evictions++;
+		}
+
+		buffer_setkey(b, dev, block);
+		*ret = b;
+		return 0;
+	}
+}
+
+int
+buffer_read(struct device *dev, daddr_t block, struct buf **ret)
+{
+	struct buf *b;
+	int result;
+
+	lock_acquire(buf_lock);
+	result = buffer_lookup(dev, block, &b);
+	if (result) {
+		lock_release(buf_lock);
+		return result;
+	}
+
+	if (!b->b_valid) {
+		b->b_busy = true;
+		lock_release(buf_lock);
+		result = buffer_devio(dev, block, b->b_data, UIO_READ);
+		lock_acquire(buf_lock);
+		buf_stats.bs_reads++;
+		b->b_busy = false;
+		cv_broadcast(buf_cv, buf_lock);
+		if (result) {
+			/* Leave it invalid, to be reused first. */
+			buffer_unpin(b, true);
+			lock_release(buf_lock);
+			return result;
+		}
+		b->b_valid = true;
+	}
+
+	lock_release(buf_lock);
+	*ret = b;
+	return 0;
+}
+
+int
+buffer_get(struct device *dev, daddr_t block, struct buf **ret)
+{
+	struct buf *b;
+	int result;
+
+	lock_acquire(buf_lock);
+	result = buffer_lookup(dev, block, &b);
+	if (result) {
+		lock_release(buf_lock);
+		return result;
+	}
+	if (!b->b_valid) {
+		bzero(b->b_data, BUFFER_SIZE);
+		b->b_valid = true;
+	}
+	lock_release(buf_lock);
+
+	*ret = b;
+	return 0;
+}
+
+void
+buffer_release(struct buf *b)
+{
+	lock_acquire(buf_lock);
+	buffer_unpin(b, false);
+	lock_release(buf_lock);
+}
+
+void *
+buffer_map(struct buf *b)
+{
+	KASSERT(b->b_pins > 0);
+	return b->b_data;
+}
+
+void
+buffer_markdirty(struct buf *b)
+{
+	lock_acquire(buf_lock);
+	KASSERT(b->b_pins > 0);
+	KASSERT(b->b_valid);
+	buffer_setdirty(b, true);
+	lock_release(buf_lock);
+}
+
+/*
+ * Work function for read-ahead.
+ */
+static
+void
+buffer_readahead_work(void *vb)
+{
+	struct buf *b = vb;
+	int result;
+
+	result = buffer_devio(b->b_dev, b->b_block, b->b_data, UIO_READ);
+
+	lock_acquire(buf_lock);
+	buf_stats.bs_reads++;
+	b->b_busy = false;
+	b->b_valid = (result == 0);
+	cv_broadcast(buf_cv, buf_lock);
+	/* If it failed, reuse it first; nobody's waiting for it to work. */
+	buffer_unpin(b, result != 0);
+	lock_release(buf_lock);
+}
+
+void
+buffer_readahead(struct device *dev, daddr_t block)
+{
+	struct buf *b;
+
+	lock_acquire(buf_lock);
+	if (!buf_readahead_on || buffer_find(dev, block) != NULL) {
+		lock_release(buf_lock);
+		return;
+	}
+
+	b = NULL;
+	if (buf_count < BUF_MAX) {
+		b = buffer_create();
+	}
+	if (b == NULL) {
+		b = buf_lruhead;
+		if (b == NULL || b->b_dirty) {
+			/* Not worth waiting or writing for. */
+			lock_release(buf_lock);
+			return;
+		}
+		buffer_lru_remove(b);
+		buffer_hash_remove(b);
+		buf_stats.bs_evictions++;
+	}
+	buffer_setkey(b, dev, block);
+	b->b_busy = true;
+	buf_stats.bs_readaheads++;
+	lock_release(buf_lock);
+
+	workqueue_enqueue(&b->b_work);
+}
+
+void
+buffer_drop(struct device *dev, daddr_t block)
+{
+	struct buf *b;
+
+	lock_acquire(buf_lock);
+	while ((b = buffer_find(dev, block)) != NULL &&
+	       (b->b_busy || b->b_pins > 0)) {
+		/*
+		 * A read-ahead is still filling it in, or it's being
+		 * written back (by the syncer or to evict it), which
+		 * pins it without making it busy. The owner of the
+		 * block being freed holds no pins of its own, so this
+		 * only waits for the I/O.
+		 */
+		cv_wait(buf_cv, buf_lock);
+	}
+	if (b != NULL) {
+		buffer_destroy(b);
+	}
+	lock_release(buf_lock);
+}
+
+////////////////////////////////////////////////////////////
+// Writeback
+
+/*
+ * Write back all of DEV's dirty buffers.
+ *
+ * We do them in batches: each batch is the BUF_SYNCBATCH lowest
+ * numbered dirty blocks, so unless more blocks get dirtied meanwhile
+ * the disk sees the whole lot in ascending order. Buffers are pinned,
+ * not busy, while they're being written, so they can still be used;
+ * if one is changed during the write it'll get marked dirty again
+ * afterwards.
+ *
+ * Only buffers dirtied no later than the tick we started in are
+ * written. Otherwise writers that keep dirtying blocks while we're
+ * writing would keep every batch full and we'd never return; what
+ * they dirty later is left for the next sync.
+ */
+int
+buffer_sync(struct device *dev)
+{
+	struct buf *batch[BUF_SYNCBATCH];
+	struct buf *b;
+	uint32_t start;
+	unsigned i, j, n;
+	int result, err = 0;
+
+	lock_acquire(buf_lock);
+	start = hardclock_ticks;
+	do {
+		/* Find the lowest dirty blocks, in order. */
+		n = 0;
+		for (i=0; i<BUF_HASHSIZE; i++) {
+			for (b = buf_hash[i]; b != NULL; b = b->b_hashnext) {
+				if (b->b_dev != dev || !b->b_dirty) {
+					continue;
+				}
+				if ((int32_t)(b->b_dirtytime - start) > 0) {
+					/* Dirtied since we started. */
+					continue;
+				}
+				if (n == BUF_SYNCBATCH) {
+					if (batch[n-1]->b_block < b->b_block) {
+						continue;
+					}
+					/* Bump the highest one. */
+					n--;
+				}
+				for (j = n; j > 0 &&
+					     batch[j-1]->b_block > b->b_block;
+				     j--) {
+					batch[j] = batch[j-1];
+				}
+				batch[j] = b;
+				n++;
+			}
+		}
+		for (i=0; i<n; i++) {
+			buffer_pin(batch[i]);
+			buffer_setclean(batch[i]);
+		}
+
+		lock_release(buf_lock);
+		for (i=0; i<n; i++) {
+			b = batch[i];
+			result = buffer_devio(dev, b->b_block, b->b_data,
+					      UIO_WRITE);
+			if (result) {
+				lock_acquire(buf_lock);
+				buffer_setdirty(b, false);
+				lock_release(buf_lock);
+				err = result;
+			}
+		}
+		lock_acquire(buf_lock);
+		buf_stats.bs_writes += n;
+		for (i=0; i<n; i++) {
+			buffer_unpin(batch[i], false);
+		}
+	} while (n == BUF_SYNCBATCH && err == 0);
+	lock_release(buf_lock);
+
+	return err;
+}
+
+/*
+ * Write back and throw away all of DEV's buffers.
+ */
+int
+buffer_purge(struct device *dev)
+{
+	struct buf *b, *next;
+	unsigned i;
+	int result;
+
+	result = buffer_sync(dev);
+	if (result) {
+		return result;
+	}
+
+	lock_acquire(buf_lock);
+	for (i=0; i<BUF_HASHSIZE; i++) {
+		for (b = buf_hash[i]; b != NULL; b = next) {
+			next = b->b_hashnext;
+			if (b->b_dev != dev) {
+				continue;
+			}
+			if (b->b_busy) {
+				/* Wait for the read-ahead; rescan the chain. */
+				cv_wait(buf_cv, buf_lock);
+				next = buf_hash[i];
+				continue;
+			}
+			KASSERT(!b->b_dirty);
+			buffer_destroy(b);
+		}
+	}
+	lock_release(buf_lock);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+// Syncer
+
+/*
+ * Wake the syncer up early. Called with buf_lock held.
+ */
+static
+void
+buffer_syncer_kick(void)
+{
+	buf_stats.bs_kicks++;
+	spinlock_acquire(&buf_syncer_lock);
+	buf_syncer_kicked = true;
+	wchan_wakeone(buf_syncer_wchan, &buf_syncer_lock);
+	spinlock_release(&buf_syncer_lock);
+}
+
+static
+void
+buffer_syncer(void *data1, unsigned long data2)
+{
+	uint32_t lastsync, maxage;
+	bool kicked;
+
+	(void)data1;
+	(void)data2;
+
+	lastsync = hardclock_ticks;
+	while (1) {
+		spinlock_acquire(&buf_syncer_lock);
+		if (!buf_syncer_kicked) {
+			wchan_sleep_timeout(buf_syncer_wchan,
+					    &buf_syncer_lock,
+					    BUF_SYNCINTERVAL * HZ);
+		}
+		kicked = buf_syncer_kicked;
+		buf_syncer_kicked = false;
+		spinlock_release(&buf_syncer_lock);
+
+		lock_acquire(buf_lock);
+		maxage = buf_maxage * HZ;
+		lock_release(buf_lock);
+
+		if (!kicked && hardclock_ticks - lastsync < maxage) {
+			continue;
+		}
+
+		/*
+		 * Anything dirtied after this point is caught by the
+		 * next pass, at most maxage from now.
+		 */
+		lastsync = hardclock_ticks;
+		vfs_sync();
+
+		lock_acquire(buf_lock);
+		buf_stats.bs_syncs++;
+		lock_release(buf_lock);
+	}
+}
+
+void
+buffer_setmaxage(unsigned seconds)
+{
+	KASSERT(seconds > 0);
+	lock_acquire(buf_lock);
+	buf_maxage = seconds;
+	lock_release(buf_lock);
+}
+
+void
+buffer_setreadahead(bool on)
+{
+	lock_acquire(buf_lock);
+	buf_readahead_on = on;
+	lock_release(buf_lock);
+}
+
+void
+buffer_syncer_start(void)
+{
+	int result;
+
+	result = thread_fork("syncer", NULL, buffer_syncer, NULL, 0);
+	if (result) {
+		panic("buffer_syncer_start: thread_fork: %s\n",
+		      strerror(result));
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Setup and stats
+
+void
+buffer_printstats(void)
+{
+	lock_acquire(buf_lock);
+	kprintf("Buffer cache: %u of %u buffers in use\n",
+		buf_count, BUF_MAX);
+	kprintf("    %u lookups, %u hits, hit rate %u%%\n",
+		buf_stats.bs_lookups, buf_stats.bs_hits,
+		buf_stats.bs_lookups == 0 ? 0 :
+		(unsigned)((uint64_t)buf_stats.bs_hits * 100 /
+			   buf_stats.bs_lookups));
+	kprintf("    %u reads (%u read-ahead, %s), %u writes, "
+		"%u evictions\n",
+		buf_stats.bs_reads, buf_stats.bs_readaheads,
+		buf_readahead_on ? "on" : "off",
+		buf_stats.bs_writes, buf_stats.bs_evictions);
+	kprintf("    %u dirty; oldest written back was %u ms old\n",
+		buf_ndirty, buf_stats.bs_maxdirtyage * (1000 / HZ));
+	kprintf("Syncer: max dirty age %u s, %u passes "
+		"(%u woken early)\n",
+		buf_maxage, buf_stats.bs_syncs, buf_stats.bs_kicks);
+	lock_release(buf_lock);
+}
+
+void
+buffer_bootstrap(void)
+{
+	buf_lock = lock_create("buffer cache");
+	if (buf_lock == NULL) {
+		panic("buffer_bootstrap: Out of memory\n");
+	}
+	buf_cv = cv_create("buffer cache");
+	if (buf_cv == NULL) {
+		panic("buffer_bootstrap: Out of memory\n");
+	}
+	spinlock_init(&buf_syncer_lock);
+	buf_syncer_wchan = wchan_create("syncer");
+	if (buf_syncer_wchan == NULL) {
+		panic("buffer_bootstrap: Out of memory\n");
+	}
+}
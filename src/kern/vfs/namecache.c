@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Name cache. See namecache.h.
+ *
+ * There are NC_MAX entries, allocated statically, all of them always
+ * on an LRU list, oldest first; unused entries (nc_dir == NULL) are
+ * kept at the old end so they're used first. Entries in use are also
+ * on a hash chain by (directory, name).
+ *
+ * Each vnode counts the entries that mention it (vn_nccount) so that
+ * purging a vnode nobody cached, the usual case, doesn't have to
+ * look at the whole table.
+ *
+ * nc_lock protects everything, including vn_nccount, except the
+ * lookup statistics: every path component of every name lookup comes
+ * through namecache_lookup, so those are per-CPU counters updated
+ * after nc_lock is dropped. Nothing here sleeps.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <percpu.h>
+#include <vnode.h>
+#include <namecache.h>
+
+/* Number of entries. */
+#define NC_MAX		512
+
+/* Number of hash chains. */
+#define NC_HASHSIZE	256
+
+struct ncentry {
+	struct ncentry *nc_hashnext;		/* hash chain */
+	struct ncentry *nc_lruprev;		/* LRU list */
+	struct ncentry *nc_lrunext;
+	struct vnode *nc_dir;			/* key: directory */
+	struct vnode *nc_vn;			/* result; NULL if none */
+	char nc_name[NAMECACHE_NAMELEN];	/* key: name */
+};
+
+static struct spinlock nc_lock = SPINLOCK_INITIALIZER;
+static struct ncentry nc_entries[NC_MAX];
+static struct ncentry *nc_hash[NC_HASHSIZE];
+static struct ncentry *nc_lruhead;		/* oldest */
+static struct ncentry *nc_lrutail;		/* newest */
+
+static struct percpu_counter nc_lookups;
+static struct percpu_counter nc_hits;
+static struct percpu_counter nc_neghits;
+
+/* Protected by nc_lock. */
+static struct {
+	unsigned ns_enters;
+	unsigned ns_purges;
+} nc_stats;
+
+////////////////////////////////////////////////////////////
+// Tables
+
+static
+unsigned
+namecache_hashval(struct vnode *dir, const char *name)
+{
+	unsigned hv = (uintptr_t)dir >> 4;
+
+	while (*name) {
+		hv = hv * 31 + (unsigned char)*name++;
+	}
+	return hv % NC_HASHSIZE;
+}
+
+static
+struct ncentry *
+namecache_find(struct vnode *dir, const char *name)
+{
+	struct ncentry *nc;
+
+	for (nc = nc_hash[namecache_hashval(dir, name)];
+	     nc != NULL; nc = nc->nc_hashnext) {
+		if (nc->nc_dir == dir && !strcmp(nc->nc_name, name)) {
+			return nc;
+		}
+	}
+	return NULL;
+}
+
+static
+void
+namecache_lru_remove(struct ncentry *nc)
+{
+	if (nc->nc_lruprev != NULL) {
+		nc->nc_lruprev->nc_lrunext = nc->nc_lrunext;
+	}
+	else {
+		nc_lruhead = nc->nc_lrunext;
+	}
+	if (nc->nc_lrunext != NULL) {
+		nc->nc_lrunext->nc_lruprev = nc->nc_lruprev;
+	}
+	else {
+		nc_lrutail = nc->nc_lruprev;
+	}
+	nc->nc_lruprev = nc->nc_lrunext = NULL;
+}
+
+/*
+ * Put NC on the LRU list: at the new end normally, or at the old end
+ * if it's been emptied and should be reused first.
+ */
+static
+void
+namecache_lru_add(struct ncentry *nc, bool oldest)
+{
+	if (oldest) {
+		nc->nc_lruprev = NULL;
+		nc->nc_lrunext = nc_lruhead;
+		if (nc_lruhead != NULL) {
+			nc_lruhead->nc_lruprev = nc;
+		}
+		else {
+			nc_lrutail = nc;
+		}
+		nc_lruhead = nc;
+	}
+	else {
+		nc->nc_lrunext = NULL;
+		nc->nc_lruprev = nc_lrutail;
+		if (nc_lrutail != NULL) {
+			nc_lrutail->nc_lrunext = nc;
+		}
+		else {
+			nc_lruhead = nc;
+		}
+		nc_lrutail = nc;
+	}
+}
+
+/*
+ * Empty an entry that's in use and move it to the old end.
+ */
+static
+void
+namecache_remove(struct ncentry *nc)
+{
+	struct ncentry **pp;
+
+	KASSERT(nc->nc_dir != NULL);
+
+	pp = &nc_hash[namecache_hashval(nc->nc_dir, nc->nc_name)];
+	while (*pp != nc) {
+		KASSERT(*pp != NULL);
+		pp = &(*pp)->nc_hashnext;
+	}
+	*pp = nc->nc_hashnext;
+	nc->nc_hashnext = NULL;
+
+	KASSERT(nc->nc_dir->vn_nccount > 0);
+	nc->nc_dir->vn_nccount--;
+	if (nc->nc_vn != NULL) {
+		KASSERT(nc->nc_vn->vn_nccount > 0);
+		nc->nc_vn->vn_nccount--;
+	}
+	nc->nc_dir = NULL;
+	nc->nc_vn = NULL;
+
+	namecache_lru_remove(nc);
+	namecache_lru_add(nc, true);
+	nc_stats.ns_purges++;
+}
+
+////////////////////////////////////////////////////////////
+// Interface
+
+bool
+namecache_lookup(struct vnode *dir, const char *name, struct vnode **ret)
+{
+	struct ncentry *nc;
+	struct vnode *vn;
+
+	spinlock_acquire(&nc_lock);
+	nc = namecache_find(dir, name);
+	if (nc == NULL) {
+		spinlock_release(&nc_lock);
+		percpu_counter_add(&nc_lookups, 1);
+		return false;
+	}
+
+	namecache_lru_remove(nc);
+	namecache_lru_add(nc, false);
+
+	vn = nc->nc_vn;
+	if (vn != NULL) {
+		VOP_INCREF(vn);
+	}
+	spinlock_release(&nc_lock);
+
+	percpu_counter_add(&nc_lookups, 1);
+	percpu_counter_add(&nc_hits, 1);
+	if (vn == NULL) {
+		percpu_counter_add(&nc_neghits, 1);
+	}
+	*ret = vn;
+	return true;
+}
+
+void
+namecache_enter(struct vnode *dir, const char *name, struct vnode *vn)
+{
+	struct ncentry *nc;
+
+	if (strlen(name) >= NAMECACHE_NAMELEN) {
+		return;
+	}
+
+	spinlock_acquire(&nc_lock);
+	nc = namecache_find(dir, name);
+	if (nc != NULL) {
+		/* Replace whatever we had. */
+		namecache_remove(nc);
+	}
+
+	/* Take the oldest entry. */
+	nc = nc_lruhead;
+	KASSERT(nc != NULL);
+	if (nc->nc_dir != NULL) {
+		namecache_remove(nc);
+	}
+
+	nc->nc_dir = dir;
+	nc->nc_vn = vn;
+	strcpy(nc->nc_name, name);
+	dir->vn_nccount++;
+	if (vn != NULL) {
+		vn->vn_nccount++;
+	}
+
+	nc->nc_hashnext = nc_hash[namecache_hashval(dir, name)];
+	nc_hash[namecache_hashval(dir, name)] = nc;
+	namecache_lru_remove(nc);
+	namecache_lru_add(nc, false);
+	nc_stats.ns_enters++;
+	spinlock_release(&nc_lock);
+}
+
+void
+namecache_purge(struct vnode *dir, const char *name)
+{
+	struct ncentry *nc;
+
+	spinlock_acquire(&nc_lock);
+	nc = namecache_find(dir, name);
+	if (nc != NULL) {
+		namecache_remove(nc);
+	}
+	spinlock_release(&nc_lock);
+}
+
+void
+namecache_purgevnode(struct vnode *vn)
+{
+	unsigned i;
+
+	spinlock_acquire(&nc_lock);
+	for (i=0; i<NC_MAX && vn->vn_nccount > 0; i++) {
+		if (nc_entries[i].nc_dir == vn ||
+		    (nc_entries[i].nc_dir != NULL &&
+		     nc_entries[i].nc_vn == vn)) {
+			namecache_remove(&nc_entries[i]);
+		}
+	}
+	KASSERT(vn->vn_nccount == 0);
+	spinlock_release(&nc_lock);
+}
+
+////////////////////////////////////////////////////////////
+// Setup and stats
+
+void
+namecache_printstats(void)
+{
+	unsigned lookups, hits, neghits, enters, purges;
+
+	lookups = percpu_counter_read(&nc_lookups);
+	hits = percpu_counter_read(&nc_hits);
+	neghits = percpu_counter_read(&nc_neghits);
+
+	spinlock_acquire(&nc_lock);
+	enters = nc_stats.ns_enters;
+	purges = nc_stats.ns_purges;
+	spinlock_release(&nc_lock);
+
+	kprintf("Name cache: %u entries\n", NC_MAX);
+	kprintf("    %u lookups, %u hits (%u negative), hit rate %u%%\n",
+		lookups, hits, neghits,
+		lookups == 0 ? 0 : (unsigned)((uint64_t)hits * 100 / lookups));
+	kprintf("    %u entered, %u purged\n", enters, purges);
+}
+
+void
+namecache_bootstrap(void)
+{
+	unsigned i;
+
+	for (i=0; i<NC_MAX; i++) {
+		nc_entries[i].nc_hashnext = NULL;
+		nc_entries[i].nc_lruprev = nc_entries[i].nc_lrunext = NULL;
+		nc_entries[i].nc_dir = NULL;
+		nc_entries[i].nc_vn = NULL;
+		namecache_lru_add(&nc_entries[i], false);
+	}
+}
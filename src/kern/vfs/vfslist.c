@@ -37,12 +37,15 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
-#include <array.h>
+#include <membar.h>
 #include <synch.h>
+#include <epoch.h>
 #include <vfs.h>
 #include <fs.h>
 #include <vnode.h>
 #include <device.h>
+#include <buf.h>
+#include <namecache.h>
 
 /*
  * Structure for a single named device.
@@ -82,25 +85,112 @@ struct knowndev {
 	struct fs *kd_fs;
 };
 
-DECLARRAY(knowndev, static __UNUSED inline);
-DEFARRAY(knowndev, static __UNUSED inline);
+/*
+ * The table of known devices.
+ *
+ * The table is never changed in place. vfs_doadd builds a copy with
+ * the new entry, publishes it, and frees the old copy after an epoch
+ * grace period (see epoch.h). So code that doesn't sleep can walk the
+ * table with no lock, inside an epoch read section; see
+ * knowndevs_find. Code holding vfs_biglock, which vfs_doadd also
+ * holds, can just use it.
+ *
+ * Entries are never removed, so a struct knowndev found in the table
+ * stays valid after the read section ends. Its kd_fs field changes on
+ * mount and unmount, under vfs_biglock. Following kd_fs (calling FSOP
+ * functions on it) needs vfs_biglock, since unmount frees the fs. But
+ * kd_fs is one word, and mount sets it only after a barrier, so it
+ * can be read and compared without the lock, as vfs_getdevname does.
+ */
+struct knowndevtab {
+	struct epoch_cb kt_free;	/* for freeing after replacement */
+	unsigned kt_num;		/* number of entries */
+	struct knowndev *kt_devs[];	/* the entries */
+};
 
-static struct knowndevarray *knowndevs;
+static struct knowndevtab *volatile knowndevs;
 
 /* The big lock for all FS ops. Remove for filesystem assignment. */
 static struct lock *vfs_biglock;
 static unsigned vfs_biglock_depth;
 
 
+/*
+ * Knowndevs table functions.
+ */
+static
+struct knowndevtab *
+knowndevtab_create(unsigned num)
+{
+	struct knowndevtab *kt;
+
+	kt = kmalloc(sizeof(*kt) + num * sizeof(kt->kt_devs[0]));
+	if (kt == NULL) {
+		return NULL;
+	}
+	kt->kt_num = num;
+	return kt;
+}
+
+static
+void
+knowndevtab_free(void *kt)
+{
+	kfree(kt);
+}
+
+/*
+ * Get the current table, in an epoch read section or with
+ * vfs_biglock held.
+ */
+static
+struct knowndevtab *
+knowndevs_get(void)
+{
+	struct knowndevtab *kt;
+
+	kt = knowndevs;
+	membar_load_load();
+	return kt;
+}
+
+/*
+ * Look up a device by name or raw name. Lock-free.
+ */
+static
+struct knowndev *
+knowndevs_find(const char *devname)
+{
+	struct knowndevtab *kt;
+	struct knowndev *kd, *ret;
+	unsigned i;
+
+	ret = NULL;
+	epoch_enter();
+	kt = knowndevs_get();
+	for (i=0; i<kt->kt_num; i++) {
+		kd = kt->kt_devs[i];
+		if (!strcmp(kd->kd_name, devname) ||
+		    (kd->kd_rawname != NULL &&
+		     !strcmp(kd->kd_rawname, devname))) {
+			ret = kd;
+			break;
+		}
+	}
+	epoch_exit();
+
+	return ret;
+}
+
 /*
  * Setup function
  */
 void
 vfs_bootstrap(void)
 {
-	knowndevs = knowndevarray_create();
+	knowndevs = knowndevtab_create(0);
 	if (knowndevs==NULL) {
-		panic("vfs: Could not create knowndevs array\n");
+		panic("vfs: Could not create knowndevs table\n");
 	}
 
 	vfs_biglock = lock_create("vfs_biglock");
@@ -109,6 +199,9 @@ vfs_bootstrap(void)
 	}
 	vfs_biglock_depth = 0;
 
+	buffer_bootstrap();
+	namecache_bootstrap();
+
 	devnull_create();
 	semfs_bootstrap();
 }
@@ -152,14 +245,16 @@ vfs_biglock_do_i_hold(void)
 int
 vfs_sync(void)
 {
+	struct knowndevtab *kt;
 	struct knowndev *dev;
 	unsigned i, num;
 
 	vfs_biglock_acquire();
 
-	num = knowndevarray_num(knowndevs);
+	kt = knowndevs_get();
+	num = kt->kt_num;
 	for (i=0; i<num; i++) {
-		dev = knowndevarray_get(knowndevs, i);
+		dev = kt->kt_devs[i];
 		if (dev->kd_fs != NULL) {
 			/*result =*/ FSOP_SYNC(dev->kd_fs);
 		}
@@ -173,52 +268,48 @@ vfs_sync(void)
 /*
  * Given a device name (lhd0, emu0, somevolname, null, etc.), hand
  * back an appropriate vnode.
+ *
+ * Finding the device by name is lock-free (knowndevs_find), and a
+ * raw or plain device comes back without any lock. Anything that
+ * follows kd_fs takes vfs_biglock, which the caller may already hold.
  */
 int
 vfs_getroot(const char *devname, struct vnode **ret)
 {
+	struct knowndevtab *kt;
 	struct knowndev *kd;
+	const char *volname;
 	unsigned i, num;
+	int result;
 
-	KASSERT(vfs_biglock_do_i_hold());
-
-	num = knowndevarray_num(knowndevs);
-	for (i=0; i<num; i++) {
-		kd = knowndevarray_get(knowndevs, i);
-
+	kd = knowndevs_find(devname);
+	if (kd != NULL) {
 		/*
 		 * If this device has a mounted filesystem, and
-		 * DEVNAME names either the filesystem or the device,
-		 * return the root of the filesystem.
+		 * DEVNAME names the device, return the root of the
+		 * filesystem.
 		 *
 		 * If it has no mounted filesystem, it's mountable,
 		 * and DEVNAME names the device, return ENXIO.
 		 */
-
-		if (kd->kd_fs!=NULL) {
-			const char *volname;
-			volname = FSOP_GETVOLNAME(kd->kd_fs);
-
-			if (!strcmp(kd->kd_name, devname) ||
-			    (volname!=NULL && !strcmp(volname, devname))) {
-				return FSOP_GETROOT(kd->kd_fs, ret);
-			}
-		}
-		else {
-			if (kd->kd_rawname!=NULL &&
-			    !strcmp(kd->kd_name, devname)) {
-				return ENXIO;
+		if (!strcmp(kd->kd_name, devname)) {
+			if (kd->kd_rawname != NULL || kd->kd_fs != NULL) {
+				vfs_biglock_acquire();
+				if (kd->kd_fs != NULL) {
+					result = FSOP_GETROOT(kd->kd_fs, ret);
+				}
+				else {
+					result = ENXIO;
+				}
+				vfs_biglock_release();
+				return result;
 			}
-		}
 
-		/*
-		 * If DEVNAME names the device, and we get here, it
-		 * must have no fs and not be mountable. In this case,
-		 * we return the device itself.
-		 */
-		if (!strcmp(kd->kd_name, devname)) {
-			KASSERT(kd->kd_fs==NULL);
-			KASSERT(kd->kd_rawname==NULL);
+			/*
+			 * Otherwise it must have no fs and not be
+			 * mountable. In this case, we return the
+			 * device itself.
+			 */
 			KASSERT(kd->kd_device != NULL);
 			VOP_INCREF(kd->kd_vnode);
 			*ret = kd->kd_vnode;
@@ -226,28 +317,45 @@ vfs_getroot(const char *devname, struct vnode **ret)
 		}
 
 		/*
-		 * If the device has a rawname and DEVNAME names that,
-		 * return the device itself.
+		 * DEVNAME names the raw device; return the device
+		 * itself.
 		 */
-		if (kd->kd_rawname!=NULL && !strcmp(kd->kd_rawname, devname)) {
-			KASSERT(kd->kd_device != NULL);
-			VOP_INCREF(kd->kd_vnode);
-			*ret = kd->kd_vnode;
-			return 0;
-		}
+		KASSERT(kd->kd_rawname != NULL);
+		KASSERT(kd->kd_device != NULL);
+		VOP_INCREF(kd->kd_vnode);
+		*ret = kd->kd_vnode;
+		return 0;
+	}
 
-		/*
-		 * If none of the above tests matched, we didn't name
-		 * any of the names of this device, so go on to the
-		 * next one.
-		 */
+	/*
+	 * Not a device name; try the volume names of mounted
+	 * filesystems. FSOP_GETVOLNAME may take locks, so this can't
+	 * be done in a read section; vfs_biglock, which keeps the
+	 * table and kd_fs from changing, does instead.
+	 */
+	result = ENODEV;
+	vfs_biglock_acquire();
+	kt = knowndevs_get();
+	num = kt->kt_num;
+	for (i=0; i<num; i++) {
+		kd = kt->kt_devs[i];
+		if (kd->kd_fs == NULL) {
+			continue;
+		}
+		volname = FSOP_GETVOLNAME(kd->kd_fs);
+		if (volname != NULL && !strcmp(volname, devname)) {
+			result = FSOP_GETROOT(kd->kd_fs, ret);
+			break;
+		}
 	}
+	vfs_biglock_release();
 
 	/*
-	 * If we got here, the device specified by devname doesn't exist.
+	 * If nothing matched, the device specified by devname doesn't
+	 * exist.
 	 */
 
-	return ENODEV;
+	return result;
 }
 
 /*
@@ -256,29 +364,34 @@ vfs_getroot(const char *devname, struct vnode **ret)
 const char *
 vfs_getdevname(struct fs *fs)
 {
+	struct knowndevtab *kt;
 	struct knowndev *kd;
-	unsigned i, num;
+	const char *ret;
+	unsigned i;
 
 	KASSERT(fs != NULL);
 
-	KASSERT(vfs_biglock_do_i_hold());
-
-	num = knowndevarray_num(knowndevs);
-	for (i=0; i<num; i++) {
-		kd = knowndevarray_get(knowndevs, i);
-
+	/*
+	 * This needs no lock. The caller holds a reference to the fs,
+	 * so it can't be unmounted, and the kd_fs that points to it
+	 * can't change while we look. Other entries' kd_fs may be
+	 * changing, but we only compare them, never follow them (see
+	 * above). The names are never freed, so we can hand one back
+	 * after the read section.
+	 */
+	ret = NULL;
+	epoch_enter();
+	kt = knowndevs_get();
+	for (i=0; i<kt->kt_num; i++) {
+		kd = kt->kt_devs[i];
 		if (kd->kd_fs == fs) {
-			/*
-			 * This is not a race condition: as long as the
-			 * guy calling us holds a reference to the fs,
-			 * the fs cannot go away, and the device can't
-			 * go away until the fs goes away.
-			 */
-			return kd->kd_name;
+			ret = kd->kd_name;
+			break;
 		}
 	}
+	epoch_exit();
 
-	return NULL;
+	return ret;
 }
 
 /*
@@ -336,13 +449,15 @@ badnames(const char *n1, const char *n2, const char *n3)
 {
 	const char *volname;
 	unsigned i, num;
+	struct knowndevtab *kt;
 	struct knowndev *kd;
 
 	KASSERT(vfs_biglock_do_i_hold());
 
-	num = knowndevarray_num(knowndevs);
+	kt = knowndevs_get();
+	num = kt->kt_num;
 	for (i=0; i<num; i++) {
-		kd = knowndevarray_get(knowndevs, i);
+		kd = kt->kt_devs[i];
 
 		if (kd->kd_fs) {
 			volname = FSOP_GETVOLNAME(kd->kd_fs);
@@ -372,10 +487,11 @@ int
 vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 {
 	char *name=NULL, *rawname=NULL;
+	struct knowndevtab *oldkt, *newkt=NULL;
 	struct knowndev *kd=NULL;
 	struct vnode *vnode=NULL;
 	const char *volname=NULL;
-	unsigned index;
+	unsigned index, i;
 	int result;
 
 	vfs_biglock_acquire();
@@ -420,16 +536,31 @@ vfs_doadd(const char *dname, int mountable, struct device *dev, struct fs *fs)
 		goto fail;
 	}
 
-	result = knowndevarray_add(knowndevs, kd, &index);
-	if (result) {
+	oldkt = knowndevs_get();
+	newkt = knowndevtab_create(oldkt->kt_num + 1);
+	if (newkt==NULL) {
+		result = ENOMEM;
 		goto fail;
 	}
+	for (i=0; i<oldkt->kt_num; i++) {
+		newkt->kt_devs[i] = oldkt->kt_devs[i];
+	}
+	index = oldkt->kt_num;
+	newkt->kt_devs[index] = kd;
 
 	if (dev != NULL) {
 		/* use index+1 as the device number, so 0 is reserved */
 		dev->d_devnumber = index+1;
 	}
 
+	/*
+	 * Publish the new table only once it's complete, and free the
+	 * old one once nobody can still be looking at it.
+	 */
+	membar_store_store();
+	knowndevs = newkt;
+	epoch_defer(&oldkt->kt_free, knowndevtab_free, oldkt);
+
 	vfs_biglock_release();
 	return 0;
 
@@ -482,15 +613,17 @@ static
 int
 findmount(const char *devname, struct knowndev **result)
 {
+	struct knowndevtab *kt;
 	struct knowndev *dev;
 	unsigned i, num;
 	bool found = false;
 
 	KASSERT(vfs_biglock_do_i_hold());
 
-	num = knowndevarray_num(knowndevs);
+	kt = knowndevs_get();
+	num = kt->kt_num;
 	for (i=0; !found && i<num; i++) {
-		dev = knowndevarray_get(knowndevs, i);
+		dev = kt->kt_devs[i];
 		if (dev->kd_rawname==NULL) {
 			/* not mountable/unmountable */
 			continue;
@@ -543,6 +676,8 @@ vfs_mount(const char *devname, void *data,
 
 	KASSERT(fs != NULL);
 
+	/* Make the fs visible to vfs_getdevname only once it's set up. */
+	membar_store_store();
 	kd->kd_fs = fs;
 
 	volname = FSOP_GETVOLNAME(fs);
@@ -606,15 +741,17 @@ vfs_unmount(const char *devname)
 int
 vfs_unmountall(void)
 {
+	struct knowndevtab *kt;
 	struct knowndev *dev;
 	unsigned i, num;
 	int result;
 
 	vfs_biglock_acquire();
 
-	num = knowndevarray_num(knowndevs);
+	kt = knowndevs_get();
+	num = kt->kt_num;
 	for (i=0; i<num; i++) {
-		dev = knowndevarray_get(knowndevs, i);
+		dev = kt->kt_devs[i];
 		if (dev->kd_rawname == NULL) {
 			/* not mountable/unmountable */
 			continue;
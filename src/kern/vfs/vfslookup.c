@@ -240,13 +240,17 @@ vfs_lookparent(char *path, struct vnode **retval,
 	int result;
 
 	vfs_biglock_acquire();
-
 	result = getdevice(path, &path, &startvn);
+	vfs_biglock_release();
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
+	/*
+	 * We have a reference to STARTVN, so the rest doesn't need
+	 * the big lock; filesystems that want it take it themselves.
+	 */
+
 	if (strlen(path)==0) {
 		/*
 		 * It does not make sense to use just a device name in
@@ -261,7 +265,6 @@ vfs_lookparent(char *path, struct vnode **retval,
 
 	VOP_DECREF(startvn);
 
-	vfs_biglock_release();
 	return result;
 }
 
@@ -272,22 +275,20 @@ vfs_lookup(char *path, struct vnode **retval)
 	int result;
 
 	vfs_biglock_acquire();
-
 	result = getdevice(path, &path, &startvn);
+	vfs_biglock_release();
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
 	if (strlen(path)==0) {
 		*retval = startvn;
-		vfs_biglock_release();
 		return 0;
 	}
 
+	/* As in vfs_lookparent, the rest doesn't need the big lock. */
 	result = VOP_LOOKUP(startvn, path, retval);
 
 	VOP_DECREF(startvn);
-	vfs_biglock_release();
 	return result;
 }
@@ -36,6 +36,7 @@
 #include <synch.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <namecache.h>
 
 /*
  * Initialize an abstract vnode.
@@ -48,10 +49,10 @@ vnode_init(struct vnode *vn, const struct vnode_ops *ops,
 	KASSERT(ops != NULL);
 
 	vn->vn_ops = ops;
-	vn->vn_refcount = 1;
-	spinlock_init(&vn->vn_countlock);
+	atomic_store(&vn->vn_refcount, 1);
 	vn->vn_fs = fs;
 	vn->vn_data = fsdata;
+	vn->vn_nccount = 0;
 	return 0;
 }
 
@@ -61,12 +62,13 @@ vnode_init(struct vnode *vn, const struct vnode_ops *ops,
 void
 vnode_cleanup(struct vnode *vn)
 {
-	KASSERT(vn->vn_refcount == 1);
+	KASSERT(atomic_load(&vn->vn_refcount) == 1);
 
-	spinlock_cleanup(&vn->vn_countlock);
+	/* The name cache mustn't hand it out again. */
+	namecache_purgevnode(vn);
 
 	vn->vn_ops = NULL;
-	vn->vn_refcount = 0;
+	atomic_store(&vn->vn_refcount, 0);
 	vn->vn_fs = NULL;
 	vn->vn_data = NULL;
 }
@@ -81,9 +83,31 @@ vnode_incref(struct vnode *vn)
 {
 	KASSERT(vn != NULL);
 
-	spinlock_acquire(&vn->vn_countlock);
-	vn->vn_refcount++;
-	spinlock_release(&vn->vn_countlock);
+	atomic_fetchadd(&vn->vn_refcount, 1);
+}
+
+/*
+ * Decrement refcount unless it's 1. Nobody but the caller can take
+ * the count from 1 to 0, since the 1 is the caller's own reference;
+ * and if someone else takes a new reference after we see 1, it's up
+ * to VOP_RECLAIM, which checks again, to notice.
+ */
+bool
+vnode_decref_nonlast(struct vnode *vn)
+{
+	int count;
+
+	KASSERT(vn != NULL);
+
+	do {
+		count = atomic_load(&vn->vn_refcount);
+		KASSERT(count > 0);
+		if (count == 1) {
+			return false;
+		}
+	} while (!atomic_cas(&vn->vn_refcount, count, count - 1));
+
+	return true;
 }
 
 /*
@@ -94,42 +118,32 @@ vnode_incref(struct vnode *vn)
 void
 vnode_decref(struct vnode *vn)
 {
-	bool destroy;
 	int result;
 
-	KASSERT(vn != NULL);
-
-	spinlock_acquire(&vn->vn_countlock);
-
-	KASSERT(vn->vn_refcount > 0);
-	if (vn->vn_refcount > 1) {
-		vn->vn_refcount--;
-		destroy = false;
+	if (vnode_decref_nonlast(vn)) {
+		return;
 	}
-	else {
-		/* Don't decrement; pass the reference to VOP_RECLAIM. */
-		destroy = true;
-	}
-	spinlock_release(&vn->vn_countlock);
-
-	if (destroy) {
-		result = VOP_RECLAIM(vn);
-		if (result != 0 && result != EBUSY) {
-			// XXX: lame.
-			kprintf("vfs: Warning: VOP_RECLAIM: %s\n",
-				strerror(result));
-		}
+
+	/* Don't decrement; pass the reference to VOP_RECLAIM. */
+	result = VOP_RECLAIM(vn);
+	if (result != 0 && result != EBUSY) {
+		// XXX: lame.
+		kprintf("vfs: Warning: VOP_RECLAIM: %s\n",
+			strerror(result));
 	}
 }
 
 /*
  * Check for various things being valid.
  * Called before all VOP_* calls.
+ *
+ * This takes no locks: filesystems call VOPs holding their own, and
+ * everything looked at here is either fixed or read atomically.
  */
 void
 vnode_check(struct vnode *v, const char *opstr)
 {
-	vfs_biglock_acquire();
+	int refcount;
 
 	if (v == NULL) {
 		panic("vnode_check: vop_%s: null vnode\n", opstr);
@@ -158,20 +172,16 @@ vnode_check(struct vnode *v, const char *opstr)
 		panic("vnode_check: vop_%s: deadbeef fs pointer\n", opstr);
 	}
 
-	spinlock_acquire(&v->vn_countlock);
-
-	if (v->vn_refcount < 0) {
+	refcount = atomic_load(&v->vn_refcount);
+	if (refcount < 0) {
 		panic("vnode_check: vop_%s: negative refcount %d\n", opstr,
-		      v->vn_refcount);
+		      refcount);
 	}
-	else if (v->vn_refcount == 0) {
+	else if (refcount == 0) {
 		panic("vnode_check: vop_%s: zero refcount\n", opstr);
 	}
-	else if (v->vn_refcount > 0x100000) {
+	else if (refcount > 0x100000) {
 		kprintf("vnode_check: vop_%s: warning: large refcount %d\n",
-			opstr, v->vn_refcount);
+			opstr, refcount);
 	}
-
-	spinlock_release(&v->vn_countlock);
-	vfs_biglock_release();
 }
@@ -180,3 +180,18 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+int
+as_define_thread_stack(struct addrspace *as, unsigned slot,
+		       vaddr_t *stackptr)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)slot;
+	(void)stackptr;
+
+	return ENOSYS;
+}
+
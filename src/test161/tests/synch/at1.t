@@ -0,0 +1,14 @@
+---
+name: "Atomic Operations Test"
+description:
+  Runs atomic fetch-add, compare-and-swap, and exchange and per-CPU
+  counter updates from many threads at once and checks that no update
+  is lost.
+tags: [synch, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 4
+---
+khu
+at1
+khu
@@ -0,0 +1,14 @@
+---
+name: "Epoch Reclamation Test"
+description:
+  Replaces a shared object while readers look at it in epoch read
+  sections and checks that no reader ever sees a reclaimed object
+  and that deferred frees all happen.
+tags: [synch, kleaks]
+depends: [boot, semaphores, locks]
+sys161:
+  cpus: 4
+---
+khu
+ept1
+khu
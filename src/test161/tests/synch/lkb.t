@@ -0,0 +1,12 @@
+---
+name: "Lock Contention Benchmark"
+description:
+  Times a contended lock with and without adaptive spinning.
+tags: [synch, locks, kleaks]
+depends: [boot, semaphores, locks]
+sys161:
+  cpus: 4
+---
+khu
+lkb
+khu
@@ -0,0 +1,13 @@
+---
+name: "Priority Inheritance Test"
+description:
+  Tests that lock holders inherit the priority of their waiters,
+  transitively across a chain of locks.
+tags: [synch, locks, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 1
+---
+khu
+pi1
+khu
@@ -0,0 +1,13 @@
+---
+name: "Softirq Test"
+description:
+  Checks that softirqs wait for the spl to drop, run in order, and
+  aren't lost when scheduled from threads on every CPU.
+tags: [synch, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 4
+---
+khu
+si1
+khu
@@ -0,0 +1,13 @@
+---
+name: "Spinlock Fairness Benchmark"
+description:
+  Measures spinlock throughput and how evenly the lock is shared
+  between CPUs.
+tags: [synch, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 8
+---
+khu
+spb
+khu
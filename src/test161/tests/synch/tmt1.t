@@ -0,0 +1,11 @@
+---
+name: "Timer Wheel Test"
+description:
+  Tests timed sleeps, sem_timedP, and cv_timedwait, including sleeps
+  long enough to cascade between levels of the timer wheel.
+tags: [synch, kleaks]
+depends: [boot, semaphores, locks]
+---
+khu
+tmt1
+khu
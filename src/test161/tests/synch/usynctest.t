@@ -0,0 +1,11 @@
+---
+name: "User Mutex and Semaphore Test"
+description: >
+  Run the futex-based user-level mutexes and semaphores with several
+  user threads in one process.
+tags: [synch]
+depends: [boot, shell]
+sys161:
+  cpus: 4
+---
+| p /testbin/usynctest
@@ -0,0 +1,13 @@
+---
+name: "Broadcast Wakeup Benchmark"
+description:
+  Times cv_broadcast with 64 waiters spread across CPUs and checks
+  that every waiter wakes.
+tags: [synch, cvs, kleaks]
+depends: [boot, semaphores, locks]
+sys161:
+  cpus: 8
+---
+khu
+wb1
+khu
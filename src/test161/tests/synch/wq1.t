@@ -0,0 +1,14 @@
+---
+name: "Work Queue Test"
+description:
+  Queues work on every CPU, runs and cancels delayed work, and runs a
+  parallel_for, checking that every item runs exactly once and where
+  it was queued.
+tags: [synch, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 4
+---
+khu
+wq1
+khu
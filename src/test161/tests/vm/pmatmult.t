@@ -0,0 +1,11 @@
+---
+name: "Threaded Matrix Mult"
+description: >
+  Run matmult split across four user threads in one address space.
+tags: [vm]
+depends: [boot, shell]
+sys161:
+  cpus: 4
+  ram: 2M
+---
+| p /testbin/pmatmult
@@ -0,0 +1,12 @@
+---
+name: "Threaded Triple Matrix Mult"
+description: >
+  Run three concurrent copies of matmult as user threads in one
+  process.
+tags: [vm]
+depends: [boot, shell]
+sys161:
+  cpus: 2
+  ram: 6M
+---
+| p /testbin/ptriplemat
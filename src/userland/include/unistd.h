@@ -39,10 +39,12 @@
  * about the kern/ headers.
  */
 #include <kern/fcntl.h>
+#include <kern/futex.h>
 #include <kern/ioctl.h>
 #include <kern/reboot.h>
 #include <kern/seek.h>
 #include <kern/time.h>
+#include <kern/resource.h>
 #include <kern/unistd.h>
 #include <kern/wait.h>
 
@@ -147,6 +149,14 @@ ssize_t readlink(const char *path, char *buf, size_t buflen);
 int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
 int __time(time_t *seconds, unsigned long *nanoseconds);
+int getrusage(int who, struct rusage *usage);
+int nanosleep(const struct timespec *req, struct timespec *rem);
+int __thread_create(void (*start)(void *(*)(void *), void *),
+		    void *(*func)(void *), void *arg);
+int thread_join(int tid, void **retval);
+int thread_detach(int tid);
+__DEAD void thread_exit(void *retval);
+int futex(volatile int *uaddr, int op, int val);
 ssize_t __getcwd(char *buf, size_t buflen);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
@@ -158,5 +168,6 @@ ssize_t __getcwd(char *buf, size_t buflen);
 int execvp(const char *prog, char *const *args); /* calls execv */
 char *getcwd(char *buf, size_t buflen);		/* calls __getcwd */
 time_t time(time_t *seconds);			/* calls __time */
+int thread_create(void *(*func)(void *), void *arg); /* calls __thread_create */
 
 #endif /* _UNISTD_H_ */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef _USYNC_H_
+#define _USYNC_H_
+
+/*
+ * Mutexes and semaphores for the threads of one process.
+ *
+ * The state lives in user memory and is updated with atomic
+ * instructions, so taking a free mutex or a semaphore with a nonzero
+ * count, and releasing either with nobody waiting, never enters the
+ * kernel. Only sleeping and waking go through the futex() system
+ * call. Futexes are keyed by address space, so these don't work
+ * between processes.
+ */
+
+/*
+ * Mutex. um_state is 0 when unlocked, 1 when locked, and 2 when
+ * locked and someone may be sleeping on it.
+ */
+struct umutex {
+	volatile int um_state;
+};
+
+#define UMUTEX_INITIALIZER { 0 }
+
+void umutex_init(struct umutex *mx);
+void umutex_lock(struct umutex *mx);
+int umutex_trylock(struct umutex *mx);	/* 1 if we got it, else 0 */
+void umutex_unlock(struct umutex *mx);
+
+/*
+ * Counting semaphore.
+ */
+struct usema {
+	volatile int us_count;
+	volatile int us_sleepers;
+};
+
+#define USEMA_INITIALIZER(count) { (count), 0 }
+
+void usema_init(struct usema *sem, unsigned count);
+void usema_P(struct usema *sem);
+void usema_V(struct usema *sem);
+
+#endif /* _USYNC_H_ */
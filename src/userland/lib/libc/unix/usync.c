@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * User-level mutexes and semaphores on top of futex(). See <usync.h>.
+ *
+ * The atomic operations are the same LL/SC sequences the kernel uses
+ * for spinlocks (see kern/arch/mips/include/spinlock.h); LL and SC
+ * are allowed in user mode.
+ */
+
+#include <unistd.h>
+#include <usync.h>
+
+/*
+ * If *P is OLDVAL, set it to NEWVAL. Returns what *P was.
+ */
+static
+int
+usync_cas(volatile int *p, int oldval, int newval)
+{
+	int x, y;
+
+	do {
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set noreorder;"	/* we fill the delay slot */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%2);"		/*   x = *p */
+			"bne %0, %3, 1f;"	/*   if (x != oldval) fail */
+			"li %1, 0;"		/*   y = 0 (delay slot) */
+			"move %1, %4;"		/*   y = newval */
+			"sc %1, 0(%2);"		/*   *p = y; y = success? */
+			"1:"
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "=&r" (y)
+			: "r" (p), "r" (oldval), "r" (newval)
+			: "memory");
+	} while (x == oldval && y == 0);
+
+	return x;
+}
+
+/*
+ * Set *P to NEWVAL. Returns what *P was.
+ */
+static
+int
+usync_swap(volatile int *p, int newval)
+{
+	int x, y;
+
+	do {
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%2);"		/*   x = *p */
+			"move %1, %3;"		/*   y = newval */
+			"sc %1, 0(%2);"		/*   *p = y; y = success? */
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "=&r" (y)
+			: "r" (p), "r" (newval)
+			: "memory");
+	} while (y == 0);
+
+	return x;
+}
+
+/*
+ * Add INC to *P. Returns what *P was.
+ */
+static
+int
+usync_add(volatile int *p, int inc)
+{
+	int x, y;
+
+	do {
+		__asm volatile(
+			".set push;"		/* save assembler mode */
+			".set mips32;"		/* allow MIPS32 instructions */
+			".set volatile;"	/* avoid unwanted optimization */
+			"ll %0, 0(%2);"		/*   x = *p */
+			"addu %1, %0, %3;"	/*   y = x + inc */
+			"sc %1, 0(%2);"		/*   *p = y; y = success? */
+			".set pop"		/* restore assembler mode */
+			: "=&r" (x), "=&r" (y)
+			: "r" (p), "r" (inc)
+			: "memory");
+	} while (y == 0);
+
+	return x;
+}
+
+////////////////////////////////////////////////////////////
+// mutex
+
+void
+umutex_init(struct umutex *mx)
+{
+	mx->um_state = 0;
+}
+
+/*
+ * Take the mutex. The fast path is one compare-and-swap from 0 to 1.
+ * Otherwise mark the mutex contended (2) and sleep until we're the
+ * one who changes it from 0; since we can't tell whether anyone else
+ * is still asleep, we always take it as contended in that case.
+ */
+void
+umutex_lock(struct umutex *mx)
+{
+	int c;
+
+	c = usync_cas(&mx->um_state, 0, 1);
+	if (c == 0) {
+		return;
+	}
+	if (c != 2) {
+		c = usync_swap(&mx->um_state, 2);
+	}
+	while (c != 0) {
+		(void)futex(&mx->um_state, FUTEX_WAIT, 2);
+		c = usync_swap(&mx->um_state, 2);
+	}
+}
+
+int
+umutex_trylock(struct umutex *mx)
+{
+	return usync_cas(&mx->um_state, 0, 1) == 0;
+}
+
+/*
+ * Release the mutex. Only enter the kernel if it was contended.
+ */
+void
+umutex_unlock(struct umutex *mx)
+{
+	if (usync_add(&mx->um_state, -1) != 1) {
+		mx->um_state = 0;
+		(void)futex(&mx->um_state, FUTEX_WAKE, 1);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// semaphore
+
+void
+usema_init(struct usema *sem, unsigned count)
+{
+	sem->us_count = count;
+	sem->us_sleepers = 0;
+}
+
+/*
+ * Take one from the count, sleeping while it's zero. We announce
+ * ourselves in us_sleepers before checking the count again in
+ * FUTEX_WAIT, so a V that raises the count after that check will see
+ * us and wake us; a V before it makes FUTEX_WAIT return at once.
+ */
+void
+usema_P(struct usema *sem)
+{
+	int c;
+
+	while (1) {
+		c = sem->us_count;
+		if (c > 0) {
+			if (usync_cas(&sem->us_count, c, c - 1) == c) {
+				return;
+			}
+			continue;
+		}
+		usync_add(&sem->us_sleepers, 1);
+		(void)futex(&sem->us_count, FUTEX_WAIT, 0);
+		usync_add(&sem->us_sleepers, -1);
+	}
+}
+
+/*
+ * Add one to the count, and wake a sleeper if there might be one.
+ */
+void
+usema_V(struct usema *sem)
+{
+	usync_add(&sem->us_count, 1);
+	if (sem->us_sleepers > 0) {
+		(void)futex(&sem->us_count, FUTEX_WAKE, 1);
+	}
+}
@@ -73,6 +73,9 @@ static bool dofiles, dodirs;
 static bool doindirect;
 static bool recurse;
 
+/* Set from the superblock: inodes are extent-mapped. */
+static bool extents;
+
 ////////////////////////////////////////////////////////////
 // printouts
 
@@ -142,6 +145,7 @@ readsb(void)
 	if (SWAP32(sb.sb_magic) != SFS_MAGIC) {
 		errx(1, "Not an sfs filesystem");
 	}
+	extents = (SWAP32(sb.sb_features) & SFS_FEATURE_EXTENTS) != 0;
 	return SWAP32(sb.sb_nblocks);
 }
 
@@ -163,6 +167,11 @@ dumpsb(void)
 		 SFS_FREEMAPBLOCKS(SWAP32(sb.sb_nblocks)));
 	dumpvalf("Block size", "%u bytes", SFS_BLOCKSIZE);
 	dumplval("Volume name", sb.sb_volname);
+	dumpvalf("Features", "0x%x%s%s", SWAP32(sb.sb_features),
+		 (SWAP32(sb.sb_features) & SFS_FEATURE_HASHDIR) ?
+		 " (hashed directories)" : "",
+		 (SWAP32(sb.sb_features) & SFS_FEATURE_EXTENTS) ?
+		 " (extents)" : "");
 
 	for (i=0; i<ARRAYCOUNT(sb.reserved); i++) {
 		if (sb.reserved[i] != 0) {
@@ -255,6 +264,57 @@ dumpindirect(uint32_t block)
 	}
 }
 
+static
+void
+dumpextents(const struct sfs_extent *se, unsigned n, unsigned depth)
+{
+	unsigned i;
+
+	for (i=0; i<n; i++) {
+		if (depth > 0) {
+			printf("@%-3u     from block %u: tree block %u\n", i,
+			       SWAP32(se[i].se_fileblock),
+			       SWAP32(se[i].se_diskblock));
+		}
+		else {
+			printf("@%-3u     block %u: %u blocks at %u\n", i,
+			       SWAP32(se[i].se_fileblock),
+			       SWAP32(se[i].se_len),
+			       SWAP32(se[i].se_diskblock));
+		}
+	}
+}
+
+static
+void
+dumpextblock(uint32_t block, unsigned depth)
+{
+	struct sfs_extblock eb;
+	unsigned i, n;
+
+	if (block == 0) {
+		return;
+	}
+	diskread(&eb, block);
+	n = SWAP16(eb.seb_nextents);
+	printf("Extent tree block %u: depth %u, %u entries\n",
+	       block, SWAP16(eb.seb_depth), n);
+	if (SWAP16(eb.seb_depth) != depth) {
+		printf("    [depth should be %u]\n", depth);
+		return;
+	}
+	if (n > SFS_NEXTBLOCK) {
+		n = SFS_NEXTBLOCK;
+	}
+	dumpextents(eb.seb_extents, n, depth);
+	if (depth > 0) {
+		for (i=0; i<n; i++) {
+			dumpextblock(SWAP32(eb.seb_extents[i].se_diskblock),
+				     depth - 1);
+		}
+	}
+}
+
 static
 uint32_t
 traverse_ib(uint32_t fileblock, uint32_t numblocks, uint32_t block,
@@ -275,16 +335,77 @@ traverse_ib(uint32_t fileblock, uint32_t numblocks, uint32_t block,
 	return fileblock;
 }
 
+/*
+ * Walk the extents SE[0..N) at depth DEPTH, in order, handing each
+ * file block from FILEBLOCK up to NUMBLOCKS to DOBLOCK, with 0 for
+ * holes up to the last extent. Overlapping extents are skipped.
+ */
+static
+uint32_t
+traverse_ext(uint32_t fileblock, uint32_t numblocks,
+	     const struct sfs_extent *se, unsigned n, unsigned depth,
+	     void (*doblock)(uint32_t, uint32_t))
+{
+	struct sfs_extblock eb;
+	uint32_t start, len, disk, j;
+	unsigned i;
+
+	for (i=0; i<n && fileblock < numblocks; i++) {
+		start = SWAP32(se[i].se_fileblock);
+		disk = SWAP32(se[i].se_diskblock);
+		if (depth > 0) {
+			diskread(&eb, disk);
+			if (SWAP16(eb.seb_depth) != depth - 1 ||
+			    SWAP16(eb.seb_nextents) > SFS_NEXTBLOCK) {
+				warnx("Bad extent tree block %u", disk);
+				continue;
+			}
+			fileblock = traverse_ext(fileblock, numblocks,
+						 eb.seb_extents,
+						 SWAP16(eb.seb_nextents),
+						 depth - 1, doblock);
+			continue;
+		}
+		if (start < fileblock) {
+			warnx("Overlapping extent at block %u", start);
+			continue;
+		}
+		while (fileblock < start && fileblock < numblocks) {
+			doblock(fileblock++, 0);
+		}
+		len = SWAP32(se[i].se_len);
+		for (j=0; j<len && fileblock < numblocks; j++) {
+			doblock(fileblock++, disk + j);
+		}
+	}
+	return fileblock;
+}
+
 static
 void
 traverse(const struct sfs_dinode *sfi, void (*doblock)(uint32_t, uint32_t))
 {
+	struct sfs_extdinode ei;
 	uint32_t fileblock;
 	uint32_t numblocks;
-	unsigned i;
+	unsigned i, n;
 
 	numblocks = DIVROUNDUP(SWAP32(sfi->sfi_size), SFS_BLOCKSIZE);
 
+	if (extents) {
+		memcpy(&ei, sfi, sizeof(ei));
+		n = SWAP16(ei.sfi_nextents);
+		if (n > SFS_NEXTINODE) {
+			n = SFS_NEXTINODE;
+		}
+		fileblock = traverse_ext(0, numblocks, ei.sfi_extents, n,
+					 SWAP16(ei.sfi_extdepth), doblock);
+		while (fileblock < numblocks) {
+			doblock(fileblock++, 0);
+		}
+		return;
+	}
+
 	fileblock = 0;
 	for (i=0; i<SFS_NDIRECT && fileblock < numblocks; i++) {
 		doblock(fileblock++, SWAP32(sfi->sfi_direct[i]));
@@ -314,7 +435,11 @@ dumpdirblock(uint32_t fileblock, uint32_t diskblock)
 	printf("    [block %u]\n", diskblock);
 	for (i=0; i<nsds; i++) {
 		uint32_t ino = SWAP32(sds[i].sfd_ino);
-		if (ino==SFS_NOINO) {
+		if (ino==SFS_NOINO &&
+		    !strcmp(sds[i].sfd_name, SFS_DIRDELETED)) {
+			printf("        [deleted entry]\n");
+		}
+		else if (ino==SFS_NOINO) {
 			printf("        [free entry]\n");
 		}
 		else {
@@ -425,31 +550,40 @@ dumpfile(uint32_t ino, const struct sfs_dinode *sfi)
 
 static
 void
-dumpinode(uint32_t ino, const char *name)
+dumpextinode(const struct sfs_dinode *sfi)
 {
-	struct sfs_dinode sfi;
-	const char *typename;
-	char tmp[128];
-	unsigned i;
-
-	diskread(&sfi, ino);
-
-	printf("Inode %u", ino);
-	if (name != NULL) {
-		printf(" (%s)", name);
+	struct sfs_extdinode ei;
+	unsigned i, n, depth;
+
+	memcpy(&ei, sfi, sizeof(ei));
+	n = SWAP16(ei.sfi_nextents);
+	depth = SWAP16(ei.sfi_extdepth);
+	printf("    Extent tree: depth %u, %u entries\n", depth, n);
+	if (n > SFS_NEXTINODE) {
+		n = SFS_NEXTINODE;
+	}
+	dumpextents(ei.sfi_extents, n, depth);
+	for (i=0; i<ARRAYCOUNT(ei.sfi_extwaste); i++) {
+		if (ei.sfi_extwaste[i] != 0) {
+			printf("    Word %u in waste area: 0x%x\n",
+			       i, SWAP32(ei.sfi_extwaste[i]));
+		}
 	}
-	printf("\n");
-	printf("--------------\n");
 
-	switch (SWAP16(sfi.sfi_type)) {
-	    case SFS_TYPE_FILE: typename = "regular file"; break;
-	    case SFS_TYPE_DIR: typename = "directory"; break;
-	    default: typename = "invalid"; break;
+	if (doindirect && depth > 0) {
+		for (i=0; i<n; i++) {
+			dumpextblock(SWAP32(ei.sfi_extents[i].se_diskblock),
+				     depth - 1);
+		}
 	}
-	dumpvalf("Type", "%u (%s)", SWAP16(sfi.sfi_type), typename);
-	dumpvalf("Size", "%u", SWAP32(sfi.sfi_size));
-	dumpvalf("Link count", "%u", SWAP16(sfi.sfi_linkcount));
-	printf("\n");
+}
+
+static
+void
+dumpblockptrs(const struct sfs_dinode *sfi)
+{
+	char tmp[128];
+	unsigned i;
 
         printf("    Direct blocks:\n");
         for (i=0; i<SFS_NDIRECT; i++) {
@@ -465,7 +599,7 @@ dumpinode(uint32_t ino, const char *name)
 		 * number print then needs up to 16 digits.
 		 */
 		snprintf(tmp, sizeof(tmp), "%u (0x%x)",
-			 SWAP32(sfi.sfi_direct[i]), SWAP32(sfi.sfi_direct[i]));
+			 SWAP32(sfi->sfi_direct[i]), SWAP32(sfi->sfi_direct[i]));
 		printf("  %-16s", tmp);
 		if (i % 4 == 3) {
 			printf("\n");
@@ -475,16 +609,50 @@ dumpinode(uint32_t ino, const char *name)
 		printf("\n");
 	}
 	printf("    Indirect block: %u (0x%x)\n",
-	       SWAP32(sfi.sfi_indirect), SWAP32(sfi.sfi_indirect));
-	for (i=0; i<ARRAYCOUNT(sfi.sfi_waste); i++) {
-		if (sfi.sfi_waste[i] != 0) {
+	       SWAP32(sfi->sfi_indirect), SWAP32(sfi->sfi_indirect));
+	for (i=0; i<ARRAYCOUNT(sfi->sfi_waste); i++) {
+		if (sfi->sfi_waste[i] != 0) {
 			printf("    Word %u in waste area: 0x%x\n",
-			       i, SWAP32(sfi.sfi_waste[i]));
+			       i, SWAP32(sfi->sfi_waste[i]));
 		}
 	}
 
 	if (doindirect) {
-		dumpindirect(SWAP32(sfi.sfi_indirect));
+		dumpindirect(SWAP32(sfi->sfi_indirect));
+	}
+}
+
+static
+void
+dumpinode(uint32_t ino, const char *name)
+{
+	struct sfs_dinode sfi;
+	const char *typename;
+
+	diskread(&sfi, ino);
+
+	printf("Inode %u", ino);
+	if (name != NULL) {
+		printf(" (%s)", name);
+	}
+	printf("\n");
+	printf("--------------\n");
+
+	switch (SWAP16(sfi.sfi_type)) {
+	    case SFS_TYPE_FILE: typename = "regular file"; break;
+	    case SFS_TYPE_DIR: typename = "directory"; break;
+	    default: typename = "invalid"; break;
+	}
+	dumpvalf("Type", "%u (%s)", SWAP16(sfi.sfi_type), typename);
+	dumpvalf("Size", "%u", SWAP32(sfi.sfi_size));
+	dumpvalf("Link count", "%u", SWAP16(sfi.sfi_linkcount));
+	printf("\n");
+
+	if (extents) {
+		dumpextinode(&sfi);
+	}
+	else {
+		dumpblockptrs(&sfi);
 	}
 
 	if (SWAP16(sfi.sfi_type) == SFS_TYPE_DIR && dodirs) {
@@ -509,7 +677,7 @@ usage(void)
 	warnx("   -s: dump superblock");
 	warnx("   -b: dump free block bitmap");
 	warnx("   -i ino: dump specified inode");
-	warnx("   -I: dump indirect blocks");
+	warnx("   -I: dump indirect (or extent tree) blocks");
 	warnx("   -f: dump file contents");
 	warnx("   -d: dump directory contents");
 	warnx("   -r: recurse into directory contents");
@@ -72,6 +72,8 @@ check(void)
 {
 	assert(sizeof(struct sfs_superblock)==SFS_BLOCKSIZE);
 	assert(sizeof(struct sfs_dinode)==SFS_BLOCKSIZE);
+	assert(sizeof(struct sfs_extdinode)==SFS_BLOCKSIZE);
+	assert(sizeof(struct sfs_extblock)==SFS_BLOCKSIZE);
 	assert(SFS_BLOCKSIZE % sizeof(struct sfs_direntry) == 0);
 }
 
@@ -125,7 +127,7 @@ initfreemap(uint32_t fsblocks)
  */
 static
 void
-writesuper(const char *volname, uint32_t nblocks)
+writesuper(const char *volname, uint32_t nblocks, uint32_t features)
 {
 	struct sfs_superblock sb;
 
@@ -140,6 +142,7 @@ writesuper(const char *volname, uint32_t nblocks)
 	sb.sb_magic = SWAP32(SFS_MAGIC);
 	sb.sb_nblocks = SWAP32(nblocks);
 	strcpy(sb.sb_volname, volname);
+	sb.sb_features = SWAP32(features);
 
 	/* and write it out. */
 	diskwrite(&sb, SFS_SUPER_BLOCK);
@@ -189,15 +192,34 @@ writerootdir(void)
 int
 main(int argc, char **argv)
 {
-	uint32_t size, blocksize;
+	uint32_t size, blocksize, features;
 	char *volname, *s;
 
 #ifdef HOST
 	hostcompat_init(argc, argv);
 #endif
 
+	/*
+	 * -H: hashed directories; -E: extent-mapped inodes (see
+	 * kern/sfs.h)
+	 */
+	features = 0;
+	while (argc > 3 && argv[1][0] == '-') {
+		if (!strcmp(argv[1], "-H")) {
+			features |= SFS_FEATURE_HASHDIR;
+		}
+		else if (!strcmp(argv[1], "-E")) {
+			features |= SFS_FEATURE_EXTENTS;
+		}
+		else {
+			break;
+		}
+		argc--;
+		argv++;
+	}
+
 	if (argc!=3) {
-		errx(1, "Usage: mksfs device/diskfile volume-name");
+		errx(1, "Usage: mksfs [-H] [-E] device/diskfile volume-name");
 	}
 
 	check();
@@ -230,7 +252,7 @@ main(int argc, char **argv)
 
 	/* Write out the on-disk structures */
 	initfreemap(size);
-	writesuper(volname, size);
+	writesuper(volname, size, features);
 	writefreemap(size);
 	writerootdir();
 
@@ -247,6 +247,263 @@ check_inode_blocks(uint32_t ino, struct sfs_dinode *sfi, int isdir)
 	return changed;
 }
 
+/*
+ * State for checking extent trees.
+ */
+struct extstate {
+	uint32_t ino;		/* inode we're doing (constant) */
+	uint32_t fileblocks;	/* file size in blocks (constant) */
+	uint32_t volblocks;	/* volume size in blocks (constant) */
+	unsigned pasteofcount;	/* number of blocks found past eof */
+	blockusage_t usagetype;	/* how to call freemap_blockinuse() */
+};
+
+static int check_extent_node(struct extstate *es, struct sfs_extent *se,
+			     unsigned *np, unsigned max, unsigned depth,
+			     uint32_t lo, uint32_t hi);
+
+/*
+ * Check the leaf extents SE[0..*NP), which may only map file blocks
+ * from LO up to HI. Extents that are malformed, overlap the one
+ * before, or are out of range are dropped; the part of an extent past
+ * EOF is freed. The survivors are moved up to fill the gaps, and *NP
+ * updated. Returns nonzero if anything changed.
+ */
+static
+int
+check_extent_leaf(struct extstate *es, struct sfs_extent *se, unsigned *np,
+		  uint32_t lo, uint32_t hi)
+{
+	unsigned i, k;
+	uint32_t j, keep;
+	int changed = 0;
+
+	for (i=k=0; i<*np; i++) {
+		if (se[i].se_len == 0 || se[i].se_diskblock == 0 ||
+		    se[i].se_diskblock >= es->volblocks ||
+		    se[i].se_len > es->volblocks - se[i].se_diskblock ||
+		    se[i].se_fileblock < lo || se[i].se_fileblock >= hi ||
+		    se[i].se_len > hi - se[i].se_fileblock) {
+			setbadness(EXIT_RECOV);
+			warnx("Inode %lu: bad extent for block %lu "
+			      "(%lu blocks at %lu) (dropped)",
+			      (unsigned long)es->ino,
+			      (unsigned long)se[i].se_fileblock,
+			      (unsigned long)se[i].se_len,
+			      (unsigned long)se[i].se_diskblock);
+			changed = 1;
+			continue;
+		}
+
+		if (se[i].se_fileblock + se[i].se_len > es->fileblocks) {
+			keep = 0;
+			if (se[i].se_fileblock < es->fileblocks) {
+				keep = es->fileblocks - se[i].se_fileblock;
+			}
+			for (j=keep; j<se[i].se_len; j++) {
+				freemap_blockfree(se[i].se_diskblock + j);
+			}
+			es->pasteofcount += se[i].se_len - keep;
+			se[i].se_len = keep;
+			changed = 1;
+			if (keep == 0) {
+				continue;
+			}
+		}
+
+		for (j=0; j<se[i].se_len; j++) {
+			freemap_blockinuse(se[i].se_diskblock + j,
+					   es->usagetype, es->ino);
+		}
+		lo = se[i].se_fileblock + se[i].se_len;
+		se[k++] = se[i];
+	}
+
+	memset(&se[k], 0, (*np - k) * sizeof(se[0]));
+	*np = k;
+	return changed;
+}
+
+/*
+ * Check the index entries SE[0..*NP), at depth DEPTH, and the tree
+ * blocks under them, which may only map file blocks from LO up to
+ * HI. Entries that are malformed or out of order are dropped, as are
+ * those whose tree block is bad or ends up empty. Otherwise as for
+ * check_extent_leaf.
+ */
+static
+int
+check_extent_index(struct extstate *es, struct sfs_extent *se, unsigned *np,
+		   unsigned depth, uint32_t lo, uint32_t hi)
+{
+	struct sfs_extblock eb;
+	unsigned i, k, n, count;
+	uint32_t childhi;
+	int changed = 0, bchanged;
+
+	/* First the entries themselves... */
+	n = *np;
+	for (i=k=0; i<n; i++) {
+		if (se[i].se_len != 0 || se[i].se_diskblock == 0 ||
+		    se[i].se_diskblock >= es->volblocks ||
+		    se[i].se_fileblock < lo || se[i].se_fileblock >= hi) {
+			setbadness(EXIT_RECOV);
+			warnx("Inode %lu: bad extent tree entry for block "
+			      "%lu (dropped)", (unsigned long)es->ino,
+			      (unsigned long)se[i].se_fileblock);
+			changed = 1;
+			continue;
+		}
+		lo = se[i].se_fileblock + 1;
+		se[k++] = se[i];
+	}
+	memset(&se[k], 0, (n - k) * sizeof(se[0]));
+
+	/* ...then the blocks they point to. */
+	n = k;
+	for (i=k=0; i<n; i++) {
+		childhi = i+1 < n ? se[i+1].se_fileblock : hi;
+
+		sfs_readextblock(se[i].se_diskblock, &eb);
+		if (eb.seb_depth != depth - 1 ||
+		    eb.seb_nextents > SFS_NEXTBLOCK) {
+			setbadness(EXIT_RECOV);
+			warnx("Inode %lu: bad extent tree block %lu (dropped)",
+			      (unsigned long)es->ino,
+			      (unsigned long)se[i].se_diskblock);
+			changed = 1;
+			continue;
+		}
+
+		count = eb.seb_nextents;
+		bchanged = check_extent_node(es, eb.seb_extents, &count,
+					     SFS_NEXTBLOCK, depth - 1,
+					     se[i].se_fileblock, childhi);
+		if (count == 0) {
+			/* Nothing (left) in it */
+			if (eb.seb_nextents == 0) {
+				warnx("Inode %lu: empty extent tree block "
+				      "%lu (freed)", (unsigned long)es->ino,
+				      (unsigned long)se[i].se_diskblock);
+			}
+			setbadness(EXIT_RECOV);
+			freemap_blockfree(se[i].se_diskblock);
+			changed = 1;
+			continue;
+		}
+		if (eb.seb_reserved != 0) {
+			setbadness(EXIT_RECOV);
+			warnx("Inode %lu: extent tree block %lu reserved "
+			      "field not zeroed (fixed)",
+			      (unsigned long)es->ino,
+			      (unsigned long)se[i].se_diskblock);
+			eb.seb_reserved = 0;
+			bchanged = 1;
+		}
+		if (bchanged) {
+			eb.seb_nextents = count;
+			sfs_writeextblock(se[i].se_diskblock, &eb);
+		}
+		freemap_blockinuse(se[i].se_diskblock, B_IBLOCK, es->ino);
+		se[k++] = se[i];
+	}
+	memset(&se[k], 0, (n - k) * sizeof(se[0]));
+
+	*np = k;
+	return changed;
+}
+
+/*
+ * Check one node of an extent tree: the entries SE[0..*NP) out of
+ * room for MAX, at depth DEPTH, mapping file blocks from LO up to HI.
+ */
+static
+int
+check_extent_node(struct extstate *es, struct sfs_extent *se, unsigned *np,
+		  unsigned max, unsigned depth, uint32_t lo, uint32_t hi)
+{
+	int changed;
+
+	if (depth == 0) {
+		changed = check_extent_leaf(es, se, np, lo, hi);
+	}
+	else {
+		changed = check_extent_index(es, se, np, depth, lo, hi);
+	}
+
+	if (checkzeroed(&se[*np], (max - *np) * sizeof(se[0]))) {
+		setbadness(EXIT_RECOV);
+		warnx("Inode %lu: unused extent entries not zeroed (fixed)",
+		      (unsigned long)es->ino);
+		changed = 1;
+	}
+	return changed;
+}
+
+/*
+ * check_inode_blocks for extent-mapped inodes.
+ */
+static
+int
+check_inode_extents(uint32_t ino, struct sfs_dinode *sfi, int isdir)
+{
+	struct sfs_extdinode ei;
+	struct extstate es;
+	unsigned count;
+	int changed;
+
+	memcpy(&ei, sfi, sizeof(ei));
+
+	es.ino = ino;
+	es.fileblocks = ei.sfi_size / SFS_BLOCKSIZE +
+		(ei.sfi_size % SFS_BLOCKSIZE != 0);
+	es.volblocks = sb_totalblocks();
+	es.pasteofcount = 0;
+	es.usagetype = isdir ? B_DIRDATA : B_DATA;
+
+	changed = 0;
+
+	if (checkzeroed(ei.sfi_extwaste, sizeof(ei.sfi_extwaste))) {
+		warnx("Inode %lu: sfi_extwaste section not zeroed (fixed)",
+		      (unsigned long) ino);
+		setbadness(EXIT_RECOV);
+		changed = 1;
+	}
+
+	if (ei.sfi_extdepth > SFS_EXTMAXDEPTH ||
+	    ei.sfi_nextents > SFS_NEXTINODE) {
+		setbadness(EXIT_RECOV);
+		warnx("Inode %lu: bad extent tree root (cleared)",
+		      (unsigned long) ino);
+		ei.sfi_extdepth = 0;
+		ei.sfi_nextents = 0;
+		memset(ei.sfi_extents, 0, sizeof(ei.sfi_extents));
+		changed = 1;
+	}
+
+	count = ei.sfi_nextents;
+	if (check_extent_node(&es, ei.sfi_extents, &count, SFS_NEXTINODE,
+			      ei.sfi_extdepth, 0, 0xffffffff)) {
+		changed = 1;
+	}
+	ei.sfi_nextents = count;
+	if (count == 0 && ei.sfi_extdepth > 0) {
+		ei.sfi_extdepth = 0;
+		changed = 1;
+	}
+
+	if (es.pasteofcount > 0) {
+		warnx("Inode %lu: %u blocks after EOF (freed)",
+		     (unsigned long) ino, es.pasteofcount);
+		setbadness(EXIT_RECOV);
+	}
+
+	if (changed) {
+		memcpy(sfi, &ei, sizeof(ei));
+	}
+	return changed;
+}
+
 /*
  * Do the pass1 inode-level checks on inode INO, which has already
  * been loaded into SFI. Note that sfi_type has already been
@@ -270,15 +527,23 @@ pass1_inode(uint32_t ino, struct sfs_dinode *sfi, int alreadychanged)
 
 	freemap_blockinuse(ino, B_INODE, ino);
 
-	if (checkzeroed(sfi->sfi_waste, sizeof(sfi->sfi_waste))) {
-		warnx("Inode %lu: sfi_waste section not zeroed (fixed)",
-		      (unsigned long) ino);
-		setbadness(EXIT_RECOV);
-		changed = 1;
+	if (sb_extents()) {
+		/* (this checks sfi_extwaste) */
+		if (check_inode_extents(ino, sfi, isdir)) {
+			changed = 1;
+		}
 	}
+	else {
+		if (checkzeroed(sfi->sfi_waste, sizeof(sfi->sfi_waste))) {
+			warnx("Inode %lu: sfi_waste section not zeroed "
+			      "(fixed)", (unsigned long) ino);
+			setbadness(EXIT_RECOV);
+			changed = 1;
+		}
 
-	if (check_inode_blocks(ino, sfi, isdir)) {
-		changed = 1;
+		if (check_inode_blocks(ino, sfi, isdir)) {
+			changed = 1;
+		}
 	}
 
 	if (changed) {
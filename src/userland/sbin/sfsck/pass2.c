@@ -47,6 +47,67 @@
 #include "passes.h"
 #include "main.h"
 
+/*
+ * Check whether every entry in a hashed directory (see kern/sfs.h)
+ * can be found by probing from its hash slot. Returns the number of
+ * entries that can't.
+ */
+static
+uint32_t
+pass2_hashcheck(struct sfs_direntry *d, uint32_t nd)
+{
+	uint32_t i, j, n, bad=0;
+
+	for (i=0; i<nd; i++) {
+		if (d[i].sfd_ino == SFS_NOINO) {
+			continue;
+		}
+		j = sfs_dirhash(d[i].sfd_name) % nd;
+		for (n=0; n<nd && j != i; n++) {
+			if (d[j].sfd_ino == SFS_NOINO &&
+			    d[j].sfd_name[0] == 0) {
+				/* empty slot; probing stops here */
+				break;
+			}
+			j = (j+1) % nd;
+		}
+		if (j != i) {
+			bad++;
+		}
+	}
+	return bad;
+}
+
+/*
+ * Lay out a hashed directory again from scratch, dropping deleted
+ * entries. The number of slots stays the same, so everything fits.
+ */
+static
+void
+pass2_rehash(struct sfs_direntry *d, uint32_t nd)
+{
+	struct sfs_direntry *old;
+	uint32_t i, j;
+
+	old = domalloc(nd * sizeof(struct sfs_direntry));
+	memcpy(old, d, nd * sizeof(struct sfs_direntry));
+	for (i=0; i<nd; i++) {
+		d[i].sfd_ino = SFS_NOINO;
+		bzero(d[i].sfd_name, sizeof(d[i].sfd_name));
+	}
+	for (i=0; i<nd; i++) {
+		if (old[i].sfd_ino == SFS_NOINO) {
+			continue;
+		}
+		j = sfs_dirhash(old[i].sfd_name) % nd;
+		while (d[j].sfd_ino != SFS_NOINO) {
+			j = (j+1) % nd;
+		}
+		d[j] = old[i];
+	}
+	free(old);
+}
+
 /*
  * Process a directory. INO is the inode number; PARENTINO is the
  * parent's inode number; PATHSOFAR is the path to this directory.
@@ -88,6 +149,21 @@ pass2_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 	dirsize = maxdirentries * sizeof(struct sfs_direntry);
 	direntries = domalloc(dirsize);
 
+	/*
+	 * A hashed directory is always a whole number of blocks,
+	 * because the slot count is part of where entries go.
+	 */
+	if (sb_hashdirs() && ndirentries != maxdirentries) {
+		setbadness(EXIT_RECOV);
+		warnx("Directory %s: Size %lu not a multiple of the block "
+		      "size (fixed)", pathsofar,
+		      (unsigned long) sfi.sfi_size);
+		ndirentries = maxdirentries;
+		sfi.sfi_size = dirsize;
+		ichanged = 1;
+		dchanged = 1;
+	}
+
 	sortvector = domalloc(ndirentries * sizeof(int));
 
 	sfs_readdir(&sfi, direntries, ndirentries);
@@ -297,6 +373,23 @@ pass2_dir(uint32_t ino, uint32_t parentino, const char *pathsofar)
 		ichanged = 1;
 	}
 
+	/*
+	 * In a hashed directory, anything moved around above (or
+	 * already out of place) has to go back where lookups will
+	 * look for it.
+	 */
+
+	if (sb_hashdirs() && !dchanged &&
+	    pass2_hashcheck(direntries, ndirentries) > 0) {
+		setbadness(EXIT_RECOV);
+		warnx("Directory %s: Entries not in hash order (fixed)",
+		      pathsofar);
+		dchanged = 1;
+	}
+	if (sb_hashdirs() && dchanged && ndirentries > 0) {
+		pass2_rehash(direntries, ndirentries);
+	}
+
 	/*
 	 * Write back anything that changed, clean up, and return.
 	 */
@@ -57,6 +57,12 @@ sb_load(void)
 
 	assert(sb.sb_nblocks > 0);
 	assert(SFS_FREEMAPBLOCKS(sb.sb_nblocks) > 0);
+
+	/* We can't check a volume laid out in a way we don't know. */
+	if (sb.sb_features & ~SFS_FEATURES_KNOWN) {
+		errx(EXIT_FATAL, "Unsupported features 0x%lx",
+		     (unsigned long) (sb.sb_features & ~SFS_FEATURES_KNOWN));
+	}
 }
 
 /*
@@ -122,3 +128,21 @@ sb_volname(void)
 {
 	return sb.sb_volname;
 }
+
+/*
+ * Return whether directories are hash tables.
+ */
+int
+sb_hashdirs(void)
+{
+	return (sb.sb_features & SFS_FEATURE_HASHDIR) != 0;
+}
+
+/*
+ * Return whether inodes are extent-mapped.
+ */
+int
+sb_extents(void)
+{
+	return (sb.sb_features & SFS_FEATURE_EXTENTS) != 0;
+}
@@ -49,6 +49,12 @@ uint32_t sb_freemapblocks(void);
 /* After the superblock is loaded: return volume name. */
 const char *sb_volname(void);
 
+/* After the superblock is loaded: true if directories are hashed. */
+int sb_hashdirs(void);
+
+/* After the superblock is loaded: true if inodes use extents. */
+int sb_extents(void);
+
 /* Check the superblock. Must load it first. */
 void sb_check(void);
 
@@ -40,6 +40,7 @@
 #include "utils.h"
 #include "ibmacros.h"
 #include "sfs.h"
+#include "sb.h"
 #include "main.h"
 
 ////////////////////////////////////////////////////////////
@@ -50,6 +51,8 @@ sfs_setup(void)
 {
 	assert(sizeof(struct sfs_superblock)==SFS_BLOCKSIZE);
 	assert(sizeof(struct sfs_dinode)==SFS_BLOCKSIZE);
+	assert(sizeof(struct sfs_extdinode)==SFS_BLOCKSIZE);
+	assert(sizeof(struct sfs_extblock)==SFS_BLOCKSIZE);
 	assert(SFS_BLOCKSIZE % sizeof(struct sfs_direntry) == 0);
 }
 
@@ -62,6 +65,7 @@ swapsb(struct sfs_superblock *sb)
 {
 	sb->sb_magic = SWAP32(sb->sb_magic);
 	sb->sb_nblocks = SWAP32(sb->sb_nblocks);
+	sb->sb_features = SWAP32(sb->sb_features);
 }
 
 static
@@ -72,12 +76,55 @@ swapbits(uint8_t *bits)
 	(void)bits;
 }
 
+static
+void
+swapextents(struct sfs_extent *se, unsigned n)
+{
+	unsigned i;
+
+	for (i=0; i<n; i++) {
+		se[i].se_fileblock = SWAP32(se[i].se_fileblock);
+		se[i].se_diskblock = SWAP32(se[i].se_diskblock);
+		se[i].se_len = SWAP32(se[i].se_len);
+	}
+}
+
+static
+void
+swapextinode(struct sfs_extdinode *sfi)
+{
+	sfi->sfi_size = SWAP32(sfi->sfi_size);
+	sfi->sfi_type = SWAP16(sfi->sfi_type);
+	sfi->sfi_linkcount = SWAP16(sfi->sfi_linkcount);
+	sfi->sfi_extdepth = SWAP16(sfi->sfi_extdepth);
+	sfi->sfi_nextents = SWAP16(sfi->sfi_nextents);
+	swapextents(sfi->sfi_extents, SFS_NEXTINODE);
+}
+
+static
+void
+swapextblock(struct sfs_extblock *eb)
+{
+	eb->seb_depth = SWAP16(eb->seb_depth);
+	eb->seb_nextents = SWAP16(eb->seb_nextents);
+	eb->seb_reserved = SWAP32(eb->seb_reserved);
+	swapextents(eb->seb_extents, SFS_NEXTBLOCK);
+}
+
 static
 void
 swapinode(struct sfs_dinode *sfi)
 {
+	struct sfs_extdinode ei;
 	int i;
 
+	if (sb_extents()) {
+		memcpy(&ei, sfi, sizeof(ei));
+		swapextinode(&ei);
+		memcpy(sfi, &ei, sizeof(ei));
+		return;
+	}
+
 	sfi->sfi_size = SWAP32(sfi->sfi_size);
 	sfi->sfi_type = SWAP16(sfi->sfi_type);
 	sfi->sfi_linkcount = SWAP16(sfi->sfi_linkcount);
@@ -152,6 +199,59 @@ ibmap(uint32_t iblock, uint32_t offset, uint32_t entrysize)
 	}
 }
 
+/*
+ * bmap() for extent-mapped inodes. This walks down the tree the same
+ * way the kernel does, but gives up (returning 0) on anything broken
+ * instead of panicking; pass1 has fixed those by the time it matters.
+ */
+static
+uint32_t
+extbmap(const struct sfs_dinode *sfi, uint32_t fileblock)
+{
+	struct sfs_extdinode ei;
+	struct sfs_extblock eb;
+	const struct sfs_extent *se;
+	unsigned depth, n;
+	int i;
+
+	memcpy(&ei, sfi, sizeof(ei));
+	depth = ei.sfi_extdepth;
+	n = ei.sfi_nextents;
+	se = ei.sfi_extents;
+	if (n > SFS_NEXTINODE) {
+		return 0;
+	}
+
+	while (1) {
+		/* Find the last entry starting at or before FILEBLOCK */
+		for (i = (int)n - 1; i >= 0; i--) {
+			if (se[i].se_fileblock <= fileblock) {
+				break;
+			}
+		}
+		if (depth == 0) {
+			break;
+		}
+		if (i < 0 || se[i].se_diskblock == 0 ||
+		    se[i].se_diskblock >= sb_totalblocks()) {
+			return 0;
+		}
+		sfs_readextblock(se[i].se_diskblock, &eb);
+		if (eb.seb_depth != depth - 1 ||
+		    eb.seb_nextents > SFS_NEXTBLOCK) {
+			return 0;
+		}
+		depth = eb.seb_depth;
+		n = eb.seb_nextents;
+		se = eb.seb_extents;
+	}
+
+	if (i < 0 || fileblock - se[i].se_fileblock >= se[i].se_len) {
+		return 0;
+	}
+	return se[i].se_diskblock + (fileblock - se[i].se_fileblock);
+}
+
 /*
  * bmap() for SFS.
  *
@@ -163,6 +263,10 @@ bmap(const struct sfs_dinode *sfi, uint32_t fileblock)
 {
 	uint32_t iblock, offset;
 
+	if (sb_extents()) {
+		return extbmap(sfi, fileblock);
+	}
+
 	if (fileblock < INOMAX_D) {
 		return GET_D(sfi, fileblock);
 	}
@@ -264,6 +368,25 @@ sfs_writeindirect(uint32_t blocknum, uint32_t *entries)
 	swapindir(entries);
 }
 
+/*
+ *  extent tree blocks - blocknum is a disk block number.
+ */
+
+void
+sfs_readextblock(uint32_t blocknum, struct sfs_extblock *eb)
+{
+	diskread(eb, blocknum);
+	swapextblock(eb);
+}
+
+void
+sfs_writeextblock(uint32_t blocknum, struct sfs_extblock *eb)
+{
+	swapextblock(eb);
+	diskwrite(eb, blocknum);
+	swapextblock(eb);
+}
+
 ////////////////////////////////////////////////////////////
 // directory I/O
 
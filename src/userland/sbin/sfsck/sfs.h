@@ -40,6 +40,7 @@
 
 struct sfs_superblock;
 struct sfs_dinode;
+struct sfs_extblock;
 struct sfs_direntry;
 
 /* Call this before anything else in this module */
@@ -65,6 +66,10 @@ void sfs_writeinode(uint32_t inum, struct sfs_dinode *sfi);
 void sfs_readindirect(uint32_t blocknum, uint32_t *entries);
 void sfs_writeindirect(uint32_t blocknum, uint32_t *entries);
 
+/* extent tree block */
+void sfs_readextblock(uint32_t blocknum, struct sfs_extblock *eb);
+void sfs_writeextblock(uint32_t blocknum, struct sfs_extblock *eb);
+
 /* directory - ND should be the number of directory entries D points to */
 void sfs_readdir(struct sfs_dinode *sfi, struct sfs_direntry *d, unsigned nd);
 void sfs_writedir(const struct sfs_dinode *sfi,
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* pmatmult.c
+ *    matmult, with the multiplication split across several user
+ *    threads sharing the one address space. Each thread does a
+ *    disjoint set of rows, so no locking is needed.
+ *
+ *    Then it creates NCHURN more threads that do nothing and that it
+ *    never joins, half of them detached, to check that threads which
+ *    have exited don't use up the process's thread slots.
+ *
+ *    Usage: pmatmult [nthreads]
+ */
+
+#include <stdlib.h>
+#include <err.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <test161/test161.h>
+
+#define Dim 	72	/* sum total of the arrays doesn't fit in
+			 * physical memory
+			 */
+
+#define RIGHT  8772192		/* correct answer */
+
+#define DEFAULT_THREADS	4
+#define MAX_THREADS	16
+#define NCHURN		(3 * MAX_THREADS)
+#define NRETRIES	100	/* waits for a thread to exit, 10 ms each */
+
+int A[Dim][Dim];
+int B[Dim][Dim];
+int C[Dim][Dim];
+int T[Dim][Dim][Dim];
+
+static int nthreads;
+
+static
+void *
+idler(void *arg)
+{
+	return arg;
+}
+
+/*
+ * Create NCHURN idle threads and let them go. A create may have to
+ * wait for earlier ones to exit, but not for them to be joined.
+ * Returns the number created.
+ */
+static
+int
+churn(void)
+{
+	struct timespec ts;
+	int i, tries, tid;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = 10000000;
+	for (i = 0; i < NCHURN; i++) {
+		tries = 0;
+		while ((tid = thread_create(idler, NULL)) < 0) {
+			if (errno != EAGAIN || ++tries > NRETRIES) {
+				warn("thread_create: thread %d", i);
+				return i;
+			}
+			nanosleep(&ts, NULL);
+		}
+		if (i % 2 == 0 && thread_detach(tid) < 0) {
+			warn("thread_detach: thread %d", i);
+			return i;
+		}
+	}
+	return i;
+}
+
+/*
+ * Compute rows ID, ID+nthreads, ID+2*nthreads, ... of C. Returns the
+ * number of rows done so main can check that they all got done.
+ */
+static
+void *
+worker(void *arg)
+{
+	int id = (int)arg;
+	int i, j, k, rows;
+
+	rows = 0;
+	for (i = id; i < Dim; i += nthreads) {
+		for (j = 0; j < Dim; j++) {
+			for (k = 0; k < Dim; k++) {
+				T[i][j][k] = A[i][k] * B[k][j];
+			}
+		}
+		for (j = 0; j < Dim; j++) {
+			for (k = 0; k < Dim; k++) {
+				C[i][j] += T[i][j][k];
+			}
+		}
+		rows++;
+	}
+	return (void *)rows;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int tids[MAX_THREADS];
+	void *rows;
+	int i, j, r, done, churned;
+
+	nthreads = DEFAULT_THREADS;
+	if (argc > 1) {
+		nthreads = atoi(argv[1]);
+	}
+	if (nthreads < 1 || nthreads > MAX_THREADS) {
+		printf("Usage: pmatmult [nthreads], 1 <= nthreads <= %d\n",
+		       MAX_THREADS);
+		return 1;
+	}
+
+	for (i = 0; i < Dim; i++) {	/* first initialize the matrices */
+		for (j = 0; j < Dim; j++) {
+			TEST161_LPROGRESS_N(i*Dim + j, 1000);
+			A[i][j] = i;
+			B[i][j] = j;
+			C[i][j] = 0;
+		}
+	}
+	nprintf("\n");
+
+	for (i = 0; i < nthreads; i++) {	/* then multiply them */
+		tids[i] = thread_create(worker, (void *)i);
+		if (tids[i] < 0) {
+			err(1, "thread_create");
+		}
+	}
+
+	done = 0;
+	for (i = 0; i < nthreads; i++) {
+		if (thread_join(tids[i], &rows) < 0) {
+			err(1, "thread_join");
+		}
+		done += (int)rows;
+	}
+
+	r = 0;
+	for (i = 0; i < Dim; i++)
+		r += C[i][i];
+
+	churned = churn();
+
+	nprintf("pmatmult finished with %d threads.\n", nthreads);
+	nprintf("answer is: %d (should be %d)\n", r, RIGHT);
+	nprintf("unjoined threads created: %d (should be %d)\n",
+		churned, NCHURN);
+	if (r != RIGHT || done != Dim || churned != NCHURN) {
+		nprintf("FAILED\n");
+		success(TEST161_FAIL, SECRET, "/testbin/pmatmult");
+		return 1;
+	}
+
+	nprintf("Passed.\n");
+	success(TEST161_SUCCESS, SECRET, "/testbin/pmatmult");
+	return 0;
+}
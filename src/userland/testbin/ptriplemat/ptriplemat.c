@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * ptriplemat.c
+ *
+ * 	Like triplemat, runs three matmults at once, but as three
+ * 	threads in one process instead of three processes. Each
+ * 	thread has its own set of matrices.
+ *
+ * When the VM assignment is complete, your system should survive this.
+ */
+
+#include <unistd.h>
+#include <err.h>
+#include <stdio.h>
+#include <test161/test161.h>
+
+#define Dim 	72
+#define RIGHT  8772192		/* correct answer */
+#define NCOPIES	3
+
+struct mats {
+	int A[Dim][Dim];
+	int B[Dim][Dim];
+	int C[Dim][Dim];
+	int T[Dim][Dim][Dim];
+};
+
+static struct mats mats[NCOPIES];
+
+/*
+ * One matmult. Returns the trace of the product.
+ */
+static
+void *
+matmult(void *arg)
+{
+	struct mats *m = arg;
+	int i, j, k, r;
+
+	for (i = 0; i < Dim; i++) {
+		for (j = 0; j < Dim; j++) {
+			m->A[i][j] = i;
+			m->B[i][j] = j;
+			m->C[i][j] = 0;
+		}
+	}
+
+	for (i = 0; i < Dim; i++) {
+		for (j = 0; j < Dim; j++) {
+			for (k = 0; k < Dim; k++) {
+				m->T[i][j][k] = m->A[i][k] * m->B[k][j];
+			}
+		}
+	}
+
+	for (i = 0; i < Dim; i++) {
+		for (j = 0; j < Dim; j++) {
+			for (k = 0; k < Dim; k++) {
+				m->C[i][j] += m->T[i][j][k];
+			}
+		}
+	}
+
+	r = 0;
+	for (i = 0; i < Dim; i++) {
+		r += m->C[i][i];
+	}
+	return (void *)r;
+}
+
+int
+main(void)
+{
+	int tids[NCOPIES];
+	void *r;
+	int i, failed;
+
+	for (i = 0; i < NCOPIES; i++) {
+		tids[i] = thread_create(matmult, &mats[i]);
+		if (tids[i] < 0) {
+			err(1, "thread_create");
+		}
+	}
+
+	failed = 0;
+	for (i = 0; i < NCOPIES; i++) {
+		if (thread_join(tids[i], &r) < 0) {
+			err(1, "thread_join");
+		}
+		nprintf("matmult %d: answer is %d (should be %d)\n",
+			i, (int)r, RIGHT);
+		if ((int)r != RIGHT) {
+			failed = 1;
+		}
+	}
+
+	if (failed) {
+		nprintf("FAILED\n");
+		success(TEST161_FAIL, SECRET, "/testbin/ptriplemat");
+		return 1;
+	}
+
+	nprintf("Passed.\n");
+	success(TEST161_SUCCESS, SECRET, "/testbin/ptriplemat");
+	return 0;
+}
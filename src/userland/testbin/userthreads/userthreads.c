@@ -32,19 +32,11 @@
  * forks 3 threads off 2 to functions, each of which displays a string
  * every once in a while.
  *
- * This won't do much of anything unless you implement user-level
- * threads.
+ * Threads are created with thread_create(). The parent doesn't wait
+ * for them; child threads keep running after it leaves, and exit
+ * when they return from the function they started in.
  *
- * It also makes various assumptions about the thread API. In
- * particular, it believes (1) that you create a thread by calling
- * "threadfork()" and passing the address for execution of the new
- * thread to begin at, (2) that if the parent thread exits any child
- * threads will keep running, and (3) child threads will exit if they
- * return from the function they started in. If any or all of these
- * assumptions are not met by your user-level threads, you will need
- * to patch this test accordingly.
- *
- * This is also a rather basic test and you'll probably want to write
+ * This is a rather basic test and you'll probably want to write
  * some more of your own.
  */
 
@@ -61,8 +53,8 @@
 volatile int count = 0;
 
 /* the 2 threads : */
-void ThreadRunner(void);
-void BladeRunner(void);
+void *ThreadRunner(void *);
+void *BladeRunner(void *);
 
 int
 main(int argc, char *argv[])
@@ -74,13 +66,14 @@ main(int argc, char *argv[])
 
     for (i=0; i<NTHREADS; i++) {
 	if (i)
-	    threadfork(ThreadRunner);
+	    thread_create(ThreadRunner, NULL);
         else
-	    threadfork(BladeRunner);
+	    thread_create(BladeRunner, NULL);
     }
 
     tprintf("Parent has left.\n");
-    return 0;
+    /* Exit only this thread; returning would end the whole process. */
+    thread_exit(NULL);
 }
 
 /* multiple threads will simply print out the global variable.
@@ -88,22 +81,26 @@ main(int argc, char *argv[])
    random results.
 */
 
-void
-BladeRunner()
+void *
+BladeRunner(void *junk)
 {
+    (void)junk;
     while (count < MAX) {
 	if (count % 500 == 0)
 	    tprintf("Blade ");
 	count++;
     }
+    return NULL;
 }
 
-void
-ThreadRunner()
+void *
+ThreadRunner(void *junk)
 {
+    (void)junk;
     while (count < MAX) {
 	if (count % 513 == 0)
 	    tprintf(" Runner\n");
 	count++;
     }
+    return NULL;
 }
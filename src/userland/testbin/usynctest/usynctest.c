@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/* usynctest.c
+ *    Test the futex-based mutexes and semaphores in <usync.h> with
+ *    several user threads.
+ *
+ *    First, threads bump a shared counter under a mutex with a
+ *    deliberately slow read-modify-write, so a broken mutex loses
+ *    updates. Then producer and consumer threads pass numbered items
+ *    through a small ring buffer guarded by semaphores; the consumers
+ *    must see each item exactly once.
+ */
+
+#include <stdlib.h>
+#include <err.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <usync.h>
+#include <test161/test161.h>
+
+#define NTHREADS	4
+#define LOOPS		2000
+
+#define NCONSUMERS	3
+#define NITEMS		3000
+#define RINGSIZE	8
+
+static struct umutex countlock = UMUTEX_INITIALIZER;
+static volatile int counter;
+
+static struct umutex ringlock = UMUTEX_INITIALIZER;
+static struct usema ringfree = USEMA_INITIALIZER(RINGSIZE);
+static struct usema ringfull = USEMA_INITIALIZER(0);
+static int ring[RINGSIZE];
+static unsigned ringhead, ringtail;
+static volatile char seen[NITEMS + 1];
+
+static
+void *
+counter_thread(void *arg)
+{
+	int i, j, tmp;
+
+	(void)arg;
+	for (i = 0; i < LOOPS; i++) {
+		umutex_lock(&countlock);
+		tmp = counter;
+		for (j = 0; j < 50; j++) {
+			/* widen the window */
+		}
+		counter = tmp + 1;
+		umutex_unlock(&countlock);
+	}
+	return NULL;
+}
+
+static
+void
+ring_put(int item)
+{
+	usema_P(&ringfree);
+	umutex_lock(&ringlock);
+	ring[ringhead] = item;
+	ringhead = (ringhead + 1) % RINGSIZE;
+	umutex_unlock(&ringlock);
+	usema_V(&ringfull);
+}
+
+static
+int
+ring_get(void)
+{
+	int item;
+
+	usema_P(&ringfull);
+	umutex_lock(&ringlock);
+	item = ring[ringtail];
+	ringtail = (ringtail + 1) % RINGSIZE;
+	umutex_unlock(&ringlock);
+	usema_V(&ringfree);
+	return item;
+}
+
+/*
+ * Take items until we get a 0. Returns the number of bad items
+ * (out of range or already seen).
+ */
+static
+void *
+consumer_thread(void *arg)
+{
+	int item, bad;
+
+	(void)arg;
+	bad = 0;
+	while ((item = ring_get()) != 0) {
+		if (item < 0 || item > NITEMS || seen[item]) {
+			bad++;
+			continue;
+		}
+		seen[item] = 1;
+	}
+	return (void *)bad;
+}
+
+int
+main(void)
+{
+	int tids[NTHREADS > NCONSUMERS ? NTHREADS : NCONSUMERS];
+	void *ret;
+	int i, bad;
+
+	nprintf("usynctest: mutex...\n");
+	for (i = 0; i < NTHREADS; i++) {
+		tids[i] = thread_create(counter_thread, NULL);
+		if (tids[i] < 0) {
+			err(1, "thread_create");
+		}
+	}
+	for (i = 0; i < NTHREADS; i++) {
+		if (thread_join(tids[i], NULL) < 0) {
+			err(1, "thread_join");
+		}
+	}
+	nprintf("counter is %d (should be %d)\n", counter, NTHREADS * LOOPS);
+	if (counter != NTHREADS * LOOPS) {
+		nprintf("FAILED\n");
+		success(TEST161_FAIL, SECRET, "/testbin/usynctest");
+		return 1;
+	}
+
+	nprintf("usynctest: semaphores...\n");
+	for (i = 0; i < NCONSUMERS; i++) {
+		tids[i] = thread_create(consumer_thread, NULL);
+		if (tids[i] < 0) {
+			err(1, "thread_create");
+		}
+	}
+	for (i = 1; i <= NITEMS; i++) {
+		TEST161_LPROGRESS_N(i, 500);
+		ring_put(i);
+	}
+	for (i = 0; i < NCONSUMERS; i++) {
+		ring_put(0);
+	}
+	nprintf("\n");
+
+	bad = 0;
+	for (i = 0; i < NCONSUMERS; i++) {
+		if (thread_join(tids[i], &ret) < 0) {
+			err(1, "thread_join");
+		}
+		bad += (int)ret;
+	}
+	for (i = 1; i <= NITEMS; i++) {
+		if (!seen[i]) {
+			bad++;
+		}
+	}
+	if (bad != 0) {
+		nprintf("%d items lost or duplicated\n", bad);
+		nprintf("FAILED\n");
+		success(TEST161_FAIL, SECRET, "/testbin/usynctest");
+		return 1;
+	}
+
+	nprintf("Passed.\n");
+	success(TEST161_SUCCESS, SECRET, "/testbin/usynctest");
+	return 0;
+}